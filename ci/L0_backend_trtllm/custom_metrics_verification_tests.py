@@ -53,6 +53,44 @@ metric_to_stat_dict = {
     "v1_specific_metric=empty_generation_slots": "Empty Generation Slots",
     "general_type=iteration_counter": "Iteration Counter",
     "general_type=timestamp": "Timestamp",
+    "lora_scheduling_type=estimated_resident_hits":
+    "LoRA Scheduling Estimated Resident Hits",
+    "lora_scheduling_type=estimated_resident_misses":
+    "LoRA Scheduling Estimated Resident Misses",
+    "lora_adapter_store_type=loads": "LoRA Adapter Store Loads",
+    "lora_adapter_store_type=load_time_us": "LoRA Adapter Store Load Time",
+    "lora_adapter_store_type=hits": "LoRA Adapter Store Hits",
+    "lora_adapter_store_type=bytes": "LoRA Adapter Store Bytes",
+    "lora_adapter_store_type=estimated_engine_cache_hits":
+    "LoRA Adapter Store Estimated Engine Cache Hits",
+    "prompt_table_cache_type=hits": "Prompt Table Cache Hits",
+    "prompt_table_cache_type=misses": "Prompt Table Cache Misses",
+    "prompt_table_cache_type=bytes_saved": "Prompt Table Cache Bytes Saved",
+    "session_store_type=hits": "Session Store Hits",
+    "session_store_type=reused_tokens": "Session Store Reused Tokens",
+    "speculative_decoding_type=draft_tokens":
+    "Speculative Decoding Draft Tokens",
+    "speculative_decoding_type=accepted_tokens":
+    "Speculative Decoding Accepted Tokens",
+    "speculative_decoding_type=rounds": "Speculative Decoding Rounds",
+    "speculative_decoding_type=fallbacks": "Speculative Decoding Fallbacks",
+    "answer_dispatch_type=workers": "Answer Dispatch Workers",
+    "answer_dispatch_type=queued": "Answer Dispatch Queued",
+    "answer_dispatch_type=dispatched": "Answer Dispatch Count",
+    "answer_dispatch_type=receive_time_us": "Answer Dispatch Receive Time",
+    "answer_dispatch_type=queue_time_us": "Answer Dispatch Queue Time",
+    "answer_dispatch_type=send_time_us": "Answer Dispatch Send Time",
+    "worker_pool_type=idle": "Worker Pool Idle Workers",
+    "worker_pool_type=hits": "Worker Pool Hits",
+    "worker_pool_type=misses": "Worker Pool Misses",
+    "worker_load_type=load_time_us": "Worker Load Time",
+    "drain_type=draining": "Drain Active",
+    "drain_type=handed_over": "Drain Handed Over Work Items",
+    "drain_type=remaining": "Drain Remaining Work Items",
+    "rejection_type=input_length": "Request Validation Input Length Rejections",
+    "rejection_type=sequence_length": "Request Validation Sequence Length Rejections",
+    "rejection_type=token_id": "Request Validation Token Id Rejections",
+    "rejection_type=beam_width": "Request Validation Beam Width Rejections",
 }
 
 
@@ -59,6 +59,53 @@ const std::vector<std::string> CustomMetricsReporter::IFB_specific_labels_{
 const std::vector<std::string> CustomMetricsReporter::general_metric_keys_{"Timestamp", "Iteration Counter"};
 const std::vector<std::string> CustomMetricsReporter::general_metric_labels_{"timestamp", "iteration_counter"};
 
+const std::vector<std::string> CustomMetricsReporter::lora_scheduling_keys_{
+    "LoRA Scheduling Estimated Resident Hits", "LoRA Scheduling Estimated Resident Misses"};
+const std::vector<std::string> CustomMetricsReporter::lora_scheduling_labels_{
+    "estimated_resident_hits", "estimated_resident_misses"};
+
+const std::vector<std::string> CustomMetricsReporter::lora_adapter_store_keys_{"LoRA Adapter Store Loads",
+    "LoRA Adapter Store Load Time", "LoRA Adapter Store Hits", "LoRA Adapter Store Bytes",
+    "LoRA Adapter Store Estimated Engine Cache Hits"};
+const std::vector<std::string> CustomMetricsReporter::lora_adapter_store_labels_{
+    "loads", "load_time_us", "hits", "bytes", "estimated_engine_cache_hits"};
+
+const std::vector<std::string> CustomMetricsReporter::prompt_table_cache_keys_{
+    "Prompt Table Cache Hits", "Prompt Table Cache Misses", "Prompt Table Cache Bytes Saved"};
+const std::vector<std::string> CustomMetricsReporter::prompt_table_cache_labels_{"hits", "misses", "bytes_saved"};
+
+const std::vector<std::string> CustomMetricsReporter::session_store_keys_{
+    "Session Store Hits", "Session Store Reused Tokens"};
+const std::vector<std::string> CustomMetricsReporter::session_store_labels_{"hits", "reused_tokens"};
+
+const std::vector<std::string> CustomMetricsReporter::speculative_decoding_keys_{"Speculative Decoding Draft Tokens",
+    "Speculative Decoding Accepted Tokens", "Speculative Decoding Rounds", "Speculative Decoding Fallbacks"};
+const std::vector<std::string> CustomMetricsReporter::speculative_decoding_labels_{
+    "draft_tokens", "accepted_tokens", "rounds", "fallbacks"};
+
+const std::vector<std::string> CustomMetricsReporter::answer_dispatch_keys_{"Answer Dispatch Workers",
+    "Answer Dispatch Queued", "Answer Dispatch Count", "Answer Dispatch Receive Time", "Answer Dispatch Queue Time",
+    "Answer Dispatch Send Time"};
+const std::vector<std::string> CustomMetricsReporter::answer_dispatch_labels_{
+    "workers", "queued", "dispatched", "receive_time_us", "queue_time_us", "send_time_us"};
+
+const std::vector<std::string> CustomMetricsReporter::worker_pool_keys_{
+    "Worker Pool Idle Workers", "Worker Pool Hits", "Worker Pool Misses"};
+const std::vector<std::string> CustomMetricsReporter::worker_pool_labels_{"idle", "hits", "misses"};
+
+const std::vector<std::string> CustomMetricsReporter::worker_load_keys_{"Worker Load Time"};
+const std::vector<std::string> CustomMetricsReporter::worker_load_labels_{"load_time_us"};
+
+const std::vector<std::string> CustomMetricsReporter::drain_keys_{
+    "Drain Active", "Drain Handed Over Work Items", "Drain Remaining Work Items"};
+const std::vector<std::string> CustomMetricsReporter::drain_labels_{"draining", "handed_over", "remaining"};
+
+const std::vector<std::string> CustomMetricsReporter::request_validation_keys_{
+    "Request Validation Input Length Rejections", "Request Validation Sequence Length Rejections",
+    "Request Validation Token Id Rejections", "Request Validation Beam Width Rejections"};
+const std::vector<std::string> CustomMetricsReporter::request_validation_labels_{
+    "input_length", "sequence_length", "token_id", "beam_width"};
+
 uint64_t convertTimestampToSeconds(std::string const& ts)
 {
     std::tm tm = {};
@@ -93,8 +140,11 @@ TRITONSERVER_Error* TritonMetricGroup::CreateGroup(std::string const& model_name
         TRITONSERVER_ParameterNew("model", TRITONSERVER_PARAMETER_STRING, model_name.c_str()));
     std::unique_ptr<TRITONSERVER_Parameter, ParameterDeleter> model_version(
         TRITONSERVER_ParameterNew("version", TRITONSERVER_PARAMETER_STRING, std::to_string(version).c_str()));
-    labels.emplace_back(model_label.get());
-    labels.emplace_back(model_version.get());
+    if (!model_name.empty())
+    {
+        labels.emplace_back(model_label.get());
+        labels.emplace_back(model_version.get());
+    }
 
     for (size_t i = 0; i < sub_labels_.size(); ++i)
     {
@@ -128,6 +178,9 @@ std::vector<std::string> const& TritonMetricGroup::JsonKeys() const
 TRITONSERVER_Error* CustomMetricsReporter::InitializeReporter(
     std::string const& model_name, const uint64_t version, bool const is_v1_model)
 {
+    model_name_ = model_name;
+    model_version_ = version;
+
     /* REQUEST METRIC GROUP */
     request_metric_family_ = std::make_unique<TritonMetricGroup>(
         "nv_trt_llm_request_metrics", "TRT LLM request metrics", "request_type", request_keys_, request_labels_);
@@ -179,6 +232,41 @@ TRITONSERVER_Error* CustomMetricsReporter::InitializeReporter(
     return nullptr; // success
 }
 
+TRITONSERVER_Error* CustomMetricsReporter::InitializeOrchestratorReporter(
+    std::string const& model_name, const uint64_t version)
+{
+    model_name_ = model_name;
+    model_version_ = version;
+
+    /* WORKER LOAD METRIC GROUP */
+    return AddMetricGroup("nv_trt_llm_worker_load_metrics", "TRT LLM orchestrator worker load metrics",
+        "worker_load_type", worker_load_keys_, worker_load_labels_);
+}
+
+TRITONSERVER_Error* CustomMetricsReporter::InitializeOrchestratorWideReporter()
+{
+    /* ANSWER DISPATCH METRIC GROUP */
+    RETURN_IF_ERROR(AddMetricGroup("nv_trt_llm_answer_dispatch_metrics", "TRT LLM orchestrator answer dispatch metrics",
+        "answer_dispatch_type", answer_dispatch_keys_, answer_dispatch_labels_));
+
+    /* WORKER POOL METRIC GROUP */
+    return AddMetricGroup("nv_trt_llm_worker_pool_metrics", "TRT LLM orchestrator worker pool metrics",
+        "worker_pool_type", worker_pool_keys_, worker_pool_labels_);
+}
+
+TRITONSERVER_Error* CustomMetricsReporter::AddMetricGroup(std::string const& metric_family_label,
+    std::string const& metric_family_description, std::string const& category_label,
+    std::vector<std::string> const& json_keys, std::vector<std::string> const& labels)
+{
+    auto metric_group = std::make_unique<TritonMetricGroup>(
+        metric_family_label, metric_family_description, category_label, json_keys, labels);
+
+    RETURN_IF_ERROR(metric_group->CreateGroup(model_name_, model_version_));
+    metric_groups_.push_back(std::move(metric_group));
+
+    return nullptr; // success
+}
+
 TRITONSERVER_Error* CustomMetricsReporter::UpdateCustomMetrics(std::string const& custom_metrics)
 {
     triton::common::TritonJson::Value metrics;
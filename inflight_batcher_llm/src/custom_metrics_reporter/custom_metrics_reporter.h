@@ -53,7 +53,8 @@ public:
     /// pointers and parameters.
     ///
     /// \param model_name The name of the model to provide a metrics
-    /// group for.
+    /// group for, empty for metrics that do not belong to a model,
+    /// which have no model and version labels.
     /// \param version The version of the model to provide a metrics
     /// group for.
     /// \return a TRITONSERVER_Error indicating success or failure.
@@ -141,6 +142,22 @@ public:
     /// \return a TRITONSERVER_Error indicating success or failure.
     TRITONSERVER_Error* InitializeReporter(std::string const& model, const uint64_t version, bool const is_v1_model);
 
+    /// Initialize the TritonMetricGroups of an orchestrator instance,
+    /// which only reports the statistics of its workers. The engine
+    /// statistics are not available in the orchestrator process.
+    ///
+    /// \param model The name of the model to provide metrics for.
+    /// \param version The version of the model to provide metrics for.
+    /// \return a TRITONSERVER_Error indicating success or failure.
+    TRITONSERVER_Error* InitializeOrchestratorReporter(std::string const& model, const uint64_t version);
+
+    /// Initialize the TritonMetricGroups of the statistics shared by
+    /// all the models of the orchestrator, its answer dispatch and its
+    /// worker pool, which are reported without model and version labels.
+    ///
+    /// \return a TRITONSERVER_Error indicating success or failure.
+    TRITONSERVER_Error* InitializeOrchestratorWideReporter();
+
     /// Updates the vector of TritonMetricGroup objects with a
     /// JSON-formatted statistics string.
     ///
@@ -149,6 +166,20 @@ public:
     /// \return a TRITONSERVER_Error indicating success or failure.
     TRITONSERVER_Error* UpdateCustomMetrics(std::string const& custom_metrics);
 
+    /// Create an additional TritonMetricGroup for statistics that the
+    /// backend appends to the TRT LLM statistics. Must be called after
+    /// InitializeReporter.
+    ///
+    /// \param metric_family_label The name of the metric family.
+    /// \param metric_family_description The description of the metric family.
+    /// \param category_label The label distinguishing the metrics of the group.
+    /// \param json_keys The JSON keys of the statistics handled by the group.
+    /// \param labels The label values associated with each JSON key.
+    /// \return a TRITONSERVER_Error indicating success or failure.
+    TRITONSERVER_Error* AddMetricGroup(std::string const& metric_family_label,
+        std::string const& metric_family_description, std::string const& category_label,
+        std::vector<std::string> const& json_keys, std::vector<std::string> const& labels);
+
     static const std::vector<std::string> request_keys_;
     static const std::vector<std::string> request_labels_;
 
@@ -167,7 +198,39 @@ public:
     static const std::vector<std::string> general_metric_keys_;
     static const std::vector<std::string> general_metric_labels_;
 
+    static const std::vector<std::string> lora_scheduling_keys_;
+    static const std::vector<std::string> lora_scheduling_labels_;
+
+    static const std::vector<std::string> lora_adapter_store_keys_;
+    static const std::vector<std::string> lora_adapter_store_labels_;
+
+    static const std::vector<std::string> prompt_table_cache_keys_;
+    static const std::vector<std::string> prompt_table_cache_labels_;
+
+    static const std::vector<std::string> session_store_keys_;
+    static const std::vector<std::string> session_store_labels_;
+
+    static const std::vector<std::string> speculative_decoding_keys_;
+    static const std::vector<std::string> speculative_decoding_labels_;
+
+    static const std::vector<std::string> answer_dispatch_keys_;
+    static const std::vector<std::string> answer_dispatch_labels_;
+
+    static const std::vector<std::string> worker_pool_keys_;
+    static const std::vector<std::string> worker_pool_labels_;
+
+    static const std::vector<std::string> worker_load_keys_;
+    static const std::vector<std::string> worker_load_labels_;
+
+    static const std::vector<std::string> drain_keys_;
+    static const std::vector<std::string> drain_labels_;
+
+    static const std::vector<std::string> request_validation_keys_;
+    static const std::vector<std::string> request_validation_labels_;
+
 private:
+    std::string model_name_;
+    uint64_t model_version_{0};
     std::vector<std::unique_ptr<TritonMetricGroup>> metric_groups_;
     std::unique_ptr<TritonMetricGroup> request_metric_family_;
     std::unique_ptr<TritonMetricGroup> runtime_memory_metric_family_;
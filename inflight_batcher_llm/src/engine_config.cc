@@ -0,0 +1,136 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "engine_config.h"
+
+#include "tensorrt_llm/common/assert.h"
+
+#include <fstream>
+#include <nlohmann/json.hpp>
+
+namespace triton::backend::inflight_batcher_llm
+{
+
+namespace
+{
+
+std::optional<nvinfer1::DataType> parseDataType(std::string const& dataType)
+{
+    if (dataType == "float16")
+    {
+        return nvinfer1::DataType::kHALF;
+    }
+    if (dataType == "bfloat16")
+    {
+        return nvinfer1::DataType::kBF16;
+    }
+    if (dataType == "float32")
+    {
+        return nvinfer1::DataType::kFLOAT;
+    }
+    return std::nullopt;
+}
+
+/// @brief Member of the first section of the configuration that has it with the expected type
+/// @param isType Type check of nlohmann::json, e.g. &nlohmann::json::is_string
+template <typename T>
+std::optional<T> findMember(nlohmann::json const& json, std::initializer_list<char const*> sections,
+    std::string const& name, bool (nlohmann::json::*isType)() const noexcept)
+{
+    for (auto const* section : sections)
+    {
+        auto const it = json.find(section);
+        if (it != json.end() && it->is_object() && it->contains(name) && (it->at(name).*isType)())
+        {
+            return it->at(name).get<T>();
+        }
+    }
+    return std::nullopt;
+}
+
+} // namespace
+
+EngineConfig EngineConfig::load(std::string const& enginePath)
+{
+    auto configPath = enginePath + "/config.json";
+    std::ifstream jsonStream(configPath);
+    TLLM_CHECK_WITH_INFO(jsonStream.is_open(), "Cannot find engine config file %s", configPath.c_str());
+
+    auto constexpr allowExceptions = true;
+    auto constexpr ignoreComments = true;
+    auto const json = nlohmann::json::parse(jsonStream, nullptr, allowExceptions, ignoreComments);
+
+    EngineConfig config;
+
+    // The build parameters are in build_config, and in builder_config for the engines of older versions
+    auto const getLimit = [&json](std::string const& name)
+    {
+        return findMember<int32_t>(
+            json, {"build_config", "builder_config", "pretrained_config"}, name, &nlohmann::json::is_number_integer);
+    };
+    auto& limits = config.limits;
+    limits.maxInputLen = getLimit("max_input_len");
+    limits.maxSequenceLen = getLimit("max_seq_len");
+    if (!limits.maxSequenceLen)
+    {
+        auto const maxOutputLen = getLimit("max_output_len");
+        if (limits.maxInputLen && maxOutputLen)
+        {
+            limits.maxSequenceLen = limits.maxInputLen.value() + maxOutputLen.value();
+        }
+    }
+    limits.maxBeamWidth = getLimit("max_beam_width");
+    limits.vocabSize = getLimit("vocab_size");
+
+    // The data types are in pretrained_config, and in builder_config for the engines of older versions
+    auto const getDataType = [&json](std::string const& name) -> std::optional<nvinfer1::DataType>
+    {
+        auto const dataType
+            = findMember<std::string>(json, {"pretrained_config", "builder_config"}, name, &nlohmann::json::is_string);
+        return dataType ? parseDataType(dataType.value()) : std::nullopt;
+    };
+    auto& dataTypes = config.dataTypes;
+    dataTypes.model = getDataType("dtype");
+    if (!dataTypes.model)
+    {
+        dataTypes.model = getDataType("precision");
+    }
+    dataTypes.logits = getDataType("logits_dtype");
+
+    // gather_all_token_logits enables both in the engines of older versions
+    auto const getFlag = [&json](std::string const& name)
+    {
+        return findMember<bool>(json, {"build_config", "builder_config"}, name, &nlohmann::json::is_boolean)
+            .value_or(false);
+    };
+    auto const gatherAllTokenLogits = getFlag("gather_all_token_logits");
+    dataTypes.gatherContextLogits = gatherAllTokenLogits || getFlag("gather_context_logits");
+    dataTypes.gatherGenerationLogits = gatherAllTokenLogits || getFlag("gather_generation_logits");
+    return config;
+}
+
+} // namespace triton::backend::inflight_batcher_llm
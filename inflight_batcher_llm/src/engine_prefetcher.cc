@@ -0,0 +1,174 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "engine_prefetcher.h"
+
+#include "tensorrt_llm/common/logger.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <fcntl.h>
+#include <filesystem>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace triton::backend::inflight_batcher_llm
+{
+
+namespace
+{
+
+uint64_t nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+} // namespace
+
+EnginePrefetcher::EnginePrefetcher(
+    std::string const& modelPath, int32_t concurrency, size_t chunkBytes, int32_t rank, int32_t worldSize)
+    : mChunkBytes(std::max<size_t>(chunkBytes, 1))
+    , mStartNs(nowNs())
+{
+    // Each rank loads its own engine file, e.g. rank1.engine or llama_float16_tp2_rank1.engine
+    std::string const rankSuffix = "rank" + std::to_string(rank);
+    std::vector<std::string> engineFiles;
+    std::error_code ec;
+    for (auto const& entry : std::filesystem::directory_iterator(modelPath, ec))
+    {
+        if (!entry.is_regular_file(ec) || entry.path().extension() != ".engine")
+        {
+            continue;
+        }
+        auto const stem = entry.path().stem().string();
+        bool const isRankFile = stem.size() >= rankSuffix.size()
+            && stem.compare(stem.size() - rankSuffix.size(), rankSuffix.size(), rankSuffix) == 0
+            && (stem.size() == rankSuffix.size() || !std::isdigit(stem[stem.size() - rankSuffix.size() - 1]));
+        // A single-rank engine may not be named after its rank
+        if (isRankFile || worldSize <= 1)
+        {
+            engineFiles.push_back(entry.path().string());
+        }
+    }
+    std::sort(engineFiles.begin(), engineFiles.end());
+
+    for (size_t i = 0; i < engineFiles.size(); ++i)
+    {
+        int const fd = open(engineFiles[i].c_str(), O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0)
+        {
+            TLLM_LOG_WARNING("Cannot prefetch engine file %s", engineFiles[i].c_str());
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+            continue;
+        }
+
+        // Let the kernel start reading ahead while the chunks are queued
+        posix_fadvise(fd, 0, st.st_size, POSIX_FADV_WILLNEED);
+        for (int64_t offset = 0; offset < st.st_size; offset += mChunkBytes)
+        {
+            mChunks.push_back(
+                Chunk{mFds.size(), offset, static_cast<size_t>(std::min<int64_t>(mChunkBytes, st.st_size - offset))});
+        }
+        mFiles.push_back(engineFiles[i]);
+        mFds.push_back(fd);
+    }
+
+    auto const numThreads = std::min<size_t>(std::max(concurrency, 1), mChunks.size());
+    for (size_t i = 0; i < numThreads; ++i)
+    {
+        mThreads.emplace_back([this]() { readChunks(); });
+    }
+}
+
+EnginePrefetcher::~EnginePrefetcher()
+{
+    // Stop the threads early if the prefetch was not waited for, e.g. after an error
+    mNextChunk.store(mChunks.size());
+    for (auto& thread : mThreads)
+    {
+        if (thread.joinable())
+        {
+            thread.join();
+        }
+    }
+    for (auto fd : mFds)
+    {
+        close(fd);
+    }
+}
+
+void EnginePrefetcher::readChunks()
+{
+    std::vector<char> buffer(mChunkBytes);
+    while (true)
+    {
+        auto const chunkIdx = mNextChunk.fetch_add(1);
+        if (chunkIdx >= mChunks.size())
+        {
+            break;
+        }
+
+        auto const& chunk = mChunks[chunkIdx];
+        size_t numRead = 0;
+        while (numRead < chunk.size)
+        {
+            auto const n = pread(mFds[chunk.fileIdx], buffer.data(), chunk.size - numRead, chunk.offset + numRead);
+            if (n <= 0)
+            {
+                TLLM_LOG_WARNING("Failed to prefetch engine file %s", mFiles[chunk.fileIdx].c_str());
+                break;
+            }
+            numRead += n;
+        }
+        mNumBytes += numRead;
+    }
+}
+
+void EnginePrefetcher::wait()
+{
+    for (auto& thread : mThreads)
+    {
+        if (thread.joinable())
+        {
+            thread.join();
+        }
+    }
+
+    auto const elapsedS = static_cast<double>(nowNs() - mStartNs) / 1e9;
+    auto const numMB = static_cast<double>(mNumBytes.load()) / (1 << 20);
+    TLLM_LOG_INFO("Prefetched %zu engine files (%.1f MB) in %.2f s with %zu threads: %.1f MB/s", mFiles.size(),
+        numMB, elapsedS, mThreads.size(), elapsedS > 0 ? numMB / elapsedS : 0.);
+}
+
+} // namespace triton::backend::inflight_batcher_llm
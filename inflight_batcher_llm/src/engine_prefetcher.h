@@ -0,0 +1,81 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace triton::backend::inflight_batcher_llm
+{
+
+/// @brief Read the engine files of a model into the page cache in the background, so that GptManager loads the
+/// engine from memory instead of reading it serially from disk or network storage. The files are split into chunks
+/// read by several threads. With several ranks, each rank reads the engine file of its own rank.
+class EnginePrefetcher
+{
+public:
+    /// @param modelPath Directory holding the engine files
+    /// @param concurrency Number of threads reading the files
+    /// @param chunkBytes Size of the reads, each thread keeps a buffer of that size
+    /// @param rank Rank of this process
+    /// @param worldSize Number of ranks, a single rank reads all the engine files of the directory
+    EnginePrefetcher(
+        std::string const& modelPath, int32_t concurrency, size_t chunkBytes, int32_t rank, int32_t worldSize);
+
+    ~EnginePrefetcher();
+
+    /// @brief Wait for the files to be read and log the achieved throughput
+    void wait();
+
+private:
+    struct Chunk
+    {
+        size_t fileIdx;
+        int64_t offset;
+        size_t size;
+    };
+
+    /// @brief Read the next chunks until none is left
+    void readChunks();
+
+    size_t mChunkBytes;
+    std::vector<std::string> mFiles;
+    std::vector<int> mFds;
+    std::vector<Chunk> mChunks;
+    std::atomic<size_t> mNextChunk{0};
+    std::atomic<uint64_t> mNumBytes{0};
+
+    std::vector<std::thread> mThreads;
+    uint64_t mStartNs{0};
+};
+
+} // namespace triton::backend::inflight_batcher_llm
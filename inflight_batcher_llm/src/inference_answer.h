@@ -80,6 +80,12 @@ public:
 
     static std::shared_ptr<InferenceAnswer> deserialize(int64_t const* packed_ptr);
 
+    /// @brief Read the request id of a serialized answer without deserializing its tensors
+    static uint64_t deserializeRequestId(int64_t const* packed_ptr)
+    {
+        return static_cast<uint64_t>(*packed_ptr);
+    }
+
 private:
     uint64_t request_id_;
     std::list<NamedTensor> response_tensors_;
@@ -0,0 +1,296 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "inprocess_client.h"
+
+#include "model_instance_state.h"
+#include "model_state.h"
+#include "sampling_params.h"
+#include "work_item.h"
+
+#include "tensorrt_llm/batch_manager/inferenceRequest.h"
+#include "tensorrt_llm/common/logger.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace triton::backend::inflight_batcher_llm
+{
+
+namespace
+{
+
+using tensorrt_llm::batch_manager::InferenceRequest;
+using tensorrt_llm::batch_manager::NamedTensor;
+namespace inference_request = tensorrt_llm::batch_manager::inference_request;
+
+std::string const kInputLengthsTensorName = "input_lengths";
+
+/// @brief Add a tensor with the {1, numValues} shape of the Triton inputs to the request
+template <typename T>
+void emplaceInput(InferenceRequest& inferenceRequest, std::string const& name, nvinfer1::DataType dataType,
+    std::vector<T> const& values)
+{
+    NamedTensor tensor(dataType, {1, static_cast<int64_t>(values.size())}, name, values.data());
+    inferenceRequest.emplaceInputTensor(tensor.name, std::move(tensor.tensor));
+}
+
+/// @brief Pack an optional sampling parameter into the block stored in the request
+template <typename T>
+void packOptionalInput(
+    SamplingParams& samplingParams, std::string const& name, nvinfer1::DataType dataType, std::optional<T> value)
+{
+    if (value)
+    {
+        *static_cast<T*>(samplingParams.slot(name, dataType, 1)) = value.value();
+    }
+}
+
+std::shared_ptr<InferenceRequest> createInferenceRequest(InProcessRequest const& request, uint64_t requestId)
+{
+    if (request.inputIds.empty())
+    {
+        throw std::invalid_argument("input_ids of request " + std::to_string(requestId) + " is empty");
+    }
+
+    auto inferenceRequest = std::make_shared<InferenceRequest>(requestId);
+    auto const kINT32 = nvinfer1::DataType::kINT32;
+    auto const kFLOAT = nvinfer1::DataType::kFLOAT;
+    emplaceInput(*inferenceRequest, inference_request::kInputIdsTensorName, kINT32, request.inputIds);
+    emplaceInput(*inferenceRequest, kInputLengthsTensorName, kINT32,
+        std::vector<int32_t>{static_cast<int32_t>(request.inputIds.size())});
+    emplaceInput(
+        *inferenceRequest, inference_request::kMaxNewTokensTensorName, kINT32, std::vector{request.maxNewTokens});
+
+    SamplingParams samplingParams;
+    packOptionalInput(
+        samplingParams, inference_request::kBeamWidthTensorName, kINT32, std::optional{request.beamWidth});
+    packOptionalInput(samplingParams, inference_request::kEndIdTensorName, kINT32, request.endId);
+    packOptionalInput(samplingParams, inference_request::kPadIdTensorName, kINT32, request.padId);
+    packOptionalInput(samplingParams, inference_request::kTemperatureTensorName, kFLOAT, request.temperature);
+    packOptionalInput(samplingParams, inference_request::kRuntimeTopKTensorName, kINT32, request.topK);
+    packOptionalInput(samplingParams, inference_request::kRuntimeTopPTensorName, kFLOAT, request.topP);
+    packOptionalInput(
+        samplingParams, inference_request::kRepetitionPenaltyTensorName, kFLOAT, request.repetitionPenalty);
+    packOptionalInput(
+        samplingParams, inference_request::kRandomSeedTensorName, nvinfer1::DataType::kINT64, request.randomSeed);
+    samplingParams.store(*inferenceRequest);
+    inferenceRequest->setIsStreaming(request.streaming);
+    return inferenceRequest;
+}
+
+/// @brief Extract the output tokens of each beam from the output_ids [1, beam, len] and sequence_length [1, beam]
+/// tensors of a response
+/// @param numInputTokens Number of tokens of the input_ids at the start of each beam, skipped to only return the
+/// generated tokens
+std::vector<std::vector<int32_t>> getOutputIds(std::list<NamedTensor> const& responseTensors, size_t numInputTokens)
+{
+    auto const findTensor = [&responseTensors](std::string const& name) -> NamedTensor const*
+    {
+        auto it = std::find_if(responseTensors.begin(), responseTensors.end(),
+            [&name](NamedTensor const& tensor) { return tensor.name == name; });
+        return it != responseTensors.end() && it->tensor ? &*it : nullptr;
+    };
+    auto const* outputIds = findTensor(inference_request::kOutputIdsTensorName);
+    auto const* sequenceLength = findTensor(inference_request::kSequenceLengthTensorName);
+    if (outputIds == nullptr)
+    {
+        return {};
+    }
+
+    auto const shape = outputIds->tensor->getShape();
+    auto const beamWidth = shape.nbDims == 3 ? shape.d[1] : 1;
+    auto const width = shape.d[shape.nbDims - 1];
+    auto const* ids = static_cast<int32_t const*>(outputIds->tensor->data());
+    auto const* lengths
+        = sequenceLength != nullptr ? static_cast<int32_t const*>(sequenceLength->tensor->data()) : nullptr;
+
+    std::vector<std::vector<int32_t>> beams(beamWidth);
+    for (int64_t beam = 0; beam < beamWidth; ++beam)
+    {
+        // Streamed responses only hold the new tokens, while sequence_length counts all the tokens of the sequence
+        auto const length = lengths != nullptr ? std::min<int64_t>(lengths[beam], width) : width;
+        auto const start = std::min<int64_t>(numInputTokens, length);
+        beams[beam].assign(ids + beam * width + start, ids + beam * width + length);
+    }
+    return beams;
+}
+
+/// @brief Check the members of a model configuration read by the model state
+/// @return The error, std::nullopt if the configuration is valid
+std::optional<std::string> validateModelConfig(std::string const& modelConfigJson)
+{
+    auto const config = nlohmann::json::parse(modelConfigJson, nullptr, /*allow_exceptions=*/false);
+    if (config.is_discarded() || !config.is_object())
+    {
+        return "not a JSON object";
+    }
+    if (auto const policy = config.find("model_transaction_policy"); policy != config.end())
+    {
+        if (!policy->is_object() || (policy->contains("decoupled") && !policy->at("decoupled").is_boolean()))
+        {
+            return "model_transaction_policy.decoupled must be a boolean";
+        }
+    }
+    if (auto const outputs = config.find("output"); outputs != config.end())
+    {
+        auto const isValidOutput = [](nlohmann::json const& output)
+        {
+            return output.is_object() && output.contains("name") && output.at("name").is_string()
+                && output.contains("data_type") && output.at("data_type").is_string();
+        };
+        if (!outputs->is_array() || !std::all_of(outputs->begin(), outputs->end(), isValidOutput))
+        {
+            return "output must be an array of objects with a name and a data_type string";
+        }
+    }
+    auto const parameters = config.find("parameters");
+    if (parameters == config.end() || !parameters->is_object())
+    {
+        return "parameters must be an object";
+    }
+    for (auto const& [name, value] : parameters->items())
+    {
+        if (!value.is_object() || !value.contains("string_value") || !value.at("string_value").is_string())
+        {
+            return "parameter " + name + " must have a string_value string";
+        }
+    }
+    return std::nullopt;
+}
+
+} // namespace
+
+std::atomic<uint64_t> InProcessClient::sNextRequestId = 1ULL << 63;
+
+InProcessClient::InProcessClient(std::string modelName)
+    : mModelName(std::move(modelName))
+{
+}
+
+uint64_t InProcessClient::submit(InProcessRequest const& request, ResponseCallback callback)
+{
+    auto const outputsIncludeInput = ModelInstanceState::outputsIncludeInput(mModelName);
+    if (!outputsIncludeInput)
+    {
+        throw std::runtime_error("Model " + mModelName + " is not loaded in this process");
+    }
+    // Streamed responses only hold the new tokens, the others start with the input unless exclude_input_in_output
+    // is set
+    size_t const numInputTokens = outputsIncludeInput.value() && !request.streaming ? request.inputIds.size() : 0;
+
+    auto const requestId = sNextRequestId++;
+    auto responseCallback
+        = [requestId, numInputTokens, callback = std::move(callback)](
+              std::list<NamedTensor> const& responseTensors, bool finalResponse, std::string const& errMsg)
+    {
+        InProcessResponse response;
+        response.requestId = requestId;
+        response.finalResponse = finalResponse;
+        response.error = errMsg;
+        if (errMsg.empty())
+        {
+            response.outputIds = getOutputIds(responseTensors, numInputTokens);
+        }
+        callback(response);
+    };
+
+    auto workItem = std::make_shared<WorkItem>(
+        createInferenceRequest(request, requestId), requestId, std::move(responseCallback));
+    if (!ModelInstanceState::enqueue(mModelName, std::move(workItem)))
+    {
+        throw std::runtime_error("Model " + mModelName + " is not loaded in this process");
+    }
+    return requestId;
+}
+
+std::future<InProcessResponse> InProcessClient::submit(InProcessRequest const& request)
+{
+    auto promise = std::make_shared<std::promise<InProcessResponse>>();
+    auto future = promise->get_future();
+    auto accumulated = std::make_shared<InProcessResponse>();
+    submit(request,
+        [promise, accumulated, streaming = request.streaming](InProcessResponse const& response)
+        {
+            if (!streaming || accumulated->outputIds.empty())
+            {
+                accumulated->outputIds = response.outputIds;
+            }
+            else
+            {
+                for (size_t beam = 0; beam < std::min(accumulated->outputIds.size(), response.outputIds.size()); ++beam)
+                {
+                    accumulated->outputIds[beam].insert(accumulated->outputIds[beam].end(),
+                        response.outputIds[beam].begin(), response.outputIds[beam].end());
+                }
+            }
+            if (response.finalResponse)
+            {
+                accumulated->requestId = response.requestId;
+                accumulated->finalResponse = true;
+                accumulated->error = response.error;
+                promise->set_value(std::move(*accumulated));
+            }
+        });
+    return future;
+}
+
+bool InProcessClient::cancel(uint64_t requestId)
+{
+    return ModelInstanceState::stop(mModelName, requestId);
+}
+
+InProcessEngine::InProcessEngine(std::string const& modelName, std::string const& modelConfigJson, uint64_t version)
+{
+    // Errors of TritonJson are TRITONSERVER_Error objects, which cannot be created without a Triton server: the
+    // configuration is validated before it is parsed, so that the model state only looks up valid members
+    if (auto const error = validateModelConfig(modelConfigJson))
+    {
+        throw std::invalid_argument("Invalid configuration of model " + modelName + ": " + error.value());
+    }
+    TritonJson::Value modelConfig;
+    modelConfig.Parse(modelConfigJson.data(), modelConfigJson.size());
+    mModelState = std::make_unique<ModelState>(modelName, version, std::move(modelConfig), std::nullopt);
+
+    ModelInstanceState* state = nullptr;
+    if (!ModelInstanceState::Create(mModelState.get(), MPI_COMM_NULL, &state))
+    {
+        throw std::runtime_error("Failed to load model " + modelName);
+    }
+    mInstance.reset(state);
+}
+
+InProcessEngine::~InProcessEngine() = default;
+
+InProcessClient InProcessEngine::client() const
+{
+    return InProcessClient(mModelState->GetModelName());
+}
+
+} // namespace triton::backend::inflight_batcher_llm
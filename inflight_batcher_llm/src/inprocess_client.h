@@ -0,0 +1,131 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace triton::backend::inflight_batcher_llm
+{
+
+class ModelState;
+class ModelInstanceState;
+
+/// @brief Request submitted by an in-process client. Sampling parameters left unset use the defaults of the engine.
+struct InProcessRequest
+{
+    std::vector<int32_t> inputIds;
+    int32_t maxNewTokens = 0;
+    int32_t beamWidth = 1;
+    std::optional<int32_t> endId;
+    std::optional<int32_t> padId;
+    std::optional<float> temperature;
+    std::optional<int32_t> topK;
+    std::optional<float> topP;
+    std::optional<float> repetitionPenalty;
+    std::optional<uint64_t> randomSeed;
+    // send a response per generated token instead of a single final response
+    bool streaming = false;
+};
+
+/// @brief Response received by an in-process client
+struct InProcessResponse
+{
+    uint64_t requestId = 0;
+    // tokens generated for each beam, without the input_ids of the request
+    std::vector<std::vector<int32_t>> outputIds;
+    bool finalResponse = false;
+    // empty unless the request failed
+    std::string error;
+};
+
+/// @brief Client submitting requests to a model loaded in the same process, e.g. by the Triton server embedding the
+/// backend or by an InProcessEngine. The requests skip the network front end and the Triton request and response
+/// objects: they are added to the work items queue of the model instance with the fewest pending requests, and the
+/// engine output tensors are handed to the callback of the client. Only the non-orchestrator mode is supported.
+class InProcessClient
+{
+public:
+    using ResponseCallback = std::function<void(InProcessResponse const&)>;
+
+    explicit InProcessClient(std::string modelName);
+
+    /// @brief Submit a request whose responses are passed to the callback, from a thread of the engine. The callback
+    /// must not block.
+    /// @return The id of the request. Throws an error if the model is not loaded in this process.
+    uint64_t submit(InProcessRequest const& request, ResponseCallback callback);
+
+    /// @brief Submit a request and wait for its final response through the returned future. Streamed responses are
+    /// accumulated.
+    std::future<InProcessResponse> submit(InProcessRequest const& request);
+
+    /// @brief Stop a request. Its final response is sent with the tokens generated so far.
+    /// @return false if the request is not active (might be completed already)
+    bool cancel(uint64_t requestId);
+
+    std::string const& modelName() const
+    {
+        return mModelName;
+    }
+
+private:
+    std::string mModelName;
+
+    // ids of the in-process requests, kept in the upper half of the id space to not collide with the numeric ids of
+    // the Triton requests
+    static std::atomic<uint64_t> sNextRequestId;
+};
+
+/// @brief Model loaded without a Triton server, for applications embedding the engine. Its parameters are the ones of
+/// the tensorrt_llm model configuration. The MPI environment must be initialized by the application, and an engine
+/// using several GPUs must be constructed on each rank: like in the non-orchestrator mode of the backend, the
+/// constructor does not return on the ranks other than 0, which serve the requests submitted on rank 0.
+class InProcessEngine
+{
+public:
+    /// @param modelConfigJson The model configuration in the JSON format of Triton, e.g. as returned by the model
+    /// configuration endpoint of the server
+    InProcessEngine(std::string const& modelName, std::string const& modelConfigJson, uint64_t version = 1);
+    ~InProcessEngine();
+
+    InProcessEngine(InProcessEngine const&) = delete;
+    InProcessEngine& operator=(InProcessEngine const&) = delete;
+
+    InProcessClient client() const;
+
+private:
+    std::unique_ptr<ModelState> mModelState;
+    std::unique_ptr<ModelInstanceState> mInstance;
+};
+
+} // namespace triton::backend::inflight_batcher_llm
@@ -0,0 +1,172 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+// Loads a model without a Triton server and serves a few requests with the in-process client:
+//
+//   mpirun -n <world size> triton_tensorrtllm_inprocess_example <config.json> [input ids...]
+//
+// config.json is the configuration of the tensorrt_llm model in the JSON format of Triton, e.g. as returned by
+// `curl localhost:8000/v2/models/tensorrt_llm/config`. The program exits with a nonzero status if a request fails.
+
+#include "inprocess_client.h"
+
+#include <mpi.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+
+using namespace triton::backend::inflight_batcher_llm;
+
+namespace
+{
+
+std::string readFile(std::string const& path)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        throw std::runtime_error("Cannot open " + path);
+    }
+    std::stringstream content;
+    content << file.rdbuf();
+    return content.str();
+}
+
+void printOutputIds(std::string const& label, InProcessResponse const& response)
+{
+    for (size_t beam = 0; beam < response.outputIds.size(); ++beam)
+    {
+        std::cout << label << " request " << response.requestId << " beam " << beam << ":";
+        for (auto const id : response.outputIds[beam])
+        {
+            std::cout << " " << id;
+        }
+        std::cout << std::endl;
+    }
+}
+
+int run(int argc, char* argv[])
+{
+    InProcessRequest request;
+    for (int i = 2; i < argc; ++i)
+    {
+        request.inputIds.push_back(std::atoi(argv[i]));
+    }
+    if (request.inputIds.empty())
+    {
+        request.inputIds = {28524, 287, 5093, 12, 23316, 4881, 11, 30022, 263, 8776, 355, 257};
+    }
+    request.maxNewTokens = 20;
+
+    // Does not return on the ranks other than 0, which serve the requests of rank 0 until it unloads the model
+    InProcessEngine engine("tensorrt_llm", readFile(argv[1]));
+    auto client = engine.client();
+
+    // Request waiting for its final response
+    auto const response = client.submit(request).get();
+    if (!response.error.empty())
+    {
+        std::cerr << "Request " << response.requestId << " failed: " << response.error << std::endl;
+        return EXIT_FAILURE;
+    }
+    printOutputIds("Generated by", response);
+
+    // Streamed request cancelled after its first response, which must still receive a final response
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool firstResponse = false;
+    std::optional<InProcessResponse> finalResponse;
+    request.streaming = true;
+    request.maxNewTokens = 200;
+    auto const requestId = client.submit(request,
+        [&](InProcessResponse const& streamed)
+        {
+            std::lock_guard<std::mutex> lk(mutex);
+            firstResponse = true;
+            if (streamed.finalResponse)
+            {
+                finalResponse = streamed;
+            }
+            cv.notify_all();
+        });
+
+    std::unique_lock<std::mutex> lk(mutex);
+    if (!cv.wait_for(lk, std::chrono::minutes(1), [&] { return firstResponse; }))
+    {
+        std::cerr << "No response to the streamed request " << requestId << std::endl;
+        return EXIT_FAILURE;
+    }
+    lk.unlock();
+    bool const cancelled = client.cancel(requestId);
+    lk.lock();
+    if (!cv.wait_for(lk, std::chrono::minutes(1), [&] { return finalResponse.has_value(); }))
+    {
+        std::cerr << "No final response to the cancelled request " << requestId << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (!finalResponse->error.empty())
+    {
+        std::cerr << "Request " << requestId << " failed: " << finalResponse->error << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "Request " << requestId << (cancelled ? " cancelled" : " completed before its cancellation")
+              << std::endl;
+    return EXIT_SUCCESS;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "Usage: " << argv[0] << " <config.json> [input ids...]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    int provided = 0;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
+    int status = EXIT_FAILURE;
+    try
+    {
+        status = run(argc, argv);
+    }
+    catch (std::exception const& e)
+    {
+        std::cerr << e.what() << std::endl;
+    }
+    MPI_Finalize();
+    return status;
+}
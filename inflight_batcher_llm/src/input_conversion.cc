@@ -0,0 +1,392 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "input_conversion.h"
+
+#include "utils.h"
+
+#include "tensorrt_llm/batch_manager/inferenceRequest.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_set>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace triton::backend::inflight_batcher_llm
+{
+
+namespace
+{
+
+namespace inference_request = tensorrt_llm::batch_manager::inference_request;
+
+// inputs holding 64-bit ids, which the engine reads as uint64 from int64 tensors
+std::unordered_set<std::string> const k64BitInputNames{inference_request::kRandomSeedTensorName,
+    inference_request::kLoraTaskId, kPromptEmbeddingTableIdInputTensorName};
+
+// number of elements converted at once between fp16 and bf16, through fp32
+constexpr size_t kFloatChunkSize = 1024;
+
+/// @brief Whether the elements of a Triton data type are stored unchanged in a tensor of a TensorRT data type
+bool isSameRepresentation(TRITONSERVER_DataType srcType, nvinfer1::DataType dstType)
+{
+    switch (srcType)
+    {
+    case TRITONSERVER_TYPE_BOOL: return dstType == nvinfer1::DataType::kBOOL;
+    case TRITONSERVER_TYPE_UINT8: return dstType == nvinfer1::DataType::kUINT8;
+    case TRITONSERVER_TYPE_INT8: return dstType == nvinfer1::DataType::kINT8;
+    case TRITONSERVER_TYPE_INT32: return dstType == nvinfer1::DataType::kINT32;
+    case TRITONSERVER_TYPE_INT64:
+    case TRITONSERVER_TYPE_UINT64: return dstType == nvinfer1::DataType::kINT64;
+    case TRITONSERVER_TYPE_FP16: return dstType == nvinfer1::DataType::kHALF;
+    case TRITONSERVER_TYPE_FP32: return dstType == nvinfer1::DataType::kFLOAT;
+    case TRITONSERVER_TYPE_BF16: return dstType == nvinfer1::DataType::kBF16;
+    default: return false;
+    }
+}
+
+bool isFloatingPoint(TRITONSERVER_DataType dataType)
+{
+    return dataType == TRITONSERVER_TYPE_FP16 || dataType == TRITONSERVER_TYPE_FP32
+        || dataType == TRITONSERVER_TYPE_BF16;
+}
+
+bool isFloatingPoint(nvinfer1::DataType dataType)
+{
+    return dataType == nvinfer1::DataType::kHALF || dataType == nvinfer1::DataType::kFLOAT
+        || dataType == nvinfer1::DataType::kBF16;
+}
+
+/// @brief Narrow integers to int32. The loop is branch-free so that the compiler vectorizes it, the values are only
+/// inspected again to report an overflow.
+template <typename T>
+void toInt32(std::string const& name, T const* src, int32_t* dst, size_t numElements)
+{
+    auto const fits = [](T value)
+    {
+        if constexpr (std::is_unsigned_v<T>)
+        {
+            return value <= static_cast<T>(std::numeric_limits<int32_t>::max());
+        }
+        else
+        {
+            return static_cast<T>(static_cast<int32_t>(value)) == value;
+        }
+    };
+
+    bool allFit = true;
+    for (size_t i = 0; i < numElements; ++i)
+    {
+        dst[i] = static_cast<int32_t>(src[i]);
+        allFit &= fits(src[i]);
+    }
+    if (!allFit)
+    {
+        auto const index = std::find_if_not(src, src + numElements, fits) - src;
+        throw std::out_of_range(name + "[" + std::to_string(index) + "] = " + std::to_string(src[index])
+            + " does not fit in the int32 expected by the engine");
+    }
+}
+
+#if defined(__x86_64__)
+bool hasF16c()
+{
+    static bool const hasF16c = __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+    return hasF16c;
+}
+
+__attribute__((target("avx,f16c"))) void halfToFloatF16c(uint16_t const* src, float* dst, size_t numElements)
+{
+    size_t i = 0;
+    for (; i + 8 <= numElements; i += 8)
+    {
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i))));
+    }
+    for (; i < numElements; ++i)
+    {
+        dst[i] = halfToFloat(src[i]);
+    }
+}
+
+__attribute__((target("avx,f16c"))) void floatToHalfF16c(float const* src, uint16_t* dst, size_t numElements)
+{
+    size_t i = 0;
+    for (; i + 8 <= numElements; i += 8)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+            _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+    }
+    for (; i < numElements; ++i)
+    {
+        dst[i] = floatToHalf(src[i]);
+    }
+}
+#endif
+
+/// @brief Widen fp16, bf16 or fp32 elements to fp32
+void toFloat(void const* src, TRITONSERVER_DataType srcType, float* dst, size_t numElements)
+{
+    if (srcType == TRITONSERVER_TYPE_FP32)
+    {
+        std::memcpy(dst, src, numElements * sizeof(float));
+    }
+    else if (srcType == TRITONSERVER_TYPE_BF16)
+    {
+        auto const* bf16 = static_cast<uint16_t const*>(src);
+        for (size_t i = 0; i < numElements; ++i)
+        {
+            uint32_t const bits = static_cast<uint32_t>(bf16[i]) << 16;
+            std::memcpy(dst + i, &bits, sizeof(float));
+        }
+    }
+    else
+    {
+        auto const* fp16 = static_cast<uint16_t const*>(src);
+#if defined(__x86_64__)
+        if (hasF16c())
+        {
+            halfToFloatF16c(fp16, dst, numElements);
+            return;
+        }
+#endif
+        std::transform(fp16, fp16 + numElements, dst, halfToFloat);
+    }
+}
+
+/// @brief Narrow fp32 elements to fp16, bf16 or fp32
+void fromFloat(float const* src, void* dst, nvinfer1::DataType dstType, size_t numElements)
+{
+    if (dstType == nvinfer1::DataType::kFLOAT)
+    {
+        std::memcpy(dst, src, numElements * sizeof(float));
+    }
+    else if (dstType == nvinfer1::DataType::kBF16)
+    {
+        auto* bf16 = static_cast<uint16_t*>(dst);
+        for (size_t i = 0; i < numElements; ++i)
+        {
+            uint32_t bits;
+            std::memcpy(&bits, src + i, sizeof(bits));
+            // round to nearest even, NaNs stay quiet NaNs
+            auto const rounded = static_cast<uint16_t>((bits + 0x7fff + ((bits >> 16) & 1)) >> 16);
+            auto const nan = static_cast<uint16_t>((bits >> 16) | 0x40);
+            bf16[i] = (bits & 0x7fffffff) > 0x7f800000 ? nan : rounded;
+        }
+    }
+    else
+    {
+        auto* fp16 = static_cast<uint16_t*>(dst);
+#if defined(__x86_64__)
+        if (hasF16c())
+        {
+            floatToHalfF16c(src, fp16, numElements);
+            return;
+        }
+#endif
+        std::transform(src, src + numElements, fp16, floatToHalf);
+    }
+}
+
+} // namespace
+
+nvinfer1::DataType getInputDataType(
+    std::string const& name, TRITONSERVER_DataType dataType, EngineDataTypes const& engineDataTypes)
+{
+    switch (dataType)
+    {
+    case TRITONSERVER_TYPE_BOOL: return nvinfer1::DataType::kBOOL;
+    case TRITONSERVER_TYPE_UINT8: return nvinfer1::DataType::kUINT8;
+    case TRITONSERVER_TYPE_INT8: return nvinfer1::DataType::kINT8;
+    case TRITONSERVER_TYPE_UINT16:
+    case TRITONSERVER_TYPE_INT16:
+    case TRITONSERVER_TYPE_UINT32:
+    case TRITONSERVER_TYPE_INT32: return nvinfer1::DataType::kINT32;
+    case TRITONSERVER_TYPE_UINT64:
+    case TRITONSERVER_TYPE_INT64:
+        return k64BitInputNames.count(name) > 0 ? nvinfer1::DataType::kINT64 : nvinfer1::DataType::kINT32;
+    case TRITONSERVER_TYPE_FP16:
+    case TRITONSERVER_TYPE_FP32:
+    case TRITONSERVER_TYPE_BF16:
+    {
+        std::optional<nvinfer1::DataType> engineDataType;
+        if (name == inference_request::kPromptEmbeddingTableName || name == inference_request::kLoraWeights)
+        {
+            engineDataType = engineDataTypes.model;
+        }
+        else if (name == inference_request::kEmbeddingBiasTensorName)
+        {
+            engineDataType = engineDataTypes.logits;
+        }
+        else if (name == kEmbeddingBiasValuesInputTensorName)
+        {
+            // accumulated in fp32 by the backend, then narrowed to the data type of the logits
+            engineDataType = nvinfer1::DataType::kFLOAT;
+        }
+        return engineDataType.value_or(utils::to_trt_datatype(dataType));
+    }
+    default:
+        throw std::invalid_argument("input " + name + " has data type " + TRITONSERVER_DataTypeString(dataType)
+            + ", which is not supported by the engine");
+    }
+}
+
+void convertInput(std::string const& name, void const* src, TRITONSERVER_DataType srcType, void* dst,
+    nvinfer1::DataType dstType, size_t numElements)
+{
+    if (isSameRepresentation(srcType, dstType))
+    {
+        std::memcpy(dst, src, numElements * TRITONSERVER_DataTypeByteSize(srcType));
+        return;
+    }
+
+    if (dstType == nvinfer1::DataType::kINT32)
+    {
+        auto* int32 = static_cast<int32_t*>(dst);
+        switch (srcType)
+        {
+        case TRITONSERVER_TYPE_UINT16: toInt32(name, static_cast<uint16_t const*>(src), int32, numElements); return;
+        case TRITONSERVER_TYPE_INT16: toInt32(name, static_cast<int16_t const*>(src), int32, numElements); return;
+        case TRITONSERVER_TYPE_UINT32: toInt32(name, static_cast<uint32_t const*>(src), int32, numElements); return;
+        case TRITONSERVER_TYPE_UINT64: toInt32(name, static_cast<uint64_t const*>(src), int32, numElements); return;
+        case TRITONSERVER_TYPE_INT64: toInt32(name, static_cast<int64_t const*>(src), int32, numElements); return;
+        default: break;
+        }
+    }
+    else if (isFloatingPoint(srcType) && isFloatingPoint(dstType))
+    {
+        if (srcType == TRITONSERVER_TYPE_FP32)
+        {
+            fromFloat(static_cast<float const*>(src), dst, dstType, numElements);
+        }
+        else if (dstType == nvinfer1::DataType::kFLOAT)
+        {
+            toFloat(src, srcType, static_cast<float*>(dst), numElements);
+        }
+        else
+        {
+            // between fp16 and bf16, through fp32
+            float chunk[kFloatChunkSize];
+            auto const elementSize = TRITONSERVER_DataTypeByteSize(srcType);
+            for (size_t offset = 0; offset < numElements; offset += kFloatChunkSize)
+            {
+                auto const chunkSize = std::min(kFloatChunkSize, numElements - offset);
+                toFloat(static_cast<char const*>(src) + offset * elementSize, srcType, chunk, chunkSize);
+                fromFloat(chunk, static_cast<char*>(dst) + offset * elementSize, dstType, chunkSize);
+            }
+        }
+        return;
+    }
+
+    throw std::invalid_argument(
+        "input " + name + " cannot be converted from data type " + TRITONSERVER_DataTypeString(srcType));
+}
+
+float halfToFloat(uint16_t h)
+{
+    uint32_t const sign = static_cast<uint32_t>(h & 0x8000) << 16;
+    uint32_t exponent = (h >> 10) & 0x1f;
+    uint32_t mantissa = h & 0x3ff;
+    uint32_t bits;
+    if (exponent == 0x1f)
+    {
+        // NaNs are quieted like F16C does
+        bits = sign | 0x7f800000 | (mantissa << 13) | (mantissa ? 0x400000 : 0);
+    }
+    else if (exponent == 0)
+    {
+        if (mantissa == 0)
+        {
+            bits = sign;
+        }
+        else
+        {
+            // subnormal, normalize it
+            exponent = 127 - 15 + 1;
+            while ((mantissa & 0x400) == 0)
+            {
+                mantissa <<= 1;
+                --exponent;
+            }
+            bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+        }
+    }
+    else
+    {
+        bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    }
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+uint16_t floatToHalf(float f)
+{
+    // Rounds to nearest even like F16C: a tie keeps the even mantissa, and a carry into the exponent is the correct
+    // result, up to the infinity for the values from 65520
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    uint16_t const sign = (bits >> 16) & 0x8000;
+    int32_t const exponent = static_cast<int32_t>((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t const mantissa = bits & 0x7fffff;
+    if (((bits >> 23) & 0xff) == 0xff)
+    {
+        // NaNs are quieted and keep the upper bits of their payload
+        return sign | 0x7c00 | (mantissa ? 0x200 | (mantissa >> 13) : 0);
+    }
+    if (exponent >= 0x1f)
+    {
+        return sign | 0x7c00;
+    }
+
+    // The fp16 mantissa is the upper bits of the fp32 one, with the implicit bit for the subnormals
+    uint32_t significand = mantissa;
+    uint32_t shift = 13;
+    uint32_t const exponentBits = exponent > 0 ? static_cast<uint32_t>(exponent) << 10 : 0;
+    if (exponent <= 0)
+    {
+        shift = 14 - exponent;
+        if (shift > 24)
+        {
+            // below half of the smallest subnormal
+            return sign;
+        }
+        significand |= 0x800000;
+    }
+    uint32_t const truncated = significand >> shift;
+    uint32_t const remainder = significand & ((1u << shift) - 1);
+    uint32_t const halfway = 1u << (shift - 1);
+    uint32_t const roundUp = remainder > halfway || (remainder == halfway && (truncated & 1));
+    return sign | static_cast<uint16_t>((exponentBits | truncated) + roundUp);
+}
+
+} // namespace triton::backend::inflight_batcher_llm
@@ -0,0 +1,72 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "NvInfer.h"
+#include "triton/core/tritonserver.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace triton::backend::inflight_batcher_llm
+{
+
+/// @brief Data types of an engine, read from its config.json by EngineConfig, that the floating-point inputs of the
+/// requests are converted to. Inputs whose data type is unknown keep the data type they were sent with.
+struct EngineDataTypes
+{
+    // data type of the weights, used by the prompt embedding tables and the LoRA weights
+    std::optional<nvinfer1::DataType> model;
+    // data type of the logits, used by the embedding biases
+    std::optional<nvinfer1::DataType> logits;
+    // whether the engine gathers the context and generation logits, without which the logits outputs are not
+    // returned. Unknown when the config has not been read.
+    std::optional<bool> gatherContextLogits;
+    std::optional<bool> gatherGenerationLogits;
+};
+
+/// @brief Data type of the tensor an input of a request is copied into. Integer inputs are narrowed to the int32 the
+/// engine expects, except for the 64-bit ids such as random_seed, and uint64 is reinterpreted as int64.
+/// Floating-point weights and biases take the data type of the engine.
+/// Throws a std::invalid_argument if the data type has no equivalent in the engine, e.g. BYTES or FP64.
+nvinfer1::DataType getInputDataType(
+    std::string const& name, TRITONSERVER_DataType dataType, EngineDataTypes const& engineDataTypes);
+
+/// @brief Copy the elements of an input buffer into its tensor, converting them to the data type of the tensor
+/// returned by getInputDataType. Throws a std::out_of_range if an integer does not fit in the data type of the
+/// tensor.
+void convertInput(std::string const& name, void const* src, TRITONSERVER_DataType srcType, void* dst,
+    nvinfer1::DataType dstType, size_t numElements);
+
+/// @brief Convert between fp32 and the bits of an fp16 value, rounding to nearest even and quieting the NaNs like the
+/// F16C instructions used for the larger inputs
+float halfToFloat(uint16_t h);
+uint16_t floatToHalf(float f);
+
+} // namespace triton::backend::inflight_batcher_llm
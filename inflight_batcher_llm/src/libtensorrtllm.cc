@@ -69,6 +69,17 @@ extern "C"
                 "Detected TRTLLM_ORCHESTRATOR environment variable, TRTLLM backend will operator in orchestrator "
                 "mode.");
             auto* orchestrator = new Orchestrator();
+
+            // Workers spawned ahead of time, reused by the single-rank models
+            char const* poolSize = std::getenv("TRTLLM_ORCHESTRATOR_WORKER_POOL_SIZE");
+            if (poolSize && std::atoi(poolSize) > 0)
+            {
+                char const* workerPath = std::getenv("TRTLLM_ORCHESTRATOR_WORKER_PATH");
+                orchestrator->createWorkerPool(
+                    workerPath ? workerPath : "/opt/tritonserver/backends/tensorrtllm/triton_tensorrtllm_worker",
+                    std::atoi(poolSize));
+            }
+
             RETURN_IF_ERROR(TRITONBACKEND_BackendSetState(backend, reinterpret_cast<void*>(orchestrator)));
         }
         else
@@ -93,6 +104,23 @@ extern "C"
         return nullptr; // success
     }
 
+    // Triton calls TRITONBACKEND_GetBackendAttribute to query the
+    // attributes of the backend before loading its models.
+    //
+    TRITONSERVER_Error* TRITONBACKEND_GetBackendAttribute(
+        TRITONBACKEND_Backend* backend, TRITONBACKEND_BackendAttribute* backend_attributes)
+    {
+        // In orchestrator mode, each instance loads its engine in its own workers, so that the instances of a
+        // model, e.g. on different GPUs, can be initialized in parallel. In leader mode, the instances run the
+        // collectives of the engine load on the same communicator and must be initialized one after the other.
+        void* vstate;
+        RETURN_IF_ERROR(TRITONBACKEND_BackendState(backend, &vstate));
+        RETURN_IF_ERROR(
+            TRITONBACKEND_BackendAttributeSetParallelModelInstanceLoading(backend_attributes, vstate != nullptr));
+
+        return nullptr; // success
+    }
+
     // Triton calls TRITONBACKEND_ModelInitialize when a model is loaded
     // to allow the backend to create any state associated with the model,
     // and to also examine the model configuration to determine if the
@@ -158,23 +186,8 @@ extern "C"
 
         if (orchestrator)
         {
-            auto const device_ids = model_state->GetDeviceIds();
-            int const num_workers = device_ids ? device_ids.value().size() : 1;
-
-            std::string workerPath = model_state->GetWorkerPath();
-            MPI_Comm everyone;
-            MPI_Comm_spawn(workerPath.c_str(), MPI_ARGV_NULL, num_workers, MPI_INFO_NULL, 0, MPI_COMM_SELF, &everyone,
-                MPI_ERRCODES_IGNORE);
-
-            // The output comm is an intercommunicator so it has some special rules.
-            // The parent must send data with bcast using root = MPI_ROOT (-4)
-            std::vector<int64_t> packed = model_state->serialize();
-            int64_t n = packed.size();
-            MPICHECK(MPI_Bcast(&n, 1, MPI_INT64_T, MPI_ROOT, everyone));
-            MPICHECK(MPI_Bcast(packed.data(), packed.size(), MPI_INT64_T, MPI_ROOT, everyone));
-
             OrchestratorCommunicator* communicator;
-            RETURN_IF_ERROR(orchestrator->addCommunicator(model_state, instance, everyone, &communicator));
+            RETURN_IF_ERROR(orchestrator->addCommunicator(model_state, instance, &communicator));
             RETURN_IF_ERROR(TRITONBACKEND_ModelInstanceSetState(instance, reinterpret_cast<void*>(communicator)));
         }
         else
@@ -211,8 +224,7 @@ extern "C"
         if (orchestrator)
         {
             auto* communicator = reinterpret_cast<OrchestratorCommunicator*>(vstate);
-            communicator->shutdown();
-            delete communicator;
+            orchestrator->removeCommunicator(communicator);
         }
         else
         {
@@ -0,0 +1,439 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "lora_adapter_store.h"
+
+#include "tensorrt_llm/common/logger.h"
+
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace triton::backend::inflight_batcher_llm
+{
+
+namespace
+{
+
+using tensorrt_llm::runtime::ITensor;
+
+/// Read-only view of a memory-mapped file. Pages are mapped copy-on-write so that the
+/// underlying file is never modified.
+class FileMapping
+{
+public:
+    explicit FileMapping(std::filesystem::path const& path)
+    {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            throw std::runtime_error("Cannot open " + path.string());
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            close(fd);
+            throw std::runtime_error("Cannot stat " + path.string());
+        }
+        mSize = static_cast<size_t>(st.st_size);
+
+        mData = mmap(nullptr, mSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mData == MAP_FAILED)
+        {
+            throw std::runtime_error("Cannot memory-map " + path.string());
+        }
+
+        // Start reading the file in the background, the whole adapter will be needed
+        madvise(mData, mSize, MADV_WILLNEED);
+    }
+
+    ~FileMapping()
+    {
+        munmap(mData, mSize);
+    }
+
+    FileMapping(FileMapping const&) = delete;
+    FileMapping& operator=(FileMapping const&) = delete;
+
+    char* data() const
+    {
+        return static_cast<char*>(mData);
+    }
+
+    size_t size() const
+    {
+        return mSize;
+    }
+
+private:
+    void* mData;
+    size_t mSize;
+};
+
+nvinfer1::DataType npyDescrToDataType(std::string const& descr)
+{
+    if (descr == "<f2" || descr == "|f2")
+    {
+        return nvinfer1::DataType::kHALF;
+    }
+    else if (descr == "<f4" || descr == "|f4")
+    {
+        return nvinfer1::DataType::kFLOAT;
+    }
+    else if (descr == "<i4" || descr == "|i4")
+    {
+        return nvinfer1::DataType::kINT32;
+    }
+    else if (descr == "<i8" || descr == "|i8")
+    {
+        return nvinfer1::DataType::kINT64;
+    }
+    throw std::runtime_error("Unsupported npy data type " + descr);
+}
+
+/// Memory-map a .npy file as a tensor. The mapping is released with the last reference to the tensor.
+/// 2D arrays are given a leading batch dimension of 1, as for tensors received from Triton.
+ITensor::SharedPtr mapNpyTensor(std::filesystem::path const& path)
+{
+    auto mapping = std::make_shared<FileMapping>(path);
+
+    // Format: "\x93NUMPY", major version, minor version, header length (2 bytes for v1, 4 bytes for v2+), header
+    static constexpr char kMagic[] = "\x93NUMPY";
+    static constexpr size_t kMagicSize = sizeof(kMagic) - 1;
+    char const* base = mapping->data();
+    if (mapping->size() < kMagicSize + 4 || std::memcmp(base, kMagic, kMagicSize) != 0)
+    {
+        throw std::runtime_error(path.string() + " is not a npy file");
+    }
+
+    auto const major = static_cast<uint8_t>(base[kMagicSize]);
+    size_t headerOffset = kMagicSize + 2;
+    size_t headerSize = 0;
+    if (major == 1)
+    {
+        uint16_t size;
+        std::memcpy(&size, base + headerOffset, sizeof(size));
+        headerSize = size;
+        headerOffset += sizeof(size);
+    }
+    else
+    {
+        uint32_t size;
+        std::memcpy(&size, base + headerOffset, sizeof(size));
+        headerSize = size;
+        headerOffset += sizeof(size);
+    }
+    if (headerOffset + headerSize > mapping->size())
+    {
+        throw std::runtime_error(path.string() + " has a truncated header");
+    }
+
+    // The header is a python dict literal, e.g. {'descr': '<f2', 'fortran_order': False, 'shape': (1, 224, 4096), }
+    std::string const header(base + headerOffset, headerSize);
+
+    auto const descrKey = header.find("'descr'");
+    auto const descrBegin = header.find('\'', header.find(':', descrKey)) + 1;
+    auto const descrEnd = header.find('\'', descrBegin);
+    if (descrKey == std::string::npos || descrEnd == std::string::npos)
+    {
+        throw std::runtime_error(path.string() + " has no data type");
+    }
+    auto const dataType = npyDescrToDataType(header.substr(descrBegin, descrEnd - descrBegin));
+
+    auto const fortranOrderKey = header.find("'fortran_order'");
+    if (fortranOrderKey == std::string::npos
+        || header.find("True", fortranOrderKey) < header.find(',', fortranOrderKey))
+    {
+        throw std::runtime_error(path.string() + " must be stored in C order");
+    }
+
+    auto const shapeKey = header.find("'shape'");
+    auto const shapeBegin = header.find('(', shapeKey);
+    auto const shapeEnd = header.find(')', shapeBegin);
+    if (shapeKey == std::string::npos || shapeEnd == std::string::npos)
+    {
+        throw std::runtime_error(path.string() + " has no shape");
+    }
+    std::vector<int64_t> dims;
+    std::stringstream ss(header.substr(shapeBegin + 1, shapeEnd - shapeBegin - 1));
+    std::string dim;
+    while (std::getline(ss, dim, ','))
+    {
+        if (dim.find_first_not_of(' ') != std::string::npos)
+        {
+            dims.push_back(std::stoll(dim));
+        }
+    }
+    if (dims.size() == 2)
+    {
+        dims.insert(dims.begin(), 1);
+    }
+
+    ITensor::Shape shape;
+    shape.nbDims = static_cast<int32_t>(dims.size());
+    std::copy(dims.begin(), dims.end(), shape.d);
+
+    auto const dataOffset = headerOffset + headerSize;
+    auto const volume = ITensor::volume(shape);
+    auto tensor = ITensor::wrap(mapping->data() + dataOffset, dataType, shape, volume);
+    if (dataOffset + tensor->getSizeInBytes() > mapping->size())
+    {
+        throw std::runtime_error(path.string() + " is truncated");
+    }
+
+    // The deleter holds a reference to the mapping
+    return ITensor::SharedPtr(tensor.release(), [mapping](ITensor* t) { delete t; });
+}
+
+} // namespace
+
+LoraAdapterStore::LoraAdapterStore(std::filesystem::path root, size_t hostMemoryBytes, size_t engineCacheBytes)
+    : mRoot(std::move(root))
+    , mHostMemoryBytes(hostMemoryBytes)
+    , mEngineCacheBytes(engineCacheBytes)
+{
+    if (!std::filesystem::is_directory(mRoot))
+    {
+        throw std::runtime_error("LoRA adapter directory " + mRoot.string() + " does not exist");
+    }
+
+    mPrefetchThread = std::thread([this]() { prefetchThread(); });
+}
+
+LoraAdapterStore::~LoraAdapterStore()
+{
+    {
+        std::lock_guard<std::mutex> lk(mMutex);
+        mShutdown = true;
+    }
+    mPrefetchCV.notify_all();
+
+    if (mPrefetchThread.joinable())
+    {
+        mPrefetchThread.join();
+    }
+}
+
+std::shared_ptr<LoraAdapterStore::Adapter const> LoraAdapterStore::get(uint64_t taskId)
+{
+    return loadOnce(taskId, true);
+}
+
+std::shared_ptr<LoraAdapterStore::Adapter const> LoraAdapterStore::getForEngine(uint64_t taskId)
+{
+    {
+        std::lock_guard<std::mutex> lk(mMutex);
+        auto it = mEngineTaskIds.find(taskId);
+        if (it != mEngineTaskIds.end())
+        {
+            mEngineLruTaskIds.splice(mEngineLruTaskIds.begin(), mEngineLruTaskIds, it->second);
+            ++mNumEngineCacheHits;
+            return nullptr;
+        }
+    }
+
+    auto adapter = get(taskId);
+    if (!adapter)
+    {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lk(mMutex);
+    if (mEngineTaskIds.find(taskId) == mEngineTaskIds.end())
+    {
+        mEngineLruTaskIds.emplace_front(taskId, adapter->sizeInBytes);
+        mEngineTaskIds.emplace(taskId, mEngineLruTaskIds.begin());
+        mEngineSizeInBytes += adapter->sizeInBytes;
+        while (mEngineSizeInBytes > mEngineCacheBytes && !mEngineLruTaskIds.empty())
+        {
+            mEngineSizeInBytes -= mEngineLruTaskIds.back().second;
+            mEngineTaskIds.erase(mEngineLruTaskIds.back().first);
+            mEngineLruTaskIds.pop_back();
+        }
+    }
+    return adapter;
+}
+
+void LoraAdapterStore::invalidateEngineCache(uint64_t taskId)
+{
+    std::lock_guard<std::mutex> lk(mMutex);
+    auto it = mEngineTaskIds.find(taskId);
+    if (it != mEngineTaskIds.end())
+    {
+        mEngineSizeInBytes -= it->second->second;
+        mEngineLruTaskIds.erase(it->second);
+        mEngineTaskIds.erase(it);
+    }
+}
+
+void LoraAdapterStore::prefetch(uint64_t taskId)
+{
+    {
+        std::lock_guard<std::mutex> lk(mMutex);
+        if (mAdapters.find(taskId) != mAdapters.end() || mLoading.find(taskId) != mLoading.end()
+            || !mPrefetchPending.insert(taskId).second)
+        {
+            return;
+        }
+        mPrefetchQueue.push_back(taskId);
+    }
+    mPrefetchCV.notify_one();
+}
+
+std::shared_ptr<LoraAdapterStore::Adapter const> LoraAdapterStore::load(uint64_t taskId) const
+{
+    auto const adapterDir = mRoot / std::to_string(taskId);
+    if (!std::filesystem::is_directory(adapterDir))
+    {
+        return nullptr;
+    }
+
+    auto const start = std::chrono::steady_clock::now();
+
+    auto adapter = std::make_shared<Adapter>();
+    adapter->weights = mapNpyTensor(adapterDir / kWeightsFileName);
+    adapter->config = mapNpyTensor(adapterDir / kConfigFileName);
+    adapter->sizeInBytes = adapter->weights->getSizeInBytes() + adapter->config->getSizeInBytes();
+
+    auto const elapsed = std::chrono::steady_clock::now() - start;
+    ++mNumLoads;
+    mLoadTimeUs += std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    TLLM_LOG_DEBUG("Loaded LoRA adapter for task %lu (%zu bytes)", taskId, adapter->sizeInBytes);
+
+    return adapter;
+}
+
+std::shared_ptr<LoraAdapterStore::Adapter const> LoraAdapterStore::loadOnce(uint64_t taskId, bool countHit)
+{
+    std::promise<std::shared_ptr<Adapter const>> promise;
+    {
+        std::unique_lock<std::mutex> lk(mMutex);
+        auto it = mAdapters.find(taskId);
+        if (it != mAdapters.end())
+        {
+            mLruTaskIds.splice(mLruTaskIds.begin(), mLruTaskIds, it->second.second);
+            mNumHits += countHit;
+            return it->second.first;
+        }
+
+        // Another thread is loading this adapter, wait for it instead of loading it twice
+        auto loading = mLoading.find(taskId);
+        if (loading != mLoading.end())
+        {
+            auto future = loading->second;
+            lk.unlock();
+            mNumHits += countHit;
+            return future.get();
+        }
+        mLoading.emplace(taskId, promise.get_future().share());
+    }
+
+    // Load outside of the lock, other adapters can be served in the meantime
+    std::shared_ptr<Adapter const> adapter;
+    try
+    {
+        adapter = load(taskId);
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> lk(mMutex);
+        mLoading.erase(taskId);
+        promise.set_exception(std::current_exception());
+        throw;
+    }
+
+    {
+        std::lock_guard<std::mutex> lk(mMutex);
+        if (adapter)
+        {
+            insert(taskId, adapter);
+        }
+        mLoading.erase(taskId);
+    }
+    promise.set_value(adapter);
+    return adapter;
+}
+
+void LoraAdapterStore::insert(uint64_t taskId, std::shared_ptr<Adapter const> adapter)
+{
+    auto it = mAdapters.find(taskId);
+    if (it != mAdapters.end())
+    {
+        mLruTaskIds.splice(mLruTaskIds.begin(), mLruTaskIds, it->second.second);
+        return;
+    }
+
+    mLruTaskIds.push_front(taskId);
+    mSizeInBytes += adapter->sizeInBytes;
+    mAdapters.emplace(taskId, std::make_pair(std::move(adapter), mLruTaskIds.begin()));
+
+    // Always keep the adapter just inserted, even if it exceeds the budget on its own
+    while (mSizeInBytes > mHostMemoryBytes && mLruTaskIds.size() > 1)
+    {
+        auto const evicted = mAdapters.find(mLruTaskIds.back());
+        mSizeInBytes -= evicted->second.first->sizeInBytes;
+        mAdapters.erase(evicted);
+        mLruTaskIds.pop_back();
+    }
+}
+
+void LoraAdapterStore::prefetchThread()
+{
+    while (true)
+    {
+        uint64_t taskId;
+        {
+            std::unique_lock<std::mutex> lk(mMutex);
+            mPrefetchCV.wait(lk, [this]() { return mShutdown || !mPrefetchQueue.empty(); });
+            if (mShutdown)
+            {
+                break;
+            }
+            taskId = mPrefetchQueue.front();
+            mPrefetchQueue.pop_front();
+        }
+
+        try
+        {
+            loadOnce(taskId, false);
+        }
+        catch (std::exception const& e)
+        {
+            TLLM_LOG_ERROR("Failed to prefetch LoRA adapter for task %lu: %s", taskId, e.what());
+        }
+
+        std::lock_guard<std::mutex> lk(mMutex);
+        mPrefetchPending.erase(taskId);
+    }
+}
+
+} // namespace triton::backend::inflight_batcher_llm
@@ -0,0 +1,171 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "tensorrt_llm/runtime/iTensor.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace triton::backend::inflight_batcher_llm
+{
+
+/// @brief Repository of pre-converted LoRA adapters, keyed by task id.
+/// Each adapter lives in `<root>/<task_id>/` and consists of the `model.lora_weights.npy` and
+/// `model.lora_config.npy` files produced by `hf_lora_convert.py`. Adapters are memory-mapped on demand and kept
+/// in an LRU cache bounded by a host memory budget. Evicted adapters stay valid for as long as a request holds
+/// their tensors. Concurrent requests for the same adapter share a single load.
+///
+/// The store also tracks the adapters whose weights were sent to the engine, bounded by the host memory of the
+/// engine PEFT cache, so that the weights are only attached to a request when the engine is not expected to hold
+/// them already. GptManager does not expose its PEFT cache, so this is an estimate: when the engine reports an
+/// adapter missing, the caller invalidates it and resubmits the request with the weights.
+class LoraAdapterStore
+{
+    using TensorPtr = tensorrt_llm::runtime::ITensor::SharedPtr;
+
+public:
+    static constexpr char const* kWeightsFileName = "model.lora_weights.npy";
+    static constexpr char const* kConfigFileName = "model.lora_config.npy";
+
+    struct Adapter
+    {
+        TensorPtr weights;
+        TensorPtr config;
+        size_t sizeInBytes;
+    };
+
+    /// @param hostMemoryBytes Host memory budget of the store
+    /// @param engineCacheBytes Host memory of the engine PEFT cache
+    LoraAdapterStore(std::filesystem::path root, size_t hostMemoryBytes, size_t engineCacheBytes);
+
+    ~LoraAdapterStore();
+
+    /// @brief Get the adapter of a task, loading it if needed
+    /// @return nullptr if the store has no adapter for this task id. Throws if the adapter files are invalid.
+    std::shared_ptr<Adapter const> get(uint64_t taskId);
+
+    /// @brief Get the adapter of a task to attach to a request, unless the engine is expected to hold it already.
+    /// The adapter is then assumed to be held by the engine.
+    /// @return nullptr if the engine is expected to hold the adapter or if the store has no adapter for this task
+    /// id. Throws if the adapter files are invalid.
+    std::shared_ptr<Adapter const> getForEngine(uint64_t taskId);
+
+    /// @brief Forget that the engine holds the adapter of a task, after the engine reported it missing
+    void invalidateEngineCache(uint64_t taskId);
+
+    /// @brief Load the adapter of a task in the background, ahead of its use
+    void prefetch(uint64_t taskId);
+
+    /// @brief Number of adapters loaded from disk
+    uint64_t numLoads() const
+    {
+        return mNumLoads.load();
+    }
+
+    /// @brief Cumulative time spent loading adapters from disk, in microseconds
+    uint64_t loadTimeUs() const
+    {
+        return mLoadTimeUs.load();
+    }
+
+    /// @brief Number of requests sent without the adapter weights because the engine was expected to hold them
+    uint64_t numEngineCacheHits() const
+    {
+        return mNumEngineCacheHits.load();
+    }
+
+    /// @brief Number of requests served from an adapter that was already loaded
+    uint64_t numHits() const
+    {
+        return mNumHits.load();
+    }
+
+    /// @brief Size of the adapters currently held by the store
+    uint64_t sizeInBytes() const
+    {
+        std::lock_guard<std::mutex> lk(mMutex);
+        return mSizeInBytes;
+    }
+
+private:
+    /// @brief Memory-map an adapter from disk
+    /// @return nullptr if no adapter exists for this task id
+    std::shared_ptr<Adapter const> load(uint64_t taskId) const;
+
+    /// @brief Get an adapter from the cache, or load it and insert it in the cache. Waits for the load already in
+    /// flight for this task id, if any.
+    /// @param countHit Whether an adapter that is not loaded by this call counts as a hit
+    std::shared_ptr<Adapter const> loadOnce(uint64_t taskId, bool countHit);
+
+    /// @brief Insert an adapter in the LRU cache, evicting the least recently used adapters if over budget.
+    /// Must be called under mMutex.
+    void insert(uint64_t taskId, std::shared_ptr<Adapter const> adapter);
+
+    void prefetchThread();
+
+    std::filesystem::path mRoot;
+    size_t mHostMemoryBytes;
+
+    mutable std::mutex mMutex;
+    /// task ids of the cached adapters, most recently used first
+    std::list<uint64_t> mLruTaskIds;
+    std::unordered_map<uint64_t, std::pair<std::shared_ptr<Adapter const>, std::list<uint64_t>::iterator>> mAdapters;
+    size_t mSizeInBytes{0};
+    /// loads in flight, per task id
+    std::unordered_map<uint64_t, std::shared_future<std::shared_ptr<Adapter const>>> mLoading;
+
+    size_t mEngineCacheBytes;
+    /// task ids of the adapters expected to be held by the engine, most recently sent first, with their size
+    std::list<std::pair<uint64_t, size_t>> mEngineLruTaskIds;
+    std::unordered_map<uint64_t, std::list<std::pair<uint64_t, size_t>>::iterator> mEngineTaskIds;
+    size_t mEngineSizeInBytes{0};
+
+    std::thread mPrefetchThread;
+    std::deque<uint64_t> mPrefetchQueue;
+    std::unordered_set<uint64_t> mPrefetchPending;
+    std::condition_variable mPrefetchCV;
+    bool mShutdown{false};
+
+    mutable std::atomic<uint64_t> mNumLoads{0};
+    mutable std::atomic<uint64_t> mLoadTimeUs{0};
+    std::atomic<uint64_t> mNumHits{0};
+    std::atomic<uint64_t> mNumEngineCacheHits{0};
+};
+
+} // namespace triton::backend::inflight_batcher_llm
@@ -0,0 +1,92 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "lora_scheduling_policy.h"
+
+#include <algorithm>
+
+namespace triton::backend::inflight_batcher_llm
+{
+
+LoraSchedulingPolicy::LoraSchedulingPolicy(SizeType numResidentAdapters, SizeType maxSkips, SizeType lookahead)
+    : mNumResidentAdapters(std::max(numResidentAdapters, 1))
+    , mMaxSkips(std::max(maxSkips, 0))
+    , mLookahead(std::max(lookahead, 1))
+{
+}
+
+size_t LoraSchedulingPolicy::select(std::vector<std::optional<uint64_t>> const& taskIds)
+{
+    // Fairness bound: the head of the queue cannot be bypassed forever
+    if (mHeadSkips >= mMaxSkips)
+    {
+        mHeadSkips = 0;
+        return 0;
+    }
+
+    auto const numCandidates = std::min(taskIds.size(), static_cast<size_t>(mLookahead));
+    for (size_t i = 0; i < numCandidates; ++i)
+    {
+        auto const& taskId = taskIds[i];
+        // Requests without adapter never trigger an upload
+        if (!taskId || isResident(taskId.value()))
+        {
+            mHeadSkips = (i == 0) ? 0 : mHeadSkips + 1;
+            return i;
+        }
+    }
+
+    // No request can be served from the resident adapters, fall back to arrival order
+    mHeadSkips = 0;
+    return 0;
+}
+
+void LoraSchedulingPolicy::onScheduled(std::optional<uint64_t> taskId)
+{
+    if (!taskId)
+    {
+        return;
+    }
+
+    auto it = mResidentTaskIdsMap.find(taskId.value());
+    if (it != mResidentTaskIdsMap.end())
+    {
+        ++mNumHits;
+        mResidentTaskIds.splice(mResidentTaskIds.begin(), mResidentTaskIds, it->second);
+        return;
+    }
+
+    ++mNumMisses;
+    mResidentTaskIds.push_front(taskId.value());
+    mResidentTaskIdsMap.emplace(taskId.value(), mResidentTaskIds.begin());
+    if (static_cast<SizeType>(mResidentTaskIds.size()) > mNumResidentAdapters)
+    {
+        mResidentTaskIdsMap.erase(mResidentTaskIds.back());
+        mResidentTaskIds.pop_back();
+    }
+}
+
+} // namespace triton::backend::inflight_batcher_llm
@@ -0,0 +1,112 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "tensorrt_llm/runtime/common.h"
+
+#include <atomic>
+#include <cstdint>
+#include <iterator>
+#include <list>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace triton::backend::inflight_batcher_llm
+{
+
+/// @brief Queue policy that groups requests by LoRA adapter.
+/// Requests whose adapter was recently scheduled (and is therefore likely resident in the PEFT device cache)
+/// are preferred over requests that would trigger an adapter upload. GptManager does not expose the content of
+/// its PEFT cache, so residency is approximated by the set of the most recently scheduled task ids.
+/// The request at the head of the queue can be bypassed at most maxSkips times before it is scheduled.
+class LoraSchedulingPolicy
+{
+    using SizeType = tensorrt_llm::runtime::SizeType;
+
+public:
+    LoraSchedulingPolicy(SizeType numResidentAdapters, SizeType maxSkips, SizeType lookahead);
+
+    /// @brief Select the index of the next request to schedule
+    /// @param taskIds LoRA task ids of the pending requests, in arrival order. Only the first `lookahead`
+    /// entries are considered.
+    /// @return The index of the request to schedule
+    size_t select(std::vector<std::optional<uint64_t>> const& taskIds);
+
+    /// @brief Select the next item to schedule from a list of pending items
+    /// @param getTaskId Functor returning the LoRA task id of an item
+    template <typename T, typename GetTaskId>
+    typename std::list<T>::iterator select(std::list<T>& pending, GetTaskId const& getTaskId)
+    {
+        std::vector<std::optional<uint64_t>> taskIds;
+        for (auto it = pending.begin(); it != pending.end() && static_cast<SizeType>(taskIds.size()) < mLookahead;
+             ++it)
+        {
+            taskIds.push_back(getTaskId(*it));
+        }
+        auto selected = pending.begin();
+        std::advance(selected, select(taskIds));
+        return selected;
+    }
+
+    /// @brief Record that a request was scheduled, updating the set of resident adapters
+    void onScheduled(std::optional<uint64_t> taskId);
+
+    bool isResident(uint64_t taskId) const
+    {
+        return mResidentTaskIdsMap.find(taskId) != mResidentTaskIdsMap.end();
+    }
+
+    /// @brief Number of scheduled LoRA requests whose adapter was already resident
+    uint64_t numHits() const
+    {
+        return mNumHits.load();
+    }
+
+    /// @brief Number of scheduled LoRA requests whose adapter had to be loaded
+    uint64_t numMisses() const
+    {
+        return mNumMisses.load();
+    }
+
+private:
+    SizeType mNumResidentAdapters;
+    SizeType mMaxSkips;
+    SizeType mLookahead;
+
+    /// Number of times the request at the head of the queue has been bypassed
+    SizeType mHeadSkips{0};
+
+    /// Task ids of the resident adapters, most recently scheduled first
+    std::list<uint64_t> mResidentTaskIds;
+    std::unordered_map<uint64_t, std::list<uint64_t>::iterator> mResidentTaskIdsMap;
+
+    std::atomic<uint64_t> mNumHits{0};
+    std::atomic<uint64_t> mNumMisses{0};
+};
+
+} // namespace triton::backend::inflight_batcher_llm
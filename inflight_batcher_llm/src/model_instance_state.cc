@@ -25,12 +25,14 @@
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "model_instance_state.h"
+#include "engine_config.h"
 #include "utils.h"
 
 #include "mpi_utils.h"
 
 #include "tensorrt_llm/common/mpiUtils.h"
 
+#include <cuda_runtime_api.h>
 #include <nlohmann/json.hpp>
 
 namespace mpi = tensorrt_llm::mpi;
@@ -38,6 +40,9 @@ namespace mpi = tensorrt_llm::mpi;
 namespace triton::backend::inflight_batcher_llm
 {
 
+std::mutex ModelInstanceState::sInstancesMutex;
+std::unordered_map<std::string, std::vector<ModelInstanceState*>> ModelInstanceState::sInstances;
+
 TRITONSERVER_Error* ModelInstanceState::Create(
     ModelState* model_state, TRITONBACKEND_ModelInstance* triton_model_instance, ModelInstanceState** state)
 {
@@ -78,6 +83,44 @@ ModelInstanceState::ModelInstanceState(
     , modelInstance_(triton_model_instance)
     , mHasActiveRequests(false)
 {
+    uint64_t initStartNs = 0;
+    SET_TIMESTAMP(initStartNs);
+
+    mModelPath = model_state_->GetParameter<std::string>("gpt_model_path");
+
+    // parse engine prefetch parameters
+    // - engine_prefetch_concurrency
+    // - engine_prefetch_readahead_bytes
+    int32_t enginePrefetchConcurrency = kDefaultEnginePrefetchConcurrency;
+    try
+    {
+        enginePrefetchConcurrency = model_state_->GetParameter<int32_t>("engine_prefetch_concurrency");
+    }
+    catch (std::exception const& e)
+    {
+        TLLM_LOG_WARNING("engine_prefetch_concurrency is not specified, will use default value of "
+            + std::to_string(kDefaultEnginePrefetchConcurrency));
+    }
+
+    uint64_t enginePrefetchReadaheadBytes = kDefaultEnginePrefetchReadaheadBytes;
+    try
+    {
+        enginePrefetchReadaheadBytes = model_state_->GetParameter<uint64_t>("engine_prefetch_readahead_bytes");
+    }
+    catch (std::exception const& e)
+    {
+        TLLM_LOG_WARNING("engine_prefetch_readahead_bytes is not specified, will use default value of "
+            + std::to_string(kDefaultEnginePrefetchReadaheadBytes));
+    }
+
+    // Read the engine file into the page cache while the rest of the parameters are parsed
+    std::unique_ptr<EnginePrefetcher> enginePrefetcher;
+    if (enginePrefetchConcurrency > 0)
+    {
+        enginePrefetcher = std::make_unique<EnginePrefetcher>(mModelPath, enginePrefetchConcurrency,
+            enginePrefetchReadaheadBytes, COMM_SESSION.getRank(), COMM_SESSION.getSize());
+    }
+
     // Note: std::string::compare fails this test (always return non-zero
     // value). Using old school strcmp instead.
     auto gpt_model_type = model_state_->GetParameter<std::string>("gpt_model_type");
@@ -101,23 +144,45 @@ ModelInstanceState::ModelInstanceState(
     }
 
 #ifdef TRITON_ENABLE_METRICS
-    custom_metrics_reporter_ = std::make_unique<custom_metrics_reporter::CustomMetricsReporter>();
-    custom_metrics_reporter_->InitializeReporter(
-        model_state->GetModelName(), model_state->GetModelVersion(), (mTrtGptModelType == TrtGptModelType::V1));
+    // The metrics are registered with the Triton server, an instance loaded without one (orchestrator worker or
+    // in-process engine) has no reporter
+    if (modelInstance_ != nullptr)
+    {
+        custom_metrics_reporter_ = std::make_unique<custom_metrics_reporter::CustomMetricsReporter>();
+        custom_metrics_reporter_->InitializeReporter(
+            model_state->GetModelName(), model_state->GetModelVersion(), (mTrtGptModelType == TrtGptModelType::V1));
+    }
 #endif
 
     mWorkItemsQueue = std::make_unique<WorkItemsQueue>(isDecoupled());
+    if (auto const sessionHistoryBytes = model_state_->GetSessionHistoryBytes())
+    {
+        mSessionStore = std::make_shared<SessionStore>(sessionHistoryBytes.value());
+        mWorkItemsQueue->setSessionStore(mSessionStore);
+#ifdef TRITON_ENABLE_METRICS
+        addMetricGroup("nv_trt_llm_session_store_metrics", "TRT LLM session store metrics", "session_store_type",
+            custom_metrics_reporter::CustomMetricsReporter::session_store_keys_,
+            custom_metrics_reporter::CustomMetricsReporter::session_store_labels_);
+#endif
+    }
 
-    // Note: std::string::compare fails this test (always return non-zero
-    // value). Using old school strcmp instead.
-    mModelPath = model_state_->GetParameter<std::string>("gpt_model_path");
-    auto configPath = mModelPath + "/config.json";
-    std::ifstream jsonStream(configPath);
-    TLLM_CHECK_WITH_INFO(jsonStream.is_open(), "Cannot find engine config file %s", configPath.c_str());
+    auto engineConfig = EngineConfig::load(mModelPath);
+    auto& engineLimits = engineConfig.limits;
+    auto const& engineDataTypes = engineConfig.dataTypes;
 
-    auto constexpr allowExceptions = true;
-    auto constexpr ingoreComments = true;
-    auto json = nlohmann::json::parse(jsonStream, nullptr, allowExceptions, ingoreComments);
+    // the vocabulary size is needed to expand sparse embedding biases, the logits are fp32 unless the engine says
+    // otherwise
+    if (engineLimits.vocabSize)
+    {
+        mSparseEmbeddingBias = std::make_unique<SparseEmbeddingBias>(engineLimits.vocabSize.value(),
+            COMM_SESSION.getSize(), engineDataTypes.logits.value_or(nvinfer1::DataType::kFLOAT),
+            kSparseEmbeddingBiasNumCached);
+    }
+    else
+    {
+        TLLM_LOG_WARNING("vocab_size not found in %s/config.json, embedding_bias_ids will be ignored",
+            mModelPath.c_str());
+    }
 
     int32_t maxBeamWidth = 1;
     try
@@ -130,6 +195,32 @@ ModelInstanceState::ModelInstanceState(
         TLLM_LOG_WARNING("max_beam_width is not specified, will use default value of 1");
     }
 
+    // Reject the requests the engine cannot serve as soon as they are queued, and convert their inputs to the data
+    // types of the engine. In orchestrator mode, the orchestrator does it before sending the requests.
+    if (COMM_SESSION.getRank() == 0 && leaderOrchComm == MPI_COMM_NULL)
+    {
+        engineLimits.maxBeamWidth = std::min(engineLimits.maxBeamWidth.value_or(maxBeamWidth), maxBeamWidth);
+        mRequestValidator = std::make_shared<RequestValidator>(std::move(engineLimits));
+        mWorkItemsQueue->setRequestValidator(mRequestValidator);
+        mWorkItemsQueue->setEngineDataTypes(engineDataTypes);
+
+        bool deferRequestConversion = false;
+        try
+        {
+            deferRequestConversion = model_state_->GetParameter<bool>("defer_request_conversion");
+        }
+        catch (std::exception const& e)
+        {
+            TLLM_LOG_WARNING("defer_request_conversion is not specified, will use default value of false");
+        }
+        mWorkItemsQueue->setDeferConversion(deferRequestConversion);
+#ifdef TRITON_ENABLE_METRICS
+        addMetricGroup("nv_trt_llm_request_validation_metrics", "TRT LLM request validation metrics", "rejection_type",
+            custom_metrics_reporter::CustomMetricsReporter::request_validation_keys_,
+            custom_metrics_reporter::CustomMetricsReporter::request_validation_labels_);
+#endif
+    }
+
     std::optional<int32_t> maxTokensInPagedKvCache = std::nullopt;
     try
     {
@@ -243,6 +334,7 @@ ModelInstanceState::ModelInstanceState(
         // If parameter is not specified, just ignore
         TLLM_LOG_WARNING("exclude_input_in_output is not specified, will be set to false");
     }
+    mExcludeInputInOutput = excludeInputInOutput;
 
     std::optional<int32_t> maxAttentionWindow = std::nullopt;
     try
@@ -350,8 +442,296 @@ ModelInstanceState::ModelInstanceState(
         TLLM_LOG_WARNING(fieldName + " not set, defaulting to 1GB");
     }
 
+    // parse LoRA-aware scheduling parameters
+    // enable_lora_aware_scheduling
+    // lora_scheduling_resident_adapters
+    // lora_scheduling_max_skips
+    // lora_scheduling_lookahead
+
+    bool enableLoraAwareScheduling = false;
+    SizeType loraSchedulingResidentAdapters = 8;
+    SizeType loraSchedulingMaxSkips = 16;
+    SizeType loraSchedulingLookahead = 64;
+
+    fieldName = "enable_lora_aware_scheduling";
+    try
+    {
+        enableLoraAwareScheduling = model_state_->GetParameter<bool>(fieldName);
+    }
+    catch (std::exception const& e)
+    {
+        TLLM_LOG_WARNING(fieldName + " not set, defaulting to false");
+    }
+
+    if (enableLoraAwareScheduling)
+    {
+        fieldName = "lora_scheduling_resident_adapters";
+        try
+        {
+            loraSchedulingResidentAdapters = model_state_->GetParameter<SizeType>(fieldName);
+        }
+        catch (std::exception const& e)
+        {
+            TLLM_LOG_WARNING(fieldName + " not set, defaulting to 8");
+        }
+        fieldName = "lora_scheduling_max_skips";
+        try
+        {
+            loraSchedulingMaxSkips = model_state_->GetParameter<SizeType>(fieldName);
+        }
+        catch (std::exception const& e)
+        {
+            TLLM_LOG_WARNING(fieldName + " not set, defaulting to 16");
+        }
+        fieldName = "lora_scheduling_lookahead";
+        try
+        {
+            loraSchedulingLookahead = model_state_->GetParameter<SizeType>(fieldName);
+        }
+        catch (std::exception const& e)
+        {
+            TLLM_LOG_WARNING(fieldName + " not set, defaulting to 64");
+        }
+
+        mLoraSchedulingPolicy = std::make_shared<LoraSchedulingPolicy>(
+            loraSchedulingResidentAdapters, loraSchedulingMaxSkips, loraSchedulingLookahead);
+        mWorkItemsQueue->setLoraSchedulingPolicy(mLoraSchedulingPolicy);
+
+#ifdef TRITON_ENABLE_METRICS
+        // The residency is estimated by the scheduling policy, it is not read from the PEFT cache of the engine
+        addMetricGroup("nv_trt_llm_lora_scheduling_metrics", "TRT LLM LoRA scheduling metrics", "lora_scheduling_type",
+            custom_metrics_reporter::CustomMetricsReporter::lora_scheduling_keys_,
+            custom_metrics_reporter::CustomMetricsReporter::lora_scheduling_labels_);
+#endif
+    }
+
+    // parse LoRA adapter store parameters
+    // lora_adapter_dir
+    // lora_adapter_store_host_memory_bytes
+
+    std::string loraAdapterDir;
+    size_t loraAdapterStoreHostMemoryBytes = size_t{1} << 30;
+
+    fieldName = "lora_adapter_dir";
+    try
+    {
+        loraAdapterDir = model_state_->GetParameter<std::string>(fieldName);
+    }
+    catch (std::exception const& e)
+    {
+        TLLM_LOG_WARNING(fieldName + " not set, LoRA adapters must be provided by clients");
+    }
+
+    if (!loraAdapterDir.empty())
+    {
+        fieldName = "lora_adapter_store_host_memory_bytes";
+        try
+        {
+            loraAdapterStoreHostMemoryBytes = model_state_->GetParameter<size_t>(fieldName);
+        }
+        catch (std::exception const& e)
+        {
+            TLLM_LOG_WARNING(fieldName + " not set, defaulting to 1GB");
+        }
+
+        // The weights are only attached to the requests whose adapter is not expected in the host PEFT cache
+        mLoraAdapterStore = std::make_unique<LoraAdapterStore>(
+            loraAdapterDir, loraAdapterStoreHostMemoryBytes, hostCacheSize.value_or(size_t{1} << 30));
+
+#ifdef TRITON_ENABLE_METRICS
+        addMetricGroup("nv_trt_llm_lora_adapter_store_metrics", "TRT LLM LoRA adapter store metrics",
+            "lora_adapter_store_type", custom_metrics_reporter::CustomMetricsReporter::lora_adapter_store_keys_,
+            custom_metrics_reporter::CustomMetricsReporter::lora_adapter_store_labels_);
+#endif
+    }
+
+    // top-k log-probs are encoded with the data type declared in the model config
+    mTopKLogProbsFp16 = model_state_->GetOutputDataType("generation_top_k_log_probs") == "TYPE_FP16";
+
+    // parse prompt embedding table cache parameters
+    // prompt_embedding_table_cache_bytes
+
+    size_t promptTableCacheBytes = 0;
+    fieldName = "prompt_embedding_table_cache_bytes";
+    try
+    {
+        promptTableCacheBytes = model_state_->GetParameter<size_t>(fieldName);
+    }
+    catch (std::exception const& e)
+    {
+        TLLM_LOG_WARNING(fieldName + " not set, prompt embedding tables will not be cached");
+    }
+
+    if (promptTableCacheBytes > 0)
+    {
+        mPromptTableCache = std::make_unique<PromptTableCache>(promptTableCacheBytes);
+
+#ifdef TRITON_ENABLE_METRICS
+        addMetricGroup("nv_trt_llm_prompt_table_cache_metrics", "TRT LLM prompt embedding table cache metrics",
+            "prompt_table_cache_type", custom_metrics_reporter::CustomMetricsReporter::prompt_table_cache_keys_,
+            custom_metrics_reporter::CustomMetricsReporter::prompt_table_cache_labels_);
+#endif
+    }
+
+    // parse speculative decoding parameters
+    // speculative_draft_model
+    // prompt_lookup_max_ngram_size
+    // enable_prompt_lookup
+    // speculative_max_draft_length
+    // speculative_min_acceptance_rate
+
+    SpeculativeDecoder::Config speculativeConfig;
+    speculativeConfig.minAcceptanceRate = 0.1f;
+    speculativeConfig.excludeInputInOutput = excludeInputInOutput;
+
+    fieldName = "speculative_draft_model";
+    try
+    {
+        speculativeConfig.draftModelName = model_state_->GetParameter<std::string>(fieldName);
+    }
+    catch (std::exception const& e)
+    {
+        TLLM_LOG_WARNING(fieldName + " not set, speculative decoding with a draft model is disabled");
+    }
+
+    fieldName = "prompt_lookup_max_ngram_size";
+    try
+    {
+        speculativeConfig.promptLookupMaxNgramSize = model_state_->GetParameter<int32_t>(fieldName);
+    }
+    catch (std::exception const& e)
+    {
+        TLLM_LOG_WARNING(fieldName + " not set, speculative decoding with prompt lookup is disabled");
+    }
+
+    if (!speculativeConfig.draftModelName.empty() || speculativeConfig.promptLookupMaxNgramSize > 0)
+    {
+        if (speculativeConfig.promptLookupMaxNgramSize > 0)
+        {
+            fieldName = "enable_prompt_lookup";
+            try
+            {
+                speculativeConfig.promptLookupByDefault = model_state_->GetParameter<bool>(fieldName);
+            }
+            catch (std::exception const& e)
+            {
+                TLLM_LOG_WARNING(fieldName + " not set, only requests setting prompt_lookup use prompt lookup");
+            }
+        }
+
+        fieldName = "speculative_max_draft_length";
+        try
+        {
+            speculativeConfig.maxDraftLength = model_state_->GetParameter<int32_t>(fieldName);
+        }
+        catch (std::exception const& e)
+        {
+            TLLM_LOG_WARNING(fieldName + " not set, defaulting to 4");
+        }
+
+        fieldName = "speculative_min_acceptance_rate";
+        try
+        {
+            speculativeConfig.minAcceptanceRate = model_state_->GetParameter<float>(fieldName);
+        }
+        catch (std::exception const& e)
+        {
+            TLLM_LOG_WARNING(fieldName + " not set, defaulting to 0.1");
+        }
+
+        // Rounds are resubmitted to the work items queue of this process, which only receives requests in
+        // non-orchestrator mode and on rank 0
+        if (modelInstance_ == nullptr || leaderOrchComm != MPI_COMM_NULL)
+        {
+            TLLM_LOG_WARNING("speculative decoding is only supported in non-orchestrator mode, ignoring");
+        }
+        else if (COMM_SESSION.getRank() == 0)
+        {
+            // The draft model is queried through the Triton server of this process
+            TRITONSERVER_Server* server = nullptr;
+            if (!speculativeConfig.draftModelName.empty())
+            {
+                TRITONBACKEND_Model* model = nullptr;
+                auto* err = TRITONBACKEND_ModelInstanceModel(modelInstance_, &model);
+                if (err == nullptr)
+                {
+                    err = TRITONBACKEND_ModelServer(model, &server);
+                }
+                if (err != nullptr)
+                {
+                    std::string const errStr
+                        = std::string("Failed to get the Triton server: ") + TRITONSERVER_ErrorMessage(err);
+                    TRITONSERVER_ErrorDelete(err);
+                    throw std::runtime_error(errStr);
+                }
+            }
+            mSpeculativeDecoder = std::make_unique<SpeculativeDecoder>(
+                server, speculativeConfig,
+                [this](uint64_t requestId, std::shared_ptr<InferenceRequest> round)
+                { mWorkItemsQueue->resubmit(requestId, std::move(round)); },
+                [this]() { return mWorkItemsQueue->numPendingWorkItems(); });
+
+#ifdef TRITON_ENABLE_METRICS
+            addMetricGroup("nv_trt_llm_speculative_decoding_metrics", "TRT LLM speculative decoding metrics",
+                "speculative_decoding_type", custom_metrics_reporter::CustomMetricsReporter::speculative_decoding_keys_,
+                custom_metrics_reporter::CustomMetricsReporter::speculative_decoding_labels_);
+#endif
+        }
+    }
+
+    try
+    {
+        mDrainTimeoutMs = model_state_->GetParameter<int32_t>("drain_timeout_ms");
+    }
+    catch (std::exception const& e)
+    {
+        TLLM_LOG_WARNING(
+            "drain_timeout_ms is not specified, will use default value of " + std::to_string(kDefaultDrainTimeoutMs));
+    }
+
+    uint64_t requestBroadcastShmBytes = kDefaultRequestBroadcastShmBytes;
+    try
+    {
+        requestBroadcastShmBytes = model_state_->GetParameter<uint64_t>("request_broadcast_shm_bytes");
+    }
+    catch (std::exception const& e)
+    {
+        TLLM_LOG_WARNING("request_broadcast_shm_bytes is not specified, will use default value of "
+            + std::to_string(kDefaultRequestBroadcastShmBytes));
+    }
+    // All the ranks create the segment before GptManager starts requesting work
+    if (requestBroadcastShmBytes > 0 && COMM_SESSION.getSize() > 1)
+    {
+        mRequestBroadcast = SharedMemoryBroadcast::create(COMM_SESSION, requestBroadcastShmBytes);
+    }
+
     auto const gpuDeviceIds = model_state_->GetDeviceIds();
 
+    std::string cpuAffinity = "none";
+    try
+    {
+        cpuAffinity = model_state_->GetParameter<std::string>("cpu_affinity");
+    }
+    catch (std::exception const& e)
+    {
+        TLLM_LOG_WARNING("cpu_affinity is not specified, will use default value of none");
+    }
+    // Same device as the one GptManager selects for this rank
+    int32_t deviceId = COMM_SESSION.getRank();
+    if (gpuDeviceIds && !gpuDeviceIds.value().empty())
+    {
+        deviceId = gpuDeviceIds.value()[COMM_SESSION.getRank() % gpuDeviceIds.value().size()];
+    }
+    else
+    {
+        int deviceCount = 0;
+        if (cudaGetDeviceCount(&deviceCount) == cudaSuccess && deviceCount > 0)
+        {
+            deviceId %= deviceCount;
+        }
+    }
+    mThreadPlacement = getThreadPlacement(cpuAffinity, deviceId);
+
     TrtGptModelOptionalParams optionalParams;
     optionalParams.kvCacheConfig.maxTokens = maxTokensInPagedKvCache;
     optionalParams.kvCacheConfig.freeGpuMemoryFraction = kvCacheFreeGpuMemFraction;
@@ -373,28 +753,72 @@ ModelInstanceState::ModelInstanceState(
     optionalParams.peftCacheManagerConfig.numCopyStreams = ModelInstanceState::kPeftCacheNumCopyStreams;
     optionalParams.peftCacheManagerConfig.numPutWorkers = ModelInstanceState::kPeftCacheNumPutWorkers;
 
-    mBatchManager = std::make_shared<GptManager>(
-        mModelPath, mTrtGptModelType, maxBeamWidth, schedulerPolicy,
-        [this](int max_num_requests)
-        {
-            return mLeaderOrchComm ? get_inference_requests_leader(max_num_requests)
-                                   : get_inference_requests(max_num_requests);
-        },
-        [this](
-            uint64_t requestId, std::list<NamedTensor> response_tensors, bool final_response, std::string const& errMsg)
-        {
-            return mLeaderOrchComm ? sendResponseLeader(requestId, response_tensors, final_response, errMsg)
-                                   : sendResponse(requestId, response_tensors, final_response, errMsg);
-        },
-        [this]() { return pollStopSignals(); }, [this](std::string const& s) { return logStats(s); }, optionalParams,
-        std::nullopt, std::nullopt, excludeInputInOutput);
+    uint64_t parametersEndNs = 0;
+    SET_TIMESTAMP(parametersEndNs);
+
+    if (enginePrefetcher)
+    {
+        enginePrefetcher->wait();
+    }
+
+    uint64_t prefetchEndNs = 0;
+    SET_TIMESTAMP(prefetchEndNs);
+
+    {
+        // GptManager allocates its host buffers and creates its threads with the placement of this thread
+        ScopedThreadPlacement threadPlacement(mThreadPlacement);
+        mBatchManager = std::make_shared<GptManager>(
+            mModelPath, mTrtGptModelType, maxBeamWidth, schedulerPolicy,
+            [this](int max_num_requests)
+            {
+                return mLeaderOrchComm ? get_inference_requests_leader(max_num_requests)
+                                       : get_inference_requests(max_num_requests);
+            },
+            [this](uint64_t requestId, std::list<NamedTensor> response_tensors, bool final_response,
+                std::string const& errMsg)
+            {
+                return mLeaderOrchComm ? sendResponseLeader(requestId, response_tensors, final_response, errMsg)
+                                       : sendResponse(requestId, response_tensors, final_response, errMsg);
+            },
+            [this]() { return pollStopSignals(); }, [this](std::string const& s) { return logStats(s); },
+            optionalParams, std::nullopt, std::nullopt, excludeInputInOutput);
+    }
+
+    uint64_t engineLoadEndNs = 0;
+    SET_TIMESTAMP(engineLoadEndNs);
+    TLLM_LOG_INFO(
+        "Model %s initialized in %.2f s: parameters %.2f s, engine prefetch wait %.2f s, engine load %.2f s",
+        model_state_->GetModelName().c_str(), (engineLoadEndNs - initStartNs) / 1e9,
+        (parametersEndNs - initStartNs) / 1e9, (prefetchEndNs - parametersEndNs) / 1e9,
+        (engineLoadEndNs - prefetchEndNs) / 1e9);
 
     int const rank = COMM_SESSION.getRank();
+    // Only the instances receiving the requests in this process can take over the work items of a draining instance
+    // and serve the in-process clients
+    if (rank == 0 && leaderOrchComm == MPI_COMM_NULL)
+    {
+        std::lock_guard<std::mutex> lk(sInstancesMutex);
+        sInstances[model_state_->GetModelName()].push_back(this);
+
+#ifdef TRITON_ENABLE_METRICS
+        if (mDrainTimeoutMs > 0)
+        {
+            addMetricGroup("nv_trt_llm_drain_metrics", "TRT LLM drain metrics", "drain_type",
+                custom_metrics_reporter::CustomMetricsReporter::drain_keys_,
+                custom_metrics_reporter::CustomMetricsReporter::drain_labels_);
+        }
+#endif
+    }
+
     // If orchestrator mode and leader rank, need to spawn threads to receive requests/ send responses from/to
     // orchestrator
     if (rank == 0 && leaderOrchComm != MPI_COMM_NULL)
     {
         mLeaderOrchComm = std::make_unique<MpiComm>(leaderOrchComm, true);
+        // The orchestrator waits for the model to be loaded before sending requests
+        constexpr MpiId readyId = MpiId::WORKER_READY;
+        mLeaderOrchComm->send(&readyId, 1, MpiType::kUINT64, 0, kMPI_ID_TAG);
+        ScopedThreadPlacement threadPlacement(mThreadPlacement);
         mReceiverThread = std::thread([this]() { return RecvMpiThread(); });
         mSenderThread = std::thread([this]() { return AnsMpiThread(); });
     }
@@ -457,7 +881,7 @@ void ModelInstanceState::RecvMpiThread()
             auto ir = InferenceRequest::deserialize(data.data());
             {
                 std::lock_guard<std::mutex> lk(mRecRequestsMutex);
-                mRecvRequests.push(ir);
+                mRecvRequests.push_back(ir);
             }
         }
         else if (mpiId == MpiId::STOP_REQUEST || mpiId == MpiId::CANCEL_REQUEST)
@@ -530,57 +954,174 @@ void ModelInstanceState::enqueue(TRITONBACKEND_Request** requests, const uint32_
         utils::handleTritonRequest(request, mRequestIdStrMap, requestsToPush, *mWorkItemsQueue);
     }
 
-    auto exceptions = mWorkItemsQueue->pushBatch(requestsToPush, exec_start_ns);
-
-    for (uint32_t r = 0; r < requestsToPush.size(); ++r)
+    std::function<void(std::shared_ptr<WorkItem>)> workItemCb;
+    if (mSpeculativeDecoder)
     {
-        auto request = requestsToPush.at(r).triton_request;
-        auto e = exceptions.at(r);
-        if (e)
+        // The speculative decoder drives the generation of eligible requests round by round. Requests queued with
+        // deferred conversion are started once they are materialized.
+        workItemCb = [this](std::shared_ptr<WorkItem> workItem)
         {
-            utils::sendEnqueueResponse(request, e->what());
-        }
+            if (workItem->getInferenceRequest())
+            {
+                startSpeculativeDecoding(*workItem);
+            }
+        };
     }
 
+    utils::pushTritonRequests(*mWorkItemsQueue, requestsToPush, exec_start_ns, workItemCb);
+
     return;
 }
 
-// Return up to max_num_requests inference requests.
-std::list<std::shared_ptr<InferenceRequest>> ModelInstanceState::get_inference_requests(int const max_num_requests)
+void ModelInstanceState::startSpeculativeDecoding(WorkItem& workItem)
 {
-    std::list<std::shared_ptr<InferenceRequest>> rval;
-    if (max_num_requests <= 0)
+    if (auto round = mSpeculativeDecoder->start(workItem.getInferenceRequest()))
     {
-        return rval;
+        workItem.setInferenceRequest(std::move(round));
     }
+}
 
-    auto const& commSession = COMM_SESSION;
+bool ModelInstanceState::enqueue(std::string const& modelName, std::shared_ptr<WorkItem> workItem)
+{
+    std::lock_guard<std::mutex> lk(sInstancesMutex);
+    auto it = sInstances.find(modelName);
+    if (it == sInstances.end() || it->second.empty())
+    {
+        return false;
+    }
+    auto const& instances = it->second;
+    auto* instance = *std::min_element(instances.begin(), instances.end(),
+        [](ModelInstanceState const* a, ModelInstanceState const* b)
+        { return a->mWorkItemsQueue->numPendingWorkItems() < b->mWorkItemsQueue->numPendingWorkItems(); });
 
-    auto rank = commSession.getRank();
-    if (rank == 0)
+    if (instance->mSpeculativeDecoder)
     {
-        auto numPendingWorkItems = mWorkItemsQueue->numPendingWorkItems();
-        // Loop over the pending work items and include at most `max_num_requests`
-        for (size_t i = 0; i < numPendingWorkItems && static_cast<int>(rval.size()) < max_num_requests; ++i)
+        instance->startSpeculativeDecoding(*workItem);
+    }
+    try
+    {
+        instance->mWorkItemsQueue->push(workItem);
+    }
+    catch (std::exception const& e)
+    {
+        if (instance->mSpeculativeDecoder)
         {
-            auto [workItem, stoppedRequest] = mWorkItemsQueue->pop();
+            instance->mSpeculativeDecoder->erase(workItem->requestId());
+        }
+        throw;
+    }
+    return true;
+}
 
-            if (workItem)
-            {
+bool ModelInstanceState::stop(std::string const& modelName, uint64_t requestId)
+{
+    std::lock_guard<std::mutex> lk(sInstancesMutex);
+    auto it = sInstances.find(modelName);
+    if (it == sInstances.end())
+    {
+        return false;
+    }
+    for (auto* instance : it->second)
+    {
+        try
+        {
+            instance->mWorkItemsQueue->stopWorkItem(requestId);
+            return true;
+        }
+        catch (std::exception const& e)
+        {
+            // not served by this instance
+        }
+    }
+    return false;
+}
+
+std::optional<bool> ModelInstanceState::outputsIncludeInput(std::string const& modelName)
+{
+    std::lock_guard<std::mutex> lk(sInstancesMutex);
+    auto it = sInstances.find(modelName);
+    if (it == sInstances.end() || it->second.empty())
+    {
+        return std::nullopt;
+    }
+    return !it->second.front()->mExcludeInputInOutput;
+}
+
+// Return up to max_num_requests inference requests.
+std::list<std::shared_ptr<InferenceRequest>> ModelInstanceState::get_inference_requests(int const max_num_requests)
+{
+    std::list<std::shared_ptr<InferenceRequest>> rval;
+    if (max_num_requests <= 0)
+    {
+        return rval;
+    }
+
+    auto const& commSession = COMM_SESSION;
+
+    auto rank = commSession.getRank();
+    if (rank == 0)
+    {
+        // Requests queued with deferred conversion are converted in the background up to the largest number of
+        // requests the engine took at once, so that the next steps find them ready
+        mWorkItemsQueue->materializeAhead(max_num_requests);
+
+        if (mLoraAdapterStore)
+        {
+            takeLoraRetryRequests(rval, max_num_requests);
+        }
+
+        auto numPendingWorkItems = mWorkItemsQueue->numPendingWorkItems();
+        // Loop over the pending work items and include at most `max_num_requests`
+        for (size_t i = 0; i < numPendingWorkItems && static_cast<int>(rval.size()) < max_num_requests; ++i)
+        {
+            auto [workItem, stoppedRequest] = mWorkItemsQueue->pop();
+
+            if (workItem)
+            {
                 if (!stoppedRequest)
                 {
-                    rval.emplace_back(workItem->getInferenceRequest());
+                    try
+                    {
+                        if (!workItem->getInferenceRequest())
+                        {
+                            mWorkItemsQueue->materialize(*workItem);
+                            if (mSpeculativeDecoder)
+                            {
+                                startSpeculativeDecoding(*workItem);
+                            }
+                        }
+                        rval.emplace_back(workItem->getInferenceRequest());
+                    }
+                    catch (std::exception const& e)
+                    {
+                        sendTritonResponse(workItem, {}, true, e.what(), *mWorkItemsQueue, modelInstance_);
+                    }
                 }
                 else
                 {
                     std::string warnStr = std::string("request Id ") + std::to_string(workItem->requestId())
                         + std::string(" has been stopped. Request is ignored.");
                     TLLM_LOG_WARNING(warnStr);
+                    if (mSpeculativeDecoder)
+                    {
+                        mSpeculativeDecoder->erase(workItem->requestId());
+                    }
                     sendTritonResponse(workItem, {}, true, warnStr, *mWorkItemsQueue, modelInstance_);
                 }
             }
         }
 
+        recordResponseOptions(rval);
+
+        if (mLoraAdapterStore)
+        {
+            loadLoraAdapters(rval);
+            for (auto taskId : mWorkItemsQueue->getPendingLoraTaskIdsWithoutWeights(kLoraAdapterNumPrefetch))
+            {
+                mLoraAdapterStore->prefetch(taskId);
+            }
+        }
+
         broadcast_inference_requests(rval);
     }
     else
@@ -591,9 +1132,17 @@ std::list<std::shared_ptr<InferenceRequest>> ModelInstanceState::get_inference_r
         mHasActiveRequests = (num_new_work_items > 0 || mBatchManager->getNumActiveRequests() > 0);
         if (num_new_work_items > 0)
         {
+            // The requests are deserialized in place when rank 0 wrote them to shared memory
+            size_t numBytes = 0;
+            auto const* packed_ptr
+                = mRequestBroadcast ? static_cast<int64_t const*>(mRequestBroadcast->read(numBytes)) : nullptr;
+            bool const inPlace = packed_ptr != nullptr;
             std::vector<int64_t> packed;
-            commSession.bcast(packed, 0);
-            int64_t* packed_ptr = packed.data();
+            if (!inPlace)
+            {
+                commSession.bcast(packed, 0);
+                packed_ptr = packed.data();
+            }
             for (int64_t count = 0; count < num_new_work_items; ++count)
             {
                 int64_t n = *(packed_ptr++);
@@ -601,8 +1150,15 @@ std::list<std::shared_ptr<InferenceRequest>> ModelInstanceState::get_inference_r
                 packed_ptr += n;
                 rval.emplace_back(ir);
             }
+            if (inPlace)
+            {
+                mRequestBroadcast->release();
+            }
         }
     }
+
+    resolveRequestInputs(rval);
+
     return rval;
 }
 
@@ -615,21 +1171,61 @@ std::list<std::shared_ptr<InferenceRequest>> ModelInstanceState::get_inference_r
         return rval;
     }
 
+    // Requests resubmitted with their LoRA weights are already in progress
+    std::list<std::shared_ptr<InferenceRequest>> retried;
+    if (mLoraAdapterStore)
+    {
+        takeLoraRetryRequests(retried, max_num_requests);
+    }
+
     std::lock_guard<std::mutex> lk(mRecRequestsMutex);
-    auto const num_requests_to_send = std::min(max_num_requests, (int) mRecvRequests.size());
+    auto const num_requests_to_send
+        = std::min(max_num_requests - static_cast<int>(retried.size()), (int) mRecvRequests.size());
 
     std::vector<uint64_t> requests_ids(num_requests_to_send);
 
     for (int i = 0; i < num_requests_to_send; ++i)
     {
-        auto ir = mRecvRequests.front();
-        mRecvRequests.pop();
+        auto irIt = mRecvRequests.begin();
+        if (mLoraSchedulingPolicy)
+        {
+            irIt = mLoraSchedulingPolicy->select(mRecvRequests,
+                [](std::shared_ptr<InferenceRequest> const& ir) { return utils::getLoraTaskId(*ir); });
+        }
+
+        auto ir = *irIt;
+        mRecvRequests.erase(irIt);
+        if (mLoraSchedulingPolicy)
+        {
+            mLoraSchedulingPolicy->onScheduled(utils::getLoraTaskId(*ir));
+        }
 
         requests_ids[i] = ir->getRequestId();
 
+        if (auto requestedOutputNames = utils::takeRequestedOutputNames(*ir))
+        {
+            std::lock_guard<std::mutex> lkOutputs(mRequestedOutputNamesMutex);
+            mRequestedOutputNames[ir->getRequestId()] = std::move(requestedOutputNames.value());
+        }
+
         rval.emplace_back(ir);
     }
 
+    if (mLoraAdapterStore)
+    {
+        loadLoraAdapters(rval);
+        auto irIt = mRecvRequests.begin();
+        for (int i = 0; irIt != mRecvRequests.end() && i < kLoraAdapterNumPrefetch; ++irIt, ++i)
+        {
+            if (auto taskId = utils::getLoraTaskIdWithoutWeights(**irIt))
+            {
+                mLoraAdapterStore->prefetch(taskId.value());
+            }
+        }
+    }
+
+    recordResponseOptions(rval);
+
     if (!requests_ids.empty())
     {
         MpiMessage message(MpiId::REQUEST_IN_PROGRESS);
@@ -638,8 +1234,12 @@ std::list<std::shared_ptr<InferenceRequest>> ModelInstanceState::get_inference_r
         SendMessage(std::move(message));
     }
 
+    rval.splice(rval.begin(), retried);
+
     broadcast_inference_requests(rval);
 
+    resolveRequestInputs(rval);
+
     return rval;
 }
 
@@ -665,7 +1265,212 @@ void ModelInstanceState::broadcast_inference_requests(std::list<std::shared_ptr<
                 packed.push_back(static_cast<int64_t>(vpacked.size()));
                 packed.insert(packed.end(), std::move_iterator(vpacked.begin()), std::move_iterator(vpacked.end()));
             }
-            commSession.bcast(packed, 0);
+            if (!mRequestBroadcast || !mRequestBroadcast->write(packed.data(), packed.size() * sizeof(int64_t)))
+            {
+                commSession.bcast(packed, 0);
+            }
+        }
+    }
+}
+
+void ModelInstanceState::loadLoraAdapters(std::list<std::shared_ptr<InferenceRequest>>& requests)
+{
+    for (auto it = requests.begin(); it != requests.end();)
+    {
+        auto const& ir = *it;
+        auto const taskId = utils::getLoraTaskIdWithoutWeights(*ir);
+        if (!taskId)
+        {
+            ++it;
+            continue;
+        }
+
+        try
+        {
+            // Requests for adapters unknown to the store are left as is, the adapter may
+            // already be in the PEFT cache
+            if (auto adapter = mLoraAdapterStore->getForEngine(taskId.value()))
+            {
+                ir->setLoraWeights(adapter->weights);
+                ir->setLoraConfig(adapter->config);
+            }
+            else
+            {
+                std::lock_guard<std::mutex> lk(mLoraRetryMutex);
+                mLoraWeightsOmitted[ir->getRequestId()] = std::make_pair(taskId.value(), ir);
+            }
+            ++it;
+        }
+        catch (std::exception const& e)
+        {
+            auto const requestId = ir->getRequestId();
+            std::string const errStr = "Failed to load LoRA adapter for task " + std::to_string(taskId.value()) + ": "
+                + e.what();
+            TLLM_LOG_ERROR(errStr);
+            it = requests.erase(it);
+            if (mLeaderOrchComm)
+            {
+                sendResponseLeader(requestId, {}, true, errStr);
+            }
+            else
+            {
+                sendResponse(requestId, {}, true, errStr);
+            }
+        }
+    }
+}
+
+bool ModelInstanceState::retryWithLoraWeights(uint64_t requestId, bool final_response, std::string const& errMsg)
+{
+    std::unique_lock<std::mutex> lk(mLoraRetryMutex);
+    auto it = mLoraWeightsOmitted.find(requestId);
+    if (it == mLoraWeightsOmitted.end())
+    {
+        return false;
+    }
+    if (!final_response || errMsg.find(kPeftTaskNotCachedError) == std::string::npos)
+    {
+        if (final_response)
+        {
+            mLoraWeightsOmitted.erase(it);
+        }
+        return false;
+    }
+
+    auto [taskId, ir] = std::move(it->second);
+    mLoraWeightsOmitted.erase(it);
+    lk.unlock();
+
+    mLoraAdapterStore->invalidateEngineCache(taskId);
+    std::shared_ptr<LoraAdapterStore::Adapter const> adapter;
+    try
+    {
+        adapter = mLoraAdapterStore->getForEngine(taskId);
+    }
+    catch (std::exception const& e)
+    {
+        TLLM_LOG_ERROR("Failed to load LoRA adapter for task %lu: %s", taskId, e.what());
+    }
+    if (!adapter)
+    {
+        return false;
+    }
+
+    TLLM_LOG_DEBUG("LoRA task %lu was evicted from the PEFT cache, resubmitting request %lu with its weights", taskId,
+        requestId);
+    ir->setLoraWeights(adapter->weights);
+    ir->setLoraConfig(adapter->config);
+    lk.lock();
+    mLoraRetryRequests.push_back(std::move(ir));
+    return true;
+}
+
+void ModelInstanceState::takeLoraRetryRequests(
+    std::list<std::shared_ptr<InferenceRequest>>& requests, int max_num_requests)
+{
+    std::lock_guard<std::mutex> lk(mLoraRetryMutex);
+    while (!mLoraRetryRequests.empty() && static_cast<int>(requests.size()) < max_num_requests)
+    {
+        requests.splice(requests.end(), mLoraRetryRequests, mLoraRetryRequests.begin());
+    }
+}
+
+void ModelInstanceState::recordResponseOptions(std::list<std::shared_ptr<InferenceRequest>> const& requests)
+{
+    auto const getBool = [](InferenceRequest const& ir, std::string const& name)
+    {
+        auto const tensor = ir.getInputTensorUnchecked(name);
+        return tensor && tensor.value() && *static_cast<bool const*>(tensor.value()->data());
+    };
+
+    for (auto const& ir : requests)
+    {
+        ResponseOptions options;
+        auto const topK = ir->getInputTensorUnchecked(kLogitsTopKInputTensorName);
+        if (topK && topK.value())
+        {
+            options.logitsTopK = std::max(0, *static_cast<int32_t const*>(topK.value()->data()));
+        }
+        options.trimOutputs = getBool(*ir, kTrimOutputsInputTensorName);
+        options.topBeamOnly = getBool(*ir, kReturnTopBeamOnlyInputTensorName);
+
+        if (options.logitsTopK > 0 || options.trimOutputs || options.topBeamOnly)
+        {
+            std::lock_guard<std::mutex> lk(mResponseOptionsMutex);
+            mResponseOptions[ir->getRequestId()] = options;
+        }
+    }
+}
+
+void ModelInstanceState::releaseRequestState(uint64_t requestId)
+{
+    {
+        std::lock_guard<std::mutex> lk(mResponseOptionsMutex);
+        mResponseOptions.erase(requestId);
+    }
+    if (mLeaderOrchComm)
+    {
+        {
+            std::lock_guard<std::mutex> lk(mRequestedOutputNamesMutex);
+            mRequestedOutputNames.erase(requestId);
+        }
+        std::lock_guard<std::mutex> lk(mStoppedReqIdsMutex);
+        mStoppedReqIds.erase(requestId);
+    }
+}
+
+std::list<NamedTensor> ModelInstanceState::transformResponse(
+    uint64_t requestId, std::list<NamedTensor> const& response_tensors, bool final_response)
+{
+    ResponseOptions options;
+    {
+        std::lock_guard<std::mutex> lk(mResponseOptionsMutex);
+        auto it = mResponseOptions.find(requestId);
+        if (it == mResponseOptions.end())
+        {
+            return response_tensors;
+        }
+        options = it->second;
+    }
+
+    auto tensors = options.logitsTopK > 0 ? reduceLogitsToTopK(response_tensors, options.logitsTopK, mTopKLogProbsFp16)
+                                          : response_tensors;
+    if (options.trimOutputs || options.topBeamOnly)
+    {
+        tensors = trimOutputs(tensors, options.trimOutputs, options.topBeamOnly);
+    }
+    return tensors;
+}
+
+void ModelInstanceState::resolveRequestInputs(std::list<std::shared_ptr<InferenceRequest>>& requests)
+{
+    for (auto it = requests.begin(); it != requests.end();)
+    {
+        try
+        {
+            SamplingParams::expand(**it);
+            if (mPromptTableCache)
+            {
+                mPromptTableCache->resolve(**it);
+            }
+            if (mSparseEmbeddingBias)
+            {
+                mSparseEmbeddingBias->expand(**it);
+            }
+            ++it;
+        }
+        catch (std::exception const& e)
+        {
+            auto const requestId = (*it)->getRequestId();
+            it = requests.erase(it);
+            if (mLeaderOrchComm)
+            {
+                sendResponseLeader(requestId, {}, true, e.what());
+            }
+            else
+            {
+                sendResponse(requestId, {}, true, e.what());
+            }
         }
     }
 }
@@ -675,33 +1480,112 @@ void ModelInstanceState::sendResponse(
 {
     if (COMM_SESSION.getRank() == 0)
     {
+        if (mLoraAdapterStore && retryWithLoraWeights(requestId, final_response, errMsg))
+        {
+            return;
+        }
+
         std::string errStr = std::string("Failed to send Triton response for requestId: ")
             + utils::getRequestIdStr(requestId, mRequestIdStrMap);
+
+        // A speculatively decoded request only completes once its last round completes
+        std::optional<std::list<NamedTensor>> speculativeTensors;
+        if (mSpeculativeDecoder && mSpeculativeDecoder->isActive(requestId))
+        {
+            if (!errMsg.empty())
+            {
+                mSpeculativeDecoder->erase(requestId);
+            }
+            else if (!final_response)
+            {
+                return;
+            }
+            else
+            {
+                auto round = mSpeculativeDecoder->onRoundComplete(requestId, response_tensors);
+                if (!round.finished)
+                {
+                    try
+                    {
+                        if (!round.responseTensors.empty())
+                        {
+                            auto const transformedTensors
+                                = transformResponse(requestId, round.responseTensors, false);
+                            auto workItem = mWorkItemsQueue->getInProgressWorkItem(requestId);
+                            LOG_IF_ERROR(sendTritonResponse(workItem, transformedTensors, false, errMsg,
+                                             *mWorkItemsQueue, modelInstance_),
+                                errStr);
+                        }
+                    }
+                    catch (std::exception const& e)
+                    {
+                        TLLM_LOG_ERROR(errStr);
+                    }
+                    mSpeculativeDecoder->continueRequest(requestId);
+                    return;
+                }
+                speculativeTensors = std::move(round.responseTensors);
+            }
+        }
+
         if (final_response)
         {
             mRequestIdStrMap.erase(requestId);
         }
         try
         {
+            auto const transformedTensors
+                = transformResponse(requestId, speculativeTensors.value_or(response_tensors), final_response);
             auto workItem = mWorkItemsQueue->getInProgressWorkItem(requestId);
             auto tritonErr = sendTritonResponse(
-                workItem, response_tensors, final_response, errMsg, *mWorkItemsQueue, modelInstance_);
+                workItem, transformedTensors, final_response, errMsg, *mWorkItemsQueue, modelInstance_);
             LOG_IF_ERROR(tritonErr, errStr);
         }
         catch (std::exception const& e)
         {
             TLLM_LOG_ERROR(errStr);
         }
+        if (final_response)
+        {
+            releaseRequestState(requestId);
+        }
     }
 }
 
 void ModelInstanceState::sendResponseLeader(
     uint64_t requestId, std::list<NamedTensor> const& response_tensors, bool final_response, std::string const& errMsg)
 {
+    if (mLoraAdapterStore && retryWithLoraWeights(requestId, final_response, errMsg))
+    {
+        return;
+    }
+
+    auto const transformedTensors = transformResponse(requestId, response_tensors, final_response);
+
+    // Don't serialize the outputs the client did not request, as sendTritonResponse does not send them
+    std::list<NamedTensor> requestedTensors;
+    {
+        std::lock_guard<std::mutex> lk(mRequestedOutputNamesMutex);
+        auto it = mRequestedOutputNames.find(requestId);
+        if (it == mRequestedOutputNames.end())
+        {
+            requestedTensors = transformedTensors;
+        }
+        else
+        {
+            std::copy_if(transformedTensors.begin(), transformedTensors.end(), std::back_inserter(requestedTensors),
+                [&it](NamedTensor const& tensor) { return it->second.count(tensor.name) > 0; });
+        }
+    }
+    if (final_response)
+    {
+        releaseRequestState(requestId);
+    }
+
     // send answer to orchestator
     MpiMessage message(MpiId::REQUEST_ANSWER);
 
-    auto answer = std::make_shared<InferenceAnswer>(requestId, response_tensors, final_response, errMsg);
+    auto answer = std::make_shared<InferenceAnswer>(requestId, requestedTensors, final_response, errMsg);
     message.data = RequestAnswerData{std::move(answer)};
 
     SendMessage(std::move(message));
@@ -740,12 +1624,27 @@ std::unordered_set<uint64_t> ModelInstanceState::pollStopSignals()
             {
                 // Store the requestIds in a contiguous vector
                 std::vector<uint64_t> stoppedReqIdsVec(stoppedReqIds.begin(), stoppedReqIds.end());
-                commSession.bcast(stoppedReqIdsVec.data(), stoppedReqIdsVec.size(), mpi::MpiType::kUINT64, 0);
+                if (!mRequestBroadcast
+                    || !mRequestBroadcast->write(stoppedReqIdsVec.data(), stoppedReqIdsVec.size() * sizeof(uint64_t)))
+                {
+                    commSession.bcast(stoppedReqIdsVec.data(), stoppedReqIdsVec.size(), mpi::MpiType::kUINT64, 0);
+                }
             }
             else
             {
                 std::vector<uint64_t> stoppedReqIdsVec(nStoppedReqIds);
-                commSession.bcast(stoppedReqIdsVec.data(), stoppedReqIdsVec.size(), mpi::MpiType::kUINT64, 0);
+                size_t numBytes = 0;
+                auto const* stoppedReqIdsPtr
+                    = mRequestBroadcast ? static_cast<uint64_t const*>(mRequestBroadcast->read(numBytes)) : nullptr;
+                if (stoppedReqIdsPtr)
+                {
+                    std::copy(stoppedReqIdsPtr, stoppedReqIdsPtr + nStoppedReqIds, stoppedReqIdsVec.begin());
+                    mRequestBroadcast->release();
+                }
+                else
+                {
+                    commSession.bcast(stoppedReqIdsVec.data(), stoppedReqIdsVec.size(), mpi::MpiType::kUINT64, 0);
+                }
                 // Store the requestIds in the set
                 stoppedReqIds.clear();
                 std::copy(stoppedReqIdsVec.begin(), stoppedReqIdsVec.end(),
@@ -759,16 +1658,194 @@ std::unordered_set<uint64_t> ModelInstanceState::pollStopSignals()
 
 void ModelInstanceState::logStats(std::string const& s)
 {
-    LOG_MESSAGE(TRITONSERVER_LOG_VERBOSE, s.c_str());
+    auto const stats = appendBackendStats(s);
+    if (modelInstance_ == nullptr)
+    {
+        TLLM_LOG_DEBUG("%s", stats.c_str());
+        return;
+    }
+    LOG_MESSAGE(TRITONSERVER_LOG_VERBOSE, stats.c_str());
 #ifdef TRITON_ENABLE_METRICS
-    LOG_IF_ERROR(custom_metrics_reporter_->UpdateCustomMetrics(s), "Failed updating TRT LLM statistics");
+    LOG_IF_ERROR(custom_metrics_reporter_->UpdateCustomMetrics(stats), "Failed updating TRT LLM statistics");
 #endif
 }
 
+#ifdef TRITON_ENABLE_METRICS
+void ModelInstanceState::addMetricGroup(std::string const& family, std::string const& description,
+    std::string const& category, std::vector<std::string> const& keys, std::vector<std::string> const& labels)
+{
+    if (custom_metrics_reporter_)
+    {
+        LOG_IF_ERROR(custom_metrics_reporter_->AddMetricGroup(family, description, category, keys, labels),
+            "Failed to create " + family);
+    }
+}
+#endif
+
+std::string ModelInstanceState::appendBackendStats(std::string const& s) const
+{
+    if (!mLoraSchedulingPolicy && !mLoraAdapterStore && !mPromptTableCache && !mSpeculativeDecoder
+        && mDrainTimeoutMs <= 0 && !mRequestValidator && !mSessionStore)
+    {
+        return s;
+    }
+
+    auto stats = nlohmann::json::parse(s, nullptr, false);
+    if (stats.is_discarded())
+    {
+        return s;
+    }
+
+    if (mLoraSchedulingPolicy)
+    {
+        stats["LoRA Scheduling Estimated Resident Hits"] = mLoraSchedulingPolicy->numHits();
+        stats["LoRA Scheduling Estimated Resident Misses"] = mLoraSchedulingPolicy->numMisses();
+    }
+
+    if (mLoraAdapterStore)
+    {
+        stats["LoRA Adapter Store Loads"] = mLoraAdapterStore->numLoads();
+        stats["LoRA Adapter Store Load Time"] = mLoraAdapterStore->loadTimeUs();
+        stats["LoRA Adapter Store Hits"] = mLoraAdapterStore->numHits();
+        stats["LoRA Adapter Store Bytes"] = mLoraAdapterStore->sizeInBytes();
+        stats["LoRA Adapter Store Estimated Engine Cache Hits"] = mLoraAdapterStore->numEngineCacheHits();
+    }
+
+    if (mPromptTableCache)
+    {
+        stats["Prompt Table Cache Hits"] = mPromptTableCache->numHits();
+        stats["Prompt Table Cache Misses"] = mPromptTableCache->numMisses();
+        stats["Prompt Table Cache Bytes Saved"] = mPromptTableCache->bytesSaved();
+    }
+
+    if (mSessionStore)
+    {
+        stats["Session Store Hits"] = mSessionStore->numHits();
+        stats["Session Store Reused Tokens"] = mSessionStore->numReusedTokens();
+    }
+
+    if (mSpeculativeDecoder)
+    {
+        stats["Speculative Decoding Draft Tokens"] = mSpeculativeDecoder->numDraftTokens();
+        stats["Speculative Decoding Accepted Tokens"] = mSpeculativeDecoder->numAcceptedTokens();
+        stats["Speculative Decoding Rounds"] = mSpeculativeDecoder->numRounds();
+        stats["Speculative Decoding Fallbacks"] = mSpeculativeDecoder->numFallbacks();
+    }
+
+    if (mRequestValidator)
+    {
+        stats["Request Validation Input Length Rejections"] = mRequestValidator->numInputLengthRejections();
+        stats["Request Validation Sequence Length Rejections"] = mRequestValidator->numSequenceLengthRejections();
+        stats["Request Validation Token Id Rejections"] = mRequestValidator->numTokenIdRejections();
+        stats["Request Validation Beam Width Rejections"] = mRequestValidator->numBeamWidthRejections();
+    }
+
+    if (mDrainTimeoutMs > 0)
+    {
+        bool const draining = mDraining.load();
+        stats["Drain Active"] = draining ? 1 : 0;
+        stats["Drain Handed Over Work Items"] = mNumHandedOverWorkItems.load();
+        stats["Drain Remaining Work Items"] = draining
+            ? mWorkItemsQueue->numPendingWorkItems() + mWorkItemsQueue->numInProgressWorkItems()
+            : 0;
+    }
+
+    return stats.dump();
+}
+
+void ModelInstanceState::drain()
+{
+    if (COMM_SESSION.getRank() != 0 || mLeaderOrchComm)
+    {
+        return;
+    }
+
+    auto const& modelName = model_state_->GetModelName();
+    {
+        std::lock_guard<std::mutex> lk(sInstancesMutex);
+        auto& instances = sInstances[modelName];
+        instances.erase(std::remove(instances.begin(), instances.end(), this), instances.end());
+    }
+
+    if (mDrainTimeoutMs <= 0)
+    {
+        return;
+    }
+
+    mDraining = true;
+    uint64_t drainStartNs = 0;
+    SET_TIMESTAMP(drainStartNs);
+
+    // Speculatively decoded requests are driven by the speculative decoder of this instance and the turns of a
+    // session need the history kept by its session store, they stay here
+    auto workItems = mWorkItemsQueue->takePendingWorkItems(
+        [this](WorkItem const& workItem)
+        {
+            return (!mSpeculativeDecoder || !mSpeculativeDecoder->isActive(workItem.requestId()))
+                && !workItem.isSessionTurn();
+        });
+    if (!workItems.empty())
+    {
+        std::lock_guard<std::mutex> lk(sInstancesMutex);
+        auto const& instances = sInstances[modelName];
+        auto target = std::min_element(instances.begin(), instances.end(),
+            [](ModelInstanceState const* a, ModelInstanceState const* b)
+            { return a->mWorkItemsQueue->numPendingWorkItems() < b->mWorkItemsQueue->numPendingWorkItems(); });
+        if (target != instances.end())
+        {
+            auto const numWorkItems = workItems.size();
+            workItems = (*target)->mWorkItemsQueue->adoptPendingWorkItems(std::move(workItems));
+            mNumHandedOverWorkItems = numWorkItems - workItems.size();
+        }
+    }
+
+    // The work items that could not be handed over are served by this instance
+    if (!workItems.empty())
+    {
+        mWorkItemsQueue->adoptPendingWorkItems(std::move(workItems));
+    }
+
+    auto const deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(mDrainTimeoutMs);
+    size_t numFailedWorkItems = 0;
+    if (!mWorkItemsQueue->waitUntilEmpty(deadline))
+    {
+        // The clients of the requests that did not complete in time get an error instead of no response
+        auto const remainingWorkItems = mWorkItemsQueue->takeAllWorkItems();
+        numFailedWorkItems = remainingWorkItems.size();
+        std::string const errStr = "Model " + modelName + " was unloaded before the request completed";
+        for (auto const& workItem : remainingWorkItems)
+        {
+            LOG_IF_ERROR(sendTritonResponse(workItem, {}, true, errStr, *mWorkItemsQueue, modelInstance_),
+                "Failed to send the error response of a drained request");
+        }
+    }
+
+    uint64_t drainEndNs = 0;
+    SET_TIMESTAMP(drainEndNs);
+    TLLM_LOG_INFO("Model %s drained in %.2f s: %lu work items handed over, %lu work items failed", modelName.c_str(),
+        (drainEndNs - drainStartNs) / 1e9, mNumHandedOverWorkItems.load(), numFailedWorkItems);
+}
+
 TRITONSERVER_Error* ModelInstanceState::sendTritonResponse(std::shared_ptr<WorkItem> workItem,
     std::list<NamedTensor> const& response_tensors, bool final_response, std::string const& errMsg,
     WorkItemsQueue& workItemsQueue, TRITONBACKEND_ModelInstance* model_instance)
 {
+    // Work items of the in-process clients bypass Triton and are answered through their callback
+    if (auto const& responseCallback = workItem->responseCallback())
+    {
+        if (final_response)
+        {
+            SET_TIMESTAMP(workItem->getTimestamps().compute_end_ns);
+            workItemsQueue.markFinished(workItem->requestId());
+        }
+        if (!errMsg.empty())
+        {
+            TLLM_LOG_ERROR("Encountered error for requestId " + std::to_string(workItem->requestId()) + ": " + errMsg);
+        }
+        responseCallback(response_tensors, final_response || !errMsg.empty(), errMsg);
+        return nullptr;
+    }
+
     TRITONBACKEND_ResponseFactory* response_factory;
     response_factory = workItem->response_factory();
 
@@ -832,6 +1909,8 @@ TRITONSERVER_Error* ModelInstanceState::sendTritonResponse(std::shared_ptr<WorkI
         }
     }
 
+    workItem->updateSession(response_tensors, final_response, err != nullptr);
+
     if (final_response)
     {
         LOG_IF_ERROR(workItem->reportBaseMetrics(model_instance, err), "Error reporting base metrics");
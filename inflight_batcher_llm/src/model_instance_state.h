@@ -44,9 +44,22 @@
 #include "tensorrt_llm/batch_manager/trtGptModelOptionalParams.h"
 #include "tensorrt_llm/runtime/decodingMode.h"
 
+#include "engine_prefetcher.h"
 #include "inference_answer.h"
+#include "lora_adapter_store.h"
+#include "lora_scheduling_policy.h"
 #include "model_state.h"
 #include "mpi_utils.h"
+#include "output_trimming.h"
+#include "prompt_table_cache.h"
+#include "request_validator.h"
+#include "sampling_params.h"
+#include "session_store.h"
+#include "shared_memory_broadcast.h"
+#include "sparse_embedding_bias.h"
+#include "speculative_decoding.h"
+#include "thread_placement.h"
+#include "top_k_logits.h"
 #include "work_item.h"
 #include "work_items_queue.h"
 
@@ -82,6 +95,20 @@ public:
     static constexpr SizeType kPeftCacheNumCopyStreams = 4;
     // number of cpu workers used to load weight into host cache
     static constexpr SizeType kPeftCacheNumPutWorkers = 4;
+    // number of queued requests whose LoRA adapter is prefetched from the adapter store
+    static constexpr SizeType kLoraAdapterNumPrefetch = 4;
+    // part of the error reported by the engine for a request whose LoRA task id is not in its PEFT cache
+    static constexpr char const* kPeftTaskNotCachedError = "not found in cache";
+    // number of dense embedding biases expanded from sparse inputs kept for reuse
+    static constexpr SizeType kSparseEmbeddingBiasNumCached = 64;
+    // number of threads reading the engine files into the page cache before the engine is loaded
+    static constexpr int32_t kDefaultEnginePrefetchConcurrency = 0;
+    // size of the reads of the engine prefetch
+    static constexpr uint64_t kDefaultEnginePrefetchReadaheadBytes = 16 << 20;
+    // time given to the requests of an unloaded instance to complete, 0 drops them immediately
+    static constexpr int32_t kDefaultDrainTimeoutMs = 0;
+    // size of the shared memory segment through which requests are broadcast to the other ranks, 0 uses MPI
+    static constexpr uint64_t kDefaultRequestBroadcastShmBytes = 0;
 
     /// @brief Create a ModelInstanceObject when running in non-orchestrator mode
     static TRITONSERVER_Error* Create(
@@ -94,6 +121,11 @@ public:
 
     virtual ~ModelInstanceState()
     {
+        // hand over the pending work items and let the in-flight ones complete
+        {
+            drain();
+        }
+
         // terminate decoupled execution loop
         {
             mWorkItemsQueue->clear();
@@ -119,6 +151,19 @@ public:
     /// @brief Add the request to the WorkItemsQueue
     void enqueue(TRITONBACKEND_Request** requests, const uint32_t request_count);
 
+    /// @brief Add a work item created in-process to the loaded instance of the model with the fewest pending work
+    /// items. Throws an error if its requestId already exists.
+    /// @return false if no instance of the model is loaded in this process
+    static bool enqueue(std::string const& modelName, std::shared_ptr<WorkItem> workItem);
+
+    /// @brief Stop a work item created in-process
+    /// @return false if the work item is not active (might be completed already)
+    static bool stop(std::string const& modelName, uint64_t requestId);
+
+    /// @brief Whether the output_ids of the non-streamed responses of a model start with the input_ids of the request
+    /// @return std::nullopt if no instance of the model is loaded in this process
+    static std::optional<bool> outputsIncludeInput(std::string const& modelName);
+
     /// @brief  Callback passed to GptManager to get new inference requests
     /// @return Up to max_num_requests inference requests.
     std::list<std::shared_ptr<InferenceRequest>> get_inference_requests(int const max_num_requests);
@@ -135,6 +180,15 @@ public:
     /// @brief  Callback passed to GptManager to print stats
     void logStats(std::string const& s);
 
+#ifdef TRITON_ENABLE_METRICS
+    /// @brief Add a group of custom metrics, unless the instance runs without a Triton server and has no reporter
+    void addMetricGroup(std::string const& family, std::string const& description, std::string const& category,
+        std::vector<std::string> const& keys, std::vector<std::string> const& labels);
+#endif
+
+    /// @brief Add the statistics collected by the backend to the JSON-formatted GptManager statistics
+    std::string appendBackendStats(std::string const& s) const;
+
     /// @brief Method that sends Triton response back to client
     static TRITONSERVER_Error* sendTritonResponse(std::shared_ptr<WorkItem> workItem,
         std::list<NamedTensor> const& response_tensors, bool final_response, std::string const& errMsg,
@@ -151,6 +205,56 @@ private:
 
     void broadcast_inference_requests(std::list<std::shared_ptr<InferenceRequest>>& rval);
 
+    /// @brief Add the adapter weights from the LoRA adapter store to the requests that only provide a task id, unless
+    /// the engine is expected to hold the adapter already. Requests whose adapter cannot be loaded are removed from
+    /// the list and an error is sent back to the client.
+    void loadLoraAdapters(std::list<std::shared_ptr<InferenceRequest>>& requests);
+
+    /// @brief Resubmit a request sent without its LoRA weights with the weights attached, if the engine reported
+    /// the adapter missing from its PEFT cache
+    /// @return true if the request was resubmitted, in which case the error must not be sent to the client
+    bool retryWithLoraWeights(uint64_t requestId, bool final_response, std::string const& errMsg);
+
+    /// @brief Take the requests resubmitted with their LoRA weights, at most max_num_requests
+    void takeLoraRetryRequests(std::list<std::shared_ptr<InferenceRequest>>& requests, int max_num_requests);
+
+    /// @brief Per-request transformations applied to the response tensors before they leave the engine process
+    struct ResponseOptions
+    {
+        int32_t logitsTopK = 0;
+        bool trimOutputs = false;
+        bool topBeamOnly = false;
+    };
+
+    /// @brief Record the response options of the requests so that their responses can be transformed
+    void recordResponseOptions(std::list<std::shared_ptr<InferenceRequest>> const& requests);
+
+    /// @brief Release the per-request state of a request once its final response is sent, whether it completed,
+    /// failed or was cancelled
+    void releaseRequestState(uint64_t requestId);
+
+    /// @brief Reduce the logits to their top-k and trim the padding of a response, if the request asked for it
+    std::list<NamedTensor> transformResponse(
+        uint64_t requestId, std::list<NamedTensor> const& response_tensors, bool final_response);
+
+    /// @brief Let the speculative decoder drive the generation of an eligible work item round by round, by replacing
+    /// its request by the first round
+    void startSpeculativeDecoding(WorkItem& workItem);
+
+    /// @brief Expand the packed sampling parameters, resolve the prompt embedding table ids and expand the sparse
+    /// embedding biases of the requests, on every rank after the broadcast. Invalid requests are removed from the
+    /// list and an error is sent back to the client.
+    void resolveRequestInputs(std::list<std::shared_ptr<InferenceRequest>>& requests);
+
+    /// @brief Stop admitting work, hand the pending work items over to another loaded instance of the model and wait
+    /// up to the drain timeout for the in-flight ones to complete
+    void drain();
+
+    // instances of the loaded models that can take over the pending work items of a draining instance and serve the
+    // in-process clients, per model name
+    static std::mutex sInstancesMutex;
+    static std::unordered_map<std::string, std::vector<ModelInstanceState*>> sInstances;
+
     ModelState* model_state_;
     TRITONBACKEND_ModelInstance* modelInstance_;
 
@@ -160,7 +264,7 @@ private:
     // Only valid for leader-worker ranks
     std::unique_ptr<MpiComm> mLeaderOrchComm;
     std::thread mReceiverThread;
-    std::queue<std::shared_ptr<InferenceRequest>> mRecvRequests;
+    std::list<std::shared_ptr<InferenceRequest>> mRecvRequests;
     std::mutex mRecRequestsMutex;
     std::thread mSenderThread;
     std::queue<MpiMessage> mSenderQueue;
@@ -168,10 +272,38 @@ private:
     std::condition_variable mSenderCV;
     std::unordered_set<uint64_t> mStoppedReqIds;
     std::mutex mStoppedReqIdsMutex;
+    // response options of the requests that set any, per request id
+    std::unordered_map<uint64_t, ResponseOptions> mResponseOptions;
+    std::mutex mResponseOptionsMutex;
+    bool mTopKLogProbsFp16 = false;
+    // outputs requested by the client, the only ones sent back to the orchestrator, per request id
+    std::unordered_map<uint64_t, std::unordered_set<std::string>> mRequestedOutputNames;
+    std::mutex mRequestedOutputNamesMutex;
     std::atomic<bool> mModelUnloadRequest = false;
+    // placement of the threads serving the GPU of this rank, std::nullopt if they are not pinned
+    std::optional<ThreadPlacement> mThreadPlacement;
+    int32_t mDrainTimeoutMs = kDefaultDrainTimeoutMs;
+    bool mExcludeInputInOutput = false;
+    std::atomic<bool> mDraining = false;
+    std::atomic<uint64_t> mNumHandedOverWorkItems = 0;
 
     std::shared_ptr<GptManager> mBatchManager;
     std::unique_ptr<WorkItemsQueue> mWorkItemsQueue;
+    std::shared_ptr<LoraSchedulingPolicy> mLoraSchedulingPolicy;
+    std::unique_ptr<LoraAdapterStore> mLoraAdapterStore;
+    // requests sent to the engine without their LoRA weights and their task id, per request id
+    std::unordered_map<uint64_t, std::pair<uint64_t, std::shared_ptr<InferenceRequest>>> mLoraWeightsOmitted;
+    // requests resubmitted with their LoRA weights after the engine reported the adapter missing
+    std::list<std::shared_ptr<InferenceRequest>> mLoraRetryRequests;
+    std::mutex mLoraRetryMutex;
+    std::unique_ptr<PromptTableCache> mPromptTableCache;
+    std::unique_ptr<SparseEmbeddingBias> mSparseEmbeddingBias;
+    std::shared_ptr<RequestValidator> mRequestValidator;
+    std::shared_ptr<SessionStore> mSessionStore;
+    // broadcast of the new requests and stopped request ids to the other ranks of a single node
+    std::unique_ptr<SharedMemoryBroadcast> mRequestBroadcast;
+    // declared after the work items queue, which it resubmits rounds to
+    std::unique_ptr<SpeculativeDecoder> mSpeculativeDecoder;
 
     std::unordered_map<uint64_t, std::string> mRequestIdStrMap;
 #ifdef TRITON_ENABLE_METRICS
@@ -85,8 +85,12 @@ void ModelState::LoadParameters()
 {
     // Check if model is in decoupled mode:
     triton::common::TritonJson::Value transaction_policy;
-    model_config_.MemberAsObject("model_transaction_policy", &transaction_policy);
-    transaction_policy.MemberAsBool("decoupled", &is_decoupled_);
+    triton::common::TritonJson::Value decoupled;
+    if (model_config_.Find("model_transaction_policy", &transaction_policy)
+        && transaction_policy.Find("decoupled", &decoupled))
+    {
+        LOG_IF_ERROR(decoupled.AsBool(&is_decoupled_), "Cannot read model_transaction_policy.decoupled");
+    }
 
     try
     {
@@ -107,6 +111,40 @@ void ModelState::LoadParameters()
         // If parameter is not specified, just ignore
         TLLM_LOG_WARNING("gpu_device_ids is not specified, will be automatically set");
     }
+
+    try
+    {
+        session_history_bytes_ = GetParameter<uint64_t>("session_history_bytes");
+        TLLM_LOG_INFO("Session mode enabled, session history limited to %lu bytes", session_history_bytes_.value());
+    }
+    catch (std::exception const& e)
+    {
+        // If parameter is not specified, just ignore
+        TLLM_LOG_WARNING("session_history_bytes is not specified, session mode is disabled");
+    }
+}
+
+std::optional<std::string> ModelState::GetOutputDataType(std::string const& name)
+{
+    TritonJson::Value outputs;
+    if (!model_config_.Find("output", &outputs))
+    {
+        return std::nullopt;
+    }
+    for (size_t i = 0; i < outputs.ArraySize(); ++i)
+    {
+        TritonJson::Value output;
+        std::string outputName;
+        LOG_IF_ERROR(outputs.IndexAsObject(i, &output), "Cannot read model output");
+        LOG_IF_ERROR(output.MemberAsString("name", &outputName), "Cannot read model output name");
+        if (outputName == name)
+        {
+            std::string dataType;
+            LOG_IF_ERROR(output.MemberAsString("data_type", &dataType), "Cannot read model output data type");
+            return dataType;
+        }
+    }
+    return std::nullopt;
 }
 
 common::TritonJson::Value& ModelState::GetModelConfig()
@@ -139,16 +177,22 @@ const std::string ModelState::GetWorkerPath()
     return workerPath;
 }
 
-std::vector<int64_t> ModelState::serialize() const
+std::vector<int64_t> ModelState::serialize(std::optional<std::vector<int32_t>> const& deviceIds) const
 {
     // model name
     // model version
+    // gpu device ids
     // model config
-    size_t totalSize = 3;
+    size_t totalSize = 4;
 
     int nameSize = (model_name_.size() + sizeof(int64_t)) / sizeof(int64_t);
     totalSize += nameSize;
 
+    auto const& packedDeviceIds = deviceIds ? deviceIds : gpu_device_ids_;
+    // -1 when the device ids are automatically set
+    int64_t const numDeviceIds = packedDeviceIds ? packedDeviceIds.value().size() : -1;
+    totalSize += std::max<int64_t>(numDeviceIds, 0);
+
     TritonJson::WriteBuffer buffer;
     model_config_.Write(&buffer);
 
@@ -162,6 +206,13 @@ std::vector<int64_t> ModelState::serialize() const
     ptr += nameSize;
 
     *ptr++ = model_version_;
+
+    *ptr++ = numDeviceIds;
+    for (int64_t i = 0; i < numDeviceIds; ++i)
+    {
+        *ptr++ = packedDeviceIds.value()[i];
+    }
+
     *ptr++ = buffer.Size();
     std::memcpy(ptr, buffer.Base(), buffer.Size());
 
@@ -176,6 +227,14 @@ ModelState ModelState::deserialize(int64_t const* packed_ptr)
 
     const uint64_t version = *packed_ptr++;
 
+    auto const numDeviceIds = *packed_ptr++;
+    std::optional<std::vector<int32_t>> deviceIds;
+    if (numDeviceIds >= 0)
+    {
+        deviceIds = std::vector<int32_t>(packed_ptr, packed_ptr + numDeviceIds);
+        packed_ptr += numDeviceIds;
+    }
+
     auto const jsonSize = *packed_ptr++;
     char const* jsonBuffer = reinterpret_cast<char const*>(packed_ptr);
     common::TritonJson::Value model_config;
@@ -185,7 +244,7 @@ ModelState ModelState::deserialize(int64_t const* packed_ptr)
         throw std::runtime_error("Failed to parse model config");
     }
 
-    return ModelState{nullptr, cname, version, std::move(model_config)};
+    return ModelState{cname, version, std::move(model_config), std::move(deviceIds)};
 }
 
 ModelState ModelState::deserialize(std::vector<int64_t> const& packed)
@@ -196,23 +255,23 @@ ModelState ModelState::deserialize(std::vector<int64_t> const& packed)
 template <>
 std::string ModelState::GetParameter<std::string>(std::string const& name)
 {
+    // The members are looked up with Find, which unlike MemberAsObject does not create a TRITONSERVER_Error for the
+    // optional parameters left unset: the model state is also used without Triton server, by the workers and the
+    // in-process engines
     TritonJson::Value parameters;
-    TRITONSERVER_Error* err = model_config_.MemberAsObject("parameters", &parameters);
-    if (err != nullptr)
+    if (!model_config_.Find("parameters", &parameters))
     {
         throw std::runtime_error("Model config doesn't have a parameters section");
-        TRITONSERVER_ErrorDelete(err);
     }
     TritonJson::Value value;
-    std::string str_value;
-    err = parameters.MemberAsObject(name.c_str(), &value);
-    if (err != nullptr)
+    TritonJson::Value string_value;
+    if (!parameters.Find(name.c_str(), &value) || !value.Find("string_value", &string_value))
     {
         std::string errStr = "Cannot find parameter with name: " + name;
         throw std::runtime_error(errStr);
-        TRITONSERVER_ErrorDelete(err);
     }
-    value.MemberAsString("string_value", &str_value);
+    std::string str_value;
+    LOG_IF_ERROR(string_value.AsString(&str_value), "Cannot read parameter " + name);
     return str_value;
 }
 
@@ -73,12 +73,25 @@ public:
         return gpu_device_ids_;
     }
 
+    /// @brief Get the data type of an output declared in the model configuration, e.g. TYPE_FP32
+    /// @return std::nullopt if the output is not declared
+    std::optional<std::string> GetOutputDataType(std::string const& name);
+
     bool IsDecoupled() const
     {
         return is_decoupled_;
     }
 
-    [[nodiscard]] std::vector<int64_t> serialize() const;
+    /// @brief Byte budget of the session histories, std::nullopt if the session mode is disabled
+    std::optional<size_t> GetSessionHistoryBytes() const
+    {
+        return session_history_bytes_;
+    }
+
+    /// @param deviceIds GPU device ids the deserialized model state uses instead of its own, e.g. the slice of a
+    /// data-parallel replica
+    [[nodiscard]] std::vector<int64_t> serialize(
+        std::optional<std::vector<int32_t>> const& deviceIds = std::nullopt) const;
 
     static ModelState deserialize(int64_t const* packed_ptr);
 
@@ -93,6 +106,7 @@ private:
     // model parameters
     std::optional<std::vector<int32_t>> gpu_device_ids_;
     bool is_decoupled_ = false;
+    std::optional<size_t> session_history_bytes_;
 
     void LoadParameters();
 
@@ -108,6 +122,14 @@ public:
 
         LoadParameters();
     }
+
+    /// @brief Model state of a worker, whose GPU device ids are set by the orchestrator
+    ModelState(std::string const& name, uint64_t version, TritonJson::Value&& model_config,
+        std::optional<std::vector<int32_t>> deviceIds)
+        : ModelState(nullptr, name, version, std::move(model_config))
+    {
+        gpu_device_ids_ = std::move(deviceIds);
+    }
 };
 
 template <>
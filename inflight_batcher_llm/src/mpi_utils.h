@@ -51,6 +51,9 @@ enum class MpiId : uint64_t
     STOP_REQUEST = 4,
     CANCEL_REQUEST = 5,
     TERMINATION = 6,
+    // Sent once by the leader-worker rank after loading the model, or failing to
+    WORKER_READY = 7,
+    WORKER_FAILED = 8,
 };
 
 struct PendingRequestData
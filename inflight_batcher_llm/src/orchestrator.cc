@@ -28,53 +28,220 @@
 
 #include "tensorrt_llm/common/mpiUtils.h"
 
+#include "engine_config.h"
 #include "inference_answer.h"
 #include "model_instance_state.h"
+#include "thread_placement.h"
 #include "utils.h"
 #include "work_item.h"
 
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <thread>
+
 namespace triton::backend::inflight_batcher_llm
 {
 
-OrchestratorCommunicator::OrchestratorCommunicator(
-    ModelState* model_state, TRITONBACKEND_ModelInstance* triton_model_instance, MPI_Comm mpiComm)
+OrchestratorCommunicator::OrchestratorCommunicator(ModelState* model_state,
+    TRITONBACKEND_ModelInstance* triton_model_instance, std::vector<MPI_Comm> const& mpiComms,
+    ProgressEngine* progressEngine, uint64_t workerLoadTimeUs)
     : model_state_(model_state)
     , modelInstance_(triton_model_instance)
+    , mProgressEngine(progressEngine)
+    , mWorkerLoadTimeUs(workerLoadTimeUs)
+    , mAnswerDispatchStats(progressEngine->getAnswerDispatchStats())
 {
     mWorkItemsQueue = std::make_unique<WorkItemsQueue>(isDecoupled());
+    if (auto const sessionHistoryBytes = model_state_->GetSessionHistoryBytes())
+    {
+        mSessionStore = std::make_shared<SessionStore>(sessionHistoryBytes.value());
+        mWorkItemsQueue->setSessionStore(mSessionStore);
+    }
+
+    // Reject the requests the engine cannot serve and convert their inputs to the data types of the engine before they
+    // are sent to the workers
+    try
+    {
+        auto const enginePath = model_state_->GetParameter<std::string>("gpt_model_path");
+        auto engineConfig = EngineConfig::load(enginePath);
+        mWorkItemsQueue->setEngineDataTypes(engineConfig.dataTypes);
+        auto& engineLimits = engineConfig.limits;
+        int32_t maxBeamWidth = 1;
+        try
+        {
+            maxBeamWidth = model_state_->GetParameter<int32_t>("max_beam_width");
+        }
+        catch (std::exception const& e)
+        {
+            // the workers warn about the default value
+        }
+        engineLimits.maxBeamWidth = std::min(engineLimits.maxBeamWidth.value_or(maxBeamWidth), maxBeamWidth);
+        mRequestValidator = std::make_shared<RequestValidator>(std::move(engineLimits));
+        mWorkItemsQueue->setRequestValidator(mRequestValidator);
+    }
+    catch (std::exception const& e)
+    {
+        TLLM_LOG_WARNING(
+            std::string("Requests are only validated by the workers and their inputs are not converted: ") + e.what());
+    }
+
+    // Requests waiting for a replica are only converted shortly before they are sent
+    try
+    {
+        mWorkItemsQueue->setDeferConversion(model_state_->GetParameter<bool>("defer_request_conversion"));
+    }
+    catch (std::exception const& e)
+    {
+        TLLM_LOG_WARNING("defer_request_conversion is not specified, will use default value of false");
+    }
+
+    for (auto mpiComm : mpiComms)
+    {
+        Replica replica;
+        replica.comm = std::make_unique<MpiComm>(mpiComm, true);
+        mReplicas.push_back(std::move(replica));
+    }
+
+    if (mReplicas.size() > 1)
+    {
+        try
+        {
+            mReplicaMaxQueuedRequests
+                = std::max(1, model_state_->GetParameter<int32_t>("replica_max_queued_requests"));
+        }
+        catch (std::exception const& e)
+        {
+            TLLM_LOG_WARNING("replica_max_queued_requests is not specified, will use default value of "
+                + std::to_string(kDefaultReplicaMaxQueuedRequests));
+        }
+    }
+
+    // The pending work items are the ones sent to the replicas that did not schedule them yet, followed by the ones
+    // waiting for a replica: the background thread converts the ones the replicas have room for
+    mWorkItemsQueue->materializeAhead(mReplicas.size() > 1
+            ? mReplicas.size() * static_cast<size_t>(mReplicaMaxQueuedRequests)
+            : std::numeric_limits<size_t>::max());
+    mWorkItemsQueue->setMaterializedCallback([this]() { mProgressEngine->notify(); });
+
+    // parse answer dispatch parameters
+    // - orchestrator_answer_dispatch_workers
+    int32_t numAnswerDispatchWorkers = kDefaultNumAnswerDispatchWorkers;
+    try
+    {
+        numAnswerDispatchWorkers
+            = std::max(1, model_state_->GetParameter<int32_t>("orchestrator_answer_dispatch_workers"));
+    }
+    catch (std::exception const& e)
+    {
+        TLLM_LOG_WARNING("orchestrator_answer_dispatch_workers is not specified, will use default value of "
+            + std::to_string(kDefaultNumAnswerDispatchWorkers));
+    }
+
+#ifdef TRITON_ENABLE_METRICS
+    custom_metrics_reporter_ = std::make_unique<custom_metrics_reporter::CustomMetricsReporter>();
+    LOG_IF_ERROR(custom_metrics_reporter_->InitializeOrchestratorReporter(
+                     model_state->GetModelName(), model_state->GetModelVersion()),
+        "Failed to create orchestrator metrics");
+    if (mRequestValidator)
+    {
+        LOG_IF_ERROR(custom_metrics_reporter_->AddMetricGroup("nv_trt_llm_request_validation_metrics",
+                         "TRT LLM request validation metrics", "rejection_type",
+                         custom_metrics_reporter::CustomMetricsReporter::request_validation_keys_,
+                         custom_metrics_reporter::CustomMetricsReporter::request_validation_labels_),
+            "Failed to create request validation metrics");
+    }
+    if (mSessionStore)
+    {
+        LOG_IF_ERROR(custom_metrics_reporter_->AddMetricGroup("nv_trt_llm_session_store_metrics",
+                         "TRT LLM session store metrics", "session_store_type",
+                         custom_metrics_reporter::CustomMetricsReporter::session_store_keys_,
+                         custom_metrics_reporter::CustomMetricsReporter::session_store_labels_),
+            "Failed to create session store metrics");
+    }
+#endif
+
+    for (int32_t i = 0; i < numAnswerDispatchWorkers; ++i)
+    {
+        mAnswerShards.push_back(std::make_unique<AnswerShard>());
+    }
+    mAnswerDispatchStats.numWorkers += mAnswerShards.size();
 
-    mMpiComm = std::make_unique<MpiComm>(mpiComm, true);
+    std::string cpuAffinity = "none";
+    try
+    {
+        cpuAffinity = model_state_->GetParameter<std::string>("cpu_affinity");
+    }
+    catch (std::exception const& e)
+    {
+        TLLM_LOG_WARNING("cpu_affinity is not specified, will use default value of none");
+    }
+    // The dispatch workers run close to the first GPU of the instance
+    auto const deviceIds = model_state_->GetDeviceIds();
+    int32_t const deviceId = (deviceIds && !deviceIds.value().empty()) ? deviceIds.value().front() : 0;
+    ScopedThreadPlacement threadPlacement(getThreadPlacement(cpuAffinity, deviceId));
+    for (size_t i = 0; i < mAnswerShards.size(); ++i)
+    {
+        mAnswerShards[i]->thread = std::thread([this, i]() { AnswerDispatchThread(i); });
+    }
 
-    mSenderThread = std::thread([this]() { SenderThread(); });
-    mAnswerThread = std::thread([this]() { AnswerThread(); });
-    mPollStopSignalThread = std::thread([this]() { PollStopSignalThread(); });
+    mProgressEngine->addCommunicator(this);
 }
 
-void OrchestratorCommunicator::SenderThread()
+bool OrchestratorCommunicator::progress()
 {
-    while (true)
     {
-        std::unique_lock lk(mSenderMutex);
-        mSenderCV.wait(lk, [&]() { return (!mSenderQueue.empty()); });
+        std::lock_guard<std::mutex> lk(mTerminatedMutex);
+        if (mTerminated)
+        {
+            return false;
+        }
+    }
+
+    std::queue<MpiMessage> messages;
+    {
+        std::lock_guard<std::mutex> lk(mSenderMutex);
+        std::swap(messages, mSenderQueue);
+    }
+
+    bool const sent = !messages.empty();
+    while (!messages.empty())
+    {
+        processMessage(messages.front());
+        messages.pop();
+    }
+
+    bool const received = receiveAnswers();
+    // The replicas that scheduled requests since the last call have room for new ones
+    assignWorkItems();
+    bool const completed = progressSends();
 
-        auto message = mSenderQueue.front();
-        mSenderQueue.pop();
+    return received || sent || completed;
+}
 
-        if (message.id == MpiId::TERMINATION)
+void OrchestratorCommunicator::processMessage(MpiMessage& message)
+{
+    if (message.id == MpiId::TERMINATION)
+    {
+        for (auto& replica : mReplicas)
         {
-            mMpiComm->send(&message.id, 1, MpiType::kUINT64, 0, kMPI_ID_TAG);
-            TLLM_LOG_INFO("Orchestrator sender thread exiting");
-            break;
+            sendMessage(*replica.comm, message.id);
         }
-        else if (message.id == MpiId::PENDING_REQUEST)
-        {
-            auto& data = std::get<PendingRequestData>(message.data);
+        mTerminationSent = true;
+        TLLM_LOG_INFO("Orchestrator sent termination");
+    }
+    else if (message.id == MpiId::PENDING_REQUEST)
+    {
+        auto& data = std::get<PendingRequestData>(message.data);
 
-            std::vector<WorkItemsQueue::RequestWrapper> requestsToPush;
-            std::vector<uint64_t> stopRequestIds;
-            uint64_t exec_start_ns = 0;
-            SET_TIMESTAMP(exec_start_ns);
+        std::vector<WorkItemsQueue::RequestWrapper> requestsToPush;
+        std::vector<uint64_t> stopRequestIds;
+        uint64_t exec_start_ns = 0;
+        SET_TIMESTAMP(exec_start_ns);
 
+        {
+            std::lock_guard<std::mutex> lk(mRequestIdStrMapMutex);
             for (auto request : data.requests)
             {
                 bool const isStopRequest
@@ -85,83 +252,319 @@ void OrchestratorCommunicator::SenderThread()
                     stopRequestIds.push_back(utils::getRequestId(request, mRequestIdStrMap));
                 }
             }
+        }
 
-            auto const workItemCb = [this, id = message.id](std::shared_ptr<WorkItem> wi)
-            {
-                auto packed = wi->getInferenceRequest()->serialize();
+        auto const workItemCb = [this](std::shared_ptr<WorkItem> wi) { mUnassignedWorkItems.push_back(wi); };
+
+        // The requests rejected by the queue, e.g. by the validation against the engine limits, are answered here
+        utils::pushTritonRequests(*mWorkItemsQueue, requestsToPush, exec_start_ns, workItemCb);
 
-                mMpiComm->send(&id, 1, MpiType::kUINT64, 0, kMPI_ID_TAG);
-                mMpiComm->send(packed.data(), packed.size(), MpiType::kINT64, 0, kMPI_DATA_TAG);
-            };
+        assignWorkItems();
+
+        if (!stopRequestIds.empty())
+        {
+            sendRequestIds(MpiId::STOP_REQUEST, stopRequestIds);
+        }
+    }
+    else if (message.id == MpiId::CANCEL_REQUEST)
+    {
+        auto& data = std::get<RequestIdsData>(message.data);
 
-            auto exceptions = mWorkItemsQueue->pushBatch(requestsToPush, exec_start_ns, workItemCb);
+        sendRequestIds(message.id, data.ids);
+    }
+}
 
-            if (!stopRequestIds.empty())
+void OrchestratorCommunicator::assignWorkItems()
+{
+    while (!mUnassignedWorkItems.empty())
+    {
+        auto const replicaIt = std::min_element(mReplicas.begin(), mReplicas.end(),
+            [](Replica const& a, Replica const& b) { return a.numQueued < b.numQueued; });
+        // A single replica gets the requests as they arrive, as its engine schedules them from its own queue
+        if (mReplicas.size() > 1 && replicaIt->numQueued >= mReplicaMaxQueuedRequests)
+        {
+            break;
+        }
+        auto const replicaIdx = static_cast<size_t>(replicaIt - mReplicas.begin());
+
+        auto workItem = mUnassignedWorkItems.front();
+        auto const requestId = workItem->requestId();
+        try
+        {
+            // The inputs are converted by the background thread of the queue, which wakes up the progress thread
+            if (!mWorkItemsQueue->materialize(*workItem, false))
             {
-                constexpr MpiId id = MpiId::STOP_REQUEST;
-                mMpiComm->send(&id, 1, MpiType::kUINT64, 0, kMPI_ID_TAG);
-                mMpiComm->send(stopRequestIds.data(), stopRequestIds.size(), MpiType::kUINT64, 0, kMPI_DATA_TAG);
+                break;
             }
+            mUnassignedWorkItems.pop_front();
+        }
+        catch (std::exception const& e)
+        {
+            mUnassignedWorkItems.pop_front();
+            // The request is answered without reaching a worker
+            mWorkItemsQueue->markInProgress(requestId);
+            LOG_IF_ERROR(ModelInstanceState::sendTritonResponse(
+                             workItem, {}, true, e.what(), *mWorkItemsQueue, modelInstance_),
+                "Failed to send Triton response for requestId: " + std::to_string(requestId));
+            std::lock_guard<std::mutex> lk(mRequestIdStrMapMutex);
+            mRequestIdStrMap.erase(requestId);
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> lk(mRequestReplicasMutex);
+            mRequestReplicas[requestId] = replicaIdx;
+        }
+
+        // The leader-worker rank only sends back the outputs the client requested
+        if (!workItem->getRequestOutputNames().empty())
+        {
+            utils::setRequestedOutputNames(*workItem->getInferenceRequest(), workItem->getRequestOutputNames());
+        }
+
+        auto packed = std::make_shared<std::vector<int64_t>>(workItem->getInferenceRequest()->serialize());
+        sendMessage(*replicaIt->comm, MpiId::PENDING_REQUEST, packed->data(), packed->size(), MPI_INT64_T, packed);
+        ++replicaIt->numQueued;
+
+        // The stop or cancel message follows its request so that the leader-worker rank knows the request
+        auto const deferredIt = mUnassignedRequestIdMessages.find(requestId);
+        if (deferredIt != mUnassignedRequestIdMessages.end())
+        {
+            auto const id = deferredIt->second;
+            mUnassignedRequestIdMessages.erase(deferredIt);
+            sendRequestIds(id, {requestId});
         }
-        else if (message.id == MpiId::CANCEL_REQUEST)
+    }
+}
+
+void OrchestratorCommunicator::sendRequestIds(MpiId id, std::vector<uint64_t> const& requestIds)
+{
+    std::vector<std::vector<uint64_t>> replicaRequestIds(mReplicas.size());
+    {
+        std::lock_guard<std::mutex> lk(mRequestReplicasMutex);
+        for (auto requestId : requestIds)
         {
-            auto& data = std::get<RequestIdsData>(message.data);
+            auto it = mRequestReplicas.find(requestId);
+            if (it != mRequestReplicas.end())
+            {
+                replicaRequestIds[it->second].push_back(requestId);
+            }
+            else if (std::any_of(mUnassignedWorkItems.begin(), mUnassignedWorkItems.end(),
+                         [requestId](auto const& workItem) { return workItem->requestId() == requestId; }))
+            {
+                mUnassignedRequestIdMessages[requestId] = id;
+            }
+        }
+    }
 
-            mMpiComm->send(&message.id, 1, MpiType::kUINT64, 0, kMPI_ID_TAG);
-            mMpiComm->send(data.ids.data(), data.ids.size(), MpiType::kUINT64, 0, kMPI_DATA_TAG);
+    for (size_t i = 0; i < mReplicas.size(); ++i)
+    {
+        if (!replicaRequestIds[i].empty())
+        {
+            auto ids = std::make_shared<std::vector<uint64_t>>(std::move(replicaRequestIds[i]));
+            sendMessage(*mReplicas[i].comm, id, ids->data(), ids->size(), MPI_UINT64_T, ids);
         }
     }
 }
 
-void OrchestratorCommunicator::AnswerThread()
+bool OrchestratorCommunicator::receiveAnswers()
 {
     MPI_Message msg;
     MPI_Status status;
     int32_t count;
-    MpiId mpiId;
 
-    while (true)
+    bool received = false;
+    for (size_t replicaIdx = 0; replicaIdx < mReplicas.size(); ++replicaIdx)
     {
-        mMpiComm->mprobe(0, kMPI_ID_TAG, &msg, &status);
-        MPICHECK(MPI_Get_count(&status, MPI_UINT64_T, &count));
-        TLLM_CHECK(count == 1);
-        MPICHECK(MPI_Mrecv(&mpiId, count, MPI_UINT64_T, &msg, &status));
+        auto& replica = mReplicas[replicaIdx];
+        auto& comm = *replica.comm;
 
-        if (mpiId == MpiId::TERMINATION)
+        int32_t numReceived = 0;
+        while (!replica.terminated && numReceived < kMaxAnswersPerProgress)
         {
-            TLLM_LOG_INFO("Orchestrator answer thread exiting");
-            break;
+            int flag = 0;
+            if (!replica.pendingId)
+            {
+                MPICHECK(MPI_Improbe(0, kMPI_ID_TAG, comm, &flag, &msg, &status));
+                if (!flag)
+                {
+                    break;
+                }
+                ++numReceived;
+
+                MpiId mpiId;
+                MPICHECK(MPI_Get_count(&status, MPI_UINT64_T, &count));
+                TLLM_CHECK(count == 1);
+                MPICHECK(MPI_Mrecv(&mpiId, count, MPI_UINT64_T, &msg, &status));
+
+                if (mpiId == MpiId::TERMINATION)
+                {
+                    replica.terminated = true;
+                    if (std::all_of(
+                            mReplicas.begin(), mReplicas.end(), [](Replica const& r) { return r.terminated; }))
+                    {
+                        TLLM_LOG_INFO("Orchestrator received termination");
+                        {
+                            std::lock_guard<std::mutex> lk(mTerminatedMutex);
+                            mTerminated = true;
+                        }
+                        mTerminatedCV.notify_all();
+                    }
+                    break;
+                }
+                replica.pendingId = mpiId;
+            }
+
+            // The data of a message is sent right after its id, it is received by the next call if it has not
+            // arrived yet
+            MPICHECK(MPI_Improbe(0, kMPI_DATA_TAG, comm, &flag, &msg, &status));
+            if (!flag)
+            {
+                break;
+            }
+            auto const mpiId = replica.pendingId.value();
+            replica.pendingId.reset();
+
+            if (mpiId == MpiId::REQUEST_IN_PROGRESS)
+            {
+                MPICHECK(MPI_Get_count(&status, MPI_UINT64_T, &count));
+
+                std::vector<uint64_t> request_ids(count);
+                MPICHECK(MPI_Mrecv(request_ids.data(), count, MPI_UINT64_T, &msg, &status));
+
+                for (auto id : request_ids)
+                {
+                    mWorkItemsQueue->markInProgress(id);
+                }
+                // The requests scheduled by the replica make room for new ones
+                replica.numQueued = std::max(0, replica.numQueued - count);
+
+                continue;
+            }
+
+            uint64_t receiveStartNs = 0;
+            SET_TIMESTAMP(receiveStartNs);
+            MPICHECK(MPI_Get_count(&status, MPI_INT64_T, &count));
+            PendingAnswer answer{std::vector<int64_t>(count), 0};
+            MPICHECK(MPI_Mrecv(answer.data.data(), count, MPI_INT64_T, &msg, &status));
+            SET_TIMESTAMP(answer.receiveTimeNs);
+            mAnswerDispatchStats.receiveTimeUs += (answer.receiveTimeNs - receiveStartNs) / 1000;
+
+            // Shard by request id so that the answers of a request are sent in the order they were received
+            auto const requestId = InferenceAnswer::deserializeRequestId(answer.data.data());
+            auto& shard = *mAnswerShards[requestId % mAnswerShards.size()];
+            {
+                std::lock_guard<std::mutex> lk(shard.mutex);
+                shard.answers.push(std::move(answer));
+            }
+            ++mAnswerDispatchStats.numQueued;
+            shard.cv.notify_one();
         }
-        else if (mpiId == MpiId::REQUEST_IN_PROGRESS)
+        received |= numReceived > 0;
+    }
+
+    return received;
+}
+
+bool OrchestratorCommunicator::progressSends()
+{
+    if (mSendRequests.empty())
+    {
+        return false;
+    }
+
+    int numCompleted = 0;
+    std::vector<int> indices(mSendRequests.size());
+    MPICHECK(MPI_Testsome(
+        mSendRequests.size(), mSendRequests.data(), &numCompleted, indices.data(), MPI_STATUSES_IGNORE));
+    if (numCompleted <= 0)
+    {
+        return false;
+    }
+
+    // The completed requests are set to MPI_REQUEST_NULL, their buffers can be released
+    size_t kept = 0;
+    for (size_t i = 0; i < mSendRequests.size(); ++i)
+    {
+        if (mSendRequests[i] != MPI_REQUEST_NULL)
         {
-            mMpiComm->mprobe(0, kMPI_DATA_TAG, &msg, &status);
-            MPICHECK(MPI_Get_count(&status, MPI_UINT64_T, &count));
+            mSendRequests[kept] = mSendRequests[i];
+            mSendBuffers[kept] = std::move(mSendBuffers[i]);
+            ++kept;
+        }
+    }
+    mSendRequests.resize(kept);
+    mSendBuffers.resize(kept);
+    return true;
+}
+
+void OrchestratorCommunicator::sendMessage(
+    MpiComm const& comm, MpiId id, void const* data, int32_t count, MPI_Datatype dataType, std::shared_ptr<void> buffer)
+{
+    auto idBuffer = std::make_shared<MpiId>(id);
+    MPI_Request request;
+    MPICHECK(MPI_Isend(idBuffer.get(), 1, MPI_UINT64_T, 0, kMPI_ID_TAG, comm, &request));
+    mSendRequests.push_back(request);
+    mSendBuffers.push_back(std::move(idBuffer));
+
+    if (data != nullptr)
+    {
+        MPICHECK(MPI_Isend(data, count, dataType, 0, kMPI_DATA_TAG, comm, &request));
+        mSendRequests.push_back(request);
+        mSendBuffers.push_back(std::move(buffer));
+    }
+}
 
-            std::vector<uint64_t> request_ids(count);
-            MPICHECK(MPI_Mrecv(request_ids.data(), count, MPI_UINT64_T, &msg, &status));
+bool OrchestratorCommunicator::hasOutstandingMessages()
+{
+    if (!mSendRequests.empty())
+    {
+        return true;
+    }
+    // The termination is acknowledged by each replica, and messages may be partially received
+    if (std::any_of(mReplicas.begin(), mReplicas.end(),
+            [this](Replica const& r) { return (mTerminationSent && !r.terminated) || r.pendingId.has_value(); }))
+    {
+        return true;
+    }
+    std::lock_guard<std::mutex> lk(mRequestReplicasMutex);
+    return !mRequestReplicas.empty();
+}
 
-            for (auto id : request_ids)
+void OrchestratorCommunicator::AnswerDispatchThread(size_t shardIdx)
+{
+    auto& shard = *mAnswerShards[shardIdx];
+    while (true)
+    {
+        PendingAnswer pending;
+        {
+            std::unique_lock<std::mutex> lk(shard.mutex);
+            shard.cv.wait(lk, [&]() { return shard.stop || !shard.answers.empty(); });
+            if (shard.answers.empty())
             {
-                mWorkItemsQueue->markInProgress(id);
+                break;
             }
-
-            continue;
+            pending = std::move(shard.answers.front());
+            shard.answers.pop();
         }
+        --mAnswerDispatchStats.numQueued;
 
-        mMpiComm->mprobe(0, kMPI_DATA_TAG, &msg, &status);
-        MPICHECK(MPI_Get_count(&status, MPI_INT64_T, &count));
-        std::vector<int64_t> data(count);
-        MPICHECK(MPI_Mrecv(data.data(), count, MPI_INT64_T, &msg, &status));
+        uint64_t dispatchStartNs = 0;
+        SET_TIMESTAMP(dispatchStartNs);
+        mAnswerDispatchStats.queueTimeUs += (dispatchStartNs - pending.receiveTimeNs) / 1000;
 
-        auto answer = InferenceAnswer::deserialize(data.data());
+        auto answer = InferenceAnswer::deserialize(pending.data.data());
         auto const requestId = answer->GetRequestId();
 
-        std::string errStr = std::string("Failed to send Triton response for requestId: ")
-            + utils::getRequestIdStr(requestId, mRequestIdStrMap);
-
-        if (answer->IsFinalResponse())
+        std::string errStr;
         {
-            mRequestIdStrMap.erase(requestId);
+            std::lock_guard<std::mutex> lk(mRequestIdStrMapMutex);
+            errStr = std::string("Failed to send Triton response for requestId: ")
+                + utils::getRequestIdStr(requestId, mRequestIdStrMap);
+
+            if (answer->IsFinalResponse())
+            {
+                mRequestIdStrMap.erase(requestId);
+            }
         }
 
         try
@@ -175,35 +578,101 @@ void OrchestratorCommunicator::AnswerThread()
         {
             TLLM_LOG_ERROR(errStr);
         }
+
+        // Once the request is finished, a stop request for it is rejected by the work items queue
+        if (answer->IsFinalResponse())
+        {
+            std::lock_guard<std::mutex> lk(mRequestReplicasMutex);
+            mRequestReplicas.erase(requestId);
+        }
+
+        uint64_t dispatchEndNs = 0;
+        SET_TIMESTAMP(dispatchEndNs);
+        mAnswerDispatchStats.dispatchTimeUs += (dispatchEndNs - dispatchStartNs) / 1000;
+        ++mAnswerDispatchStats.numDispatched;
     }
 }
 
-void OrchestratorCommunicator::PollStopSignalThread(int const intervalInMs)
+void OrchestratorCommunicator::stopAnswerDispatch()
 {
-    while (true)
+    for (auto& shard : mAnswerShards)
     {
-        std::this_thread::sleep_for(std::chrono::milliseconds(intervalInMs));
-
-        if (mShutdownRequest.load())
         {
-            break;
+            std::lock_guard<std::mutex> lk(shard->mutex);
+            shard->stop = true;
+        }
+        shard->cv.notify_one();
+    }
+    for (auto& shard : mAnswerShards)
+    {
+        if (shard->thread.joinable())
+        {
+            shard->thread.join();
         }
+    }
+    mAnswerDispatchStats.numWorkers -= mAnswerShards.size();
+    TLLM_LOG_INFO("Orchestrator answer dispatch threads exiting");
+}
 
-        // Merge cancelled requests into stopped requests Ids
-        auto cancelledReqIds = mWorkItemsQueue->getCancelledInProgressReqIds();
+void OrchestratorCommunicator::reportStats()
+{
+#ifdef TRITON_ENABLE_METRICS
+    nlohmann::json stats;
+    stats["Worker Load Time"] = mWorkerLoadTimeUs;
+    if (mRequestValidator)
+    {
+        stats["Request Validation Input Length Rejections"] = mRequestValidator->numInputLengthRejections();
+        stats["Request Validation Sequence Length Rejections"] = mRequestValidator->numSequenceLengthRejections();
+        stats["Request Validation Token Id Rejections"] = mRequestValidator->numTokenIdRejections();
+        stats["Request Validation Beam Width Rejections"] = mRequestValidator->numBeamWidthRejections();
+    }
+    if (mSessionStore)
+    {
+        stats["Session Store Hits"] = mSessionStore->numHits();
+        stats["Session Store Reused Tokens"] = mSessionStore->numReusedTokens();
+    }
+    LOG_IF_ERROR(
+        custom_metrics_reporter_->UpdateCustomMetrics(stats.dump()), "Failed updating orchestrator metrics");
+#endif
+}
 
-        if (cancelledReqIds.empty())
+void OrchestratorCommunicator::pollStopSignals()
+{
+    {
+        std::lock_guard<std::mutex> lk(mTerminatedMutex);
+        if (mTerminated)
         {
-            continue;
+            return;
         }
+    }
 
-        std::vector<uint64_t> cancelledReqIdsVec(cancelledReqIds.begin(), cancelledReqIds.end());
+    if (++mNumStopSignalPolls % kMetricsIntervals == 0)
+    {
+        reportStats();
+    }
 
-        MpiMessage message(MpiId::CANCEL_REQUEST);
-        message.data = RequestIdsData{std::move(cancelledReqIdsVec)};
+    // Merge cancelled requests into stopped requests Ids
+    auto cancelledReqIds = mWorkItemsQueue->getCancelledInProgressReqIds();
+    // The cancel message of the requests waiting for a replica is sent once they are assigned
+    for (auto const& workItem : mUnassignedWorkItems)
+    {
+        if (workItem->isCancelled())
+        {
+            cancelledReqIds.insert(workItem->requestId());
+        }
+    }
 
-        SendMessage(std::move(message));
+    if (cancelledReqIds.empty())
+    {
+        return;
     }
+
+    std::vector<uint64_t> cancelledReqIdsVec(cancelledReqIds.begin(), cancelledReqIds.end());
+
+    MpiMessage message(MpiId::CANCEL_REQUEST);
+    message.data = RequestIdsData{std::move(cancelledReqIdsVec)};
+
+    processMessage(message);
 }
 
 void OrchestratorCommunicator::SendMessage(MpiMessage&& message)
@@ -213,7 +682,7 @@ void OrchestratorCommunicator::SendMessage(MpiMessage&& message)
         mSenderQueue.push(std::move(message));
     }
 
-    mSenderCV.notify_all();
+    mProgressEngine->notify();
 }
 
 void OrchestratorCommunicator::enqueue(TRITONBACKEND_Request** requests, const uint32_t request_count)
@@ -228,38 +697,292 @@ void OrchestratorCommunicator::enqueue(TRITONBACKEND_Request** requests, const u
 
 void OrchestratorCommunicator::shutdown()
 {
-    MpiMessage message(MpiId::TERMINATION);
+    SendMessage(MpiMessage(MpiId::TERMINATION));
 
+    // The leader-worker ranks send the termination back once they have sent all their answers
     {
-        std::unique_lock<std::mutex> lk(mSenderMutex);
-        mSenderQueue.push(message);
+        std::unique_lock<std::mutex> lk(mTerminatedMutex);
+        mTerminatedCV.wait(lk, [&]() { return mTerminated; });
     }
 
-    mSenderCV.notify_all();
-    mShutdownRequest.store(true);
+    mProgressEngine->removeCommunicator(this);
+    // The leader-worker ranks received all the messages before acknowledging the termination
+    MPICHECK(MPI_Waitall(mSendRequests.size(), mSendRequests.data(), MPI_STATUSES_IGNORE));
+    mSendRequests.clear();
+    mSendBuffers.clear();
+    stopAnswerDispatch();
+}
+
+ProgressEngine::ProgressEngine()
+{
+#ifdef TRITON_ENABLE_METRICS
+    custom_metrics_reporter_ = std::make_unique<custom_metrics_reporter::CustomMetricsReporter>();
+    LOG_IF_ERROR(
+        custom_metrics_reporter_->InitializeOrchestratorWideReporter(), "Failed to create orchestrator metrics");
+#endif
+    mProgressThread = std::thread([this]() { ProgressThread(); });
+}
+
+ProgressEngine::~ProgressEngine()
+{
+    {
+        std::lock_guard<std::mutex> lk(mWakeUpMutex);
+        mStop = true;
+    }
+    mWakeUpCV.notify_one();
 
-    if (mSenderThread.joinable())
+    if (mProgressThread.joinable())
     {
-        mSenderThread.join();
+        mProgressThread.join();
     }
-    if (mAnswerThread.joinable())
+}
+
+void ProgressEngine::addCommunicator(OrchestratorCommunicator* communicator)
+{
     {
-        mAnswerThread.join();
+        std::lock_guard<std::mutex> lk(mCommunicatorsMutex);
+        mCommunicators.push_back(communicator);
     }
-    if (mPollStopSignalThread.joinable())
+    notify();
+}
+
+void ProgressEngine::removeCommunicator(OrchestratorCommunicator* communicator)
+{
+    std::lock_guard<std::mutex> lk(mCommunicatorsMutex);
+    mCommunicators.erase(std::remove(mCommunicators.begin(), mCommunicators.end(), communicator), mCommunicators.end());
+}
+
+void ProgressEngine::notify()
+{
     {
-        mPollStopSignalThread.join();
+        std::lock_guard<std::mutex> lk(mWakeUpMutex);
+        mNotified = true;
     }
+    mWakeUpCV.notify_one();
+}
+
+void ProgressEngine::ProgressThread()
+{
+    auto nextStopSignalPoll = std::chrono::steady_clock::now() + kStopSignalPollInterval;
+
+    while (true)
+    {
+        bool madeProgress = false;
+        bool hasOutstandingMessages = false;
+        {
+            std::lock_guard<std::mutex> lk(mCommunicatorsMutex);
+            for (auto* communicator : mCommunicators)
+            {
+                madeProgress |= communicator->progress();
+                hasOutstandingMessages |= communicator->hasOutstandingMessages();
+            }
+
+            if (std::chrono::steady_clock::now() >= nextStopSignalPoll)
+            {
+                for (auto* communicator : mCommunicators)
+                {
+                    communicator->pollStopSignals();
+                }
+                if (++mNumStopSignalPolls % OrchestratorCommunicator::kMetricsIntervals == 0)
+                {
+                    reportStats();
+                }
+                nextStopSignalPoll = std::chrono::steady_clock::now() + kStopSignalPollInterval;
+            }
+        }
+
+        std::unique_lock<std::mutex> lk(mWakeUpMutex);
+        if (mStop)
+        {
+            TLLM_LOG_INFO("Orchestrator progress thread exiting");
+            break;
+        }
+        if (madeProgress || mNotified)
+        {
+            // More messages are likely to follow, poll again right away
+            mNotified = false;
+            continue;
+        }
+
+        if (hasOutstandingMessages)
+        {
+            // Answers from the leader-worker ranks cannot notify the condition variable, keep polling them while
+            // requests are in flight. Like MPI_Waitany, which busy-polls in Open MPI, but the enqueued requests and
+            // the stop signal polls are not delayed.
+            lk.unlock();
+            std::this_thread::yield();
+            continue;
+        }
+
+        // Nothing can arrive from the leader-worker ranks until requests are enqueued
+        mWakeUpCV.wait_for(lk, kMaxIdleWait, [&]() { return mNotified || mStop; });
+    }
+}
+
+void ProgressEngine::reportStats()
+{
+#ifdef TRITON_ENABLE_METRICS
+    nlohmann::json stats;
+    stats["Answer Dispatch Workers"] = mAnswerDispatchStats.numWorkers.load();
+    stats["Answer Dispatch Queued"] = mAnswerDispatchStats.numQueued.load();
+    stats["Answer Dispatch Count"] = mAnswerDispatchStats.numDispatched.load();
+    stats["Answer Dispatch Receive Time"] = mAnswerDispatchStats.receiveTimeUs.load();
+    stats["Answer Dispatch Queue Time"] = mAnswerDispatchStats.queueTimeUs.load();
+    stats["Answer Dispatch Send Time"] = mAnswerDispatchStats.dispatchTimeUs.load();
+    stats["Worker Pool Idle Workers"] = mWorkerPool ? mWorkerPool->numIdle() : 0;
+    stats["Worker Pool Hits"] = mWorkerPool ? mWorkerPool->numHits() : 0;
+    stats["Worker Pool Misses"] = mWorkerPool ? mWorkerPool->numMisses() : 0;
+    LOG_IF_ERROR(
+        custom_metrics_reporter_->UpdateCustomMetrics(stats.dump()), "Failed updating orchestrator metrics");
+#endif
+}
+
+void Orchestrator::createWorkerPool(std::string const& workerPath, int32_t size)
+{
+    mWorkerPool = std::make_unique<WorkerPool>(workerPath, size);
+    mProgressEngine.setWorkerPool(mWorkerPool.get());
 }
 
 TRITONSERVER_Error* Orchestrator::addCommunicator(ModelState* model_state,
-    TRITONBACKEND_ModelInstance* triton_model_instance, MPI_Comm mpiComm, OrchestratorCommunicator** communicator)
+    TRITONBACKEND_ModelInstance* triton_model_instance, OrchestratorCommunicator** communicator)
 {
-    *communicator = new OrchestratorCommunicator(model_state, triton_model_instance, mpiComm);
+    uint64_t loadStartNs = 0;
+    SET_TIMESTAMP(loadStartNs);
+
+    int32_t numReplicas = 1;
+    try
+    {
+        numReplicas = std::max(1, model_state->GetParameter<int32_t>("data_parallel_replicas"));
+    }
+    catch (std::exception const& e)
+    {
+        TLLM_LOG_WARNING("data_parallel_replicas is not specified, will use default value of 1");
+    }
+
+    // Each replica runs on its own slice of the GPU device ids
+    auto const device_ids = model_state->GetDeviceIds();
+    if (numReplicas > 1 && (!device_ids || device_ids.value().size() % numReplicas != 0))
+    {
+        std::string const errStr = "gpu_device_ids must be specified and split evenly between the "
+            + std::to_string(numReplicas) + " data-parallel replicas";
+        return TRITONSERVER_ErrorNew(TRITONSERVER_ERROR_INVALID_ARG, errStr.c_str());
+    }
+    int const num_workers = device_ids ? device_ids.value().size() / numReplicas : 1;
+
+    auto const workerPath = model_state->GetWorkerPath();
+    std::vector<MPI_Comm> replicaComms;
+    std::vector<MPI_Comm> pooledWorkers;
+    for (int32_t replicaIdx = 0; replicaIdx < numReplicas; ++replicaIdx)
+    {
+        std::optional<std::vector<int32_t>> replicaDeviceIds;
+        if (device_ids)
+        {
+            auto const sliceBegin = device_ids.value().begin() + replicaIdx * num_workers;
+            replicaDeviceIds = std::vector<int32_t>(sliceBegin, sliceBegin + num_workers);
+        }
+
+        // Pooled workers run the default worker executable, models using another one spawn their workers
+        MPI_Comm pooledWorker = (mWorkerPool && num_workers == 1 && workerPath == mWorkerPool->getWorkerPath())
+            ? mWorkerPool->acquire()
+            : MPI_COMM_NULL;
+
+        // The output comm is an intercommunicator so it has some special rules.
+        // The parent must send data with bcast using root = MPI_ROOT (-4)
+        std::vector<int64_t> packed = model_state->serialize(replicaDeviceIds);
+        int64_t n = packed.size();
+
+        // Instances are initialized in parallel, the spawns and the collectives on the worker comms of the
+        // different instances must not interleave
+        std::lock_guard<std::mutex> lk(mWorkerCommsMutex);
+        MPI_Comm everyone;
+        if (pooledWorker != MPI_COMM_NULL)
+        {
+            MPICHECK(MPI_Bcast(&n, 1, MPI_INT64_T, MPI_ROOT, pooledWorker));
+            MPICHECK(MPI_Bcast(packed.data(), packed.size(), MPI_INT64_T, MPI_ROOT, pooledWorker));
+            // The communicator frees its comm, the pooled worker keeps its own for the next model
+            MPICHECK(MPI_Comm_dup(pooledWorker, &everyone));
+            pooledWorkers.push_back(pooledWorker);
+        }
+        else
+        {
+            MPICHECK(MPI_Comm_spawn(workerPath.c_str(), MPI_ARGV_NULL, num_workers, MPI_INFO_NULL, 0, MPI_COMM_SELF,
+                &everyone, MPI_ERRCODES_IGNORE));
+            MPICHECK(MPI_Bcast(&n, 1, MPI_INT64_T, MPI_ROOT, everyone));
+            MPICHECK(MPI_Bcast(packed.data(), packed.size(), MPI_INT64_T, MPI_ROOT, everyone));
+        }
+        replicaComms.push_back(everyone);
+    }
+
+    // The leader-worker rank of each replica reports whether it loaded the model. The engine load takes seconds,
+    // so the readiness is polled without holding the lock, for the other instances to start their workers meanwhile
+    std::vector<MpiId> replicaIds(numReplicas);
+    std::vector<MPI_Request> readyRequests(numReplicas);
+    {
+        std::lock_guard<std::mutex> lk(mWorkerCommsMutex);
+        for (int32_t replicaIdx = 0; replicaIdx < numReplicas; ++replicaIdx)
+        {
+            MPICHECK(MPI_Irecv(&replicaIds[replicaIdx], 1, MPI_UINT64_T, 0, kMPI_ID_TAG, replicaComms[replicaIdx],
+                &readyRequests[replicaIdx]));
+        }
+    }
+    for (int ready = 0; !ready;)
+    {
+        {
+            std::lock_guard<std::mutex> lk(mWorkerCommsMutex);
+            MPICHECK(MPI_Testall(numReplicas, readyRequests.data(), &ready, MPI_STATUSES_IGNORE));
+        }
+        if (!ready)
+        {
+            std::this_thread::sleep_for(kWorkerReadyPollInterval);
+        }
+    }
+
+    std::vector<bool> replicaReady(numReplicas);
+    for (int32_t replicaIdx = 0; replicaIdx < numReplicas; ++replicaIdx)
+    {
+        replicaReady[replicaIdx] = replicaIds[replicaIdx] == MpiId::WORKER_READY;
+    }
+
+    if (std::find(replicaReady.begin(), replicaReady.end(), false) != replicaReady.end())
+    {
+        std::lock_guard<std::mutex> lk(mWorkerCommsMutex);
+        for (int32_t replicaIdx = 0; replicaIdx < numReplicas; ++replicaIdx)
+        {
+            // The replicas that loaded the model serve it until they are terminated
+            if (replicaReady[replicaIdx])
+            {
+                MpiId mpiId = MpiId::TERMINATION;
+                MPICHECK(MPI_Send(&mpiId, 1, MPI_UINT64_T, 0, kMPI_ID_TAG, replicaComms[replicaIdx]));
+                MPICHECK(
+                    MPI_Recv(&mpiId, 1, MPI_UINT64_T, 0, kMPI_ID_TAG, replicaComms[replicaIdx], MPI_STATUS_IGNORE));
+            }
+            MPICHECK(MPI_Comm_free(&replicaComms[replicaIdx]));
+        }
+        // Pooled workers wait for the next model whether or not they loaded this one
+        for (auto pooledWorker : pooledWorkers)
+        {
+            mWorkerPool->release(pooledWorker);
+        }
+        std::string const errStr = "Workers failed to load model " + model_state->GetModelName() + ", see their logs";
+        return TRITONSERVER_ErrorNew(TRITONSERVER_ERROR_INTERNAL, errStr.c_str());
+    }
+
+    uint64_t loadEndNs = 0;
+    SET_TIMESTAMP(loadEndNs);
+    TLLM_LOG_INFO("Workers of model %s loaded in %lu us: %d replicas of %d ranks, %lu from the worker pool",
+        model_state->GetModelName().c_str(), (loadEndNs - loadStartNs) / 1000, numReplicas, num_workers,
+        pooledWorkers.size());
+
+    *communicator = new OrchestratorCommunicator(
+        model_state, triton_model_instance, replicaComms, &mProgressEngine, (loadEndNs - loadStartNs) / 1000);
 
     {
         std::lock_guard<std::mutex> lk(mCommunicatorsMutex);
         mCommunicators.insert(*communicator);
+        if (!pooledWorkers.empty())
+        {
+            mPooledWorkers[*communicator] = std::move(pooledWorkers);
+        }
     }
 
     return nullptr; // success
@@ -267,8 +990,20 @@ TRITONSERVER_Error* Orchestrator::addCommunicator(ModelState* model_state,
 
 void Orchestrator::removeCommunicator(OrchestratorCommunicator* communicator)
 {
+    communicator->shutdown();
+    delete communicator;
+
     std::lock_guard<std::mutex> lk(mCommunicatorsMutex);
     mCommunicators.erase(communicator);
+    auto pooledWorkers = mPooledWorkers.find(communicator);
+    if (pooledWorkers != mPooledWorkers.end())
+    {
+        for (auto pooledWorker : pooledWorkers->second)
+        {
+            mWorkerPool->release(pooledWorker);
+        }
+        mPooledWorkers.erase(pooledWorkers);
+    }
 }
 
 } // namespace triton::backend::inflight_batcher_llm
@@ -28,29 +28,65 @@
 
 #include "model_state.h"
 #include "mpi_utils.h"
+#include "request_validator.h"
+#include "session_store.h"
 #include "work_items_queue.h"
+#include "worker_pool.h"
 
 #include "triton/core/tritonbackend.h"
 #include "triton/core/tritonserver.h"
 
 #include "tensorrt_llm/common/mpiUtils.h"
 
+#ifdef TRITON_ENABLE_METRICS
+#include "custom_metrics_reporter/custom_metrics_reporter.h"
+#endif
+
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <list>
 #include <mutex>
+#include <optional>
 #include <queue>
 #include <thread>
 #include <unordered_set>
+#include <vector>
 
 using namespace tensorrt_llm::mpi;
 
 namespace triton::backend::inflight_batcher_llm
 {
 
+class ProgressEngine;
+
+/// @brief Answer dispatch statistics of all the communicators of the orchestrator, reported by the progress engine
+struct AnswerDispatchStats
+{
+    std::atomic<uint64_t> numWorkers{0};
+    std::atomic<uint64_t> numQueued{0};
+    std::atomic<uint64_t> numDispatched{0};
+    std::atomic<uint64_t> receiveTimeUs{0};
+    std::atomic<uint64_t> queueTimeUs{0};
+    std::atomic<uint64_t> dispatchTimeUs{0};
+};
+
 class OrchestratorCommunicator
 {
 public:
-    OrchestratorCommunicator(
-        ModelState* model_state, TRITONBACKEND_ModelInstance* triton_model_instance, MPI_Comm mpiComm);
+    // default number of threads deserializing and sending the inference answers to Triton
+    static constexpr int32_t kDefaultNumAnswerDispatchWorkers = 4;
+    // number of stop signal polls between two updates of the metrics
+    static constexpr int32_t kMetricsIntervals = 100;
+    // maximum number of answers received per progress call, so that a busy communicator does not starve the others
+    static constexpr int32_t kMaxAnswersPerProgress = 64;
+    // default number of requests sent to a data-parallel replica that it has not scheduled yet
+    static constexpr int32_t kDefaultReplicaMaxQueuedRequests = 16;
+
+    /// @param mpiComms Inter-communicators with the worker group of each data-parallel replica of the model
+    /// @param workerLoadTimeUs Time taken by the workers of the instance to start and load the model
+    OrchestratorCommunicator(ModelState* model_state, TRITONBACKEND_ModelInstance* triton_model_instance,
+        std::vector<MPI_Comm> const& mpiComms, ProgressEngine* progressEngine, uint64_t workerLoadTimeUs);
 
     void enqueue(TRITONBACKEND_Request** requests, const uint32_t request_count);
     void shutdown();
@@ -60,34 +96,180 @@ public:
         return model_state_->IsDecoupled();
     }
 
-private:
-    /// @brief Send work items to leader-worker ranks
-    void SenderThread();
-    /// @brief Receive inference answers from leader-worker ranks
-    void AnswerThread();
-    /// @brief Polls at a given interval for stop signals
-    void PollStopSignalThread(int const invervalInMs = 10);
+    /// @brief Send the queued messages to the leader-worker ranks and receive their inference answers, without
+    /// waiting for new ones. Called by the progress engine.
+    /// @return Whether any message was sent or received
+    bool progress();
+
+    /// @brief Forward the cancelled requests to the leader-worker ranks. Called by the progress engine at a fixed
+    /// interval.
+    void pollStopSignals();
+
+    /// @brief Whether messages are being sent, or answers are expected from the leader-worker ranks. Called by the
+    /// progress engine.
+    bool hasOutstandingMessages();
 
+private:
+    /// @brief Send a message to the leader-worker ranks
+    void processMessage(MpiMessage& message);
+    /// @brief Send the work items not assigned yet to the replicas that have room for them, the replica with the
+    /// fewest queued requests first
+    void assignWorkItems();
+    /// @brief Send the ids of stopped or cancelled requests to the replicas serving them
+    void sendRequestIds(MpiId id, std::vector<uint64_t> const& requestIds);
+    /// @brief Receive the inference answers available from the leader-worker ranks and hand them over to the
+    /// dispatch workers
+    bool receiveAnswers();
+    /// @brief Send a message to the leader-worker rank of a replica without waiting for its completion
+    /// @param buffer Owner of the data, kept until the send completes
+    void sendMessage(MpiComm const& comm, MpiId id, void const* data = nullptr, int32_t count = 0,
+        MPI_Datatype dataType = MPI_BYTE, std::shared_ptr<void> buffer = nullptr);
+    /// @brief Release the buffers of the completed sends
+    /// @return Whether any send completed
+    bool progressSends();
+    /// @brief Deserialize the inference answers of a shard and send the Triton responses
+    void AnswerDispatchThread(size_t shardIdx);
+    /// @brief Stop the dispatch workers once they have sent the answers already received
+    void stopAnswerDispatch();
+    /// @brief Report the statistics of the workers and of the requests of the instance to the Triton metrics
+    void reportStats();
     void SendMessage(MpiMessage&& message);
 
 private:
     ModelState* model_state_;
     TRITONBACKEND_ModelInstance* modelInstance_;
 
-    std::unique_ptr<MpiComm> mMpiComm;
+    /// @brief Worker group of a data-parallel replica of the model
+    struct Replica
+    {
+        std::unique_ptr<MpiComm> comm;
+        // requests sent to the leader-worker rank that it has not scheduled yet
+        int32_t numQueued = 0;
+        bool terminated = false;
+        // id of a message received without its data yet
+        std::optional<MpiId> pendingId;
+    };
+
+    // only accessed by the progress thread
+    std::vector<Replica> mReplicas;
+    int32_t mReplicaMaxQueuedRequests = kDefaultReplicaMaxQueuedRequests;
+    std::list<std::shared_ptr<WorkItem>> mUnassignedWorkItems;
+    // stop or cancel messages received before their request was assigned to a replica, per request id
+    std::unordered_map<uint64_t, MpiId> mUnassignedRequestIdMessages;
+    // sends in flight and the buffers they read from
+    std::vector<MPI_Request> mSendRequests;
+    std::vector<std::shared_ptr<void>> mSendBuffers;
+    bool mTerminationSent = false;
 
+    // replica serving each request, accessed by the progress thread and the dispatch workers
+    std::unordered_map<uint64_t, size_t> mRequestReplicas;
+    std::mutex mRequestReplicasMutex;
+
+    // shared by the replicas, which take work items from it as they schedule their requests
     std::unique_ptr<WorkItemsQueue> mWorkItemsQueue;
+    std::shared_ptr<RequestValidator> mRequestValidator;
+    std::shared_ptr<SessionStore> mSessionStore;
 
-    std::thread mSenderThread;
+    ProgressEngine* mProgressEngine;
+    uint64_t mWorkerLoadTimeUs;
     std::queue<MpiMessage> mSenderQueue;
     std::mutex mSenderMutex;
-    std::condition_variable mSenderCV;
+    int32_t mNumStopSignalPolls = 0;
+
+    // set once the leader-worker ranks acknowledged the termination
+    bool mTerminated = false;
+    std::mutex mTerminatedMutex;
+    std::condition_variable mTerminatedCV;
+
+    /// @brief Serialized inference answer waiting to be dispatched
+    struct PendingAnswer
+    {
+        std::vector<int64_t> data;
+        uint64_t receiveTimeNs;
+    };
+
+    /// @brief Answers of the requests assigned to a dispatch worker, in the order they were received. The answers of
+    /// a request are always assigned to the same worker so that its responses are sent in order.
+    struct AnswerShard
+    {
+        std::thread thread;
+        std::queue<PendingAnswer> answers;
+        std::mutex mutex;
+        std::condition_variable cv;
+        bool stop = false;
+    };
 
-    std::thread mAnswerThread;
-    std::thread mPollStopSignalThread;
-    std::atomic<bool> mShutdownRequest = false;
+    std::vector<std::unique_ptr<AnswerShard>> mAnswerShards;
+    // owned by the progress engine
+    AnswerDispatchStats& mAnswerDispatchStats;
 
+    // accessed by the progress thread and the dispatch workers
     std::unordered_map<uint64_t, std::string> mRequestIdStrMap;
+    std::mutex mRequestIdStrMapMutex;
+#ifdef TRITON_ENABLE_METRICS
+    std::unique_ptr<custom_metrics_reporter::CustomMetricsReporter> custom_metrics_reporter_;
+#endif
+};
+
+//
+// ProgressEngine
+// Drives the communication of all the communicators of the orchestrator from a single thread, using non-blocking
+// MPI calls. The thread keeps polling while answers are expected from the leader-worker ranks, otherwise it blocks
+// until requests are enqueued.
+//
+
+class ProgressEngine
+{
+public:
+    // longest wait of the progress thread without requests in flight, so that the metrics are eventually updated
+    static constexpr std::chrono::milliseconds kMaxIdleWait{1000};
+    // interval between two polls of the cancelled requests
+    static constexpr std::chrono::milliseconds kStopSignalPollInterval{10};
+
+    ProgressEngine();
+    ~ProgressEngine();
+
+    void addCommunicator(OrchestratorCommunicator* communicator);
+
+    /// @brief Stop driving a communicator, waits for the current progress call to complete
+    void removeCommunicator(OrchestratorCommunicator* communicator);
+
+    /// @brief Wake up the progress thread, e.g. when a message is queued
+    void notify();
+
+    AnswerDispatchStats& getAnswerDispatchStats()
+    {
+        return mAnswerDispatchStats;
+    }
+
+    /// @brief Set the worker pool of the orchestrator, whose statistics are reported with the answer dispatch ones
+    void setWorkerPool(WorkerPool const* workerPool)
+    {
+        mWorkerPool = workerPool;
+    }
+
+private:
+    void ProgressThread();
+
+    /// @brief Report the answer dispatch statistics of all the communicators and the worker pool statistics
+    void reportStats();
+
+    std::thread mProgressThread;
+
+    std::vector<OrchestratorCommunicator*> mCommunicators;
+    std::mutex mCommunicatorsMutex;
+
+    bool mNotified = false;
+    bool mStop = false;
+    std::mutex mWakeUpMutex;
+    std::condition_variable mWakeUpCV;
+
+    AnswerDispatchStats mAnswerDispatchStats;
+    WorkerPool const* mWorkerPool{nullptr};
+    int32_t mNumStopSignalPolls = 0;
+#ifdef TRITON_ENABLE_METRICS
+    std::unique_ptr<custom_metrics_reporter::CustomMetricsReporter> custom_metrics_reporter_;
+#endif
 };
 
 //
@@ -102,14 +284,31 @@ public:
 
     virtual ~Orchestrator() {}
 
+    /// @brief Spawn the workers that will be reused by the single-rank models
+    void createWorkerPool(std::string const& workerPath, int32_t size);
+
+    // interval of the checks whether the workers of an instance loaded the model
+    static constexpr std::chrono::milliseconds kWorkerReadyPollInterval{10};
+
+    /// @brief Start the worker group of each data-parallel replica of a model instance, from the worker pool if
+    /// possible, send them the model and wait until they loaded it
     TRITONSERVER_Error* addCommunicator(ModelState* model_state, TRITONBACKEND_ModelInstance* triton_model_instance,
-        MPI_Comm mpiComm, OrchestratorCommunicator** communicator);
+        OrchestratorCommunicator** communicator);
+
+    /// @brief Shut down and delete a communicator, its pooled workers go back to the pool
     void removeCommunicator(OrchestratorCommunicator* communicator);
 
 private:
     std::unordered_set<OrchestratorCommunicator*> mCommunicators;
+    // pooled workers of each communicator using some
+    std::unordered_map<OrchestratorCommunicator*, std::vector<MPI_Comm>> mPooledWorkers;
+    // declared before the progress engine so that the idle workers are told to exit last
+    std::unique_ptr<WorkerPool> mWorkerPool;
+    ProgressEngine mProgressEngine;
 
     mutable std::mutex mCommunicatorsMutex;
+    // serializes the spawns and the messages to the workers of the instances being initialized
+    std::mutex mWorkerCommsMutex;
 };
 
 } // namespace triton::backend::inflight_batcher_llm
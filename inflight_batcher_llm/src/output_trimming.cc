@@ -0,0 +1,145 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "output_trimming.h"
+
+#include <algorithm>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace triton::backend::inflight_batcher_llm
+{
+
+namespace
+{
+
+using tensorrt_llm::batch_manager::NamedTensor;
+
+/// Response tensors have a leading batch dimension of 1
+constexpr int32_t kBeamDim = 1;
+constexpr int32_t kLengthDim = 2;
+
+/// Outputs of shape [1, beam, ...]
+std::unordered_set<std::string> const kPerBeamOutputNames{"output_ids", "sequence_length", "cum_log_probs",
+    "output_log_probs", "generation_logits", "generation_top_k_ids", "generation_top_k_log_probs"};
+
+/// Outputs of shape [1, beam, len, ...] padded at the end of their length dimension
+std::unordered_set<std::string> const kPaddedOutputNames{"output_ids", "output_log_probs", "generation_logits",
+    "generation_top_k_ids", "generation_top_k_log_probs"};
+
+/// Copy the leading [numBeams, length] block of each batch entry of a [batch, beam, len, ...] tensor
+NamedTensor slice(NamedTensor const& tensor, int64_t numBeams, int64_t length)
+{
+    auto const shape = tensor.tensor->getShape();
+    std::vector<int64_t> slicedShape(shape.d, shape.d + shape.nbDims);
+    slicedShape[kBeamDim] = numBeams;
+    if (shape.nbDims > kLengthDim)
+    {
+        slicedShape[kLengthDim] = length;
+    }
+
+    size_t const elementSize
+        = tensor.tensor->getSize() > 0 ? tensor.tensor->getSizeInBytes() / tensor.tensor->getSize() : 0;
+    size_t innerSize = elementSize;
+    for (int32_t i = kLengthDim + 1; i < shape.nbDims; ++i)
+    {
+        innerSize *= shape.d[i];
+    }
+    size_t const srcRowSize = shape.nbDims > kLengthDim ? shape.d[kLengthDim] * innerSize : innerSize;
+    size_t const dstRowSize = shape.nbDims > kLengthDim ? length * innerSize : innerSize;
+
+    NamedTensor sliced(tensor.tensor->getDataType(), slicedShape, tensor.name);
+    auto const* src = static_cast<char const*>(tensor.tensor->data());
+    auto* dst = static_cast<char*>(sliced.tensor->data());
+    for (int64_t batch = 0; batch < shape.d[0]; ++batch)
+    {
+        for (int64_t beam = 0; beam < numBeams; ++beam)
+        {
+            std::memcpy(dst + (batch * numBeams + beam) * dstRowSize,
+                src + (batch * shape.d[kBeamDim] + beam) * srcRowSize, dstRowSize);
+        }
+    }
+    return sliced;
+}
+
+} // namespace
+
+std::list<NamedTensor> trimOutputs(
+    std::list<NamedTensor> const& responseTensors, bool trimToSequenceLength, bool topBeamOnly)
+{
+    // Longest sequence of the returned beams and width of output_ids, used as reference for the other outputs
+    std::optional<int64_t> maxSequenceLength;
+    int64_t outputIdsWidth = 0;
+    for (auto const& tensor : responseTensors)
+    {
+        if (tensor.name == "sequence_length" && tensor.tensor->getSize() > 0)
+        {
+            auto const* lengths = static_cast<int32_t const*>(tensor.tensor->data());
+            auto const numBeams = topBeamOnly ? 1 : tensor.tensor->getSize();
+            maxSequenceLength = *std::max_element(lengths, lengths + numBeams);
+        }
+        else if (tensor.name == "output_ids" && tensor.tensor->getShape().nbDims > kLengthDim)
+        {
+            outputIdsWidth = tensor.tensor->getShape().d[kLengthDim];
+        }
+    }
+
+    std::list<NamedTensor> trimmed;
+    for (auto const& tensor : responseTensors)
+    {
+        auto const shape = tensor.tensor->getShape();
+        if (kPerBeamOutputNames.count(tensor.name) == 0 || shape.nbDims <= kBeamDim)
+        {
+            trimmed.push_back(tensor);
+            continue;
+        }
+
+        auto const hasLength = shape.nbDims > kLengthDim;
+        auto const numBeams = topBeamOnly ? std::min<int64_t>(1, shape.d[kBeamDim]) : shape.d[kBeamDim];
+        auto length = hasLength ? shape.d[kLengthDim] : 0;
+        if (trimToSequenceLength && maxSequenceLength && kPaddedOutputNames.count(tensor.name) && hasLength)
+        {
+            // Outputs that exclude the prompt are shorter than output_ids by the prompt length
+            auto const offset = std::max<int64_t>(0, outputIdsWidth - shape.d[kLengthDim]);
+            length = std::clamp<int64_t>(maxSequenceLength.value() - offset, 0, shape.d[kLengthDim]);
+        }
+
+        if (numBeams == shape.d[kBeamDim] && (!hasLength || length == shape.d[kLengthDim]))
+        {
+            trimmed.push_back(tensor);
+        }
+        else
+        {
+            trimmed.push_back(slice(tensor, numBeams, length));
+        }
+    }
+    return trimmed;
+}
+
+} // namespace triton::backend::inflight_batcher_llm
@@ -0,0 +1,95 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "prompt_lookup.h"
+
+#include <algorithm>
+
+namespace triton::backend::inflight_batcher_llm
+{
+
+PromptLookup::PromptLookup(int32_t maxNgramSize)
+    : mMaxNgramSize(std::max(maxNgramSize, 1))
+    , mNgrams(mMaxNgramSize)
+{
+}
+
+void PromptLookup::append(std::vector<int32_t> const& tokens)
+{
+    for (auto const token : tokens)
+    {
+        auto const position = mTokens.size();
+        for (int32_t ngramSize = 1; ngramSize <= mMaxNgramSize && static_cast<size_t>(ngramSize) <= position;
+             ++ngramSize)
+        {
+            mNgrams[ngramSize - 1][hashNgram(position, ngramSize)] = position;
+        }
+        mTokens.push_back(token);
+    }
+}
+
+std::vector<int32_t> PromptLookup::propose(int32_t maxDraftLength) const
+{
+    auto const length = mTokens.size();
+    if (maxDraftLength <= 0)
+    {
+        return {};
+    }
+
+    for (int32_t ngramSize = std::min<int64_t>(mMaxNgramSize, length); ngramSize > 0; --ngramSize)
+    {
+        auto const& ngrams = mNgrams[ngramSize - 1];
+        auto const it = ngrams.find(hashNgram(length, ngramSize));
+        if (it == ngrams.end())
+        {
+            continue;
+        }
+
+        // Skip hash collisions
+        auto const next = it->second;
+        if (!std::equal(mTokens.begin() + (next - ngramSize), mTokens.begin() + next, mTokens.end() - ngramSize))
+        {
+            continue;
+        }
+        auto const end = std::min(next + maxDraftLength, length);
+        return std::vector<int32_t>(mTokens.begin() + next, mTokens.begin() + end);
+    }
+    return {};
+}
+
+uint64_t PromptLookup::hashNgram(size_t end, int32_t ngramSize) const
+{
+    // FNV-1a over the tokens of the n-gram
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = end - ngramSize; i < end; ++i)
+    {
+        hash = (hash ^ static_cast<uint32_t>(mTokens[i])) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+} // namespace triton::backend::inflight_batcher_llm
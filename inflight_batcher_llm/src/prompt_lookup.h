@@ -0,0 +1,63 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace triton::backend::inflight_batcher_llm
+{
+
+/// @brief N-gram index of the tokens of a request (prompt and generated tokens), used to draft tokens without a draft
+/// model. The draft is the continuation of the last earlier occurrence of the longest n-gram ending the sequence,
+/// which is effective when the output copies spans of the prompt (summarization, code editing, RAG).
+class PromptLookup
+{
+public:
+    explicit PromptLookup(int32_t maxNgramSize);
+
+    /// @brief Append tokens to the sequence and index the n-grams they complete
+    void append(std::vector<int32_t> const& tokens);
+
+    /// @brief Propose up to maxDraftLength tokens following the sequence
+    /// @return The draft tokens, empty if no suffix of the sequence occurred earlier
+    std::vector<int32_t> propose(int32_t maxDraftLength) const;
+
+private:
+    uint64_t hashNgram(size_t end, int32_t ngramSize) const;
+
+    int32_t mMaxNgramSize;
+    std::vector<int32_t> mTokens;
+    /// per n-gram size, position following the last occurrence of each n-gram, keyed by n-gram hash.
+    /// The n-grams ending the sequence are only indexed once they are followed by a token.
+    std::vector<std::unordered_map<uint64_t, size_t>> mNgrams;
+};
+
+} // namespace triton::backend::inflight_batcher_llm
@@ -0,0 +1,204 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "prompt_table_cache.h"
+
+#include "utils.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace triton::backend::inflight_batcher_llm
+{
+
+PromptTableCache::PromptTableCache(size_t maxBytes)
+    : mMaxBytes(maxBytes)
+{
+}
+
+std::optional<uint64_t> PromptTableCache::getTableId(InferenceRequest const& inferenceRequest)
+{
+    auto const tableId = inferenceRequest.getInputTensorUnchecked(kPromptEmbeddingTableIdInputTensorName);
+    if (!tableId || !tableId.value())
+    {
+        return std::nullopt;
+    }
+    return *static_cast<uint64_t const*>(tableId.value()->data());
+}
+
+uint64_t PromptTableCache::hashTable(tensorrt_llm::runtime::ITensor const& table)
+{
+    // FNV-1a over the data type, the shape and the content, 8 bytes at a time
+    static constexpr uint64_t kOffsetBasis = 0xcbf29ce484222325ULL;
+    static constexpr uint64_t kPrime = 0x100000001b3ULL;
+
+    uint64_t hash = kOffsetBasis;
+    auto const mix = [&hash](uint64_t word)
+    {
+        hash ^= word;
+        hash *= kPrime;
+    };
+
+    mix(static_cast<uint64_t>(table.getDataType()));
+    auto const& shape = table.getShape();
+    for (int32_t i = 0; i < shape.nbDims; ++i)
+    {
+        mix(static_cast<uint64_t>(shape.d[i]));
+    }
+
+    auto const* data = static_cast<char const*>(table.data());
+    auto const numBytes = table.getSizeInBytes();
+    size_t offset = 0;
+    for (; offset + sizeof(uint64_t) <= numBytes; offset += sizeof(uint64_t))
+    {
+        uint64_t word;
+        std::memcpy(&word, data + offset, sizeof(word));
+        mix(word);
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, data + offset, numBytes - offset);
+    mix(tail);
+    return hash;
+}
+
+PromptTableCache::TensorPtr PromptTableCache::findTable(
+    uint64_t hash, tensorrt_llm::runtime::ITensor const& table) const
+{
+    auto it = mTables.find(hash);
+    if (it == mTables.end())
+    {
+        return nullptr;
+    }
+    auto const& cached = *it->second.tensor;
+    if (cached.getDataType() != table.getDataType() || cached.getSizeInBytes() != table.getSizeInBytes()
+        || cached.getShape().nbDims != table.getShape().nbDims
+        || !std::equal(cached.getShape().d, cached.getShape().d + cached.getShape().nbDims, table.getShape().d)
+        || std::memcmp(cached.data(), table.data(), table.getSizeInBytes()) != 0)
+    {
+        return nullptr;
+    }
+    return it->second.tensor;
+}
+
+void PromptTableCache::releaseTable(uint64_t hash)
+{
+    auto it = mTables.find(hash);
+    if (--it->second.numIds == 0)
+    {
+        mSizeInBytes -= it->second.tensor->getSizeInBytes();
+        mTables.erase(it);
+    }
+}
+
+void PromptTableCache::resolve(InferenceRequest& inferenceRequest)
+{
+    auto const tableId = getTableId(inferenceRequest);
+    if (!tableId)
+    {
+        return;
+    }
+
+    auto const table = inferenceRequest.getPromptEmbeddingTableUnchecked();
+    bool const hasTable = table && table.value();
+    auto const hash = hasTable ? hashTable(*table.value()) : 0;
+
+    {
+        std::lock_guard<std::mutex> lk(mMutex);
+        auto it = mTableIds.find(tableId.value());
+        if (!hasTable)
+        {
+            if (it == mTableIds.end())
+            {
+                throw std::runtime_error("prompt_embedding_table_id " + std::to_string(tableId.value())
+                    + " is not cached, prompt_embedding_table must be provided");
+            }
+            mLruTableIds.splice(mLruTableIds.begin(), mLruTableIds, it->second.second);
+            auto const& cached = mTables.at(it->second.first).tensor;
+            inferenceRequest.setPromptEmbeddingTable(cached);
+            ++mNumHits;
+            mBytesSaved += cached->getSizeInBytes();
+        }
+        else if (auto cached = findTable(hash, *table.value()))
+        {
+            // The content is already cached, share it and let the copy sent with the request go
+            inferenceRequest.setPromptEmbeddingTable(cached);
+            ++mNumHits;
+            if (it == mTableIds.end())
+            {
+                mLruTableIds.push_front(tableId.value());
+                mTableIds.emplace(tableId.value(), std::make_pair(hash, mLruTableIds.begin()));
+                ++mTables.at(hash).numIds;
+            }
+            else
+            {
+                mLruTableIds.splice(mLruTableIds.begin(), mLruTableIds, it->second.second);
+                if (it->second.first != hash)
+                {
+                    ++mTables.at(hash).numIds;
+                    releaseTable(it->second.first);
+                    it->second.first = hash;
+                }
+            }
+        }
+        else if (mTables.find(hash) != mTables.end())
+        {
+            // Hash collision with a different table, serve the request without caching its table
+            TLLM_LOG_WARNING("prompt_embedding_table_id %lu collides with a cached table, it is not cached",
+                tableId.value());
+        }
+        else
+        {
+            // The table provided with the request replaces the cached one, so that clients can update a table in
+            // place
+            if (it != mTableIds.end())
+            {
+                releaseTable(it->second.first);
+                mLruTableIds.erase(it->second.second);
+                mTableIds.erase(it);
+            }
+
+            mLruTableIds.push_front(tableId.value());
+            mTableIds.emplace(tableId.value(), std::make_pair(hash, mLruTableIds.begin()));
+            mTables.emplace(hash, Table{table.value(), 1});
+            mSizeInBytes += table.value()->getSizeInBytes();
+            ++mNumMisses;
+
+            // Always keep the table just inserted, even if it exceeds the budget on its own
+            while (mSizeInBytes > mMaxBytes && mLruTableIds.size() > 1)
+            {
+                auto const evicted = mTableIds.find(mLruTableIds.back());
+                releaseTable(evicted->second.first);
+                mTableIds.erase(evicted);
+                mLruTableIds.pop_back();
+            }
+        }
+    }
+
+    // The engine does not know the id
+    utils::eraseInputTensors(inferenceRequest, {kPromptEmbeddingTableIdInputTensorName});
+}
+
+} // namespace triton::backend::inflight_batcher_llm
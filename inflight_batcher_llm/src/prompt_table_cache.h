@@ -0,0 +1,118 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "tensorrt_llm/batch_manager/inferenceRequest.h"
+#include "tensorrt_llm/runtime/iTensor.h"
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+namespace triton::backend::inflight_batcher_llm
+{
+
+/// @brief Cache of prompt embedding tables, keyed by a client-provided id.
+/// A client sends a table once together with `prompt_embedding_table_id`, later requests only send the id and share
+/// the cached tensor. Tables are stored by content hash, so that identical tables sent under different ids, or sent
+/// again under the same id, are only held once. Ids are evicted in LRU order when the cache exceeds its budget, a
+/// table is released with the last id referencing it.
+/// Every rank resolves the same requests in the same order, so the caches of all ranks hold the same tables and
+/// requests can be broadcast without their table.
+class PromptTableCache
+{
+    using InferenceRequest = tensorrt_llm::batch_manager::InferenceRequest;
+    using TensorPtr = tensorrt_llm::runtime::ITensor::SharedPtr;
+
+public:
+    explicit PromptTableCache(size_t maxBytes);
+
+    /// @brief Get the prompt embedding table id of a request, if any
+    static std::optional<uint64_t> getTableId(InferenceRequest const& inferenceRequest);
+
+    /// @brief Hash of the data type, shape and content of a table
+    static uint64_t hashTable(tensorrt_llm::runtime::ITensor const& table);
+
+    /// @brief Attach the cached table to a request that only provides its id, or cache the table provided with the
+    /// request. The id is removed from the request once resolved. Requests without id are left untouched.
+    /// Throws if the request only provides an id that is not cached.
+    void resolve(InferenceRequest& inferenceRequest);
+
+    /// @brief Number of requests that used a cached table, either by id or because they sent a cached content
+    uint64_t numHits() const
+    {
+        return mNumHits.load();
+    }
+
+    /// @brief Number of tables added to the cache
+    uint64_t numMisses() const
+    {
+        return mNumMisses.load();
+    }
+
+    /// @brief Cumulative size of the tables that did not have to be sent with requests
+    uint64_t bytesSaved() const
+    {
+        return mBytesSaved.load();
+    }
+
+private:
+    struct Table
+    {
+        TensorPtr tensor;
+        /// number of ids referencing the table
+        size_t numIds;
+    };
+
+    /// @brief Find a cached table with the same hash and content. Must be called under mMutex.
+    /// @return nullptr if no such table is cached
+    TensorPtr findTable(uint64_t hash, tensorrt_llm::runtime::ITensor const& table) const;
+
+    /// @brief Drop the reference of an id to its table, releasing the table if unreferenced. Must be called under
+    /// mMutex.
+    void releaseTable(uint64_t hash);
+
+    size_t mMaxBytes;
+
+    std::mutex mMutex;
+    /// table ids, most recently used first
+    std::list<uint64_t> mLruTableIds;
+    /// content hash of the table of each id
+    std::unordered_map<uint64_t, std::pair<uint64_t, std::list<uint64_t>::iterator>> mTableIds;
+    /// tables, per content hash
+    std::unordered_map<uint64_t, Table> mTables;
+    size_t mSizeInBytes{0};
+
+    std::atomic<uint64_t> mNumHits{0};
+    std::atomic<uint64_t> mNumMisses{0};
+    std::atomic<uint64_t> mBytesSaved{0};
+};
+
+} // namespace triton::backend::inflight_batcher_llm
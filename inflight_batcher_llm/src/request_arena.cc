@@ -0,0 +1,341 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "request_arena.h"
+
+#include "utils.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+namespace triton::backend::inflight_batcher_llm
+{
+
+namespace
+{
+
+using tensorrt_llm::runtime::BufferManager;
+using tensorrt_llm::runtime::ITensor;
+
+/// @brief Pool of arena blocks in power-of-two size classes. Blocks released by any thread are reused by the next
+/// arenas instead of going back to malloc, whose per-thread caches do not help when blocks are allocated and freed
+/// by different threads. Each thread keeps a few small blocks of its own and exchanges them with the shared lists in
+/// batches, so that the threads converting requests and the ones releasing them rarely take the lock. The shared
+/// lists are bounded in bytes and the blocks that stayed unused in them for a trim interval are freed.
+class BlockPool
+{
+public:
+    static BlockPool& instance()
+    {
+        // Never destroyed, arenas may be released after the static destructors ran
+        static auto* pool = new BlockPool();
+        return *pool;
+    }
+
+    /// @brief Take a block of at least the given capacity, which is rounded up to the size of the block
+    char* acquire(size_t& capacity)
+    {
+        auto const sizeClass = getSizeClass(capacity);
+        if (sizeClass >= kNumSizeClasses)
+        {
+            return static_cast<char*>(::operator new(capacity));
+        }
+        capacity = kMinBlockBytes << sizeClass;
+        if (auto* cache = threadCache(sizeClass))
+        {
+            if (cache->empty())
+            {
+                // refill half of the cache so that the next releases fit too
+                auto const numBlocks = threadCacheCapacity(sizeClass) / 2;
+                cache->resize(numBlocks);
+                cache->resize(take(sizeClass, cache->data(), numBlocks));
+            }
+            if (!cache->empty())
+            {
+                auto* data = cache->back();
+                cache->pop_back();
+                return data;
+            }
+        }
+        else
+        {
+            char* data = nullptr;
+            if (take(sizeClass, &data, 1) == 1)
+            {
+                return data;
+            }
+        }
+        return static_cast<char*>(::operator new(capacity));
+    }
+
+    void release(char* data, size_t capacity)
+    {
+        auto const sizeClass = getSizeClass(capacity);
+        if (sizeClass >= kNumSizeClasses)
+        {
+            ::operator delete(data);
+            return;
+        }
+        if (auto* cache = threadCache(sizeClass))
+        {
+            auto const cacheCapacity = threadCacheCapacity(sizeClass);
+            if (cache->size() == cacheCapacity)
+            {
+                // hand over half of the cache so that the next acquisitions hit too
+                auto const numKept = cacheCapacity / 2;
+                give(sizeClass, cache->data() + numKept, cacheCapacity - numKept);
+                cache->resize(numKept);
+            }
+            cache->push_back(data);
+            return;
+        }
+        give(sizeClass, &data, 1);
+    }
+
+    size_t getPooledBytes()
+    {
+        std::lock_guard<std::mutex> lk(mMutex);
+        return mPooledBytes;
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // 4 KiB to 1 MiB blocks, larger arenas are allocated and freed directly
+    static constexpr size_t kMinBlockBytes = 4096;
+    static constexpr size_t kNumSizeClasses = 9;
+    // The blocks of up to 32 KiB, i.e. the arenas of most requests, are cached per thread, up to 64 KiB per class
+    static constexpr size_t kNumThreadCachedSizeClasses = 4;
+    static constexpr size_t kThreadCacheBytes = 64 * 1024;
+    static constexpr size_t kMaxPooledBytes = 16 * 1024 * 1024;
+    static constexpr auto kTrimInterval = std::chrono::seconds(1);
+
+    /// @brief Blocks kept by a thread for the small size classes, returned to the shared lists when the thread exits
+    struct ThreadCache
+    {
+        std::array<std::vector<char*>, kNumThreadCachedSizeClasses> blocks;
+
+        ThreadCache()
+        {
+            for (size_t sizeClass = 0; sizeClass < blocks.size(); ++sizeClass)
+            {
+                blocks[sizeClass].reserve(threadCacheCapacity(sizeClass));
+            }
+        }
+
+        ~ThreadCache()
+        {
+            for (size_t sizeClass = 0; sizeClass < blocks.size(); ++sizeClass)
+            {
+                BlockPool::instance().give(sizeClass, blocks[sizeClass].data(), blocks[sizeClass].size());
+            }
+            destroyed() = true;
+        }
+
+        // Trivially destructible, so that arenas released by later thread or static destructors still read it
+        static bool& destroyed()
+        {
+            thread_local bool flag = false;
+            return flag;
+        }
+    };
+
+    BlockPool()
+        : mLastTrim(Clock::now())
+    {
+        mLowWater.fill(0);
+    }
+
+    /// @return nullptr if the size class is not cached per thread or the cache of the thread is gone
+    static std::vector<char*>* threadCache(size_t sizeClass)
+    {
+        if (sizeClass >= kNumThreadCachedSizeClasses || ThreadCache::destroyed())
+        {
+            return nullptr;
+        }
+        thread_local ThreadCache cache;
+        return &cache.blocks[sizeClass];
+    }
+
+    static constexpr size_t threadCacheCapacity(size_t sizeClass)
+    {
+        return kThreadCacheBytes / (kMinBlockBytes << sizeClass);
+    }
+
+    /// @brief Move up to the given number of blocks from the shared list of a size class
+    /// @return the number of blocks moved
+    size_t take(size_t sizeClass, char** blocks, size_t numBlocks)
+    {
+        std::vector<char*> unusedBlocks;
+        {
+            std::lock_guard<std::mutex> lk(mMutex);
+            auto& freeBlocks = mFreeBlocks[sizeClass];
+            numBlocks = std::min(numBlocks, freeBlocks.size());
+            std::copy(freeBlocks.end() - numBlocks, freeBlocks.end(), blocks);
+            freeBlocks.resize(freeBlocks.size() - numBlocks);
+            mPooledBytes -= numBlocks * (kMinBlockBytes << sizeClass);
+            mLowWater[sizeClass] = std::min(mLowWater[sizeClass], freeBlocks.size());
+            unusedBlocks = trim();
+        }
+        for (auto* data : unusedBlocks)
+        {
+            ::operator delete(data);
+        }
+        return numBlocks;
+    }
+
+    /// @brief Move blocks to the shared list of a size class, freeing the ones exceeding the byte budget of the pool
+    void give(size_t sizeClass, char* const* blocks, size_t numBlocks)
+    {
+        auto const blockBytes = kMinBlockBytes << sizeClass;
+        size_t numKept = 0;
+        std::vector<char*> unusedBlocks;
+        {
+            std::lock_guard<std::mutex> lk(mMutex);
+            auto& freeBlocks = mFreeBlocks[sizeClass];
+            while (numKept < numBlocks && mPooledBytes + blockBytes <= kMaxPooledBytes)
+            {
+                freeBlocks.push_back(blocks[numKept++]);
+                mPooledBytes += blockBytes;
+            }
+            unusedBlocks = trim();
+        }
+        for (auto* data : unusedBlocks)
+        {
+            ::operator delete(data);
+        }
+        for (size_t i = numKept; i < numBlocks; ++i)
+        {
+            ::operator delete(blocks[i]);
+        }
+    }
+
+    /// @brief Once per interval, remove from the shared lists the blocks that none of the acquisitions of the
+    /// interval needed. Called with the lock held, the blocks are freed by the caller after releasing it.
+    std::vector<char*> trim()
+    {
+        std::vector<char*> unusedBlocks;
+        auto const now = Clock::now();
+        if (now - mLastTrim < kTrimInterval)
+        {
+            return unusedBlocks;
+        }
+        mLastTrim = now;
+        for (size_t sizeClass = 0; sizeClass < kNumSizeClasses; ++sizeClass)
+        {
+            auto& freeBlocks = mFreeBlocks[sizeClass];
+            auto const numUnused = mLowWater[sizeClass];
+            unusedBlocks.insert(unusedBlocks.end(), freeBlocks.end() - numUnused, freeBlocks.end());
+            freeBlocks.resize(freeBlocks.size() - numUnused);
+            mPooledBytes -= numUnused * (kMinBlockBytes << sizeClass);
+            mLowWater[sizeClass] = freeBlocks.size();
+        }
+        return unusedBlocks;
+    }
+
+    static size_t getSizeClass(size_t capacity)
+    {
+        size_t sizeClass = 0;
+        while (sizeClass < kNumSizeClasses && (kMinBlockBytes << sizeClass) < capacity)
+        {
+            ++sizeClass;
+        }
+        return sizeClass;
+    }
+
+    std::mutex mMutex;
+    std::array<std::vector<char*>, kNumSizeClasses> mFreeBlocks;
+    // Smallest size of each shared list since the last trim, i.e. the number of its blocks nobody needed
+    std::array<size_t, kNumSizeClasses> mLowWater;
+    size_t mPooledBytes{0};
+    Clock::time_point mLastTrim;
+};
+
+size_t alignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+size_t RequestArena::tensorBytes(size_t sizeInBytes)
+{
+    return alignUp(sizeInBytes, alignof(std::max_align_t)) + kObjectBytes;
+}
+
+size_t RequestArena::getPooledBytes()
+{
+    return BlockPool::instance().getPooledBytes();
+}
+
+std::shared_ptr<RequestArena> RequestArena::create(size_t capacity)
+{
+    auto* data = BlockPool::instance().acquire(capacity);
+    return std::make_shared<RequestArena>(data, capacity);
+}
+
+ITensor::SharedPtr RequestArena::allocateTensor(
+    std::shared_ptr<RequestArena> const& arena, nvinfer1::DataType dataType, ITensor::Shape const& shape)
+{
+    auto const volume = ITensor::volume(shape);
+    auto const sizeInBytes
+        = static_cast<size_t>(volume) * TRITONSERVER_DataTypeByteSize(utils::to_triton_datatype(dataType));
+    auto* data = arena->allocate(sizeInBytes);
+    if (data == nullptr)
+    {
+        return BufferManager::cpu(shape, dataType);
+    }
+    auto tensor = ITensor::wrap(data, dataType, shape, volume);
+    // The control block is placed in the arena too, the allocator holds the reference to the arena
+    return ITensor::SharedPtr(tensor.release(), std::default_delete<ITensor>(), Allocator<ITensor>(arena));
+}
+
+RequestArena::RequestArena(char* data, size_t capacity)
+    : mData(data)
+    , mCapacity(capacity)
+{
+}
+
+RequestArena::~RequestArena()
+{
+    BlockPool::instance().release(mData, mCapacity);
+}
+
+void* RequestArena::allocate(size_t numBytes, size_t alignment)
+{
+    auto const offset = alignUp(mOffset, alignment);
+    if (offset + numBytes > mCapacity)
+    {
+        return nullptr;
+    }
+    mOffset = offset + numBytes;
+    return mData + offset;
+}
+
+} // namespace triton::backend::inflight_batcher_llm
@@ -0,0 +1,145 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "NvInfer.h"
+#include "tensorrt_llm/runtime/iTensor.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+
+namespace triton::backend::inflight_batcher_llm
+{
+
+/// @brief Contiguous host block holding the input tensors of a request, the control blocks of their shared pointers
+/// and the request itself. The block is released in one operation once the last of them is destroyed, i.e. when the
+/// request is complete, and is recycled for the next requests by a pool shared between the threads converting the
+/// requests and the ones releasing them, which keeps at most 16 MiB of unused blocks. An arena is filled by a single
+/// thread.
+class RequestArena
+{
+public:
+    using ITensor = tensorrt_llm::runtime::ITensor;
+
+    /// @brief Allocator placing objects, e.g. with std::allocate_shared, in an arena. Objects that do not fit
+    /// anymore are allocated on the heap. The allocator keeps the arena alive.
+    template <typename T>
+    class Allocator
+    {
+    public:
+        using value_type = T;
+
+        explicit Allocator(std::shared_ptr<RequestArena> arena)
+            : mArena(std::move(arena))
+        {
+        }
+
+        template <typename U>
+        Allocator(Allocator<U> const& other)
+            : mArena(other.arena())
+        {
+        }
+
+        T* allocate(size_t n)
+        {
+            if (void* p = mArena->allocate(n * sizeof(T), alignof(T)))
+            {
+                return static_cast<T*>(p);
+            }
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        }
+
+        void deallocate(T* p, size_t)
+        {
+            // memory of the arena is released with the arena
+            if (!mArena->owns(p))
+            {
+                ::operator delete(p);
+            }
+        }
+
+        std::shared_ptr<RequestArena> const& arena() const
+        {
+            return mArena;
+        }
+
+        template <typename U>
+        bool operator==(Allocator<U> const& other) const
+        {
+            return mArena == other.arena();
+        }
+
+        template <typename U>
+        bool operator!=(Allocator<U> const& other) const
+        {
+            return mArena != other.arena();
+        }
+
+    private:
+        std::shared_ptr<RequestArena> mArena;
+    };
+
+    /// Bytes reserved per object allocated in an arena, e.g. for the control block of a shared pointer
+    static constexpr size_t kObjectBytes = 64;
+
+    /// @brief Bytes to reserve in an arena for a tensor of the given size and the control block of its pointer
+    static size_t tensorBytes(size_t sizeInBytes);
+
+    /// @brief Create an arena of at least the given capacity, taking its block from the pool if possible
+    static std::shared_ptr<RequestArena> create(size_t capacity);
+
+    /// @brief Bytes of the blocks kept by the shared pool for the next arenas, not counting the few small blocks
+    /// cached by each thread
+    static size_t getPooledBytes();
+
+    /// @brief Uninitialized tensor placed in an arena. Tensors that do not fit anymore are allocated on the heap.
+    static ITensor::SharedPtr allocateTensor(
+        std::shared_ptr<RequestArena> const& arena, nvinfer1::DataType dataType, ITensor::Shape const& shape);
+
+    RequestArena(char* data, size_t capacity);
+    ~RequestArena();
+
+    RequestArena(RequestArena const&) = delete;
+    RequestArena& operator=(RequestArena const&) = delete;
+
+    /// @return nullptr if the arena is full
+    void* allocate(size_t numBytes, size_t alignment = alignof(std::max_align_t));
+
+    bool owns(void const* p) const
+    {
+        return p >= mData && p < mData + mCapacity;
+    }
+
+private:
+    char* mData;
+    size_t mCapacity;
+    size_t mOffset{0};
+};
+
+} // namespace triton::backend::inflight_batcher_llm
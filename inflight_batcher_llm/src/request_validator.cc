@@ -0,0 +1,346 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "request_validator.h"
+
+#include "sampling_params.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace triton::backend::inflight_batcher_llm
+{
+
+/// @brief Inputs of a request checked against the limits of the engine, read from an InferenceRequest or from the
+/// buffers of a Triton request
+struct RequestValidator::RequestInputs
+{
+    uint64_t requestId = 0;
+    int64_t inputLength = 0;
+    // buffers holding the input ids with their number of ids, empty if the ids are not checked
+    std::vector<std::pair<void const*, size_t>> inputIdsBuffers;
+    bool inputIdsAreInt64 = false;
+    std::optional<int64_t> maxNewTokens;
+    std::optional<int64_t> beamWidth;
+    std::optional<int64_t> promptVocabSize;
+    bool hasPromptEmbeddingTableId = false;
+};
+
+namespace
+{
+
+namespace inference_request = tensorrt_llm::batch_manager::inference_request;
+
+std::optional<int64_t> getInt32Scalar(
+    tensorrt_llm::batch_manager::InferenceRequest const& inferenceRequest, std::string const& name)
+{
+    auto const value = SamplingParams::getScalar<int32_t>(inferenceRequest, name);
+    return value ? std::optional<int64_t>(value.value()) : std::nullopt;
+}
+
+/// @brief Input of a Triton request read by the validator
+struct TritonInput
+{
+    TRITONBACKEND_Input* input = nullptr;
+    TRITONSERVER_DataType dataType = TRITONSERVER_TYPE_INVALID;
+    int64_t numElements = 0;
+    uint32_t bufferCount = 0;
+};
+
+/// @brief Host buffer of an input, nullptr if it is in device memory
+void const* getTritonInputBuffer(TritonInput const& in, uint32_t bufferId, uint64_t& byteSize)
+{
+    void const* buffer = nullptr;
+    byteSize = 0;
+    TRITONSERVER_MemoryType memoryType = TRITONSERVER_MEMORY_CPU;
+    int64_t memoryTypeId = 0;
+    TRITONBACKEND_InputBuffer(in.input, bufferId, &buffer, &byteSize, &memoryType, &memoryTypeId);
+    if (memoryType != TRITONSERVER_MEMORY_CPU && memoryType != TRITONSERVER_MEMORY_CPU_PINNED)
+    {
+        return nullptr;
+    }
+    return buffer;
+}
+
+template <typename T>
+std::optional<int64_t> readScalar(void const* buffer, uint64_t byteSize)
+{
+    if (byteSize < sizeof(T))
+    {
+        return std::nullopt;
+    }
+    T value;
+    std::memcpy(&value, buffer, sizeof(T));
+    if constexpr (std::is_same_v<T, uint64_t>)
+    {
+        return static_cast<int64_t>(std::min<uint64_t>(value, std::numeric_limits<int64_t>::max()));
+    }
+    return static_cast<int64_t>(value);
+}
+
+/// @brief First element of an integer input, std::nullopt if it cannot be read before the conversion of the inputs,
+/// which reports the invalid ones
+std::optional<int64_t> getTritonScalar(std::optional<TritonInput> const& in)
+{
+    if (!in || in->numElements < 1 || in->bufferCount == 0)
+    {
+        return std::nullopt;
+    }
+    uint64_t byteSize = 0;
+    auto const* buffer = getTritonInputBuffer(in.value(), 0, byteSize);
+    if (buffer == nullptr)
+    {
+        return std::nullopt;
+    }
+    switch (in->dataType)
+    {
+    case TRITONSERVER_TYPE_INT8: return readScalar<int8_t>(buffer, byteSize);
+    case TRITONSERVER_TYPE_UINT8: return readScalar<uint8_t>(buffer, byteSize);
+    case TRITONSERVER_TYPE_INT16: return readScalar<int16_t>(buffer, byteSize);
+    case TRITONSERVER_TYPE_UINT16: return readScalar<uint16_t>(buffer, byteSize);
+    case TRITONSERVER_TYPE_INT32: return readScalar<int32_t>(buffer, byteSize);
+    case TRITONSERVER_TYPE_UINT32: return readScalar<uint32_t>(buffer, byteSize);
+    case TRITONSERVER_TYPE_INT64: return readScalar<int64_t>(buffer, byteSize);
+    case TRITONSERVER_TYPE_UINT64: return readScalar<uint64_t>(buffer, byteSize);
+    default: return std::nullopt;
+    }
+}
+
+/// @brief Smallest and largest token ids. The branch-free loop is vectorized by the compiler, unlike
+/// std::minmax_element.
+template <typename T>
+std::pair<T, T> getMinMax(T const* ids, size_t numIds)
+{
+    T minId = std::numeric_limits<T>::max();
+    T maxId = std::numeric_limits<T>::min();
+    for (size_t i = 0; i < numIds; ++i)
+    {
+        minId = std::min(minId, ids[i]);
+        maxId = std::max(maxId, ids[i]);
+    }
+    return {minId, maxId};
+}
+
+/// @brief Position and value of the first id outside of [0, idsEnd) in the buffers
+template <typename T>
+std::optional<std::pair<size_t, int64_t>> findInvalidId(
+    std::vector<std::pair<void const*, size_t>> const& buffers, int64_t idsEnd)
+{
+    size_t offset = 0;
+    for (auto const& [data, numIds] : buffers)
+    {
+        auto const* ids = static_cast<T const*>(data);
+        auto const [minId, maxId] = getMinMax(ids, numIds);
+        if (minId < 0 || maxId >= idsEnd)
+        {
+            auto const position
+                = std::find_if(ids, ids + numIds, [idsEnd](T id) { return id < 0 || id >= idsEnd; }) - ids;
+            return std::make_pair(offset + position, static_cast<int64_t>(ids[position]));
+        }
+        offset += numIds;
+    }
+    return std::nullopt;
+}
+
+std::string requestPrefix(uint64_t requestId)
+{
+    return "request " + std::to_string(requestId) + ": ";
+}
+
+} // namespace
+
+RequestValidator::RequestValidator(EngineLimits limits)
+    : mLimits(std::move(limits))
+{
+}
+
+void RequestValidator::validate(InferenceRequest const& inferenceRequest)
+{
+    auto const inputIds = inferenceRequest.getInputTensorUnchecked(inference_request::kInputIdsTensorName);
+    if (!inputIds || !inputIds.value())
+    {
+        // the engine reports the missing input
+        return;
+    }
+    auto const& inputIdsTensor = *inputIds.value();
+
+    RequestInputs inputs;
+    inputs.requestId = inferenceRequest.getRequestId();
+    inputs.inputLength = static_cast<int64_t>(inputIdsTensor.getSize());
+    if (inputIdsTensor.getDataType() == nvinfer1::DataType::kINT32
+        || inputIdsTensor.getDataType() == nvinfer1::DataType::kINT64)
+    {
+        inputs.inputIdsBuffers.emplace_back(inputIdsTensor.data(), inputIdsTensor.getSize());
+        inputs.inputIdsAreInt64 = inputIdsTensor.getDataType() == nvinfer1::DataType::kINT64;
+    }
+    inputs.maxNewTokens = getInt32Scalar(inferenceRequest, inference_request::kMaxNewTokensTensorName);
+    inputs.beamWidth = getInt32Scalar(inferenceRequest, inference_request::kBeamWidthTensorName);
+    inputs.promptVocabSize = getInt32Scalar(inferenceRequest, inference_request::kPromptVocabSizeName);
+    inputs.hasPromptEmbeddingTableId
+        = inferenceRequest.getInputTensorUnchecked(kPromptEmbeddingTableIdInputTensorName).has_value();
+    validate(inputs);
+}
+
+void RequestValidator::validate(TRITONBACKEND_Request* request, uint64_t requestId)
+{
+    // The inputs are looked up in a single pass, missing inputs are not errors
+    std::optional<TritonInput> inputIds;
+    std::optional<TritonInput> maxNewTokens;
+    std::optional<TritonInput> beamWidth;
+    std::optional<TritonInput> promptVocabSize;
+    bool hasPromptEmbeddingTableId = false;
+
+    uint32_t numInputs = 0;
+    LOG_IF_ERROR(TRITONBACKEND_RequestInputCount(request, &numInputs), "Error getting input count");
+    for (uint32_t idx = 0; idx < numInputs; ++idx)
+    {
+        TritonInput in;
+        char const* name = nullptr;
+        int64_t const* shape = nullptr;
+        uint32_t dimsCount = 0;
+        TRITONBACKEND_RequestInputByIndex(request, idx, &in.input);
+        TRITONBACKEND_InputProperties(in.input, &name, &in.dataType, &shape, &dimsCount, nullptr, &in.bufferCount);
+        in.numElements = 1;
+        for (uint32_t dim = 0; dim < dimsCount; ++dim)
+        {
+            in.numElements *= shape[dim];
+        }
+
+        std::string_view const inputName(name);
+        if (inputName == inference_request::kInputIdsTensorName)
+        {
+            inputIds = in;
+        }
+        else if (inputName == inference_request::kMaxNewTokensTensorName)
+        {
+            maxNewTokens = in;
+        }
+        else if (inputName == inference_request::kBeamWidthTensorName)
+        {
+            beamWidth = in;
+        }
+        else if (inputName == inference_request::kPromptVocabSizeName)
+        {
+            promptVocabSize = in;
+        }
+        else if (inputName == kPromptEmbeddingTableIdInputTensorName)
+        {
+            hasPromptEmbeddingTableId = true;
+        }
+    }
+    if (!inputIds)
+    {
+        // the engine reports the missing input
+        return;
+    }
+
+    RequestInputs inputs;
+    inputs.requestId = requestId;
+    inputs.inputLength = inputIds->numElements;
+    if (inputIds->dataType == TRITONSERVER_TYPE_INT32 || inputIds->dataType == TRITONSERVER_TYPE_INT64)
+    {
+        inputs.inputIdsAreInt64 = inputIds->dataType == TRITONSERVER_TYPE_INT64;
+        auto const idSize = inputs.inputIdsAreInt64 ? sizeof(int64_t) : sizeof(int32_t);
+        for (uint32_t bufferId = 0; bufferId < inputIds->bufferCount; ++bufferId)
+        {
+            uint64_t byteSize = 0;
+            auto const* buffer = getTritonInputBuffer(inputIds.value(), bufferId, byteSize);
+            if (buffer == nullptr)
+            {
+                // the ids in device memory are not checked
+                inputs.inputIdsBuffers.clear();
+                break;
+            }
+            inputs.inputIdsBuffers.emplace_back(buffer, byteSize / idSize);
+        }
+    }
+    inputs.maxNewTokens = getTritonScalar(maxNewTokens);
+    inputs.beamWidth = getTritonScalar(beamWidth);
+    inputs.promptVocabSize = getTritonScalar(promptVocabSize);
+    inputs.hasPromptEmbeddingTableId = hasPromptEmbeddingTableId;
+    validate(inputs);
+}
+
+void RequestValidator::validate(RequestInputs const& inputs)
+{
+    auto const inputLength = inputs.inputLength;
+    if (mLimits.maxInputLen && inputLength > mLimits.maxInputLen.value())
+    {
+        ++mNumInputLengthRejections;
+        throw std::invalid_argument(requestPrefix(inputs.requestId) + "input length " + std::to_string(inputLength)
+            + " exceeds the max_input_len " + std::to_string(mLimits.maxInputLen.value()) + " of the engine");
+    }
+
+    auto const& outputLength = inputs.maxNewTokens;
+    if (mLimits.maxSequenceLen && outputLength && inputLength + outputLength.value() > mLimits.maxSequenceLen.value())
+    {
+        ++mNumSequenceLengthRejections;
+        throw std::invalid_argument(requestPrefix(inputs.requestId) + "input length " + std::to_string(inputLength)
+            + " plus request_output_len " + std::to_string(outputLength.value()) + " exceeds the max_seq_len "
+            + std::to_string(mLimits.maxSequenceLen.value()) + " of the engine");
+    }
+
+    auto const& beamWidth = inputs.beamWidth;
+    if (mLimits.maxBeamWidth && beamWidth && beamWidth.value() > mLimits.maxBeamWidth.value())
+    {
+        ++mNumBeamWidthRejections;
+        throw std::invalid_argument(requestPrefix(inputs.requestId) + "beam_width " + std::to_string(beamWidth.value())
+            + " exceeds the max_beam_width " + std::to_string(mLimits.maxBeamWidth.value()));
+    }
+
+    if (mLimits.vocabSize && !inputs.inputIdsBuffers.empty())
+    {
+        // Prompt tuning maps the rows of the prompt table to the ids that follow the vocabulary. The size of a
+        // table referenced by id is only known once the table is resolved.
+        int64_t idsEnd = mLimits.vocabSize.value();
+        if (inputs.promptVocabSize)
+        {
+            idsEnd += inputs.promptVocabSize.value();
+        }
+        else if (inputs.hasPromptEmbeddingTableId)
+        {
+            idsEnd = std::numeric_limits<int32_t>::max() + int64_t{1};
+        }
+
+        auto const invalidId = inputs.inputIdsAreInt64 ? findInvalidId<int64_t>(inputs.inputIdsBuffers, idsEnd)
+                                                       : findInvalidId<int32_t>(inputs.inputIdsBuffers, idsEnd);
+        if (invalidId)
+        {
+            ++mNumTokenIdRejections;
+            auto const [position, id] = invalidId.value();
+            throw std::invalid_argument(requestPrefix(inputs.requestId) + "input_ids[" + std::to_string(position)
+                + "] = " + std::to_string(id) + " is outside of the vocabulary of size " + std::to_string(idsEnd));
+        }
+    }
+}
+
+} // namespace triton::backend::inflight_batcher_llm
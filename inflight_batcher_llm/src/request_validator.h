@@ -0,0 +1,111 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "triton/core/tritonbackend.h"
+
+#include "tensorrt_llm/batch_manager/inferenceRequest.h"
+
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace triton::backend::inflight_batcher_llm
+{
+
+/// @brief Limits of an engine that a request must satisfy, read from its config.json by EngineConfig. Limits missing
+/// from the configuration are not checked.
+struct EngineLimits
+{
+    std::optional<int32_t> maxInputLen;
+    // max_seq_len of the engine, or max_input_len + max_output_len for the engines built before it was added
+    std::optional<int32_t> maxSequenceLen;
+    std::optional<int32_t> maxBeamWidth;
+    std::optional<int32_t> vocabSize;
+};
+
+/// @brief Checks the requests against the limits of the engine when they are queued, so that invalid requests are
+/// rejected before they are copied, scheduled or sent to the workers instead of failing inside the engine
+class RequestValidator
+{
+    using InferenceRequest = tensorrt_llm::batch_manager::InferenceRequest;
+
+public:
+    explicit RequestValidator(EngineLimits limits);
+
+    /// @brief Check the input length, requested sequence length, input token ids and beam width of a request.
+    /// Throws a std::invalid_argument describing the first violated limit.
+    void validate(InferenceRequest const& inferenceRequest);
+
+    /// @brief Check a Triton request from the properties and buffers of its inputs, before its inputs are copied into
+    /// an InferenceRequest. Same checks and errors as for an InferenceRequest.
+    void validate(TRITONBACKEND_Request* request, uint64_t requestId);
+
+    EngineLimits const& limits() const
+    {
+        return mLimits;
+    }
+
+    /// @brief Number of requests whose input is longer than max_input_len
+    uint64_t numInputLengthRejections() const
+    {
+        return mNumInputLengthRejections.load();
+    }
+
+    /// @brief Number of requests whose input and requested output are longer than max_seq_len
+    uint64_t numSequenceLengthRejections() const
+    {
+        return mNumSequenceLengthRejections.load();
+    }
+
+    /// @brief Number of requests with a token id that is negative or not in the vocabulary
+    uint64_t numTokenIdRejections() const
+    {
+        return mNumTokenIdRejections.load();
+    }
+
+    /// @brief Number of requests whose beam width is above max_beam_width
+    uint64_t numBeamWidthRejections() const
+    {
+        return mNumBeamWidthRejections.load();
+    }
+
+private:
+    struct RequestInputs;
+
+    void validate(RequestInputs const& inputs);
+
+    EngineLimits mLimits;
+
+    std::atomic<uint64_t> mNumInputLengthRejections{0};
+    std::atomic<uint64_t> mNumSequenceLengthRejections{0};
+    std::atomic<uint64_t> mNumTokenIdRejections{0};
+    std::atomic<uint64_t> mNumBeamWidthRejections{0};
+};
+
+} // namespace triton::backend::inflight_batcher_llm
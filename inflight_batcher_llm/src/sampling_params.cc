@@ -0,0 +1,206 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "sampling_params.h"
+#include "utils.h"
+
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+namespace triton::backend::inflight_batcher_llm
+{
+
+namespace
+{
+
+namespace inference_request = tensorrt_llm::batch_manager::inference_request;
+using NamedTensor = tensorrt_llm::batch_manager::NamedTensor;
+
+static_assert(std::is_trivially_copyable_v<SamplingParams>);
+static_assert(sizeof(SamplingParams) % sizeof(int64_t) == 0, "the block is stored as int64 words");
+
+struct Field
+{
+    char const* name;
+    nvinfer1::DataType dataType;
+    size_t offset;
+};
+
+// The position of a field is its bit in the presence mask
+Field const kFields[] = {
+    {inference_request::kBeamWidthTensorName, nvinfer1::DataType::kINT32, offsetof(SamplingParams, beamWidth)},
+    {inference_request::kRuntimeTopKTensorName, nvinfer1::DataType::kINT32, offsetof(SamplingParams, runtimeTopK)},
+    {inference_request::kMinLengthTensorName, nvinfer1::DataType::kINT32, offsetof(SamplingParams, minLength)},
+    {inference_request::kEndIdTensorName, nvinfer1::DataType::kINT32, offsetof(SamplingParams, endId)},
+    {inference_request::kPadIdTensorName, nvinfer1::DataType::kINT32, offsetof(SamplingParams, padId)},
+    {inference_request::kTemperatureTensorName, nvinfer1::DataType::kFLOAT, offsetof(SamplingParams, temperature)},
+    {inference_request::kRuntimeTopPTensorName, nvinfer1::DataType::kFLOAT, offsetof(SamplingParams, runtimeTopP)},
+    {inference_request::kLengthPenaltyTensorName, nvinfer1::DataType::kFLOAT, offsetof(SamplingParams, lenPenalty)},
+    {inference_request::kRepetitionPenaltyTensorName, nvinfer1::DataType::kFLOAT,
+        offsetof(SamplingParams, repetitionPenalty)},
+    {inference_request::kPresencePenaltyTensorName, nvinfer1::DataType::kFLOAT,
+        offsetof(SamplingParams, presencePenalty)},
+    {inference_request::kFrequencyPenaltyTensorName, nvinfer1::DataType::kFLOAT,
+        offsetof(SamplingParams, frequencyPenalty)},
+    {inference_request::kRandomSeedTensorName, nvinfer1::DataType::kINT64, offsetof(SamplingParams, randomSeed)},
+};
+
+static_assert(sizeof(kFields) / sizeof(Field) <= 32, "the presence mask has 32 bits");
+
+template <typename T>
+constexpr nvinfer1::DataType dataTypeOf()
+{
+    if constexpr (std::is_same_v<T, int32_t>)
+    {
+        return nvinfer1::DataType::kINT32;
+    }
+    else if constexpr (std::is_same_v<T, int64_t>)
+    {
+        return nvinfer1::DataType::kINT64;
+    }
+    else if constexpr (std::is_same_v<T, float>)
+    {
+        return nvinfer1::DataType::kFLOAT;
+    }
+    else
+    {
+        static_assert(std::is_same_v<T, bool>);
+        return nvinfer1::DataType::kBOOL;
+    }
+}
+
+} // namespace
+
+std::string const SamplingParams::kTensorName = "sampling_params";
+
+void* SamplingParams::slot(std::string const& name, nvinfer1::DataType dataType, int64_t numElements)
+{
+    if (numElements != 1)
+    {
+        return nullptr;
+    }
+    for (uint32_t i = 0; i < sizeof(kFields) / sizeof(Field); ++i)
+    {
+        if (kFields[i].dataType == dataType && name == kFields[i].name)
+        {
+            presentMask |= 1u << i;
+            return reinterpret_cast<char*>(this) + kFields[i].offset;
+        }
+    }
+    return nullptr;
+}
+
+void const* SamplingParams::find(std::string const& name, nvinfer1::DataType dataType) const
+{
+    for (uint32_t i = 0; i < sizeof(kFields) / sizeof(Field); ++i)
+    {
+        if ((presentMask & (1u << i)) && kFields[i].dataType == dataType && name == kFields[i].name)
+        {
+            return reinterpret_cast<char const*>(this) + kFields[i].offset;
+        }
+    }
+    return nullptr;
+}
+
+void SamplingParams::store(InferenceRequest& inferenceRequest, std::shared_ptr<RequestArena> const& arena) const
+{
+    auto const numWords = static_cast<int64_t>(sizeof(SamplingParams) / sizeof(int64_t));
+    if (!arena)
+    {
+        NamedTensor block(nvinfer1::DataType::kINT64, {1, numWords}, kTensorName, this);
+        inferenceRequest.emplaceInputTensor(block.name, std::move(block.tensor));
+        return;
+    }
+    auto block = RequestArena::allocateTensor(
+        arena, nvinfer1::DataType::kINT64, tensorrt_llm::runtime::ITensor::makeShape({1, numWords}));
+    std::memcpy(block->data(), this, sizeof(SamplingParams));
+    inferenceRequest.emplaceInputTensor(kTensorName, std::move(block));
+}
+
+std::optional<SamplingParams> SamplingParams::load(InferenceRequest const& inferenceRequest)
+{
+    auto const tensor = inferenceRequest.getInputTensorUnchecked(kTensorName);
+    if (!tensor || !tensor.value() || tensor.value()->getSizeInBytes() != sizeof(SamplingParams))
+    {
+        return std::nullopt;
+    }
+    SamplingParams params;
+    std::memcpy(&params, tensor.value()->data(), sizeof(SamplingParams));
+    return params;
+}
+
+void SamplingParams::expand(InferenceRequest& inferenceRequest)
+{
+    auto const params = load(inferenceRequest);
+    if (!params)
+    {
+        return;
+    }
+    for (uint32_t i = 0; i < sizeof(kFields) / sizeof(Field); ++i)
+    {
+        auto const& field = kFields[i];
+        if (!(params->presentMask & (1u << i)) || inferenceRequest.getInputTensorUnchecked(field.name))
+        {
+            continue;
+        }
+        NamedTensor t(field.dataType, {1, 1}, field.name, reinterpret_cast<char const*>(&*params) + field.offset);
+        inferenceRequest.emplaceInputTensor(t.name, std::move(t.tensor));
+    }
+
+    // The engine does not know the block
+    utils::eraseInputTensors(inferenceRequest, {kTensorName});
+}
+
+template <typename T>
+std::optional<T> SamplingParams::getScalar(InferenceRequest const& inferenceRequest, std::string const& name)
+{
+    auto const tensor = inferenceRequest.getInputTensorUnchecked(name);
+    if (tensor && tensor.value())
+    {
+        if (tensor.value()->getSize() == 0 || tensor.value()->getDataType() != dataTypeOf<T>())
+        {
+            return std::nullopt;
+        }
+        return *static_cast<T const*>(tensor.value()->data());
+    }
+    auto const params = load(inferenceRequest);
+    auto const* value = params ? params->find(name, dataTypeOf<T>()) : nullptr;
+    if (value == nullptr)
+    {
+        return std::nullopt;
+    }
+    T result;
+    std::memcpy(&result, value, sizeof(T));
+    return result;
+}
+
+template std::optional<bool> SamplingParams::getScalar(InferenceRequest const&, std::string const&);
+template std::optional<int32_t> SamplingParams::getScalar(InferenceRequest const&, std::string const&);
+template std::optional<int64_t> SamplingParams::getScalar(InferenceRequest const&, std::string const&);
+template std::optional<float> SamplingParams::getScalar(InferenceRequest const&, std::string const&);
+
+} // namespace triton::backend::inflight_batcher_llm
@@ -0,0 +1,91 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "NvInfer.h"
+#include "request_arena.h"
+#include "tensorrt_llm/batch_manager/inferenceRequest.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace triton::backend::inflight_batcher_llm
+{
+
+/// @brief Scalar sampling inputs of a request packed in a fixed layout. The block replaces about a dozen one-element
+/// tensors while the request is queued, broadcast to the tensor-parallel ranks and sent to the workers, and is
+/// expanded back into the tensors expected by TRT-LLM on every rank before the request is handed to the engine.
+struct SamplingParams
+{
+    using InferenceRequest = tensorrt_llm::batch_manager::InferenceRequest;
+
+    /// Name of the input tensor holding the packed block
+    static std::string const kTensorName;
+
+    // bit i is set if the i-th field is present
+    uint32_t presentMask{0};
+    int32_t beamWidth{0};
+    int32_t runtimeTopK{0};
+    int32_t minLength{0};
+    int32_t endId{0};
+    int32_t padId{0};
+    float temperature{0.f};
+    float runtimeTopP{0.f};
+    float lenPenalty{0.f};
+    float repetitionPenalty{0.f};
+    float presencePenalty{0.f};
+    float frequencyPenalty{0.f};
+    int64_t randomSeed{0};
+
+    /// @brief Address of the field an input is packed into, or nullptr if the input is not a packed sampling
+    /// parameter of that data type. The field is marked present.
+    void* slot(std::string const& name, nvinfer1::DataType dataType, int64_t numElements);
+
+    bool empty() const
+    {
+        return presentMask == 0;
+    }
+
+    /// @brief Store the block in a request as a single input tensor, placed in the arena of the request if any
+    void store(InferenceRequest& inferenceRequest, std::shared_ptr<RequestArena> const& arena = nullptr) const;
+
+    /// @brief Replace the block of a request by the tensors of its packed sampling parameters, keeping the tensors
+    /// the request already has. Requests without block are left untouched.
+    static void expand(InferenceRequest& inferenceRequest);
+
+    /// @brief Value of a one-element input of a request, read from its tensor or from the packed block
+    template <typename T>
+    static std::optional<T> getScalar(InferenceRequest const& inferenceRequest, std::string const& name);
+
+private:
+    static std::optional<SamplingParams> load(InferenceRequest const& inferenceRequest);
+
+    void const* find(std::string const& name, nvinfer1::DataType dataType) const;
+};
+
+} // namespace triton::backend::inflight_batcher_llm
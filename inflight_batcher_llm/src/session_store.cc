@@ -0,0 +1,170 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "session_store.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace triton::backend::inflight_batcher_llm
+{
+
+namespace
+{
+
+std::vector<int32_t> toVector(tensorrt_llm::runtime::ITensor const& tensor)
+{
+    auto const* data = static_cast<int32_t const*>(tensor.data());
+    return std::vector<int32_t>(data, data + tensor.getSize());
+}
+
+} // namespace
+
+SessionStore::SessionStore(size_t maxBytes)
+    : mMaxBytes(maxBytes)
+{
+}
+
+std::vector<int32_t> SessionStore::beginTurn(InferenceRequest& inferenceRequest, uint64_t correlationId, bool start)
+{
+    auto inputIds = toVector(*inferenceRequest.getInputIds());
+
+    std::vector<int32_t> history;
+    {
+        std::lock_guard<std::mutex> lk(mMutex);
+        if (!mTurnsInFlight.insert(correlationId).second)
+        {
+            throw std::runtime_error("sequence " + std::to_string(correlationId)
+                + " already has a turn in progress, wait for its final response before sending the next turn");
+        }
+        auto it = mHistories.find(correlationId);
+        if (it != mHistories.end())
+        {
+            if (start)
+            {
+                eraseLocked(correlationId);
+            }
+            else
+            {
+                history = it->second.first;
+                mLruCorrelationIds.splice(mLruCorrelationIds.begin(), mLruCorrelationIds, it->second.second);
+            }
+        }
+    }
+
+    if (history.empty())
+    {
+        return inputIds;
+    }
+
+    ++mNumHits;
+    mNumReusedTokens += history.size();
+
+    history.insert(history.end(), inputIds.begin(), inputIds.end());
+    auto const numTokens = static_cast<int64_t>(history.size());
+    NamedTensor fullInputIds(nvinfer1::DataType::kINT32, {1, numTokens},
+        tensorrt_llm::batch_manager::inference_request::kInputIdsTensorName, history.data());
+    inferenceRequest.setInputIds(fullInputIds.tensor);
+
+    auto const inputLengths = inferenceRequest.getInputTensorUnchecked("input_lengths");
+    if (inputLengths && inputLengths.value())
+    {
+        *static_cast<int32_t*>(inputLengths.value()->data()) = static_cast<int32_t>(numTokens);
+    }
+
+    return history;
+}
+
+void SessionStore::endTurn(
+    uint64_t correlationId, std::vector<int32_t> const& inputIds, std::vector<int32_t> const& outputIds, bool end)
+{
+    std::lock_guard<std::mutex> lk(mMutex);
+    mTurnsInFlight.erase(correlationId);
+    eraseLocked(correlationId);
+    if (end)
+    {
+        return;
+    }
+
+    std::vector<int32_t> history;
+    // output_ids only start with the prompt when the model does not exclude the input from the output
+    if (outputIds.size() < inputIds.size() || !std::equal(inputIds.begin(), inputIds.end(), outputIds.begin()))
+    {
+        history = inputIds;
+    }
+    history.insert(history.end(), outputIds.begin(), outputIds.end());
+
+    mLruCorrelationIds.push_front(correlationId);
+    mSizeInBytes += history.size() * sizeof(int32_t);
+    mHistories.emplace(correlationId, std::make_pair(std::move(history), mLruCorrelationIds.begin()));
+
+    while (mSizeInBytes > mMaxBytes && !mLruCorrelationIds.empty())
+    {
+        eraseLocked(mLruCorrelationIds.back());
+    }
+}
+
+std::vector<int32_t> SessionStore::getFirstBeamOutputIds(std::list<NamedTensor> const& responseTensors)
+{
+    auto const outputIds = std::find_if(responseTensors.begin(), responseTensors.end(),
+        [](NamedTensor const& tensor) { return tensor.name == "output_ids"; });
+    auto const sequenceLength = std::find_if(responseTensors.begin(), responseTensors.end(),
+        [](NamedTensor const& tensor) { return tensor.name == "sequence_length"; });
+    if (outputIds == responseTensors.end() || sequenceLength == responseTensors.end()
+        || outputIds->tensor->getShape().nbDims < 3 || sequenceLength->tensor->getSize() == 0)
+    {
+        return {};
+    }
+
+    // output_ids is [1, beam, len]. In streaming mode it only holds the new tokens, sequence_length is the total
+    // length
+    auto const width = outputIds->tensor->getShape().d[2];
+    auto const length = std::min<int64_t>(*static_cast<int32_t const*>(sequenceLength->tensor->data()), width);
+    auto const* beam = static_cast<int32_t const*>(outputIds->tensor->data());
+    return std::vector<int32_t>(beam, beam + std::max<int64_t>(length, 0));
+}
+
+void SessionStore::erase(uint64_t correlationId)
+{
+    std::lock_guard<std::mutex> lk(mMutex);
+    mTurnsInFlight.erase(correlationId);
+    eraseLocked(correlationId);
+}
+
+void SessionStore::eraseLocked(uint64_t correlationId)
+{
+    auto it = mHistories.find(correlationId);
+    if (it == mHistories.end())
+    {
+        return;
+    }
+    mSizeInBytes -= it->second.first.size() * sizeof(int32_t);
+    mLruCorrelationIds.erase(it->second.second);
+    mHistories.erase(it);
+}
+
+} // namespace triton::backend::inflight_batcher_llm
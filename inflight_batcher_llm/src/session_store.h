@@ -0,0 +1,104 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "tensorrt_llm/batch_manager/inferenceRequest.h"
+#include "tensorrt_llm/batch_manager/namedTensor.h"
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace triton::backend::inflight_batcher_llm
+{
+
+/// @brief Token history of multi-turn sessions, keyed by Triton sequence correlation id.
+/// Clients only send the tokens of a new turn, which are appended to the history of the session (previous inputs and
+/// generated tokens) to build the full `input_ids`. Histories are evicted in LRU order when the store exceeds its
+/// byte budget, in which case the next turn of the session only sees its own tokens.
+/// A session has at most one turn in flight: in decoupled mode the sequence batcher can release the next turn before
+/// the previous one has completed, such a turn is rejected as its history is not known yet.
+class SessionStore
+{
+    using InferenceRequest = tensorrt_llm::batch_manager::InferenceRequest;
+    using NamedTensor = tensorrt_llm::batch_manager::NamedTensor;
+
+public:
+    explicit SessionStore(size_t maxBytes);
+
+    /// @brief Prepend the history of the session to the input_ids of a request, and mark the turn in flight
+    /// @param start Whether the request starts a new session, discarding any previous history
+    /// @return The full input ids of the request. Throws if the session already has a turn in flight.
+    std::vector<int32_t> beginTurn(InferenceRequest& inferenceRequest, uint64_t correlationId, bool start);
+
+    /// @brief Store the input and generated tokens of a completed turn as the history of the session, and end the turn
+    /// @param outputIds Tokens of the first beam returned for the turn, with or without the input ids
+    /// @param end Whether the request ends the session, discarding its history
+    void endTurn(
+        uint64_t correlationId, std::vector<int32_t> const& inputIds, std::vector<int32_t> const& outputIds, bool end);
+
+    /// @brief Get the tokens of the first beam of a response, up to its sequence length
+    static std::vector<int32_t> getFirstBeamOutputIds(std::list<NamedTensor> const& responseTensors);
+
+    /// @brief Discard the history of a session and end its turn in flight, e.g. after the turn failed
+    void erase(uint64_t correlationId);
+
+    /// @brief Number of turns that reused the history of their session
+    uint64_t numHits() const
+    {
+        return mNumHits.load();
+    }
+
+    /// @brief Cumulative number of history tokens clients did not have to send
+    uint64_t numReusedTokens() const
+    {
+        return mNumReusedTokens.load();
+    }
+
+private:
+    /// @brief Must be called under mMutex
+    void eraseLocked(uint64_t correlationId);
+
+    size_t mMaxBytes;
+
+    std::mutex mMutex;
+    /// correlation ids, most recently used first
+    std::list<uint64_t> mLruCorrelationIds;
+    std::unordered_map<uint64_t, std::pair<std::vector<int32_t>, std::list<uint64_t>::iterator>> mHistories;
+    size_t mSizeInBytes{0};
+    /// correlation ids of the sessions with a turn in flight
+    std::unordered_set<uint64_t> mTurnsInFlight;
+
+    std::atomic<uint64_t> mNumHits{0};
+    std::atomic<uint64_t> mNumReusedTokens{0};
+};
+
+} // namespace triton::backend::inflight_batcher_llm
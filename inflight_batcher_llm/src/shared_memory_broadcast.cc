@@ -0,0 +1,256 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "shared_memory_broadcast.h"
+
+#include "tensorrt_llm/common/logger.h"
+
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <new>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+
+namespace triton::backend::inflight_batcher_llm
+{
+
+namespace
+{
+
+// number of segments created by this process, which make the segment names unique
+std::atomic<uint64_t> numSegments{0};
+
+// The segment is shared between processes, so the futexes are not private
+void futexWait(std::atomic<uint32_t>& word, uint32_t expected, std::chrono::nanoseconds timeout)
+{
+    struct timespec ts;
+    ts.tv_sec = timeout.count() / 1000000000;
+    ts.tv_nsec = timeout.count() % 1000000000;
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, expected, &ts, nullptr, 0);
+}
+
+void futexWake(std::atomic<uint32_t>& word)
+{
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+} // namespace
+
+std::unique_ptr<SharedMemoryBroadcast> SharedMemoryBroadcast::create(
+    tensorrt_llm::mpi::MpiComm const& comm, size_t capacityBytes)
+{
+    auto const rank = comm.getRank();
+    auto const worldSize = comm.getSize();
+
+    // The segment is only shared by the ranks of a single node
+    MPI_Comm nodeComm;
+    MPICHECK(MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &nodeComm));
+    int nodeSize = 0;
+    MPICHECK(MPI_Comm_size(nodeComm, &nodeSize));
+    MPICHECK(MPI_Comm_free(&nodeComm));
+    if (nodeSize != worldSize)
+    {
+        TLLM_LOG_WARNING("The ranks are not on a single node, requests are broadcast with MPI");
+        return nullptr;
+    }
+
+    uint64_t pid = getpid();
+    uint64_t segmentIdx = numSegments++;
+    comm.bcastValue(pid, 0);
+    comm.bcastValue(segmentIdx, 0);
+    auto const name = "/trtllm_broadcast_" + std::to_string(pid) + "_" + std::to_string(segmentIdx);
+
+    auto const dataOffset = (1 + worldSize) * kCacheLineBytes;
+    auto const segmentBytes = dataOffset + capacityBytes;
+
+    int fd = -1;
+    if (rank == 0)
+    {
+        fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd >= 0 && ftruncate(fd, segmentBytes) != 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+    // The other ranks open the segment once rank 0 has created it
+    comm.barrier();
+    if (rank != 0)
+    {
+        fd = shm_open(name.c_str(), O_RDWR, 0600);
+    }
+
+    void* segment = MAP_FAILED;
+    if (fd >= 0)
+    {
+        segment = mmap(nullptr, segmentBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+    }
+    // The mappings keep the segment alive
+    comm.barrier();
+    if (rank == 0)
+    {
+        shm_unlink(name.c_str());
+    }
+
+    int ok = segment != MAP_FAILED ? 1 : 0;
+    int allOk = 0;
+    MPICHECK(MPI_Allreduce(&ok, &allOk, 1, MPI_INT, MPI_MIN, comm));
+    if (!allOk)
+    {
+        if (segment != MAP_FAILED)
+        {
+            munmap(segment, segmentBytes);
+        }
+        TLLM_LOG_WARNING("Failed to create shared memory segment %s, requests are broadcast with MPI", name.c_str());
+        return nullptr;
+    }
+
+    TLLM_LOG_INFO("Requests are broadcast through shared memory segment %s of %lu bytes", name.c_str(), segmentBytes);
+    return std::unique_ptr<SharedMemoryBroadcast>(
+        new SharedMemoryBroadcast(segment, segmentBytes, capacityBytes, rank, worldSize));
+}
+
+SharedMemoryBroadcast::SharedMemoryBroadcast(
+    void* segment, size_t segmentBytes, size_t capacityBytes, int32_t rank, int32_t worldSize)
+    : mSegment(segment)
+    , mSegmentBytes(segmentBytes)
+    , mData(static_cast<char*>(segment) + (1 + worldSize) * kCacheLineBytes)
+    , mCapacityBytes(capacityBytes)
+    , mRank(rank)
+    , mWorldSize(worldSize)
+{
+    // The segment is zero-filled when created, which is a valid initial state
+    if (mRank == 0)
+    {
+        new (header()) Header{};
+        for (int32_t i = 1; i < mWorldSize; ++i)
+        {
+            new (releasedSeq(i)) std::atomic<uint32_t>(0);
+        }
+    }
+}
+
+SharedMemoryBroadcast::~SharedMemoryBroadcast()
+{
+    // The ranks still waiting for this one give up instead of waiting for the timeout
+    header()->shutdown.store(1);
+    wake(header()->seq);
+    for (int32_t i = 1; i < mWorldSize; ++i)
+    {
+        wake(*releasedSeq(i));
+    }
+    munmap(mSegment, mSegmentBytes);
+}
+
+void SharedMemoryBroadcast::wait(std::atomic<uint32_t>& seq, uint32_t value)
+{
+    auto const start = std::chrono::steady_clock::now();
+    while (seq.load(std::memory_order_acquire) != value)
+    {
+        if (header()->shutdown.load())
+        {
+            throw std::runtime_error("A rank shut down while the shared memory broadcast waited for it");
+        }
+        auto const elapsed = std::chrono::steady_clock::now() - start;
+        if (elapsed < kSpinDuration)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        if (elapsed > kWaitTimeout)
+        {
+            throw std::runtime_error("Shared memory broadcast timed out after "
+                + std::to_string(kWaitTimeout.count()) + " s waiting for message " + std::to_string(value));
+        }
+
+        // The waiter is counted before the last check, so that a rank updating the sequence number after the check
+        // sees it and wakes it up
+        header()->numWaiters.fetch_add(1);
+        auto const current = seq.load();
+        if (current != value)
+        {
+            futexWait(seq, current, kSleepDuration);
+        }
+        header()->numWaiters.fetch_sub(1);
+    }
+}
+
+void SharedMemoryBroadcast::wake(std::atomic<uint32_t>& seq)
+{
+    if (header()->numWaiters.load() > 0)
+    {
+        futexWake(seq);
+    }
+}
+
+bool SharedMemoryBroadcast::write(void const* data, size_t numBytes)
+{
+    // The other ranks may still be reading the previous message in place
+    for (int32_t i = 1; i < mWorldSize; ++i)
+    {
+        wait(*releasedSeq(i), mSeq);
+    }
+
+    bool const inPlace = numBytes <= mCapacityBytes;
+    if (inPlace)
+    {
+        std::memcpy(mData, data, numBytes);
+    }
+    header()->numBytes = numBytes;
+    header()->inPlace = inPlace;
+    header()->seq.store(++mSeq);
+    wake(header()->seq);
+    return inPlace;
+}
+
+void const* SharedMemoryBroadcast::read(size_t& numBytes)
+{
+    wait(header()->seq, ++mSeq);
+
+    numBytes = header()->numBytes;
+    if (!header()->inPlace)
+    {
+        // Nothing to read in place, the message is broadcast with MPI
+        release();
+        return nullptr;
+    }
+    return mData;
+}
+
+void SharedMemoryBroadcast::release()
+{
+    releasedSeq(mRank)->store(mSeq);
+    wake(*releasedSeq(mRank));
+}
+
+} // namespace triton::backend::inflight_batcher_llm
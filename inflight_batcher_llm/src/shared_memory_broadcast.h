@@ -0,0 +1,125 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include "tensorrt_llm/common/mpiUtils.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace triton::backend::inflight_batcher_llm
+{
+
+/// @brief Node-local shared memory segment through which rank 0 of a session broadcasts messages to the other
+/// ranks. Rank 0 copies a message once into the segment and the other ranks read it in place, instead of receiving
+/// a copy through an MPI broadcast. Messages are ordered by a sequence number: a message is only written once every
+/// rank has released the previous one. Messages larger than the segment are not written, their senders fall back to
+/// an MPI broadcast. A rank waiting for a message or a release spins briefly, then sleeps on a futex in the segment.
+/// The wait fails once a rank has destroyed its segment or after a timeout, instead of hanging.
+class SharedMemoryBroadcast
+{
+public:
+    /// @brief Create the segment of a session, must be called by all the ranks of the session
+    /// @return nullptr on all the ranks if the ranks are not on the same node or the segment cannot be created
+    static std::unique_ptr<SharedMemoryBroadcast> create(tensorrt_llm::mpi::MpiComm const& comm, size_t capacityBytes);
+
+    ~SharedMemoryBroadcast();
+
+    /// @brief Write the next message, on rank 0. Waits for the other ranks to release the previous message.
+    /// Throws an error if a rank has shut down or does not release the message before the timeout.
+    /// @return Whether the message was written, false if it is larger than the segment
+    bool write(void const* data, size_t numBytes);
+
+    /// @brief Wait for the next message, on the other ranks. Throws an error if a rank has shut down or the message is
+    /// not written before the timeout.
+    /// @return Pointer to the message in the segment, valid until it is released, or nullptr if the message was not
+    /// written to the segment
+    void const* read(size_t& numBytes);
+
+    /// @brief Let rank 0 write the next message, on the other ranks
+    void release();
+
+private:
+    SharedMemoryBroadcast(void* segment, size_t segmentBytes, size_t capacityBytes, int32_t rank, int32_t worldSize);
+
+    // sequence number, size and location of the last message. The sequence numbers are 32-bit futex words, they are
+    // only compared for equality as a rank is never more than one message ahead of the others, so they can wrap.
+    struct Header
+    {
+        std::atomic<uint32_t> seq;
+        // number of ranks sleeping on a futex, the ranks only wake them up when there are some
+        std::atomic<uint32_t> numWaiters;
+        // set by the first rank that destroys its segment
+        std::atomic<uint32_t> shutdown;
+        uint64_t numBytes;
+        uint64_t inPlace;
+    };
+
+    /// @brief Wait until a sequence number of the segment reaches a value
+    void wait(std::atomic<uint32_t>& seq, uint32_t value);
+
+    /// @brief Wake up the ranks sleeping on a sequence number of the segment
+    void wake(std::atomic<uint32_t>& seq);
+
+    // the header and the sequence number released by each rank are on their own cache line
+    static constexpr size_t kCacheLineBytes = 64;
+    static_assert(std::atomic<uint32_t>::is_always_lock_free, "shared memory atomics must be lock free");
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex words must be 32-bit");
+
+    // time spent polling a sequence number before sleeping, messages usually follow within microseconds
+    static constexpr std::chrono::microseconds kSpinDuration{50};
+    // longest sleep between the checks of the shutdown flag
+    static constexpr std::chrono::milliseconds kSleepDuration{100};
+    // time after which a rank that does not write or release a message is considered gone
+    static constexpr std::chrono::seconds kWaitTimeout{60};
+
+    Header* header() const
+    {
+        return static_cast<Header*>(mSegment);
+    }
+
+    std::atomic<uint32_t>* releasedSeq(int32_t rank) const
+    {
+        return reinterpret_cast<std::atomic<uint32_t>*>(static_cast<char*>(mSegment) + (1 + rank) * kCacheLineBytes);
+    }
+
+    void* mSegment;
+    size_t mSegmentBytes;
+    char* mData;
+    size_t mCapacityBytes;
+    int32_t mRank;
+    int32_t mWorldSize;
+    // sequence number of the last message written or read by this rank
+    uint32_t mSeq = 0;
+};
+
+} // namespace triton::backend::inflight_batcher_llm
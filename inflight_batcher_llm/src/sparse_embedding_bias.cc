@@ -0,0 +1,156 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "sparse_embedding_bias.h"
+
+#include "input_conversion.h"
+#include "utils.h"
+
+#include "tensorrt_llm/batch_manager/namedTensor.h"
+
+#include <string_view>
+
+namespace triton::backend::inflight_batcher_llm
+{
+
+namespace
+{
+
+template <typename T>
+std::vector<T> toVector(tensorrt_llm::runtime::ITensor const& tensor)
+{
+    auto const* data = static_cast<T const*>(tensor.data());
+    return std::vector<T>(data, data + tensor.getSize());
+}
+
+template <typename T>
+size_t hashBytes(std::vector<T> const& v)
+{
+    return std::hash<std::string_view>{}(
+        std::string_view(reinterpret_cast<char const*>(v.data()), v.size() * sizeof(T)));
+}
+
+} // namespace
+
+SparseEmbeddingBias::SparseEmbeddingBias(
+    int32_t vocabSize, int32_t worldSize, nvinfer1::DataType logitsDataType, size_t maxNumBiases)
+    : mVocabSize(vocabSize)
+    , mVocabSizePadded((vocabSize + worldSize - 1) / worldSize * worldSize)
+    , mLogitsDataType(logitsDataType)
+    , mMaxNumBiases(maxNumBiases)
+{
+}
+
+void SparseEmbeddingBias::expand(InferenceRequest& inferenceRequest)
+{
+    auto const idsTensor = inferenceRequest.getInputTensorUnchecked(kEmbeddingBiasIdsInputTensorName);
+    auto const valuesTensor = inferenceRequest.getInputTensorUnchecked(kEmbeddingBiasValuesInputTensorName);
+    if (!idsTensor || !idsTensor.value())
+    {
+        return;
+    }
+    if (!valuesTensor || !valuesTensor.value())
+    {
+        throw std::runtime_error(kEmbeddingBiasIdsInputTensorName + " requires " + kEmbeddingBiasValuesInputTensorName);
+    }
+    if (inferenceRequest.getEmbeddingBiasUnchecked())
+    {
+        throw std::runtime_error("embedding_bias and " + kEmbeddingBiasIdsInputTensorName + " are mutually exclusive");
+    }
+
+    auto ids = toVector<int32_t>(*idsTensor.value());
+    auto values = toVector<float>(*valuesTensor.value());
+    if (ids.size() != values.size())
+    {
+        throw std::runtime_error(kEmbeddingBiasIdsInputTensorName + " and " + kEmbeddingBiasValuesInputTensorName
+            + " must have the same number of elements");
+    }
+
+    // The engine does not know the sparse inputs
+    utils::eraseInputTensors(
+        inferenceRequest, {kEmbeddingBiasIdsInputTensorName, kEmbeddingBiasValuesInputTensorName});
+
+    auto const key = hashBytes(ids) ^ (hashBytes(values) * 31);
+
+    std::lock_guard<std::mutex> lk(mMutex);
+    auto const [begin, end] = mBiases.equal_range(key);
+    for (auto it = begin; it != end; ++it)
+    {
+        auto& bias = *it->second;
+        if (bias.ids == ids && bias.values == values)
+        {
+            mLruBiases.splice(mLruBiases.begin(), mLruBiases, it->second);
+            inferenceRequest.setEmbeddingBias(bias.dense);
+            return;
+        }
+    }
+
+    auto dense = createDenseBias(ids, values);
+    inferenceRequest.setEmbeddingBias(dense);
+
+    mLruBiases.push_front(Bias{std::move(ids), std::move(values), std::move(dense)});
+    mBiases.emplace(key, mLruBiases.begin());
+    if (mLruBiases.size() > mMaxNumBiases)
+    {
+        auto const& evicted = mLruBiases.back();
+        auto const evictedKey = hashBytes(evicted.ids) ^ (hashBytes(evicted.values) * 31);
+        auto const [evictedBegin, evictedEnd] = mBiases.equal_range(evictedKey);
+        for (auto it = evictedBegin; it != evictedEnd; ++it)
+        {
+            if (it->second == std::prev(mLruBiases.end()))
+            {
+                mBiases.erase(it);
+                break;
+            }
+        }
+        mLruBiases.pop_back();
+    }
+}
+
+SparseEmbeddingBias::TensorPtr SparseEmbeddingBias::createDenseBias(
+    std::vector<int32_t> const& ids, std::vector<float> const& values) const
+{
+    // Accumulated in fp32, then narrowed to the data type of the logits
+    std::vector<float> data(mVocabSizePadded, 0.f);
+    for (size_t i = 0; i < ids.size(); ++i)
+    {
+        if (ids[i] < 0 || ids[i] >= mVocabSize)
+        {
+            throw std::runtime_error(kEmbeddingBiasIdsInputTensorName + " contains token id " + std::to_string(ids[i])
+                + " outside of the vocabulary of size " + std::to_string(mVocabSize));
+        }
+        // Biases of repeated ids accumulate, as done by the preprocessing model
+        data[ids[i]] += values[i];
+    }
+
+    tensorrt_llm::batch_manager::NamedTensor dense(mLogitsDataType, {1, mVocabSizePadded},
+        tensorrt_llm::batch_manager::inference_request::kEmbeddingBiasTensorName);
+    convertInput(tensorrt_llm::batch_manager::inference_request::kEmbeddingBiasTensorName, data.data(),
+        TRITONSERVER_TYPE_FP32, dense.tensor->data(), mLogitsDataType, data.size());
+    return dense.tensor;
+}
+
+} // namespace triton::backend::inflight_batcher_llm
@@ -0,0 +1,83 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "tensorrt_llm/batch_manager/inferenceRequest.h"
+#include "tensorrt_llm/runtime/iTensor.h"
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace triton::backend::inflight_batcher_llm
+{
+
+/// @brief Expands the sparse `embedding_bias_ids` / `embedding_bias_values` inputs of a request into the dense
+/// `embedding_bias` tensor expected by TRT-LLM. Dense tensors are shared between requests with identical bias sets.
+/// The dense bias covers the vocabulary padded to a multiple of the world size and has the data type of the logits,
+/// as the engine adds it to the logits as is.
+class SparseEmbeddingBias
+{
+    using InferenceRequest = tensorrt_llm::batch_manager::InferenceRequest;
+    using TensorPtr = tensorrt_llm::runtime::ITensor::SharedPtr;
+
+public:
+    /// @param vocabSize Size of the vocabulary, token ids must be lower
+    /// @param worldSize Number of ranks of the engine, the vocabulary of the logits is padded to a multiple of it
+    /// @param logitsDataType Data type of the logits of the engine
+    /// @param maxNumBiases Maximum number of dense biases kept for reuse
+    SparseEmbeddingBias(
+        int32_t vocabSize, int32_t worldSize, nvinfer1::DataType logitsDataType, size_t maxNumBiases);
+
+    /// @brief Set the dense embedding bias of a request that provides a sparse one, and remove the sparse inputs.
+    /// Requests without sparse bias are left untouched. Throws if the sparse bias is invalid.
+    void expand(InferenceRequest& inferenceRequest);
+
+private:
+    struct Bias
+    {
+        std::vector<int32_t> ids;
+        std::vector<float> values;
+        TensorPtr dense;
+    };
+
+    TensorPtr createDenseBias(std::vector<int32_t> const& ids, std::vector<float> const& values) const;
+
+    int32_t mVocabSize;
+    int32_t mVocabSizePadded;
+    nvinfer1::DataType mLogitsDataType;
+    size_t mMaxNumBiases;
+
+    std::mutex mMutex;
+    /// biases, most recently used first
+    std::list<Bias> mLruBiases;
+    std::unordered_multimap<size_t, std::list<Bias>::iterator> mBiases;
+};
+
+} // namespace triton::backend::inflight_batcher_llm
@@ -0,0 +1,672 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "speculative_decoding.h"
+
+#include "sampling_params.h"
+#include "session_store.h"
+#include "utils.h"
+
+#include "tensorrt_llm/common/logger.h"
+#include "triton/backend/backend_common.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace triton::backend::inflight_batcher_llm
+{
+
+namespace
+{
+
+namespace inference_request = tensorrt_llm::batch_manager::inference_request;
+
+std::string const kInputIdsTensorName = "input_ids";
+std::string const kInputLengthsTensorName = "input_lengths";
+std::string const kRequestOutputLenTensorName = "request_output_len";
+std::string const kDraftInputIdsTensorName = "draft_input_ids";
+std::string const kStopWordsListTensorName = "stop_words_list";
+std::string const kBadWordsListTensorName = "bad_words_list";
+
+template <typename T>
+std::optional<T> getScalar(
+    tensorrt_llm::batch_manager::InferenceRequest const& inferenceRequest, std::string const& name)
+{
+    return SamplingParams::getScalar<T>(inferenceRequest, name);
+}
+
+/// @brief Get the words of a [1, 2, L] words list, whose first row holds the tokens of the words and second row the
+/// offsets of their ends, padded with -1
+std::vector<std::vector<int32_t>> getWordsList(
+    tensorrt_llm::batch_manager::InferenceRequest const& inferenceRequest, std::string const& name)
+{
+    std::vector<std::vector<int32_t>> words;
+    auto const tensor = inferenceRequest.getInputTensorUnchecked(name);
+    if (!tensor || !tensor.value() || tensor.value()->getDataType() != nvinfer1::DataType::kINT32)
+    {
+        return words;
+    }
+    auto const length = static_cast<int32_t>(tensor.value()->getSize() / 2);
+    auto const* ids = static_cast<int32_t const*>(tensor.value()->data());
+    auto const* offsets = ids + length;
+    int32_t begin = 0;
+    for (int32_t i = 0; i < length && offsets[i] >= 0 && offsets[i] <= length; ++i)
+    {
+        if (offsets[i] > begin)
+        {
+            words.emplace_back(ids + begin, ids + offsets[i]);
+        }
+        begin = offsets[i];
+    }
+    return words;
+}
+
+/// @brief Position in `newIds` of the first token completing one of the words, which may start in `previousIds`
+/// @return The number of tokens of `newIds` up to and including that token, or std::nullopt if no word is completed
+std::optional<size_t> findWordEnd(std::vector<std::vector<int32_t>> const& words,
+    std::vector<int32_t> const& previousIds, std::vector<int32_t> const& newIds)
+{
+    auto const tokenAt
+        = [&](size_t i) { return i < previousIds.size() ? previousIds[i] : newIds[i - previousIds.size()]; };
+    for (size_t i = 0; i < newIds.size(); ++i)
+    {
+        auto const end = previousIds.size() + i + 1;
+        for (auto const& word : words)
+        {
+            if (word.size() > end)
+            {
+                continue;
+            }
+            size_t j = 0;
+            while (j < word.size() && tokenAt(end - word.size() + j) == word[j])
+            {
+                ++j;
+            }
+            if (j == word.size())
+            {
+                return i + 1;
+            }
+        }
+    }
+    return std::nullopt;
+}
+
+tensorrt_llm::batch_manager::NamedTensor makeTensor(
+    std::string const& name, std::vector<int64_t> const& shape, std::vector<int32_t> const& values)
+{
+    return tensorrt_llm::batch_manager::NamedTensor(nvinfer1::DataType::kINT32, shape, name, values.data());
+}
+
+} // namespace
+
+/// @brief A request sent to the draft model. It is referenced by the request release and the final response
+/// callbacks of Triton, which may be called in any order.
+struct SpeculativeDecoder::DraftCall
+{
+    SpeculativeDecoder* decoder;
+    uint64_t requestId;
+    std::vector<int32_t> inputIds;
+    int32_t inputLength;
+    int32_t outputLen;
+    std::vector<int32_t> draftIds;
+    std::atomic<int32_t> numRefs{2};
+};
+
+SpeculativeDecoder::SpeculativeDecoder(TRITONSERVER_Server* server, Config config, SubmitRoundCallback submitRound,
+    std::function<size_t()> numPendingRequests)
+    : mServer(server)
+    , mConfig(std::move(config))
+    , mSubmitRound(std::move(submitRound))
+    , mNumPendingRequests(std::move(numPendingRequests))
+{
+    mConfig.maxDraftLength = std::max(mConfig.maxDraftLength, 1);
+    if (mConfig.draftModelName.empty())
+    {
+        return;
+    }
+
+    auto* err = TRITONSERVER_ResponseAllocatorNew(&mAllocator, allocateDraftOutput, releaseDraftOutput, nullptr);
+    if (err != nullptr)
+    {
+        std::string const errStr
+            = std::string("Failed to create the draft model response allocator: ") + TRITONSERVER_ErrorMessage(err);
+        TRITONSERVER_ErrorDelete(err);
+        throw std::runtime_error(errStr);
+    }
+}
+
+SpeculativeDecoder::~SpeculativeDecoder()
+{
+    {
+        std::unique_lock<std::mutex> lk(mMutex);
+        mRequests.clear();
+        mDraftCallsCV.wait(lk, [this]() { return mNumDraftCalls == 0; });
+    }
+    if (mAllocator != nullptr)
+    {
+        LOG_IF_ERROR(TRITONSERVER_ResponseAllocatorDelete(mAllocator), "Failed to delete the draft model allocator");
+    }
+}
+
+std::shared_ptr<tensorrt_llm::batch_manager::InferenceRequest> SpeculativeDecoder::start(
+    std::shared_ptr<InferenceRequest> const& inferenceRequest)
+{
+    bool const usePromptLookup = mConfig.promptLookupMaxNgramSize > 0
+        && getScalar<bool>(*inferenceRequest, kPromptLookupInputTensorName).value_or(mConfig.promptLookupByDefault);
+    if (!usePromptLookup && mConfig.draftModelName.empty())
+    {
+        return nullptr;
+    }
+
+    auto const inputIds = inferenceRequest->getInputTensorUnchecked(kInputIdsTensorName);
+    auto const maxNewTokens = getScalar<int32_t>(*inferenceRequest, kRequestOutputLenTensorName);
+    if (!inputIds || !inputIds.value() || !maxNewTokens || maxNewTokens.value() <= 0)
+    {
+        return nullptr;
+    }
+
+    // The engine only verifies drafts of greedy requests, log probs and logits of rounds cannot be merged, and
+    // requests providing their own draft are already speculative
+    if (getScalar<int32_t>(*inferenceRequest, inference_request::kBeamWidthTensorName).value_or(1) != 1
+        || getScalar<int32_t>(*inferenceRequest, inference_request::kRuntimeTopKTensorName).value_or(0) > 1
+        || getScalar<float>(*inferenceRequest, inference_request::kRuntimeTopPTensorName).value_or(0.f) > 0.f
+        || getScalar<bool>(*inferenceRequest, inference_request::kReturnLogProbsTensorName).value_or(false)
+        || getScalar<bool>(*inferenceRequest, inference_request::kReturnContextLogitsTensorName).value_or(false)
+        || getScalar<bool>(*inferenceRequest, inference_request::kReturnGenerationLogitsTensorName).value_or(false)
+        || inferenceRequest->getInputTensorUnchecked(kDraftInputIdsTensorName))
+    {
+        return nullptr;
+    }
+
+    RequestState state;
+    state.request = inferenceRequest;
+    auto const* ids = static_cast<int32_t const*>(inputIds.value()->data());
+    state.promptIds.assign(ids, ids + inputIds.value()->getSize());
+    state.maxNewTokens = maxNewTokens.value();
+    state.draftLength = mConfig.maxDraftLength;
+    state.endId = getScalar<int32_t>(*inferenceRequest, inference_request::kEndIdTensorName);
+    state.minLength = getScalar<int32_t>(*inferenceRequest, inference_request::kMinLengthTensorName).value_or(0);
+    state.stopWords = getWordsList(*inferenceRequest, kStopWordsListTensorName);
+    state.badWords = getWordsList(*inferenceRequest, kBadWordsListTensorName);
+
+    // Prompt lookup drafts from the prompt, with a draft model the first round generates the token the first draft
+    // starts from
+    std::shared_ptr<InferenceRequest> round;
+    if (usePromptLookup)
+    {
+        state.promptLookup.emplace(mConfig.promptLookupMaxNgramSize);
+        state.promptLookup->append(state.promptIds);
+        auto const draftLength = std::min(state.draftLength, state.maxNewTokens - 1);
+        round = prepareRound(state, state.promptLookup->propose(draftLength), draftLength);
+    }
+    else
+    {
+        round = prepareRound(state, {}, 0);
+    }
+
+    std::lock_guard<std::mutex> lk(mMutex);
+    mRequests[inferenceRequest->getRequestId()] = std::move(state);
+    return round;
+}
+
+bool SpeculativeDecoder::isActive(uint64_t requestId) const
+{
+    std::lock_guard<std::mutex> lk(mMutex);
+    return mRequests.find(requestId) != mRequests.end();
+}
+
+SpeculativeDecoder::RoundResult SpeculativeDecoder::onRoundComplete(
+    uint64_t requestId, std::list<NamedTensor> const& responseTensors)
+{
+    std::lock_guard<std::mutex> lk(mMutex);
+    auto it = mRequests.find(requestId);
+    if (it == mRequests.end())
+    {
+        return RoundResult{true, responseTensors};
+    }
+    auto& state = it->second;
+
+    // Rounds are not streamed, output_ids hold the whole sequence unless the input is excluded from the output
+    auto const inputLength = state.promptIds.size() + state.generatedIds.size();
+    auto outputIds = SessionStore::getFirstBeamOutputIds(responseTensors);
+    std::vector<int32_t> newIds;
+    if (mConfig.excludeInputInOutput)
+    {
+        newIds = std::move(outputIds);
+    }
+    else if (outputIds.size() > inputLength)
+    {
+        newIds.assign(outputIds.begin() + inputLength, outputIds.end());
+    }
+    auto const remaining = static_cast<size_t>(state.maxNewTokens) - state.generatedIds.size();
+    newIds.resize(std::min(newIds.size(), remaining));
+
+    // The engine only matches the stop words within the tokens of the round, a stop word may also start in a
+    // previous round or end on the last token of the round
+    bool stoppedOnWord = false;
+    if (auto const wordEnd = findWordEnd(state.stopWords, state.generatedIds, newIds))
+    {
+        newIds.resize(wordEnd.value());
+        stoppedOnWord = true;
+    }
+
+    auto const& draftIds = state.draftIds;
+    auto const mismatch = std::mismatch(draftIds.begin(), draftIds.end(), newIds.begin(), newIds.end());
+    auto const numAccepted = static_cast<int32_t>(std::distance(draftIds.begin(), mismatch.first));
+    auto const numDrafted = static_cast<int32_t>(draftIds.size());
+    ++mNumRounds;
+    mNumDraftTokens += numDrafted;
+    mNumAcceptedTokens += numAccepted;
+
+    if (numDrafted > 0)
+    {
+        if (numAccepted == numDrafted)
+        {
+            state.draftLength = std::min(state.draftLength + 1, mConfig.maxDraftLength);
+        }
+        else if (2 * numAccepted < numDrafted)
+        {
+            state.draftLength = std::max(state.draftLength - 1, 1);
+        }
+
+        ++state.numDraftRounds;
+        state.numDraftTokens += numDrafted;
+        state.numAcceptedTokens += numAccepted;
+        if (!state.draftingDisabled && state.numDraftRounds >= kMinDraftRoundsBeforeFallback
+            && state.numAcceptedTokens < mConfig.minAcceptanceRate * state.numDraftTokens)
+        {
+            state.draftingDisabled = true;
+            ++mNumFallbacks;
+        }
+    }
+
+    // The engine returns the accepted tokens and one token of its own, or all the requested tokens without draft,
+    // unless it stopped on the end id, a stop word or the output length
+    auto const expectedLength = static_cast<size_t>(
+        numDrafted > 0 ? std::min(numAccepted + 1, state.roundOutputLen) : state.roundOutputLen);
+    bool const finished = stoppedOnWord || newIds.size() < expectedLength || newIds.size() == remaining
+        || (state.endId && std::find(newIds.begin(), newIds.end(), state.endId.value()) != newIds.end());
+
+    state.generatedIds.insert(state.generatedIds.end(), newIds.begin(), newIds.end());
+    state.draftIds.clear();
+    if (state.promptLookup)
+    {
+        state.promptLookup->append(newIds);
+    }
+
+    RoundResult result;
+    result.finished = finished;
+    auto const sequenceLength = static_cast<int32_t>(
+        (mConfig.excludeInputInOutput ? 0 : state.promptIds.size()) + state.generatedIds.size());
+    if (state.request->isStreaming())
+    {
+        if (!newIds.empty() || finished)
+        {
+            result.responseTensors.push_back(
+                makeTensor("output_ids", {1, 1, static_cast<int64_t>(newIds.size())}, newIds));
+            result.responseTensors.push_back(makeTensor("sequence_length", {1, 1}, {sequenceLength}));
+        }
+    }
+    else if (finished)
+    {
+        auto sequence = mConfig.excludeInputInOutput ? std::vector<int32_t>{} : state.promptIds;
+        sequence.insert(sequence.end(), state.generatedIds.begin(), state.generatedIds.end());
+        result.responseTensors.push_back(
+            makeTensor("output_ids", {1, 1, static_cast<int64_t>(sequence.size())}, sequence));
+        result.responseTensors.push_back(makeTensor("sequence_length", {1, 1}, {sequenceLength}));
+    }
+
+    if (finished)
+    {
+        mRequests.erase(it);
+    }
+    return result;
+}
+
+void SpeculativeDecoder::continueRequest(uint64_t requestId)
+{
+    // Shorter drafts waste less engine time on rejected tokens when other requests are waiting
+    bool const isLoaded = mNumPendingRequests() > 0;
+
+    std::shared_ptr<InferenceRequest> round;
+    std::vector<int32_t> inputIds;
+    int32_t draftLength = 0;
+    {
+        std::lock_guard<std::mutex> lk(mMutex);
+        auto it = mRequests.find(requestId);
+        if (it == mRequests.end())
+        {
+            return;
+        }
+        auto& state = it->second;
+        auto const remaining = state.maxNewTokens - static_cast<int32_t>(state.generatedIds.size());
+
+        if (state.draftingDisabled)
+        {
+            // The remaining tokens are generated in a single round. Streaming requests are handed back to the
+            // engine, which streams the tokens as for any other request.
+            bool const isStreaming = state.request->isStreaming();
+            state.draftIds.clear();
+            state.roundOutputLen = remaining;
+            round = makeRound(state, remaining, isStreaming);
+            if (isStreaming)
+            {
+                mRequests.erase(it);
+            }
+        }
+        else
+        {
+            draftLength = isLoaded ? std::max(state.draftLength / 2, 1) : state.draftLength;
+            // The engine always generates one token after the draft
+            draftLength = std::min(draftLength, remaining - 1);
+            if (state.promptLookup)
+            {
+                round = prepareRound(state, state.promptLookup->propose(draftLength), draftLength);
+            }
+            else if (draftLength > 0)
+            {
+                inputIds = state.promptIds;
+                inputIds.insert(inputIds.end(), state.generatedIds.begin(), state.generatedIds.end());
+            }
+            else
+            {
+                round = prepareRound(state, {}, 0);
+            }
+        }
+    }
+
+    if (round)
+    {
+        mSubmitRound(requestId, std::move(round));
+    }
+    else
+    {
+        requestDraft(requestId, inputIds, draftLength);
+    }
+}
+
+void SpeculativeDecoder::erase(uint64_t requestId)
+{
+    std::lock_guard<std::mutex> lk(mMutex);
+    mRequests.erase(requestId);
+}
+
+std::shared_ptr<tensorrt_llm::batch_manager::InferenceRequest> SpeculativeDecoder::makeRound(
+    RequestState const& state, int32_t outputLen, bool isStreaming) const
+{
+    auto round = std::make_shared<InferenceRequest>(state.request->getRequestId());
+    for (auto const& [name, tensor] : state.request->getInputTensors())
+    {
+        if (name != kInputIdsTensorName && name != kInputLengthsTensorName && name != kRequestOutputLenTensorName
+            && name != kDraftInputIdsTensorName && name != inference_request::kMinLengthTensorName)
+        {
+            round->emplaceInputTensor(name, tensor);
+        }
+    }
+
+    auto inputIds = state.promptIds;
+    inputIds.insert(inputIds.end(), state.generatedIds.begin(), state.generatedIds.end());
+    auto const inputLength = static_cast<int32_t>(inputIds.size());
+    auto ids = makeTensor(kInputIdsTensorName, {1, inputLength}, inputIds);
+    round->emplaceInputTensor(ids.name, std::move(ids.tensor));
+    auto lengths = makeTensor(kInputLengthsTensorName, {1, 1}, {inputLength});
+    round->emplaceInputTensor(lengths.name, std::move(lengths.tensor));
+    auto outputLens = makeTensor(kRequestOutputLenTensorName, {1, 1}, {outputLen});
+    round->emplaceInputTensor(outputLens.name, std::move(outputLens.tensor));
+    // The minimum length applies to the whole generation, not to each round
+    auto const minLength
+        = std::min(state.minLength - static_cast<int32_t>(state.generatedIds.size()), outputLen);
+    if (minLength > 0)
+    {
+        auto minLengths = makeTensor(inference_request::kMinLengthTensorName, {1, 1}, {minLength});
+        round->emplaceInputTensor(minLengths.name, std::move(minLengths.tensor));
+    }
+    if (!state.draftIds.empty())
+    {
+        auto draft = makeTensor(kDraftInputIdsTensorName, {1, static_cast<int64_t>(state.draftIds.size())},
+            state.draftIds);
+        round->emplaceInputTensor(draft.name, std::move(draft.tensor));
+    }
+
+    // Tokens are streamed by the decoder once they have been verified
+    round->setIsStreaming(isStreaming);
+    return round;
+}
+
+std::shared_ptr<tensorrt_llm::batch_manager::InferenceRequest> SpeculativeDecoder::prepareRound(
+    RequestState& state, std::vector<int32_t> draftIds, int32_t draftLength) const
+{
+    auto const remaining = state.maxNewTokens - static_cast<int32_t>(state.generatedIds.size());
+    draftIds.resize(std::min(draftIds.size(), static_cast<size_t>(std::max(remaining - 1, 0))));
+    // Drafts never complete a bad word, which the engine would reject anyway, nor end before the minimum length
+    if (auto const wordEnd = findWordEnd(state.badWords, state.generatedIds, draftIds))
+    {
+        draftIds.resize(wordEnd.value() - 1);
+    }
+    if (state.endId)
+    {
+        auto const minLength = static_cast<size_t>(
+            std::max(state.minLength - static_cast<int32_t>(state.generatedIds.size()), 0));
+        auto const endIt = std::find(draftIds.begin(), draftIds.begin() + std::min(minLength, draftIds.size()),
+            state.endId.value());
+        draftIds.erase(endIt, draftIds.end());
+    }
+    state.draftIds = std::move(draftIds);
+    auto const numDraftTokens = state.draftIds.empty() ? draftLength : static_cast<int32_t>(state.draftIds.size());
+    state.roundOutputLen = std::min(numDraftTokens + 1, remaining);
+    return makeRound(state, state.roundOutputLen, false);
+}
+
+void SpeculativeDecoder::submitRound(uint64_t requestId, std::vector<int32_t> draftIds, int32_t draftLength)
+{
+    std::shared_ptr<InferenceRequest> round;
+    {
+        std::lock_guard<std::mutex> lk(mMutex);
+        auto it = mRequests.find(requestId);
+        if (it == mRequests.end())
+        {
+            return;
+        }
+        round = prepareRound(it->second, std::move(draftIds), draftLength);
+    }
+    mSubmitRound(requestId, std::move(round));
+}
+
+void SpeculativeDecoder::requestDraft(uint64_t requestId, std::vector<int32_t> const& inputIds, int32_t draftLength)
+{
+    auto* call = new DraftCall{this, requestId, inputIds, static_cast<int32_t>(inputIds.size()), draftLength, {}};
+    {
+        std::lock_guard<std::mutex> lk(mMutex);
+        ++mNumDraftCalls;
+    }
+
+    TRITONSERVER_InferenceRequest* request = nullptr;
+    auto* err = [&]() -> TRITONSERVER_Error*
+    {
+        RETURN_IF_ERROR(TRITONSERVER_InferenceRequestNew(&request, mServer, mConfig.draftModelName.c_str(), -1));
+        RETURN_IF_ERROR(TRITONSERVER_InferenceRequestSetReleaseCallback(request, onDraftRequestRelease, call));
+        RETURN_IF_ERROR(
+            TRITONSERVER_InferenceRequestSetResponseCallback(request, mAllocator, nullptr, onDraftResponse, call));
+
+        int64_t const inputIdsShape[] = {1, call->inputLength};
+        int64_t const scalarShape[] = {1, 1};
+        RETURN_IF_ERROR(TRITONSERVER_InferenceRequestAddInput(
+            request, kInputIdsTensorName.c_str(), TRITONSERVER_TYPE_INT32, inputIdsShape, 2));
+        RETURN_IF_ERROR(TRITONSERVER_InferenceRequestAppendInputData(request, kInputIdsTensorName.c_str(),
+            call->inputIds.data(), call->inputIds.size() * sizeof(int32_t), TRITONSERVER_MEMORY_CPU, 0));
+        RETURN_IF_ERROR(TRITONSERVER_InferenceRequestAddInput(
+            request, kInputLengthsTensorName.c_str(), TRITONSERVER_TYPE_INT32, scalarShape, 2));
+        RETURN_IF_ERROR(TRITONSERVER_InferenceRequestAppendInputData(request, kInputLengthsTensorName.c_str(),
+            &call->inputLength, sizeof(int32_t), TRITONSERVER_MEMORY_CPU, 0));
+        RETURN_IF_ERROR(TRITONSERVER_InferenceRequestAddInput(
+            request, kRequestOutputLenTensorName.c_str(), TRITONSERVER_TYPE_INT32, scalarShape, 2));
+        RETURN_IF_ERROR(TRITONSERVER_InferenceRequestAppendInputData(request, kRequestOutputLenTensorName.c_str(),
+            &call->outputLen, sizeof(int32_t), TRITONSERVER_MEMORY_CPU, 0));
+        RETURN_IF_ERROR(TRITONSERVER_InferenceRequestAddRequestedOutput(request, "output_ids"));
+        RETURN_IF_ERROR(TRITONSERVER_InferenceRequestAddRequestedOutput(request, "sequence_length"));
+
+        return TRITONSERVER_ServerInferAsync(mServer, request, nullptr);
+    }();
+
+    if (err != nullptr)
+    {
+        // Triton does not call the callbacks of requests that were not submitted, continue without draft
+        TLLM_LOG_WARNING("Failed to request a draft from model %s for requestId %lu: %s",
+            mConfig.draftModelName.c_str(), requestId, TRITONSERVER_ErrorMessage(err));
+        TRITONSERVER_ErrorDelete(err);
+        if (request != nullptr)
+        {
+            LOG_IF_ERROR(TRITONSERVER_InferenceRequestDelete(request), "Failed to delete draft model request");
+        }
+        call->numRefs = 1;
+        releaseDraftCall(call);
+        submitRound(requestId, {}, draftLength);
+    }
+}
+
+TRITONSERVER_Error* SpeculativeDecoder::allocateDraftOutput(TRITONSERVER_ResponseAllocator* allocator,
+    char const* tensorName, size_t byteSize, TRITONSERVER_MemoryType memoryType, int64_t memoryTypeId, void* userp,
+    void** buffer, void** bufferUserp, TRITONSERVER_MemoryType* actualMemoryType, int64_t* actualMemoryTypeId)
+{
+    *buffer = byteSize > 0 ? std::malloc(byteSize) : nullptr;
+    *bufferUserp = nullptr;
+    *actualMemoryType = TRITONSERVER_MEMORY_CPU;
+    *actualMemoryTypeId = 0;
+    if (byteSize > 0 && *buffer == nullptr)
+    {
+        return TRITONSERVER_ErrorNew(TRITONSERVER_ERROR_INTERNAL, "Failed to allocate draft model output");
+    }
+    return nullptr;
+}
+
+TRITONSERVER_Error* SpeculativeDecoder::releaseDraftOutput(TRITONSERVER_ResponseAllocator* allocator, void* buffer,
+    void* bufferUserp, size_t byteSize, TRITONSERVER_MemoryType memoryType, int64_t memoryTypeId)
+{
+    std::free(buffer);
+    return nullptr;
+}
+
+void SpeculativeDecoder::onDraftRequestRelease(
+    TRITONSERVER_InferenceRequest* request, uint32_t const flags, void* userp)
+{
+    if ((flags & TRITONSERVER_REQUEST_RELEASE_ALL) == 0)
+    {
+        return;
+    }
+    LOG_IF_ERROR(TRITONSERVER_InferenceRequestDelete(request), "Failed to delete draft model request");
+    auto* call = static_cast<DraftCall*>(userp);
+    call->decoder->releaseDraftCall(call);
+}
+
+void SpeculativeDecoder::onDraftResponse(TRITONSERVER_InferenceResponse* response, uint32_t const flags, void* userp)
+{
+    auto* call = static_cast<DraftCall*>(userp);
+    if (response != nullptr)
+    {
+        auto* err = TRITONSERVER_InferenceResponseError(response);
+        if (err != nullptr)
+        {
+            TLLM_LOG_WARNING("Draft model %s failed for requestId %lu: %s",
+                call->decoder->mConfig.draftModelName.c_str(), call->requestId, TRITONSERVER_ErrorMessage(err));
+            TRITONSERVER_ErrorDelete(err);
+        }
+        else
+        {
+            int32_t const* outputIds = nullptr;
+            int64_t outputWidth = 0;
+            int32_t sequenceLength = -1;
+            uint32_t numOutputs = 0;
+            LOG_IF_ERROR(TRITONSERVER_InferenceResponseOutputCount(response, &numOutputs), "Error getting outputs");
+            for (uint32_t i = 0; i < numOutputs; ++i)
+            {
+                char const* name = nullptr;
+                TRITONSERVER_DataType dataType;
+                int64_t const* shape = nullptr;
+                uint64_t dimsCount = 0;
+                void const* base = nullptr;
+                size_t byteSize = 0;
+                TRITONSERVER_MemoryType memoryType;
+                int64_t memoryTypeId = 0;
+                void* outputUserp = nullptr;
+                if (TRITONSERVER_InferenceResponseOutput(response, i, &name, &dataType, &shape, &dimsCount, &base,
+                        &byteSize, &memoryType, &memoryTypeId, &outputUserp)
+                        != nullptr
+                    || dataType != TRITONSERVER_TYPE_INT32 || byteSize == 0)
+                {
+                    continue;
+                }
+                if (std::string(name) == "output_ids" && dimsCount > 0)
+                {
+                    outputIds = static_cast<int32_t const*>(base);
+                    outputWidth = shape[dimsCount - 1];
+                }
+                else if (std::string(name) == "sequence_length")
+                {
+                    sequenceLength = *static_cast<int32_t const*>(base);
+                }
+            }
+
+            // The draft model may or may not exclude the input from its output_ids
+            if (outputIds != nullptr)
+            {
+                auto const length = sequenceLength < 0 ? outputWidth : std::min<int64_t>(sequenceLength, outputWidth);
+                std::vector<int32_t> ids(outputIds, outputIds + std::max<int64_t>(length, 0));
+                auto const& inputIds = call->inputIds;
+                auto begin = ids.begin();
+                if (ids.size() >= inputIds.size() && std::equal(inputIds.begin(), inputIds.end(), ids.begin()))
+                {
+                    begin += inputIds.size();
+                }
+                call->draftIds.insert(call->draftIds.end(), begin, ids.end());
+            }
+        }
+        LOG_IF_ERROR(TRITONSERVER_InferenceResponseDelete(response), "Failed to delete draft model response");
+    }
+
+    if (flags & TRITONSERVER_RESPONSE_COMPLETE_FINAL)
+    {
+        auto* decoder = call->decoder;
+        decoder->submitRound(call->requestId, std::move(call->draftIds), call->outputLen);
+        decoder->releaseDraftCall(call);
+    }
+}
+
+void SpeculativeDecoder::releaseDraftCall(DraftCall* call)
+{
+    if (--call->numRefs > 0)
+    {
+        return;
+    }
+    delete call;
+
+    std::lock_guard<std::mutex> lk(mMutex);
+    --mNumDraftCalls;
+    mDraftCallsCV.notify_all();
+}
+
+} // namespace triton::backend::inflight_batcher_llm
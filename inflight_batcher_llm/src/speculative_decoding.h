@@ -0,0 +1,212 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include "prompt_lookup.h"
+#include "tensorrt_llm/batch_manager/inferenceRequest.h"
+#include "tensorrt_llm/batch_manager/namedTensor.h"
+#include "triton/core/tritonserver.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace triton::backend::inflight_batcher_llm
+{
+
+/// @brief Drives speculative decoding of requests on the engine of this instance. Each round, a few tokens are drafted
+/// from the current sequence, either by a draft model served by the same Triton server or by prompt lookup, and the
+/// engine verifies them through `draft_input_ids` and returns the accepted tokens plus one token of its own. Rounds
+/// are regular inference requests that reuse the request id of the client request. The draft length adapts to the
+/// observed acceptance rate of the request and is reduced when requests are waiting to be scheduled, and requests
+/// whose drafts are mostly rejected generate their remaining tokens without drafts.
+/// Only greedy requests with a beam width of 1 are decoded speculatively, other requests are left untouched.
+class SpeculativeDecoder
+{
+    using InferenceRequest = tensorrt_llm::batch_manager::InferenceRequest;
+    using NamedTensor = tensorrt_llm::batch_manager::NamedTensor;
+
+public:
+    /// @brief Callback queuing the next round of a request for the engine
+    using SubmitRoundCallback = std::function<void(uint64_t requestId, std::shared_ptr<InferenceRequest> round)>;
+
+    struct Config
+    {
+        /// Name of the model drafting tokens, empty if drafts only come from prompt lookup
+        std::string draftModelName;
+        /// Maximum number of tokens drafted per round
+        int32_t maxDraftLength = 4;
+        /// Maximum size of the n-grams matched by prompt lookup, 0 disables prompt lookup
+        int32_t promptLookupMaxNgramSize = 0;
+        /// Whether requests that do not set the `prompt_lookup` input use prompt lookup
+        bool promptLookupByDefault = false;
+        /// Acceptance rate below which a request stops drafting
+        float minAcceptanceRate = 0.f;
+        /// Whether the engine output_ids exclude the input ids
+        bool excludeInputInOutput = false;
+    };
+
+    /// @param server Triton server serving the draft model, may be null without draft model
+    /// @param numPendingRequests Number of requests waiting to be scheduled, used to shorten drafts under load
+    SpeculativeDecoder(TRITONSERVER_Server* server, Config config, SubmitRoundCallback submitRound,
+        std::function<size_t()> numPendingRequests);
+
+    /// @brief Wait for the outstanding draft model requests
+    ~SpeculativeDecoder();
+
+    /// @brief Take over the generation of a request, if it can be decoded speculatively
+    /// @return The first round of the request, or nullptr if the request is not decoded speculatively
+    std::shared_ptr<InferenceRequest> start(std::shared_ptr<InferenceRequest> const& inferenceRequest);
+
+    /// @brief Whether the request is decoded speculatively
+    bool isActive(uint64_t requestId) const;
+
+    /// @brief Outcome of a round
+    struct RoundResult
+    {
+        /// Whether the request is complete
+        bool finished = false;
+        /// Tensors to send to the client, empty if nothing has to be sent
+        std::list<NamedTensor> responseTensors;
+    };
+
+    /// @brief Accept the tokens of the final response of a round
+    /// Once the response has been sent, `continueRequest` must be called for requests that are not finished.
+    RoundResult onRoundComplete(uint64_t requestId, std::list<NamedTensor> const& responseTensors);
+
+    /// @brief Draft the next round of a request, and submit it once the draft is available
+    void continueRequest(uint64_t requestId);
+
+    /// @brief Stop decoding a request speculatively, e.g. after an error or a cancellation
+    void erase(uint64_t requestId);
+
+    /// @brief Number of draft tokens submitted to the engine for verification
+    uint64_t numDraftTokens() const
+    {
+        return mNumDraftTokens.load();
+    }
+
+    /// @brief Number of draft tokens accepted by the engine
+    uint64_t numAcceptedTokens() const
+    {
+        return mNumAcceptedTokens.load();
+    }
+
+    /// @brief Number of rounds completed by the engine
+    uint64_t numRounds() const
+    {
+        return mNumRounds.load();
+    }
+
+    /// @brief Number of requests that stopped drafting because of a low acceptance rate
+    uint64_t numFallbacks() const
+    {
+        return mNumFallbacks.load();
+    }
+
+private:
+    /// number of rounds with a draft after which a request with a low acceptance rate stops drafting
+    static constexpr int32_t kMinDraftRoundsBeforeFallback = 4;
+
+    /// @brief Speculative decoding state of a request
+    struct RequestState
+    {
+        std::shared_ptr<InferenceRequest> request;
+        std::vector<int32_t> promptIds;
+        std::vector<int32_t> generatedIds;
+        std::vector<int32_t> draftIds;
+        int32_t maxNewTokens;
+        int32_t roundOutputLen;
+        int32_t draftLength;
+        std::optional<int32_t> endId;
+        /// minimum number of tokens generated over all the rounds
+        int32_t minLength{0};
+        /// stop and bad words of the request, matched across rounds
+        std::vector<std::vector<int32_t>> stopWords;
+        std::vector<std::vector<int32_t>> badWords;
+        /// n-gram index of the sequence, if the request uses prompt lookup
+        std::optional<PromptLookup> promptLookup;
+        int32_t numDraftRounds{0};
+        int64_t numDraftTokens{0};
+        int64_t numAcceptedTokens{0};
+        bool draftingDisabled{false};
+    };
+
+    /// @brief Build the inference request of a round from the original request
+    std::shared_ptr<InferenceRequest> makeRound(RequestState const& state, int32_t outputLen, bool isStreaming) const;
+
+    /// @brief Record the draft of the next round of a request and build the round. Without draft, the round
+    /// generates draftLength + 1 tokens.
+    std::shared_ptr<InferenceRequest> prepareRound(
+        RequestState& state, std::vector<int32_t> draftIds, int32_t draftLength) const;
+
+    /// @brief Submit the next round of a request once the draft model answered
+    void submitRound(uint64_t requestId, std::vector<int32_t> draftIds, int32_t draftLength);
+
+    /// @brief Send the sequence of a request to the draft model, `submitRound` is called with the draft
+    void requestDraft(uint64_t requestId, std::vector<int32_t> const& inputIds, int32_t draftLength);
+
+    static TRITONSERVER_Error* allocateDraftOutput(TRITONSERVER_ResponseAllocator* allocator, char const* tensorName,
+        size_t byteSize, TRITONSERVER_MemoryType memoryType, int64_t memoryTypeId, void* userp, void** buffer,
+        void** bufferUserp, TRITONSERVER_MemoryType* actualMemoryType, int64_t* actualMemoryTypeId);
+    static TRITONSERVER_Error* releaseDraftOutput(TRITONSERVER_ResponseAllocator* allocator, void* buffer,
+        void* bufferUserp, size_t byteSize, TRITONSERVER_MemoryType memoryType, int64_t memoryTypeId);
+    static void onDraftRequestRelease(TRITONSERVER_InferenceRequest* request, uint32_t const flags, void* userp);
+    static void onDraftResponse(TRITONSERVER_InferenceResponse* response, uint32_t const flags, void* userp);
+
+    struct DraftCall;
+    /// @brief Release a reference to a draft call, the last one frees it
+    void releaseDraftCall(DraftCall* call);
+
+    TRITONSERVER_Server* mServer;
+    Config mConfig;
+    SubmitRoundCallback mSubmitRound;
+    std::function<size_t()> mNumPendingRequests;
+    TRITONSERVER_ResponseAllocator* mAllocator{nullptr};
+
+    mutable std::mutex mMutex;
+    std::unordered_map<uint64_t, RequestState> mRequests;
+    /// number of draft model requests in flight, the destructor waits for them
+    size_t mNumDraftCalls{0};
+    std::condition_variable mDraftCallsCV;
+
+    std::atomic<uint64_t> mNumDraftTokens{0};
+    std::atomic<uint64_t> mNumAcceptedTokens{0};
+    std::atomic<uint64_t> mNumRounds{0};
+    std::atomic<uint64_t> mNumFallbacks{0};
+};
+
+} // namespace triton::backend::inflight_batcher_llm
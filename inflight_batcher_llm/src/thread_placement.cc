@@ -0,0 +1,224 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "thread_placement.h"
+
+#include "tensorrt_llm/common/logger.h"
+
+#include <cuda_runtime_api.h>
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sstream>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace triton::backend::inflight_batcher_llm
+{
+
+namespace
+{
+
+/// @brief Parse a list of CPUs in the format of the kernel, e.g. "0-15,32-47"
+std::optional<cpu_set_t> parseCpuList(std::string const& cpuList)
+{
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    std::stringstream ss(cpuList);
+    std::string range;
+    while (std::getline(ss, range, ','))
+    {
+        if (range.empty() || std::all_of(range.begin(), range.end(), [](char c) { return std::isspace(c); }))
+        {
+            continue;
+        }
+        try
+        {
+            auto const dash = range.find('-');
+            int const first = std::stoi(range.substr(0, dash));
+            int const last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int cpu = first; cpu <= last && cpu < CPU_SETSIZE; ++cpu)
+            {
+                CPU_SET(cpu, &cpus);
+            }
+        }
+        catch (std::exception const& e)
+        {
+            return std::nullopt;
+        }
+    }
+    if (CPU_COUNT(&cpus) == 0)
+    {
+        return std::nullopt;
+    }
+    return cpus;
+}
+
+std::optional<std::string> readFirstLine(std::string const& path)
+{
+    std::ifstream file(path);
+    std::string line;
+    if (!file.is_open() || !std::getline(file, line))
+    {
+        return std::nullopt;
+    }
+    return line;
+}
+
+/// @brief sysfs directory of the PCI device of a GPU
+std::optional<std::string> getPciDevicePath(int32_t deviceId)
+{
+    char busId[32] = {};
+    if (cudaDeviceGetPCIBusId(busId, sizeof(busId), deviceId) != cudaSuccess)
+    {
+        return std::nullopt;
+    }
+    std::string path = "/sys/bus/pci/devices/" + std::string(busId);
+    std::transform(path.begin(), path.end(), path.begin(), [](unsigned char c) { return std::tolower(c); });
+    return path;
+}
+
+long setMemoryPolicy(int mode, unsigned long const* nodeMask, unsigned long maxNode)
+{
+    return syscall(SYS_set_mempolicy, mode, nodeMask, maxNode);
+}
+
+long getMemoryPolicy(int* mode, unsigned long* nodeMask, unsigned long maxNode)
+{
+    return syscall(SYS_get_mempolicy, mode, nodeMask, maxNode, nullptr, 0UL);
+}
+
+} // namespace
+
+void ThreadPlacement::apply() const
+{
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0)
+    {
+        TLLM_LOG_WARNING("Failed to set the CPU affinity of a backend thread");
+    }
+    if (numaNode >= 0 && numaNode < static_cast<int32_t>(8 * sizeof(unsigned long)))
+    {
+        unsigned long const nodeMask = 1UL << numaNode;
+        if (setMemoryPolicy(MPOL_PREFERRED, &nodeMask, 8 * sizeof(nodeMask)) != 0)
+        {
+            TLLM_LOG_WARNING("Failed to prefer NUMA node %d for the memory of a backend thread", numaNode);
+        }
+    }
+}
+
+std::optional<ThreadPlacement> getThreadPlacement(std::string const& cpuAffinity, int32_t deviceId)
+{
+    if (cpuAffinity == "none")
+    {
+        return std::nullopt;
+    }
+
+    ThreadPlacement placement;
+    if (cpuAffinity != "auto")
+    {
+        auto cpus = parseCpuList(cpuAffinity);
+        if (!cpus)
+        {
+            TLLM_LOG_WARNING("Invalid cpu_affinity %s, backend threads are not pinned", cpuAffinity.c_str());
+            return std::nullopt;
+        }
+        placement.cpus = cpus.value();
+        return placement;
+    }
+
+    auto const devicePath = getPciDevicePath(deviceId);
+    auto const localCpuList = devicePath ? readFirstLine(devicePath.value() + "/local_cpulist") : std::nullopt;
+    auto const cpus = localCpuList ? parseCpuList(localCpuList.value()) : std::nullopt;
+    if (!cpus)
+    {
+        TLLM_LOG_WARNING("Cannot find the CPUs local to GPU %d, backend threads are not pinned", deviceId);
+        return std::nullopt;
+    }
+    placement.cpus = cpus.value();
+
+    // numa_node is -1 on single-node hosts
+    if (auto const numaNode = readFirstLine(devicePath.value() + "/numa_node"))
+    {
+        try
+        {
+            placement.numaNode = std::stoi(numaNode.value());
+        }
+        catch (std::exception const& e)
+        {
+            placement.numaNode = -1;
+        }
+    }
+
+    TLLM_LOG_INFO("Backend threads serving GPU %d are pinned to CPUs %s, NUMA node %d", deviceId,
+        localCpuList.value().c_str(), placement.numaNode);
+    return placement;
+}
+
+ScopedThreadPlacement::ScopedThreadPlacement(std::optional<ThreadPlacement> const& placement)
+{
+    if (!placement)
+    {
+        return;
+    }
+
+    cpu_set_t previousCpus;
+    if (pthread_getaffinity_np(pthread_self(), sizeof(previousCpus), &previousCpus) == 0)
+    {
+        mPreviousCpus = previousCpus;
+    }
+    // The calling thread may already have a policy of its own, e.g. set by numactl
+    MemoryPolicy previousMemoryPolicy{};
+    if (placement->numaNode >= 0
+        && getMemoryPolicy(&previousMemoryPolicy.mode, previousMemoryPolicy.nodeMask,
+               8 * sizeof(previousMemoryPolicy.nodeMask))
+            == 0)
+    {
+        mPreviousMemoryPolicy = previousMemoryPolicy;
+    }
+    placement->apply();
+}
+
+ScopedThreadPlacement::~ScopedThreadPlacement()
+{
+    if (mPreviousCpus)
+    {
+        pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &mPreviousCpus.value());
+    }
+    if (mPreviousMemoryPolicy)
+    {
+        auto const& policy = mPreviousMemoryPolicy.value();
+        if (setMemoryPolicy(policy.mode, policy.nodeMask, 8 * sizeof(policy.nodeMask)) != 0)
+        {
+            TLLM_LOG_WARNING("Failed to restore the memory policy of a backend thread");
+        }
+    }
+}
+
+} // namespace triton::backend::inflight_batcher_llm
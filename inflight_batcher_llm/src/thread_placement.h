@@ -0,0 +1,82 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <sched.h>
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace triton::backend::inflight_batcher_llm
+{
+
+/// @brief CPUs and NUMA node on which the host threads serving a GPU run and allocate their memory
+struct ThreadPlacement
+{
+    cpu_set_t cpus;
+    // NUMA node preferred for the memory allocated by the threads, -1 to keep the default policy
+    int32_t numaNode = -1;
+
+    /// @brief Pin the calling thread to the CPUs and prefer allocating its memory on the NUMA node. Threads created
+    /// by the calling thread afterwards inherit the placement.
+    void apply() const;
+};
+
+/// @brief Resolve the cpu_affinity parameter of a model
+/// @param cpuAffinity "auto" for the CPUs local to the GPU, "none" to not pin the threads, or a list of CPUs such as
+/// "0-15,32-47"
+/// @param deviceId GPU served by the threads, used by "auto"
+/// @return std::nullopt if the threads are not pinned
+std::optional<ThreadPlacement> getThreadPlacement(std::string const& cpuAffinity, int32_t deviceId);
+
+/// @brief Apply a placement to the calling thread, and restore its CPUs and memory policy when destroyed. Used
+/// around the creation of threads that inherit the placement, e.g. those of GptManager.
+class ScopedThreadPlacement
+{
+public:
+    explicit ScopedThreadPlacement(std::optional<ThreadPlacement> const& placement);
+    ~ScopedThreadPlacement();
+
+    ScopedThreadPlacement(ScopedThreadPlacement const&) = delete;
+    ScopedThreadPlacement& operator=(ScopedThreadPlacement const&) = delete;
+
+private:
+    /// @brief Memory policy of a thread, as returned by get_mempolicy
+    struct MemoryPolicy
+    {
+        int mode;
+        // large enough for the nodes of any host the kernel supports by default
+        unsigned long nodeMask[16];
+    };
+
+    std::optional<cpu_set_t> mPreviousCpus;
+    std::optional<MemoryPolicy> mPreviousMemoryPolicy;
+};
+
+} // namespace triton::backend::inflight_batcher_llm
@@ -0,0 +1,168 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "top_k_logits.h"
+
+#include "input_conversion.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace triton::backend::inflight_batcher_llm
+{
+
+namespace
+{
+
+using tensorrt_llm::batch_manager::NamedTensor;
+
+/// @brief Convert a row of logits to fp32
+void rowToFloat(NamedTensor const& logits, size_t offset, size_t size, float* dst)
+{
+    if (logits.tensor->getDataType() == nvinfer1::DataType::kHALF)
+    {
+        auto const* data = static_cast<uint16_t const*>(logits.tensor->data()) + offset;
+        std::transform(data, data + size, dst, halfToFloat);
+    }
+    else if (logits.tensor->getDataType() == nvinfer1::DataType::kFLOAT)
+    {
+        auto const* data = static_cast<float const*>(logits.tensor->data()) + offset;
+        std::copy(data, data + size, dst);
+    }
+    else
+    {
+        throw std::runtime_error("Unsupported data type for top-k reduction of " + logits.name);
+    }
+}
+
+void reduce(NamedTensor const& logits, std::string const& prefix, int32_t k, bool logProbsFp16,
+    std::list<NamedTensor>& reduced)
+{
+    auto const shape = logits.tensor->getShape();
+    if (shape.nbDims < 1)
+    {
+        return;
+    }
+    auto const vocabSize = static_cast<int32_t>(shape.d[shape.nbDims - 1]);
+    auto const topK = std::min(k, vocabSize);
+
+    std::vector<int64_t> reducedShape(shape.d, shape.d + shape.nbDims);
+    reducedShape.back() = topK;
+    auto const numPositions = vocabSize > 0 ? logits.tensor->getSize() / vocabSize : 0;
+
+    NamedTensor ids(nvinfer1::DataType::kINT32, reducedShape, prefix + "_top_k_ids");
+    NamedTensor logProbs(logProbsFp16 ? nvinfer1::DataType::kHALF : nvinfer1::DataType::kFLOAT, reducedShape,
+        prefix + "_top_k_log_probs");
+    auto* idsData = static_cast<int32_t*>(ids.tensor->data());
+
+    // Greater logits first, lower token ids first on ties. The heap keeps the smallest of the top-k at its front.
+    auto const isBetter = [](std::pair<float, int32_t> const& a, std::pair<float, int32_t> const& b)
+    { return a.first > b.first || (a.first == b.first && a.second < b.second); };
+
+    std::vector<float> row(vocabSize);
+    std::vector<std::pair<float, int32_t>> heap;
+    heap.reserve(topK);
+    for (size_t pos = 0; pos < numPositions; ++pos)
+    {
+        rowToFloat(logits, pos * vocabSize, vocabSize, row.data());
+
+        // Single pass over the row: the log-softmax normalizer is accumulated online, rescaled whenever the maximum
+        // grows, while a bounded heap keeps the top-k
+        heap.clear();
+        float maxLogit = row[0];
+        double sumExp = 0.0;
+        for (int32_t v = 0; v < vocabSize; ++v)
+        {
+            auto const logit = row[v];
+            if (logit > maxLogit)
+            {
+                sumExp = sumExp * std::exp(static_cast<double>(maxLogit - logit)) + 1.0;
+                maxLogit = logit;
+            }
+            else
+            {
+                sumExp += std::exp(static_cast<double>(logit - maxLogit));
+            }
+
+            if (static_cast<int32_t>(heap.size()) < topK)
+            {
+                heap.emplace_back(logit, v);
+                std::push_heap(heap.begin(), heap.end(), isBetter);
+            }
+            else if (topK > 0 && isBetter({logit, v}, heap.front()))
+            {
+                std::pop_heap(heap.begin(), heap.end(), isBetter);
+                heap.back() = {logit, v};
+                std::push_heap(heap.begin(), heap.end(), isBetter);
+            }
+        }
+        auto const logNormalizer = maxLogit + static_cast<float>(std::log(sumExp));
+        std::sort_heap(heap.begin(), heap.end(), isBetter);
+
+        for (int32_t i = 0; i < topK; ++i)
+        {
+            auto const out = pos * topK + i;
+            auto const logProb = heap[i].first - logNormalizer;
+            idsData[out] = heap[i].second;
+            if (logProbsFp16)
+            {
+                static_cast<uint16_t*>(logProbs.tensor->data())[out] = floatToHalf(logProb);
+            }
+            else
+            {
+                static_cast<float*>(logProbs.tensor->data())[out] = logProb;
+            }
+        }
+    }
+
+    reduced.push_back(std::move(ids));
+    reduced.push_back(std::move(logProbs));
+}
+
+} // namespace
+
+std::list<NamedTensor> reduceLogitsToTopK(std::list<NamedTensor> const& responseTensors, int32_t k, bool logProbsFp16)
+{
+    std::list<NamedTensor> reduced;
+    for (auto const& tensor : responseTensors)
+    {
+        if (tensor.name == "context_logits" || tensor.name == "generation_logits")
+        {
+            auto const prefix = tensor.name.substr(0, tensor.name.find('_'));
+            reduce(tensor, prefix, k, logProbsFp16, reduced);
+        }
+        else
+        {
+            reduced.push_back(tensor);
+        }
+    }
+    return reduced;
+}
+
+} // namespace triton::backend::inflight_batcher_llm
@@ -0,0 +1,46 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "tensorrt_llm/batch_manager/namedTensor.h"
+
+#include <cstdint>
+#include <list>
+#include <string>
+
+namespace triton::backend::inflight_batcher_llm
+{
+
+/// @brief Replace the `context_logits` and `generation_logits` response tensors by the ids and log-probs of their k
+/// most likely tokens at each position. The reduced tensors are named `<prefix>_top_k_ids` and
+/// `<prefix>_top_k_log_probs`, where prefix is `context` or `generation`, and have the shape of the logits with the
+/// vocabulary dimension replaced by k.
+/// @param logProbsFp16 Encode the log-probs as fp16 instead of fp32
+std::list<tensorrt_llm::batch_manager::NamedTensor> reduceLogitsToTopK(
+    std::list<tensorrt_llm::batch_manager::NamedTensor> const& responseTensors, int32_t k, bool logProbsFp16);
+
+} // namespace triton::backend::inflight_batcher_llm
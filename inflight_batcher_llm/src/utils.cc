@@ -25,18 +25,17 @@
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "utils.h"
+#include <algorithm>
 #include <cassert>
+#include <stdexcept>
+#include <tuple>
 
 namespace triton::backend::inflight_batcher_llm::utils
 {
 
 nvinfer1::DataType to_trt_datatype(TRITONSERVER_DataType data_type)
 {
-    if (data_type == TRITONSERVER_TYPE_INVALID)
-    {
-        assert(false);
-    }
-    else if (data_type == TRITONSERVER_TYPE_BOOL)
+    if (data_type == TRITONSERVER_TYPE_BOOL)
     {
         return nvinfer1::DataType::kBOOL;
     }
@@ -44,26 +43,10 @@ nvinfer1::DataType to_trt_datatype(TRITONSERVER_DataType data_type)
     {
         return nvinfer1::DataType::kUINT8;
     }
-    else if (data_type == TRITONSERVER_TYPE_UINT16)
-    {
-        assert(false);
-    }
-    else if (data_type == TRITONSERVER_TYPE_UINT32)
-    {
-        return nvinfer1::DataType::kINT32;
-    }
-    else if (data_type == TRITONSERVER_TYPE_UINT64)
-    {
-        return nvinfer1::DataType::kINT64;
-    }
     else if (data_type == TRITONSERVER_TYPE_INT8)
     {
         return nvinfer1::DataType::kINT8;
     }
-    else if (data_type == TRITONSERVER_TYPE_INT16)
-    {
-        assert(false);
-    }
     else if (data_type == TRITONSERVER_TYPE_INT32)
     {
         return nvinfer1::DataType::kINT32;
@@ -80,23 +63,13 @@ nvinfer1::DataType to_trt_datatype(TRITONSERVER_DataType data_type)
     {
         return nvinfer1::DataType::kFLOAT;
     }
-    else if (data_type == TRITONSERVER_TYPE_FP64)
-    {
-        assert(false);
-    }
-    else if (data_type == TRITONSERVER_TYPE_BYTES)
-    {
-        return nvinfer1::DataType::kINT8;
-    }
     else if (data_type == TRITONSERVER_TYPE_BF16)
     {
         return nvinfer1::DataType::kBF16;
     }
-    else
-    {
-        assert(false);
-    }
-    return nvinfer1::DataType(0);
+    // Unsigned 32/64-bit integers are converted by getInputDataType, the other types have no TensorRT equivalent
+    throw std::invalid_argument(
+        std::string("Triton data type ") + TRITONSERVER_DataTypeString(data_type) + " has no TensorRT equivalent");
 }
 
 TRITONSERVER_DataType to_triton_datatype(nvinfer1::DataType data_type)
@@ -198,6 +171,216 @@ std::unordered_set<std::string> getRequestOutputNames(TRITONBACKEND_Request* req
     return outputNames;
 }
 
+bool getRequestCorrelationId(TRITONBACKEND_Request* request, uint64_t& correlationId)
+{
+    TRITONSERVER_Error* err = TRITONBACKEND_RequestCorrelationId(request, &correlationId);
+    if (err != nullptr)
+    {
+        TRITONSERVER_ErrorDelete(err);
+        return false;
+    }
+    return true;
+}
+
+std::optional<uint64_t> getRequestLoraTaskId(TRITONBACKEND_Request* request)
+{
+    TRITONBACKEND_Input* input;
+    TRITONSERVER_Error* error
+        = TRITONBACKEND_RequestInput(request, tensorrt_llm::batch_manager::inference_request::kLoraTaskId, &input);
+    if (error)
+    {
+        TRITONSERVER_ErrorDelete(error);
+        return std::nullopt;
+    }
+
+    TRITONSERVER_DataType data_type = TRITONSERVER_TYPE_INVALID;
+    TRITONBACKEND_InputProperties(input, nullptr, &data_type, nullptr, nullptr, nullptr, nullptr);
+
+    void const* buffer = 0L;
+    uint64_t buffer_byte_size = 0;
+    TRITONSERVER_MemoryType memory_type = TRITONSERVER_MEMORY_CPU;
+    int64_t memory_type_id = 0;
+    TRITONBACKEND_InputBuffer(input, 0, &buffer, &buffer_byte_size, &memory_type, &memory_type_id);
+    assert((memory_type == TRITONSERVER_MEMORY_CPU) || (memory_type == TRITONSERVER_MEMORY_CPU_PINNED));
+
+    // lora_task_id is declared as TYPE_UINT64, 32-bit task ids are accepted since the inputs are converted
+    if (buffer_byte_size >= sizeof(uint64_t)
+        && (data_type == TRITONSERVER_TYPE_UINT64 || data_type == TRITONSERVER_TYPE_INT64))
+    {
+        return *static_cast<uint64_t const*>(buffer);
+    }
+    if (buffer_byte_size >= sizeof(uint32_t)
+        && (data_type == TRITONSERVER_TYPE_UINT32 || data_type == TRITONSERVER_TYPE_INT32))
+    {
+        return *static_cast<uint32_t const*>(buffer);
+    }
+    return std::nullopt;
+}
+
+bool hasRequestInput(TRITONBACKEND_Request* request, std::string const& inputTensorName)
+{
+    TRITONBACKEND_Input* input;
+    TRITONSERVER_Error* error = TRITONBACKEND_RequestInput(request, inputTensorName.c_str(), &input);
+    if (error)
+    {
+        TRITONSERVER_ErrorDelete(error);
+        return false;
+    }
+    return true;
+}
+
+std::optional<uint64_t> getLoraTaskId(tensorrt_llm::batch_manager::InferenceRequest const& inferenceRequest)
+{
+    auto const loraTaskId = inferenceRequest.getLoraTaskIdUnchecked();
+    if (!loraTaskId || !loraTaskId.value())
+    {
+        return std::nullopt;
+    }
+    return *static_cast<uint64_t const*>(loraTaskId.value()->data());
+}
+
+std::optional<uint64_t> getLoraTaskIdWithoutWeights(
+    tensorrt_llm::batch_manager::InferenceRequest const& inferenceRequest)
+{
+    if (inferenceRequest.getLoraWeightsUnchecked())
+    {
+        return std::nullopt;
+    }
+    return getLoraTaskId(inferenceRequest);
+}
+
+namespace
+{
+
+using tensorrt_llm::batch_manager::InferenceRequest;
+using tensorrt_llm::batch_manager::NamedTensor;
+
+struct OutputFlag
+{
+    std::string flagName;
+    std::vector<std::string> outputNames;
+};
+
+std::vector<OutputFlag> const& outputFlags()
+{
+    static std::vector<OutputFlag> const flags{
+        {tensorrt_llm::batch_manager::inference_request::kReturnLogProbsTensorName,
+            {"cum_log_probs", "output_log_probs"}},
+        {tensorrt_llm::batch_manager::inference_request::kReturnContextLogitsTensorName,
+            {"context_logits", "context_top_k_ids", "context_top_k_log_probs"}},
+        {tensorrt_llm::batch_manager::inference_request::kReturnGenerationLogitsTensorName,
+            {"generation_logits", "generation_top_k_ids", "generation_top_k_log_probs"}}};
+    return flags;
+}
+
+} // namespace
+
+void enableTopKLogitsOutputs(InferenceRequest& inferenceRequest, std::unordered_set<std::string> const& outputNames,
+    std::optional<bool> gatherContextLogits, std::optional<bool> gatherGenerationLogits)
+{
+    auto const topK = inferenceRequest.getInputTensorUnchecked(kLogitsTopKInputTensorName);
+    if (!topK || !topK.value() || *static_cast<int32_t const*>(topK.value()->data()) <= 0)
+    {
+        return;
+    }
+
+    for (auto const& [flagName, prefix, gather] :
+        {std::make_tuple(tensorrt_llm::batch_manager::inference_request::kReturnContextLogitsTensorName, "context",
+             gatherContextLogits.value_or(true)),
+            std::make_tuple(tensorrt_llm::batch_manager::inference_request::kReturnGenerationLogitsTensorName,
+                "generation", gatherGenerationLogits.value_or(true))})
+    {
+        // The engine rejects the requests for logits it does not gather
+        auto const prefixStr = std::string(prefix);
+        if (!gather
+            || (outputNames.count(prefixStr + "_top_k_ids") == 0
+                && outputNames.count(prefixStr + "_top_k_log_probs") == 0))
+        {
+            continue;
+        }
+
+        NamedTensor flag(nvinfer1::DataType::kBOOL, {1}, flagName);
+        *static_cast<bool*>(flag.tensor->data()) = true;
+        inferenceRequest.emplaceInputTensor(flag.name, std::move(flag.tensor));
+    }
+}
+
+void disableUnrequestedOutputs(InferenceRequest& inferenceRequest, std::unordered_set<std::string> const& outputNames)
+{
+    for (auto const& flag : outputFlags())
+    {
+        auto const isRequested = std::any_of(flag.outputNames.begin(), flag.outputNames.end(),
+            [&outputNames](std::string const& name) { return outputNames.count(name) > 0; });
+        auto const flagTensor = inferenceRequest.getInputTensorUnchecked(flag.flagName);
+        if (isRequested || !flagTensor || !flagTensor.value())
+        {
+            continue;
+        }
+
+        // Triton input buffers are copied into the request, the flag can be updated in place
+        auto* data = static_cast<bool*>(flagTensor.value()->data());
+        std::fill(data, data + flagTensor.value()->getSize(), false);
+    }
+}
+
+void setRequestedOutputNames(InferenceRequest& inferenceRequest, std::unordered_set<std::string> const& outputNames)
+{
+    // The names are NUL-terminated and concatenated
+    size_t numBytes = 0;
+    for (auto const& name : outputNames)
+    {
+        numBytes += name.size() + 1;
+    }
+    NamedTensor names(nvinfer1::DataType::kUINT8, {static_cast<int64_t>(numBytes)},
+        kRequestedOutputNamesInputTensorName);
+    auto* data = static_cast<char*>(names.tensor->data());
+    for (auto const& name : outputNames)
+    {
+        std::copy(name.c_str(), name.c_str() + name.size() + 1, data);
+        data += name.size() + 1;
+    }
+    inferenceRequest.emplaceInputTensor(names.name, std::move(names.tensor));
+}
+
+std::optional<std::unordered_set<std::string>> takeRequestedOutputNames(InferenceRequest& inferenceRequest)
+{
+    auto const tensor = inferenceRequest.getInputTensorUnchecked(kRequestedOutputNamesInputTensorName);
+    if (!tensor || !tensor.value())
+    {
+        return std::nullopt;
+    }
+
+    std::unordered_set<std::string> outputNames;
+    auto const* data = static_cast<char const*>(tensor.value()->data());
+    auto const* end = data + tensor.value()->getSize();
+    while (data < end)
+    {
+        auto const* nameEnd = std::find(data, end, '\0');
+        outputNames.emplace(data, nameEnd);
+        data = nameEnd + 1;
+    }
+    eraseInputTensors(inferenceRequest, {kRequestedOutputNamesInputTensorName});
+    return outputNames;
+}
+
+void eraseInputTensors(InferenceRequest& inferenceRequest, std::initializer_list<std::string> inputTensorNames)
+{
+    auto inputTensors = inferenceRequest.getInputTensors();
+    size_t numErased = 0;
+    for (auto const& name : inputTensorNames)
+    {
+        numErased += inputTensors.erase(name);
+    }
+    if (numErased == 0)
+    {
+        return;
+    }
+
+    InferenceRequest stripped(std::move(inputTensors), inferenceRequest.getRequestId());
+    stripped.setIsStreaming(inferenceRequest.isStreaming());
+    inferenceRequest = std::move(stripped);
+}
+
 bool getRequestBooleanInputTensor(TRITONBACKEND_Request* request, std::string const& inputTensorName)
 {
     // Get stop signal from the request
@@ -294,4 +477,20 @@ bool handleTritonRequest(TRITONBACKEND_Request* request, std::unordered_map<uint
     return false;
 }
 
+void pushTritonRequests(WorkItemsQueue& workItemsQueue, std::vector<WorkItemsQueue::RequestWrapper>& requestsToPush,
+    uint64_t exec_start_ns, std::function<void(std::shared_ptr<WorkItem>)> const& workItemCb)
+{
+    auto exceptions = workItemsQueue.pushBatch(requestsToPush, exec_start_ns, workItemCb);
+
+    for (uint32_t r = 0; r < requestsToPush.size(); ++r)
+    {
+        auto request = requestsToPush.at(r).triton_request;
+        auto e = exceptions.at(r);
+        if (e)
+        {
+            utils::sendEnqueueResponse(request, e->what());
+        }
+    }
+}
+
 } // namespace triton::backend::inflight_batcher_llm::utils
@@ -30,11 +30,14 @@
 #include "work_items_queue.h"
 
 #include "NvInfer.h"
+#include "tensorrt_llm/batch_manager/inferenceRequest.h"
 #include "tensorrt_llm/common/logger.h"
 #include "tensorrt_llm/runtime/tllmLogger.h"
 #include "triton/backend/backend_common.h"
 #include "triton/core/tritonbackend.h"
 #include "triton/core/tritonserver.h"
+#include <functional>
+#include <optional>
 #include <string>
 #include <unordered_set>
 
@@ -42,11 +45,21 @@ namespace triton::backend::inflight_batcher_llm
 {
 inline static const std::string kStopInputTensorName = "stop";
 inline static const std::string kStreamingInputTensorName = "streaming";
+inline static const std::string kPromptEmbeddingTableIdInputTensorName = "prompt_embedding_table_id";
+inline static const std::string kEmbeddingBiasIdsInputTensorName = "embedding_bias_ids";
+inline static const std::string kEmbeddingBiasValuesInputTensorName = "embedding_bias_values";
+inline static const std::string kLogitsTopKInputTensorName = "logits_top_k";
+inline static const std::string kTrimOutputsInputTensorName = "trim_outputs";
+inline static const std::string kReturnTopBeamOnlyInputTensorName = "return_top_beam_only";
+inline static const std::string kPromptLookupInputTensorName = "prompt_lookup";
+// names of the outputs requested by the client, sent along with the request by the orchestrator
+inline static const std::string kRequestedOutputNamesInputTensorName = "requested_output_names";
 
 namespace utils
 {
 
 /// @brief  Convert Triton datatype to TRT datatype
+/// Throws an error if the datatype has no TRT equivalent with the same representation
 nvinfer1::DataType to_trt_datatype(TRITONSERVER_DataType data_type);
 
 /// @brief  Convert TRT datatype to Triton datatype
@@ -63,6 +76,52 @@ std::string getRequestIdStr(uint64_t requestId, std::unordered_map<uint64_t, std
 /// @brief Get the requested output names
 std::unordered_set<std::string> getRequestOutputNames(TRITONBACKEND_Request* request);
 
+/// @brief Get the Triton sequence correlation id of a request
+/// @return false if the model does not use the sequence batcher
+bool getRequestCorrelationId(TRITONBACKEND_Request* request, uint64_t& correlationId);
+
+/// @brief Get the LoRA task id of a Triton request without converting its inputs
+/// @return std::nullopt if the request does not use a LoRA adapter
+std::optional<uint64_t> getRequestLoraTaskId(TRITONBACKEND_Request* request);
+
+/// @brief Whether a Triton request provides an input
+bool hasRequestInput(TRITONBACKEND_Request* request, std::string const& inputTensorName);
+
+/// @brief Get the LoRA task id of an inference request
+/// @return std::nullopt if the request does not use a LoRA adapter
+std::optional<uint64_t> getLoraTaskId(tensorrt_llm::batch_manager::InferenceRequest const& inferenceRequest);
+
+/// @brief Get the LoRA task id of an inference request that references an adapter without providing its weights
+/// @return std::nullopt if the request does not use a LoRA adapter or provides the adapter weights
+std::optional<uint64_t> getLoraTaskIdWithoutWeights(
+    tensorrt_llm::batch_manager::InferenceRequest const& inferenceRequest);
+
+/// @brief Enable the return_context_logits and return_generation_logits flags of a request that sets logits_top_k
+/// and requests the corresponding top-k outputs, the top-k are computed from the logits. A flag is only enabled if
+/// the engine gathers the corresponding logits, or if it is unknown whether it does.
+void enableTopKLogitsOutputs(tensorrt_llm::batch_manager::InferenceRequest& inferenceRequest,
+    std::unordered_set<std::string> const& outputNames, std::optional<bool> gatherContextLogits,
+    std::optional<bool> gatherGenerationLogits);
+
+/// @brief Disable the return_log_probs, return_context_logits and return_generation_logits flags of a request
+/// when none of the corresponding outputs has been requested, so that they are neither gathered nor returned
+void disableUnrequestedOutputs(tensorrt_llm::batch_manager::InferenceRequest& inferenceRequest,
+    std::unordered_set<std::string> const& outputNames);
+
+/// @brief Attach the names of the requested outputs to a request, for the leader-worker rank that sends its responses
+void setRequestedOutputNames(tensorrt_llm::batch_manager::InferenceRequest& inferenceRequest,
+    std::unordered_set<std::string> const& outputNames);
+
+/// @brief Get the names of the requested outputs attached to a request and remove them from the request
+/// @return std::nullopt if the request does not carry them
+std::optional<std::unordered_set<std::string>> takeRequestedOutputNames(
+    tensorrt_llm::batch_manager::InferenceRequest& inferenceRequest);
+
+/// @brief Remove input tensors from an inference request, once the backend has consumed them
+/// InferenceRequest cannot erase a tensor, the request is rebuilt in place without them.
+void eraseInputTensors(tensorrt_llm::batch_manager::InferenceRequest& inferenceRequest,
+    std::initializer_list<std::string> inputTensorNames);
+
 /// @brief Get the value of a boolean tensor
 bool getRequestBooleanInputTensor(TRITONBACKEND_Request* request, std::string const& inputTensorName);
 
@@ -75,5 +134,9 @@ void sendEnqueueResponse(TRITONBACKEND_Request* request, std::string const& errM
 bool handleTritonRequest(TRITONBACKEND_Request* request, std::unordered_map<uint64_t, std::string>& requestIdStrMap,
     std::vector<WorkItemsQueue::RequestWrapper>& requestsToPush, WorkItemsQueue& workItemsQueue);
 
+/// @brief Push a batch of requests to the work items queue and answer the requests it rejects with their error
+void pushTritonRequests(WorkItemsQueue& workItemsQueue, std::vector<WorkItemsQueue::RequestWrapper>& requestsToPush,
+    uint64_t exec_start_ns, std::function<void(std::shared_ptr<WorkItem>)> const& workItemCb = nullptr);
+
 } // namespace utils
 } // namespace triton::backend::inflight_batcher_llm
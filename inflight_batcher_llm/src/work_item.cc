@@ -26,33 +26,69 @@
 
 #include "work_item.h"
 
+#include "request_arena.h"
+#include "sampling_params.h"
 #include "utils.h"
 
-#include <map>
+#include <algorithm>
 
 namespace triton::backend::inflight_batcher_llm
 {
 
-WorkItem::WorkItem(TRITONBACKEND_Request* request, bool isDecoupled)
+namespace
+{
+
+using tensorrt_llm::runtime::ITensor;
+
+/// @brief Input of a Triton request with the tensor it is converted to
+struct RequestInput
+{
+    TRITONBACKEND_Input* input;
+    char const* name;
+    TRITONSERVER_DataType dataType;
+    uint32_t bufferCount;
+    ITensor::Shape shape;
+    nvinfer1::DataType tensorDataType;
+    size_t elementSize;
+    // field of the packed sampling parameters the input is copied into, if any
+    void* samplingParam;
+};
+
+} // namespace
+
+WorkItem::WorkItem(TRITONBACKEND_Request* request, bool isDecoupled, std::shared_ptr<SessionStore> sessionStore,
+    EngineDataTypes const& engineDataTypes, bool deferConversion)
 {
     uint64_t requestId = (rand() % INT64_MAX) + 1;
-    Initialize(request, requestId, isDecoupled);
+    Initialize(request, requestId, isDecoupled, std::move(sessionStore), engineDataTypes, deferConversion);
 }
 
-WorkItem::WorkItem(TRITONBACKEND_Request* request, uint64_t requestId, bool isDecoupled)
+WorkItem::WorkItem(TRITONBACKEND_Request* request, uint64_t requestId, bool isDecoupled,
+    std::shared_ptr<SessionStore> sessionStore, EngineDataTypes const& engineDataTypes, bool deferConversion)
 {
-    Initialize(request, requestId, isDecoupled);
+    Initialize(request, requestId, isDecoupled, std::move(sessionStore), engineDataTypes, deferConversion);
 }
 
-WorkItem::WorkItem(std::shared_ptr<tensorrt_llm::batch_manager::InferenceRequest> ir, uint64_t RequestId)
+WorkItem::WorkItem(std::shared_ptr<tensorrt_llm::batch_manager::InferenceRequest> ir, uint64_t RequestId,
+    ResponseCallback responseCallback)
     : mInferenceRequest(ir)
+    , mIsStreaming(ir->isStreaming())
     , mRequestId(RequestId)
+    , mLoraTaskId(utils::getLoraTaskId(*ir))
+    , mHasLoraWeights(ir->getLoraWeightsUnchecked().has_value())
+    , mTritonInferenceRequest(nullptr)
 {
     factory_ptr_ = nullptr;
+    mResponseCallback = std::move(responseCallback);
 }
 
 WorkItem::~WorkItem()
 {
+    // A turn released without final response, its history is unknown
+    if (mSessionTurn)
+    {
+        mSessionStore->erase(mSessionTurn->correlationId);
+    }
     if (factory_ptr_ != nullptr)
     {
         TRITONBACKEND_ResponseFactoryDelete(factory_ptr_);
@@ -65,6 +101,22 @@ TRITONBACKEND_ResponseFactory* WorkItem::response_factory()
     return factory_ptr_;
 }
 
+WorkItem::ResponseCallback const& WorkItem::responseCallback() const
+{
+    return mResponseCallback;
+}
+
+bool WorkItem::isCancelled()
+{
+    if (factory_ptr_ == nullptr)
+    {
+        return false;
+    }
+    bool is_cancelled = false;
+    TRITONBACKEND_ResponseFactoryIsCancelled(factory_ptr_, &is_cancelled);
+    return is_cancelled;
+}
+
 uint64_t WorkItem::requestId() const
 {
     return mRequestId;
@@ -75,20 +127,38 @@ std::shared_ptr<tensorrt_llm::batch_manager::InferenceRequest> WorkItem::getInfe
     return mInferenceRequest;
 }
 
+void WorkItem::setInferenceRequest(std::shared_ptr<InferenceRequest> inferenceRequest)
+{
+    mInferenceRequest = std::move(inferenceRequest);
+}
+
 bool WorkItem::hasOutputName(std::string const& outputName)
 {
     return (mRequestOutputNames.find(outputName) != mRequestOutputNames.end());
 }
 
+std::optional<uint64_t> WorkItem::loraTaskId() const
+{
+    return mLoraTaskId;
+}
+
+std::optional<uint64_t> WorkItem::loraTaskIdWithoutWeights() const
+{
+    return mHasLoraWeights ? std::nullopt : mLoraTaskId;
+}
+
 std::shared_ptr<tensorrt_llm::batch_manager::InferenceRequest> WorkItem::createInferenceRequest(
-    TRITONBACKEND_Request* request, uint64_t requestId, bool isDecoupled)
+    TRITONBACKEND_Request* request, uint64_t requestId, bool isStreaming, EngineDataTypes const& engineDataTypes)
 {
-    auto inferenceRequest = std::make_shared<InferenceRequest>(requestId);
+    // Scalar sampling inputs are packed into a single block instead of one tensor each
+    SamplingParams samplingParams;
 
-    // Extract input tensors
-    std::map<std::string, NamedTensor> input_tensors;
+    // Extract the input properties first, to place the request and all its tensors in a single arena
     uint32_t num_inputs;
     LOG_IF_ERROR(TRITONBACKEND_RequestInputCount(request, &num_inputs), "Error getting input count");
+    std::vector<RequestInput> inputs;
+    inputs.reserve(num_inputs);
+    size_t arenaBytes = sizeof(InferenceRequest) + RequestArena::kObjectBytes;
     for (uint32_t idx = 0; idx < num_inputs; ++idx)
     {
         TRITONBACKEND_Input* input = 0L;
@@ -109,58 +179,201 @@ std::shared_ptr<tensorrt_llm::batch_manager::InferenceRequest> WorkItem::createI
             continue;
         }
 
-        std::vector<int64_t> shapev;
-        for (uint32_t i = 0; i < dims_count; ++i)
+        if (dims_count > static_cast<uint32_t>(nvinfer1::Dims::MAX_DIMS))
+        {
+            throw std::invalid_argument("input " + std::string(input_name) + " has " + std::to_string(dims_count)
+                + " dimensions, more than the engine supports");
+        }
+        RequestInput& in = inputs.emplace_back();
+        in.input = input;
+        in.name = input_name;
+        in.dataType = data_type;
+        in.bufferCount = buffer_count;
+        in.shape.nbDims = static_cast<int32_t>(dims_count);
+        std::copy(shape, shape + dims_count, in.shape.d);
+
+        // The inputs are converted to the data types of the engine while they are copied
+        in.tensorDataType = getInputDataType(input_name, data_type, engineDataTypes);
+        in.elementSize = TRITONSERVER_DataTypeByteSize(utils::to_triton_datatype(in.tensorDataType));
+        auto const numElements = ITensor::volume(in.shape);
+        in.samplingParam = samplingParams.slot(input_name, in.tensorDataType, numElements);
+        if (in.samplingParam == nullptr)
         {
-            shapev.push_back(shape[i]);
+            arenaBytes += RequestArena::tensorBytes(numElements * in.elementSize);
         }
+    }
+    if (!samplingParams.empty())
+    {
+        arenaBytes += RequestArena::tensorBytes(sizeof(SamplingParams));
+    }
 
-        NamedTensor t(utils::to_trt_datatype(data_type), shapev, input_name);
+    auto arena = RequestArena::create(arenaBytes);
+    auto inferenceRequest
+        = std::allocate_shared<InferenceRequest>(RequestArena::Allocator<InferenceRequest>(arena), requestId);
+    for (auto const& in : inputs)
+    {
+        ITensor::SharedPtr tensor;
+        auto* dst = static_cast<char*>(in.samplingParam);
+        if (dst == nullptr)
+        {
+            tensor = RequestArena::allocateTensor(arena, in.tensorDataType, in.shape);
+            dst = static_cast<char*>(tensor->data());
+        }
+        auto const srcElementSize = TRITONSERVER_DataTypeByteSize(in.dataType);
         uint64_t buffer_offset = 0;
-        for (int64_t buffer_id = 0; buffer_id < buffer_count; ++buffer_id)
+        for (int64_t buffer_id = 0; buffer_id < in.bufferCount; ++buffer_id)
         {
             void const* buffer = 0L;
             uint64_t buffer_byte_size = 0;
             TRITONSERVER_MemoryType memory_type = TRITONSERVER_MEMORY_CPU;
             int64_t memory_type_id = 0;
-            TRITONBACKEND_InputBuffer(input, buffer_id, &buffer, &buffer_byte_size, &memory_type, &memory_type_id);
+            TRITONBACKEND_InputBuffer(in.input, buffer_id, &buffer, &buffer_byte_size, &memory_type, &memory_type_id);
             assert((memory_type == TRITONSERVER_MEMORY_CPU) || (memory_type == TRITONSERVER_MEMORY_CPU_PINNED));
             // TODO: Do we need to handle GPU mem input buffers??
-            std::memcpy(static_cast<char*>(t.tensor->data()) + buffer_offset, buffer, buffer_byte_size);
-            buffer_offset += buffer_byte_size;
+            auto const numElements = buffer_byte_size / srcElementSize;
+            convertInput(in.name, buffer, in.dataType, dst + buffer_offset, in.tensorDataType, numElements);
+            buffer_offset += numElements * in.elementSize;
         }
 
-        inferenceRequest->emplaceInputTensor(t.name, std::move(t.tensor));
+        if (tensor)
+        {
+            inferenceRequest->emplaceInputTensor(in.name, std::move(tensor));
+        }
     }
 
-    bool streamingFlag = utils::getRequestBooleanInputTensor(request, kStreamingInputTensorName);
-    inferenceRequest->setIsStreaming(streamingFlag);
-
-    if (streamingFlag && !isDecoupled)
+    if (!samplingParams.empty())
     {
-        throw std::runtime_error(
-            "Streaming is only supported if model is "
-            "deployed using decoupled mode.");
+        samplingParams.store(*inferenceRequest, arena);
     }
 
+    inferenceRequest->setIsStreaming(isStreaming);
+
     return inferenceRequest;
 }
 
-void WorkItem::Initialize(TRITONBACKEND_Request* request, uint64_t requestId, bool isDecoupled)
+void WorkItem::Initialize(TRITONBACKEND_Request* request, uint64_t requestId, bool isDecoupled,
+    std::shared_ptr<SessionStore> sessionStore, EngineDataTypes const& engineDataTypes, bool deferConversion)
 {
     mRequestId = requestId;
-    mInferenceRequest = createInferenceRequest(request, requestId, isDecoupled);
+    mIsStreaming = utils::getRequestBooleanInputTensor(request, kStreamingInputTensorName);
+    if (mIsStreaming && !isDecoupled)
+    {
+        throw std::runtime_error(
+            "Streaming is only supported if model is "
+            "deployed using decoupled mode.");
+    }
+
+    // Store an unconverted version of the TRITONBACKEND_Request to convert its inputs once it is scheduled, and to
+    // release the request when the base metrics have been reported
+    mTritonInferenceRequest = request;
+    mSessionStore = std::move(sessionStore);
     mRequestOutputNames = utils::getRequestOutputNames(request);
+    if (deferConversion)
+    {
+        // The queue policies only need the LoRA adapter of the request
+        mLoraTaskId = utils::getRequestLoraTaskId(request);
+        mHasLoraWeights = utils::hasRequestInput(request, tensorrt_llm::batch_manager::inference_request::kLoraWeights);
+    }
+    else
+    {
+        materialize(engineDataTypes);
+    }
 
     // Create response factory for this request
     TRITONBACKEND_ResponseFactoryNew(&factory_ptr_, request);
-
-    // Store an unconverted version of the TRITONBACKEND_Request to be used
-    // to release the request when the base metrics have been reported
-    mTritonInferenceRequest = request;
     mTimestamps.Reset();
 }
 
+void WorkItem::materialize(EngineDataTypes const& engineDataTypes)
+{
+    if (mInferenceRequest)
+    {
+        return;
+    }
+    materialize(convert(engineDataTypes));
+}
+
+WorkItem::Materialized WorkItem::convert(EngineDataTypes const& engineDataTypes) const
+{
+    auto* request = mTritonInferenceRequest;
+    Materialized materialized;
+    materialized.inferenceRequest = createInferenceRequest(request, mRequestId, mIsStreaming, engineDataTypes);
+    auto& inferenceRequest = *materialized.inferenceRequest;
+
+    // Requests of a sequence are turns of a session, the session history is prepended to their input ids
+    uint64_t correlationId = 0;
+    if (mSessionStore && utils::getRequestCorrelationId(request, correlationId) && correlationId != 0)
+    {
+        uint32_t flags = 0;
+        LOG_IF_ERROR(TRITONBACKEND_RequestFlags(request, &flags), "Error getting request flags");
+        bool const start = flags & TRITONSERVER_REQUEST_FLAG_SEQUENCE_START;
+        bool const end = flags & TRITONSERVER_REQUEST_FLAG_SEQUENCE_END;
+        auto inputIds = mSessionStore->beginTurn(inferenceRequest, correlationId, start);
+        materialized.sessionTurn = SessionTurn{correlationId, end, std::move(inputIds), {}};
+    }
+    utils::enableTopKLogitsOutputs(inferenceRequest, mRequestOutputNames, engineDataTypes.gatherContextLogits,
+        engineDataTypes.gatherGenerationLogits);
+    utils::disableUnrequestedOutputs(inferenceRequest, mRequestOutputNames);
+    return materialized;
+}
+
+void WorkItem::materialize(Materialized materialized)
+{
+    mSessionTurn = std::move(materialized.sessionTurn);
+    mLoraTaskId = utils::getLoraTaskId(*materialized.inferenceRequest);
+    mHasLoraWeights = materialized.inferenceRequest->getLoraWeightsUnchecked().has_value();
+    mInferenceRequest = std::move(materialized.inferenceRequest);
+}
+
+void WorkItem::dematerialize()
+{
+    if (mTritonInferenceRequest != nullptr && !mSessionTurn)
+    {
+        mInferenceRequest.reset();
+    }
+}
+
+bool WorkItem::isSessionTurn() const
+{
+    uint64_t correlationId = 0;
+    return mSessionTurn
+        || (mSessionStore && mTritonInferenceRequest != nullptr
+            && utils::getRequestCorrelationId(mTritonInferenceRequest, correlationId) && correlationId != 0);
+}
+
+void WorkItem::updateSession(std::list<NamedTensor> const& responseTensors, bool finalResponse, bool hasError)
+{
+    if (!mSessionTurn)
+    {
+        return;
+    }
+
+    if (hasError)
+    {
+        // The history of the session does not match what the client received anymore
+        mSessionStore->erase(mSessionTurn->correlationId);
+        mSessionTurn.reset();
+        return;
+    }
+
+    auto outputIds = SessionStore::getFirstBeamOutputIds(responseTensors);
+    if (mIsStreaming)
+    {
+        mSessionTurn->outputIds.insert(mSessionTurn->outputIds.end(), outputIds.begin(), outputIds.end());
+    }
+    else if (!outputIds.empty())
+    {
+        mSessionTurn->outputIds = std::move(outputIds);
+    }
+
+    if (finalResponse)
+    {
+        mSessionStore->endTurn(
+            mSessionTurn->correlationId, mSessionTurn->inputIds, mSessionTurn->outputIds, mSessionTurn->end);
+        mSessionTurn.reset();
+    }
+}
+
 WorkItem::Timestamps& WorkItem::getTimestamps()
 {
     return mTimestamps;
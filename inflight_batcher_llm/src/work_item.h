@@ -26,11 +26,17 @@
 
 #pragma once
 
+#include "input_conversion.h"
+#include "session_store.h"
 #include "tensorrt_llm/batch_manager/inferenceRequest.h"
 #include "triton/backend/backend_common.h"
 #include "triton/core/tritonbackend.h"
 #include "triton/core/tritonserver.h"
+#include <functional>
+#include <list>
+#include <optional>
 #include <unordered_set>
+#include <vector>
 
 namespace triton::backend::inflight_batcher_llm
 {
@@ -43,20 +49,93 @@ class WorkItem
     using InferenceRequest = tensorrt_llm::batch_manager::InferenceRequest;
     using NamedTensor = tensorrt_llm::batch_manager::NamedTensor;
 
+    /// @brief Turn of a session, identified by the Triton sequence correlation id
+    struct SessionTurn
+    {
+        uint64_t correlationId;
+        bool end;
+        std::vector<int32_t> inputIds;
+        std::vector<int32_t> outputIds;
+    };
+
 public:
-    WorkItem(TRITONBACKEND_Request* request, bool isDecoupled);
-    WorkItem(TRITONBACKEND_Request* request, uint64_t requestId, bool isDecoupled);
-    WorkItem(std::shared_ptr<InferenceRequest> ir, uint64_t RequestId);
+    /// @brief Callback receiving the responses of a work item created in-process instead of from a Triton request
+    using ResponseCallback
+        = std::function<void(std::list<NamedTensor> const& responseTensors, bool finalResponse, std::string const&)>;
+
+    /// @param engineDataTypes Data types of the engine the inputs are converted to while they are copied
+    /// @param deferConversion Only read the metadata of the request, its inputs are converted by materialize() once
+    /// it is scheduled
+    WorkItem(TRITONBACKEND_Request* request, bool isDecoupled, std::shared_ptr<SessionStore> sessionStore = nullptr,
+        EngineDataTypes const& engineDataTypes = {}, bool deferConversion = false);
+    WorkItem(TRITONBACKEND_Request* request, uint64_t requestId, bool isDecoupled,
+        std::shared_ptr<SessionStore> sessionStore = nullptr, EngineDataTypes const& engineDataTypes = {},
+        bool deferConversion = false);
+    WorkItem(std::shared_ptr<InferenceRequest> ir, uint64_t RequestId, ResponseCallback responseCallback = nullptr);
     ~WorkItem();
 
     TRITONBACKEND_ResponseFactory* response_factory();
 
+    /// @brief Callback of a work item created in-process, nullptr for a Triton request
+    ResponseCallback const& responseCallback() const;
+
+    /// @brief Whether the client cancelled the request. In-process work items are cancelled by stopping them.
+    bool isCancelled();
+
     uint64_t requestId() const;
 
+    /// @brief The request sent to the engine, nullptr until a work item queued with deferred conversion is
+    /// materialized
     std::shared_ptr<InferenceRequest> getInferenceRequest() const;
 
+    /// @brief Convert the inputs of the Triton request into the request sent to the engine, if not done yet.
+    /// Throws an error if the inputs are invalid.
+    void materialize(EngineDataTypes const& engineDataTypes);
+
+    /// @brief Request converted from the Triton request of a work item by convert(), not yet set in the work item
+    struct Materialized
+    {
+        std::shared_ptr<InferenceRequest> inferenceRequest;
+        std::optional<SessionTurn> sessionTurn;
+    };
+
+    /// @brief Convert the inputs of the Triton request without modifying the work item, e.g. on another thread than
+    /// the one scheduling it. Throws an error if the inputs are invalid.
+    Materialized convert(EngineDataTypes const& engineDataTypes) const;
+
+    /// @brief Set the request converted by convert() as the request sent to the engine
+    void materialize(Materialized materialized);
+
+    /// @brief Drop the request sent to the engine, for the inputs to be converted again by materialize() for another
+    /// engine. No-op for the work items created in-process, which have no Triton request to convert.
+    void dematerialize();
+
+    /// @brief Whether the request is a turn of a session, whose history is kept by the session store of the instance
+    /// that queued it
+    bool isSessionTurn() const;
+
+    /// @brief Replace the request sent to the engine, e.g. by the next round of a speculatively decoded request.
+    /// Responses are still streamed if the original request is streaming.
+    void setInferenceRequest(std::shared_ptr<InferenceRequest> inferenceRequest);
+
     bool hasOutputName(std::string const& outputName);
 
+    /// @brief The names of the outputs requested by the client, empty for the requests that do not come from Triton
+    std::unordered_set<std::string> const& getRequestOutputNames() const
+    {
+        return mRequestOutputNames;
+    }
+
+    /// @brief The LoRA task id of the request, if any
+    std::optional<uint64_t> loraTaskId() const;
+
+    /// @brief The LoRA task id of a request that references an adapter without providing its weights, if any
+    std::optional<uint64_t> loraTaskIdWithoutWeights() const;
+
+    /// @brief Record the tokens of a response for the session of the request, and update the session history once
+    /// the turn is complete. No-op for requests without session.
+    void updateSession(std::list<NamedTensor> const& responseTensors, bool finalResponse, bool hasError);
+
     /// timestamp storage for Triton base metrics
     struct Timestamps
     {
@@ -82,15 +161,22 @@ public:
 
 private:
     // Convert Trition request to trtllm InferenceRequest
-    static std::shared_ptr<InferenceRequest> createInferenceRequest(
-        TRITONBACKEND_Request* request, uint64_t requestId, bool isDecoupled);
+    static std::shared_ptr<InferenceRequest> createInferenceRequest(TRITONBACKEND_Request* request,
+        uint64_t requestId, bool isStreaming, EngineDataTypes const& engineDataTypes);
 
-    void Initialize(TRITONBACKEND_Request* request, uint64_t requestId, bool isDecoupled);
+    void Initialize(TRITONBACKEND_Request* request, uint64_t requestId, bool isDecoupled,
+        std::shared_ptr<SessionStore> sessionStore, EngineDataTypes const& engineDataTypes, bool deferConversion);
 
     std::shared_ptr<InferenceRequest> mInferenceRequest;
+    bool mIsStreaming{false};
     TRITONBACKEND_ResponseFactory* factory_ptr_;
+    ResponseCallback mResponseCallback;
     uint64_t mRequestId;
     std::unordered_set<std::string> mRequestOutputNames;
+    std::optional<uint64_t> mLoraTaskId;
+    bool mHasLoraWeights{false};
+    std::shared_ptr<SessionStore> mSessionStore;
+    std::optional<SessionTurn> mSessionTurn;
 
     Timestamps mTimestamps;
     TRITONBACKEND_Request* mTritonInferenceRequest;
@@ -25,8 +25,12 @@
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "work_items_queue.h"
+#include "utils.h"
 #include "work_item.h"
 
+#include <algorithm>
+#include <optional>
+
 namespace triton::backend::inflight_batcher_llm
 {
 
@@ -35,13 +39,53 @@ WorkItemsQueue::WorkItemsQueue(bool isDecoupled)
 {
 }
 
+WorkItemsQueue::~WorkItemsQueue()
+{
+    {
+        std::lock_guard<std::mutex> lk(mMutex);
+        mStopMaterializing = true;
+    }
+    mMaterializeCV.notify_all();
+    if (mMaterializeThread.joinable())
+    {
+        mMaterializeThread.join();
+    }
+}
+
 void WorkItemsQueue::clear()
 {
-    std::lock_guard<std::mutex> lk(mMutex);
+    std::unique_lock<std::mutex> lk(mMutex);
+    // The work items leave the queue once the background thread has converted them
+    mMaterializedCV.wait(lk, [this]() { return mMaterializingReqIds.empty(); });
     mPendingWorkItems.clear();
     mPendingWorkItemsReqIds.clear();
     mInProgressWorkItems.clear();
     mStoppedReqIds.clear();
+    mConversions.clear();
+    mEmptyCV.notify_all();
+}
+
+void WorkItemsQueue::setDeferConversion(bool deferConversion)
+{
+    std::lock_guard<std::mutex> lk(mMutex);
+    mDeferConversion = deferConversion;
+    if (mDeferConversion && !mMaterializeThread.joinable())
+    {
+        mMaterializeThread = std::thread([this]() { MaterializeThread(); });
+    }
+}
+
+void WorkItemsQueue::materializeAhead(size_t numWorkItems)
+{
+    {
+        std::lock_guard<std::mutex> lk(mMutex);
+        if (numWorkItems <= mNumMaterializedAhead)
+        {
+            return;
+        }
+        mNumMaterializedAhead = numWorkItems;
+    }
+    mMaterializeCV.notify_one();
 }
 
 /// @brief Add a batch of new work item to the queue
@@ -49,71 +93,329 @@ void WorkItemsQueue::clear()
 std::vector<std::shared_ptr<std::exception>> WorkItemsQueue::pushBatch(std::vector<RequestWrapper>& requestsToPush,
     uint64_t exec_start_ns, std::function<void(std::shared_ptr<WorkItem>)> const& workItemCb)
 {
-    std::lock_guard<std::mutex> lk(mMutex);
-    std::vector<std::shared_ptr<std::exception>> reqExceptions;
-    for (auto& [requestId, request] : requestsToPush)
+    std::shared_ptr<SessionStore> sessionStore;
+    std::shared_ptr<RequestValidator> requestValidator;
+    EngineDataTypes engineDataTypes;
+    bool deferConversion = false;
     {
-        if (requestId != 0 && (hasInProgressReqId(requestId) || hasPendingReqId(requestId)))
-        {
-            std::string errStr
-                = "requestId " + std::to_string(requestId) + " is already in progress, request is ignored.";
-            reqExceptions.emplace_back(std::make_shared<std::runtime_error>(errStr));
-        }
-        else
+        std::lock_guard<std::mutex> lk(mMutex);
+        sessionStore = mSessionStore;
+        requestValidator = mRequestValidator;
+        engineDataTypes = mEngineDataTypes;
+        deferConversion = mDeferConversion;
+    }
+
+    // The requests are validated from the properties of their Triton inputs before they are copied, and converted
+    // outside of the lock
+    std::vector<std::shared_ptr<std::exception>> reqExceptions(requestsToPush.size());
+    std::vector<std::shared_ptr<WorkItem>> workItems(requestsToPush.size());
+    for (size_t i = 0; i < requestsToPush.size(); ++i)
+    {
+        auto& [requestId, request] = requestsToPush[i];
+        try
         {
-            try
+            // Checked again once the work items are added, but a duplicate must not begin a turn of its session
+            if (requestId != 0)
             {
-                auto workItem = requestId != 0 ? std::make_shared<WorkItem>(request, requestId, mIsDecoupled)
-                                               : std::make_shared<WorkItem>(request, mIsDecoupled);
-                mPendingWorkItems.push_back(workItem);
-                mPendingWorkItemsReqIds.insert(workItem->requestId());
-                workItem->getTimestamps().exec_start_ns = exec_start_ns;
-                reqExceptions.push_back(nullptr);
-
-                if (workItemCb)
+                std::lock_guard<std::mutex> lk(mMutex);
+                if (hasInProgressReqId(requestId) || hasPendingReqId(requestId))
                 {
-                    workItemCb(workItem);
+                    throw std::runtime_error(
+                        "requestId " + std::to_string(requestId) + " is already in progress, request is ignored.");
                 }
             }
-            catch (std::exception const& e)
+            if (requestValidator)
             {
-                reqExceptions.emplace_back(std::make_shared<std::runtime_error>(e.what()));
+                requestValidator->validate(request, requestId);
             }
+            auto workItem = requestId != 0
+                ? std::make_shared<WorkItem>(
+                    request, requestId, mIsDecoupled, sessionStore, engineDataTypes, deferConversion)
+                : std::make_shared<WorkItem>(request, mIsDecoupled, sessionStore, engineDataTypes, deferConversion);
+            // The history prepended to the input of a session turn is only known once the request is converted
+            if (requestValidator && workItem->getInferenceRequest() && workItem->isSessionTurn())
+            {
+                try
+                {
+                    requestValidator->validate(*workItem->getInferenceRequest());
+                }
+                catch (std::exception const& e)
+                {
+                    // A rejected turn must not leave its session in progress, the next turn starts a new history
+                    workItem->updateSession({}, true, true);
+                    throw;
+                }
+            }
+            workItems[i] = std::move(workItem);
+        }
+        catch (std::exception const& e)
+        {
+            reqExceptions[i] = std::make_shared<std::runtime_error>(e.what());
         }
     }
+
+    std::lock_guard<std::mutex> lk(mMutex);
+    for (size_t i = 0; i < workItems.size(); ++i)
+    {
+        auto& workItem = workItems[i];
+        if (!workItem)
+        {
+            continue;
+        }
+        auto const requestId = workItem->requestId();
+        if (hasInProgressReqId(requestId) || hasPendingReqId(requestId))
+        {
+            std::string errStr
+                = "requestId " + std::to_string(requestId) + " is already in progress, request is ignored.";
+            reqExceptions[i] = std::make_shared<std::runtime_error>(errStr);
+            workItem->updateSession({}, true, true);
+            continue;
+        }
+        mPendingWorkItems.push_back(workItem);
+        mPendingWorkItemsReqIds.insert(requestId);
+        workItem->getTimestamps().exec_start_ns = exec_start_ns;
+
+        if (workItemCb)
+        {
+            workItemCb(workItem);
+        }
+    }
+    if (deferConversion)
+    {
+        mMaterializeCV.notify_one();
+    }
     return reqExceptions;
 }
 
-std::tuple<std::shared_ptr<WorkItem>, bool> WorkItemsQueue::pop()
+void WorkItemsQueue::push(std::shared_ptr<WorkItem> workItem)
 {
     std::lock_guard<std::mutex> lk(mMutex);
+    auto const requestId = workItem->requestId();
+    if (hasInProgressReqId(requestId) || hasPendingReqId(requestId))
+    {
+        throw std::runtime_error(
+            "requestId " + std::to_string(requestId) + " is already in progress, request is ignored.");
+    }
+    if (mRequestValidator)
+    {
+        mRequestValidator->validate(*workItem->getInferenceRequest());
+    }
+    mPendingWorkItems.push_back(std::move(workItem));
+    mPendingWorkItemsReqIds.insert(requestId);
+}
+
+bool WorkItemsQueue::materialize(WorkItem& workItem, bool convertIfNotReady)
+{
+    auto const requestId = workItem.requestId();
+    std::optional<Conversion> conversion;
+    EngineDataTypes engineDataTypes;
+    std::shared_ptr<RequestValidator> requestValidator;
+    {
+        std::unique_lock<std::mutex> lk(mMutex);
+        if (workItem.getInferenceRequest())
+        {
+            return true;
+        }
+        if (!convertIfNotReady && (mMaterializingReqIds.count(requestId) != 0 || isMaterializedAhead(workItem)))
+        {
+            return false;
+        }
+        mMaterializedCV.wait(lk, [&]() { return mMaterializingReqIds.count(requestId) == 0; });
+        auto it = mConversions.find(requestId);
+        if (it != mConversions.end())
+        {
+            conversion = std::move(it->second);
+            mConversions.erase(it);
+        }
+        else
+        {
+            mMaterializingReqIds.insert(requestId);
+        }
+        engineDataTypes = mEngineDataTypes;
+        requestValidator = mRequestValidator;
+    }
+
+    if (!conversion)
+    {
+        // The background thread did not get to the work item, its inputs are converted here outside of the lock
+        conversion = convert(workItem, engineDataTypes);
+    }
+    {
+        std::lock_guard<std::mutex> lk(mMutex);
+        mMaterializingReqIds.erase(requestId);
+        if (!conversion->error)
+        {
+            workItem.materialize(std::move(conversion->materialized));
+        }
+    }
+    mMaterializedCV.notify_all();
+    if (conversion->error)
+    {
+        std::rethrow_exception(conversion->error);
+    }
+    // The other requests were validated when they were pushed
+    if (requestValidator && workItem.isSessionTurn())
+    {
+        requestValidator->validate(*workItem.getInferenceRequest());
+    }
+    return true;
+}
+
+bool WorkItemsQueue::needsMaterializing(WorkItem const& workItem) const
+{
+    auto const requestId = workItem.requestId();
+    return workItem.getTritonInferenceRequest() != nullptr && !workItem.getInferenceRequest()
+        && mConversions.count(requestId) == 0 && mMaterializingReqIds.count(requestId) == 0
+        && mStoppedReqIds.count(requestId) == 0 && !workItem.isSessionTurn();
+}
+
+std::shared_ptr<WorkItem> WorkItemsQueue::nextToMaterialize() const
+{
+    size_t numInspected = 0;
+    for (auto it = mPendingWorkItems.begin(); it != mPendingWorkItems.end() && numInspected < mNumMaterializedAhead;
+         ++it, ++numInspected)
+    {
+        if (needsMaterializing(**it))
+        {
+            return *it;
+        }
+    }
+    return nullptr;
+}
+
+bool WorkItemsQueue::isMaterializedAhead(WorkItem const& workItem) const
+{
+    if (!mMaterializeThread.joinable())
+    {
+        return false;
+    }
+    size_t numInspected = 0;
+    for (auto it = mPendingWorkItems.begin(); it != mPendingWorkItems.end() && numInspected < mNumMaterializedAhead;
+         ++it, ++numInspected)
+    {
+        if (it->get() == &workItem)
+        {
+            return needsMaterializing(workItem);
+        }
+    }
+    return false;
+}
+
+WorkItemsQueue::Conversion WorkItemsQueue::convert(WorkItem const& workItem, EngineDataTypes const& engineDataTypes)
+{
+    Conversion conversion;
+    try
+    {
+        conversion.materialized = workItem.convert(engineDataTypes);
+    }
+    catch (std::exception const& e)
+    {
+        conversion.error = std::current_exception();
+    }
+    return conversion;
+}
+
+void WorkItemsQueue::MaterializeThread()
+{
+    std::unique_lock<std::mutex> lk(mMutex);
+    while (true)
+    {
+        std::shared_ptr<WorkItem> workItem;
+        mMaterializeCV.wait(lk, [&]() { return mStopMaterializing || (workItem = nextToMaterialize()) != nullptr; });
+        if (mStopMaterializing)
+        {
+            return;
+        }
+        auto const requestId = workItem->requestId();
+        mMaterializingReqIds.insert(requestId);
+        auto const engineDataTypes = mEngineDataTypes;
+        lk.unlock();
+
+        Conversion conversion;
+        if (workItem->isCancelled())
+        {
+            // Answered once it is scheduled, without copying its inputs
+            conversion.error = std::make_exception_ptr(
+                std::runtime_error("request " + std::to_string(requestId) + " was cancelled while queued"));
+        }
+        else
+        {
+            conversion = convert(*workItem, engineDataTypes);
+        }
+
+        lk.lock();
+        // The work item cannot leave the queue while it is converted
+        mMaterializingReqIds.erase(requestId);
+        mConversions.emplace(requestId, std::move(conversion));
+        auto const materializedCallback = mMaterializedCallback;
+        lk.unlock();
+        mMaterializedCV.notify_all();
+        if (materializedCallback)
+        {
+            materializedCallback();
+        }
+        workItem.reset();
+        lk.lock();
+    }
+}
+
+std::tuple<std::shared_ptr<WorkItem>, bool> WorkItemsQueue::pop()
+{
+    std::unique_lock<std::mutex> lk(mMutex);
 
     if (mPendingWorkItems.empty())
     {
         return {nullptr, false};
     }
 
-    auto workItem = mPendingWorkItems.front();
-    mPendingWorkItems.pop_front();
+    auto workItemIt = mPendingWorkItems.begin();
+    if (mLoraSchedulingPolicy)
+    {
+        workItemIt = mLoraSchedulingPolicy->select(
+            mPendingWorkItems, [](std::shared_ptr<WorkItem> const& wi) { return wi->loraTaskId(); });
+    }
+
+    auto workItem = *workItemIt;
+    if (mMaterializingReqIds.count(workItem->requestId()) != 0)
+    {
+        // The work item leaves the queue once the background thread has converted it
+        mMaterializedCV.wait(lk, [&]() { return mMaterializingReqIds.count(workItem->requestId()) == 0; });
+        workItemIt = std::find(mPendingWorkItems.begin(), mPendingWorkItems.end(), workItem);
+        if (workItemIt == mPendingWorkItems.end())
+        {
+            return {nullptr, false};
+        }
+    }
+    mPendingWorkItems.erase(workItemIt);
     mPendingWorkItemsReqIds.erase(workItem->requestId());
     SET_TIMESTAMP(workItem->getTimestamps().compute_start_ns);
+    if (mDeferConversion)
+    {
+        // The next work items enter the window converted ahead
+        mMaterializeCV.notify_one();
+    }
 
     // Check if work item has been stopped
     bool is_stopped = mStoppedReqIds.count(workItem->requestId());
 
     // Check if the Triton request has been cancelled
-    bool is_cancelled = false;
-    TRITONBACKEND_ResponseFactoryIsCancelled(workItem->response_factory(), &is_cancelled);
+    bool is_cancelled = workItem->isCancelled();
 
     bool stoppedRequest = false;
     if (!is_stopped && !is_cancelled)
     {
         mInProgressWorkItems.emplace(std::make_pair(workItem->requestId(), workItem));
+        if (mLoraSchedulingPolicy)
+        {
+            mLoraSchedulingPolicy->onScheduled(workItem->loraTaskId());
+        }
     }
     else
     {
         mStoppedReqIds.erase(workItem->requestId());
+        mConversions.erase(workItem->requestId());
         stoppedRequest = true;
+        notifyIfEmpty();
     }
 
     return {workItem, stoppedRequest};
@@ -140,6 +442,127 @@ void WorkItemsQueue::markInProgress(const uint64_t requestId)
     SET_TIMESTAMP(workItem->getTimestamps().compute_start_ns);
 
     mInProgressWorkItems.emplace(std::make_pair(workItem->requestId(), workItem));
+    if (mDeferConversion)
+    {
+        mMaterializeCV.notify_one();
+    }
+}
+
+void WorkItemsQueue::resubmit(
+    uint64_t requestId, std::shared_ptr<tensorrt_llm::batch_manager::InferenceRequest> inferenceRequest)
+{
+    std::lock_guard<std::mutex> lk(mMutex);
+
+    auto it = mInProgressWorkItems.find(requestId);
+    if (it == mInProgressWorkItems.end())
+    {
+        std::string warnStr
+            = "Received resubmission for request ID " + std::to_string(requestId) + " not in progress, ignoring";
+        TLLM_LOG_WARNING(warnStr);
+        return;
+    }
+
+    auto workItem = it->second;
+    mInProgressWorkItems.erase(it);
+    workItem->setInferenceRequest(std::move(inferenceRequest));
+    // The request has already been admitted, it is scheduled before new requests
+    mPendingWorkItems.push_front(workItem);
+    mPendingWorkItemsReqIds.insert(requestId);
+}
+
+std::list<std::shared_ptr<WorkItem>> WorkItemsQueue::takePendingWorkItems(
+    std::function<bool(WorkItem const&)> const& predicate)
+{
+    std::lock_guard<std::mutex> lk(mMutex);
+
+    std::list<std::shared_ptr<WorkItem>> taken;
+    for (auto it = mPendingWorkItems.begin(); it != mPendingWorkItems.end();)
+    {
+        auto const requestId = (*it)->requestId();
+        if (mStoppedReqIds.count(requestId) == 0 && mMaterializingReqIds.count(requestId) == 0 && predicate(**it))
+        {
+            mPendingWorkItemsReqIds.erase(requestId);
+            // The inputs are converted again for the engine of the queue adopting the work item
+            mConversions.erase(requestId);
+            taken.splice(taken.end(), mPendingWorkItems, it++);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    notifyIfEmpty();
+    return taken;
+}
+
+std::list<std::shared_ptr<WorkItem>> WorkItemsQueue::adoptPendingWorkItems(
+    std::list<std::shared_ptr<WorkItem>> workItems)
+{
+    std::lock_guard<std::mutex> lk(mMutex);
+
+    std::list<std::shared_ptr<WorkItem>> rejected;
+    for (auto it = workItems.begin(); it != workItems.end();)
+    {
+        auto& workItem = **it;
+        auto const requestId = workItem.requestId();
+        bool adopted = !hasInProgressReqId(requestId) && !hasPendingReqId(requestId);
+        if (adopted)
+        {
+            // The inputs were converted for the data types of the engine of the other queue
+            workItem.dematerialize();
+            if (mRequestValidator && workItem.getInferenceRequest())
+            {
+                try
+                {
+                    mRequestValidator->validate(*workItem.getInferenceRequest());
+                }
+                catch (std::exception const& e)
+                {
+                    adopted = false;
+                }
+            }
+        }
+        if (adopted)
+        {
+            mPendingWorkItemsReqIds.insert(requestId);
+            mPendingWorkItems.splice(mPendingWorkItems.end(), workItems, it++);
+        }
+        else
+        {
+            rejected.splice(rejected.end(), workItems, it++);
+        }
+    }
+    if (mDeferConversion)
+    {
+        mMaterializeCV.notify_one();
+    }
+    return rejected;
+}
+
+std::list<std::shared_ptr<WorkItem>> WorkItemsQueue::takeAllWorkItems()
+{
+    std::unique_lock<std::mutex> lk(mMutex);
+    mMaterializedCV.wait(lk, [this]() { return mMaterializingReqIds.empty(); });
+
+    std::list<std::shared_ptr<WorkItem>> taken;
+    taken.splice(taken.end(), mPendingWorkItems);
+    for (auto& [requestId, workItem] : mInProgressWorkItems)
+    {
+        taken.push_back(std::move(workItem));
+    }
+    mPendingWorkItemsReqIds.clear();
+    mInProgressWorkItems.clear();
+    mStoppedReqIds.clear();
+    mConversions.clear();
+    mEmptyCV.notify_all();
+    return taken;
+}
+
+bool WorkItemsQueue::waitUntilEmpty(std::chrono::steady_clock::time_point deadline)
+{
+    std::unique_lock<std::mutex> lk(mMutex);
+    return mEmptyCV.wait_until(
+        lk, deadline, [this]() { return mPendingWorkItems.empty() && mInProgressWorkItems.empty(); });
 }
 
 void WorkItemsQueue::markFinished(const uint64_t requestId)
@@ -154,6 +577,7 @@ void WorkItemsQueue::markFinished(const uint64_t requestId)
     {
         mStoppedReqIds.erase(requestId);
     }
+    notifyIfEmpty();
 }
 
 void WorkItemsQueue::stopWorkItem(const uint64_t requestId)
@@ -178,9 +602,7 @@ std::unordered_set<uint64_t> WorkItemsQueue::getCancelledInProgressReqIds() cons
         std::lock_guard<std::mutex> lk(mMutex);
         for (auto const& pair : mInProgressWorkItems)
         {
-            bool is_cancelled = false;
-            TRITONBACKEND_ResponseFactoryIsCancelled(pair.second->response_factory(), &is_cancelled);
-            if (is_cancelled)
+            if (pair.second->isCancelled())
             {
                 cancelledInProgressReqIds.emplace(pair.first);
             }
@@ -189,4 +611,21 @@ std::unordered_set<uint64_t> WorkItemsQueue::getCancelledInProgressReqIds() cons
     return cancelledInProgressReqIds;
 }
 
+std::vector<uint64_t> WorkItemsQueue::getPendingLoraTaskIdsWithoutWeights(size_t maxNumWorkItems) const
+{
+    std::vector<uint64_t> taskIds;
+    std::lock_guard<std::mutex> lk(mMutex);
+    size_t numWorkItems = 0;
+    for (auto it = mPendingWorkItems.begin(); it != mPendingWorkItems.end() && numWorkItems < maxNumWorkItems;
+         ++it, ++numWorkItems)
+    {
+        auto const taskId = (*it)->loraTaskIdWithoutWeights();
+        if (taskId)
+        {
+            taskIds.push_back(taskId.value());
+        }
+    }
+    return taskIds;
+}
+
 } // namespace triton::backend::inflight_batcher_llm
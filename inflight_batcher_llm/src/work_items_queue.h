@@ -26,11 +26,19 @@
 
 #pragma once
 
+#include "lora_scheduling_policy.h"
+#include "request_validator.h"
 #include "tensorrt_llm/common/logger.h"
 #include "triton/backend/backend_common.h"
 #include "triton/core/tritonbackend.h"
 #include "work_item.h"
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
 #include <list>
+#include <thread>
+#include <unordered_map>
 
 namespace triton::backend::inflight_batcher_llm
 {
@@ -40,6 +48,7 @@ class WorkItemsQueue
 {
 public:
     WorkItemsQueue(bool isDecoupled);
+    ~WorkItemsQueue();
 
     /// @brief A wrapper for a request
     struct RequestWrapper
@@ -58,6 +67,64 @@ public:
     /// @brief Clear the queue
     void clear();
 
+    /// @brief Set the policy used by pop() to group requests by LoRA adapter.
+    /// Without policy, work items are popped in arrival order.
+    void setLoraSchedulingPolicy(std::shared_ptr<LoraSchedulingPolicy> loraSchedulingPolicy)
+    {
+        std::lock_guard<std::mutex> lk(mMutex);
+        mLoraSchedulingPolicy = std::move(loraSchedulingPolicy);
+    }
+
+    /// @brief Set the store holding the history of multi-turn sessions.
+    /// Without store, requests are independent of each other.
+    void setSessionStore(std::shared_ptr<SessionStore> sessionStore)
+    {
+        std::lock_guard<std::mutex> lk(mMutex);
+        mSessionStore = std::move(sessionStore);
+    }
+
+    /// @brief Set the validator checking the requests against the limits of the engine before they are queued.
+    /// Without validator, invalid requests are rejected by the engine.
+    void setRequestValidator(std::shared_ptr<RequestValidator> requestValidator)
+    {
+        std::lock_guard<std::mutex> lk(mMutex);
+        mRequestValidator = std::move(requestValidator);
+    }
+
+    /// @brief Set the data types of the engine the inputs of the requests are converted to.
+    /// Without data types, floating-point inputs keep the data type they were sent with.
+    void setEngineDataTypes(EngineDataTypes engineDataTypes)
+    {
+        std::lock_guard<std::mutex> lk(mMutex);
+        mEngineDataTypes = std::move(engineDataTypes);
+    }
+
+    /// @brief Queue the work items as lightweight handles holding the metadata used by the queue policies, and only
+    /// convert the inputs of a request shortly before it is scheduled, on a background thread started by this call.
+    /// The requests are validated as they are pushed in both cases, from the properties of their Triton inputs.
+    void setDeferConversion(bool deferConversion);
+
+    /// @brief Have the background thread keep the inputs of the first pending work items converted, at least the given
+    /// number, e.g. the number of requests the next scheduling step may take. Session turns, whose input includes
+    /// the history of the previous turn, are converted once they are scheduled.
+    void materializeAhead(size_t numWorkItems);
+
+    /// @brief Set the callback invoked by the background thread whenever it converted a work item
+    void setMaterializedCallback(std::function<void()> materializedCallback)
+    {
+        std::lock_guard<std::mutex> lk(mMutex);
+        mMaterializedCallback = std::move(materializedCallback);
+    }
+
+    /// @brief Set the request converted by the background thread for a work item queued with deferred conversion, or
+    /// convert its inputs on the calling thread if the background thread has not. The resulting request is validated
+    /// if it is a session turn, whose input includes the history of the session. No-op if the work item has already
+    /// been converted. Throws an error if the request is invalid.
+    /// @param convertIfNotReady Whether to convert the inputs on the calling thread when the background thread is
+    /// about to convert them
+    /// @return false if the background thread has not converted the inputs yet and convertIfNotReady is false
+    bool materialize(WorkItem& workItem, bool convertIfNotReady = true);
+
     // Note: this function only be called under a lock
     bool hasInProgressReqId(const uint64_t reqId) const
     {
@@ -70,11 +137,24 @@ public:
         return (mPendingWorkItemsReqIds.find(reqId) != mPendingWorkItemsReqIds.end());
     }
 
+    // Note: this function only be called under a lock
+    void notifyIfEmpty()
+    {
+        if (mPendingWorkItems.empty() && mInProgressWorkItems.empty())
+        {
+            mEmptyCV.notify_all();
+        }
+    }
+
     /// @brief Add a batch of new work item to the queue
     /// Throws an error if requestId already exists
     std::vector<std::shared_ptr<std::exception>> pushBatch(std::vector<RequestWrapper>& requestsToPush,
         uint64_t exec_start_ns, std::function<void(std::shared_ptr<WorkItem>)> const& workItemCb = nullptr);
 
+    /// @brief Add a work item created in-process to the queue
+    /// Throws an error if requestId already exists
+    void push(std::shared_ptr<WorkItem> workItem);
+
     /// @brief Get a new work item from the queue, and move it to the list of
     /// in progress work items if it hasn't been stopped
     /// @return A tuple of the workItem and a boolean flag indicating if the work
@@ -88,6 +168,31 @@ public:
         return mPendingWorkItems.size();
     }
 
+    size_t numInProgressWorkItems() const
+    {
+        std::lock_guard<std::mutex> lk(mMutex);
+        return mInProgressWorkItems.size();
+    }
+
+    /// @brief Remove the pending work items that have not been stopped and satisfy a predicate, e.g. to hand them
+    /// over to the queue of another model instance
+    std::list<std::shared_ptr<WorkItem>> takePendingWorkItems(std::function<bool(WorkItem const&)> const& predicate);
+
+    /// @brief Append work items taken from another queue to the pending work items. The requests from Triton are
+    /// converted again for this engine once they are scheduled, the requests created in-process are validated
+    /// against the limits of this engine.
+    /// @return The work items whose request id is already used in this queue or that this engine cannot serve, which
+    /// are not added
+    std::list<std::shared_ptr<WorkItem>> adoptPendingWorkItems(std::list<std::shared_ptr<WorkItem>> workItems);
+
+    /// @brief Remove all the pending and in-progress work items, e.g. to fail the ones an unloaded instance could not
+    /// complete
+    std::list<std::shared_ptr<WorkItem>> takeAllWorkItems();
+
+    /// @brief Wait until the queue has no pending and no in-progress work items
+    /// @return false if work items remain at the deadline
+    bool waitUntilEmpty(std::chrono::steady_clock::time_point deadline);
+
     std::shared_ptr<WorkItem> getInProgressWorkItem(uint64_t requestId)
     {
         std::lock_guard<std::mutex> lk(mMutex);
@@ -98,6 +203,10 @@ public:
     /// @param requestId
     void markInProgress(const uint64_t requestId);
 
+    /// @brief Move an in-progress work item back to the front of the queue with a new inference request, e.g. the
+    /// next round of a speculatively decoded request
+    void resubmit(uint64_t requestId, std::shared_ptr<tensorrt_llm::batch_manager::InferenceRequest> inferenceRequest);
+
     /// @brief  Mark a request as being finished
     /// @param requestId
     void markFinished(const uint64_t requestId);
@@ -115,6 +224,11 @@ public:
 
     std::unordered_set<uint64_t> getCancelledInProgressReqIds() const;
 
+    /// @brief Get the LoRA task ids of the first pending work items that reference an adapter
+    /// without providing its weights
+    /// @param maxNumWorkItems Maximum number of pending work items to inspect
+    std::vector<uint64_t> getPendingLoraTaskIdsWithoutWeights(size_t maxNumWorkItems) const;
+
 private:
     /// Queue of work items
     std::list<std::shared_ptr<WorkItem>> mPendingWorkItems;
@@ -130,7 +244,54 @@ private:
     /// Whether model using this queue is decoupled
     bool mIsDecoupled;
 
+    /// Optional policy selecting the next work item based on its LoRA adapter
+    std::shared_ptr<LoraSchedulingPolicy> mLoraSchedulingPolicy;
+
+    /// Optional store of the session histories
+    std::shared_ptr<SessionStore> mSessionStore;
+
+    /// Optional validator of the requests against the limits of the engine
+    std::shared_ptr<RequestValidator> mRequestValidator;
+
+    /// Data types of the engine the inputs are converted to
+    EngineDataTypes mEngineDataTypes;
+
+    /// Whether the inputs are converted when the work items are scheduled instead of when they are pushed
+    bool mDeferConversion{false};
+
+    /// @brief Conversion of the inputs of a pending work item by the background thread, or its error
+    struct Conversion
+    {
+        WorkItem::Materialized materialized;
+        std::exception_ptr error;
+    };
+
+    // Note: these functions only be called under a lock
+    bool needsMaterializing(WorkItem const& workItem) const;
+    std::shared_ptr<WorkItem> nextToMaterialize() const;
+    bool isMaterializedAhead(WorkItem const& workItem) const;
+
+    void MaterializeThread();
+
+    static Conversion convert(WorkItem const& workItem, EngineDataTypes const& engineDataTypes);
+
+    /// Number of first pending work items whose inputs the background thread converts
+    size_t mNumMaterializedAhead{0};
+    /// Conversions done by the background thread, taken by materialize()
+    std::unordered_map<uint64_t, Conversion> mConversions;
+    /// ids of the work items whose inputs are being converted, by the background thread or by materialize()
+    std::unordered_set<uint64_t> mMaterializingReqIds;
+    std::function<void()> mMaterializedCallback;
+    bool mStopMaterializing{false};
+    std::thread mMaterializeThread;
+
     mutable std::mutex mMutex;
+    /// notified when the last work item leaves the queue
+    std::condition_variable mEmptyCV;
+    /// wakes up the background thread when there may be work items to convert
+    std::condition_variable mMaterializeCV;
+    /// notified when the conversion of a work item completes
+    std::condition_variable mMaterializedCV;
 };
 
 } // namespace triton::backend::inflight_batcher_llm
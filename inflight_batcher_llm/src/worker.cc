@@ -1,9 +1,15 @@
 #include "model_instance_state.h"
+#include "worker_pool.h"
 
 #include "tensorrt_llm/common/logger.h"
+#include "tensorrt_llm/plugins/api/tllmPlugin.h"
+#include "tensorrt_llm/runtime/tllmLogger.h"
 
+#include <cuda_runtime_api.h>
 #include <mpi.h>
 
+#include <cstring>
+
 using namespace triton::backend::inflight_batcher_llm;
 
 // This worker is launched from the TRT-LLM Triton backend when using the orchestrator mode
@@ -15,8 +21,12 @@ using namespace triton::backend::inflight_batcher_llm;
 // (i.e. a TRT-LLM Triton backend).
 // See https://www.mpi-forum.org/docs/mpi-4.1/mpi41-report/node198.htm#Node198 for
 // more information on MPI inter-communicators
+// A worker spawned by the WorkerPool serves models one after the other over the same parentComm, until
+// it receives an empty model.
 int main(int argc, char* argv[])
 {
+    bool const isPooled = argc > 1 && std::strcmp(argv[1], WorkerPool::kPooledWorkerArg) == 0;
+
     MPI_Init(&argc, &argv);
 
     MPI_Comm parentComm;
@@ -35,24 +45,62 @@ int main(int argc, char* argv[])
         return -1;
     }
 
-    // Since parentComm is an intercommunicator, input root
-    // is the rank of the parent process in his group
-    // (always 0 as the parent size is checked before)
-    int64_t packedSize;
-    MPICHECK(MPI_Bcast(&packedSize, 1, MPI_INT64_T, 0, parentComm));
-    std::vector<int64_t> packed(packedSize);
-    MPICHECK(MPI_Bcast(packed.data(), packedSize, MPI_INT64_T, 0, parentComm));
-    ModelState modelState = ModelState::deserialize(packed);
-
-    TLLM_LOG_INFO("Worker loading model %s", modelState.GetModelName().c_str());
-
-    ModelInstanceState* state;
-    if (!ModelInstanceState::Create(&modelState, parentComm, &state))
+    if (isPooled)
     {
-        return -1;
+        // Initialize CUDA and the plugins while waiting for a model
+        int deviceCount = 0;
+        cudaGetDeviceCount(&deviceCount);
+        auto logger = std::make_shared<tensorrt_llm::runtime::TllmLogger>();
+        initTrtLlmPlugins(logger.get());
     }
 
-    delete state;
+    do
+    {
+        // Since parentComm is an intercommunicator, input root
+        // is the rank of the parent process in his group
+        // (always 0 as the parent size is checked before)
+        int64_t packedSize;
+        MPICHECK(MPI_Bcast(&packedSize, 1, MPI_INT64_T, 0, parentComm));
+        if (packedSize == 0)
+        {
+            TLLM_LOG_INFO("Pooled worker exiting");
+            break;
+        }
+        std::vector<int64_t> packed(packedSize);
+        MPICHECK(MPI_Bcast(packed.data(), packedSize, MPI_INT64_T, 0, parentComm));
+        ModelState modelState = ModelState::deserialize(packed);
+
+        TLLM_LOG_INFO("Worker loading model %s", modelState.GetModelName().c_str());
+
+        // The model instance frees its communicator once unloaded, a pooled worker keeps parentComm for the next
+        // model
+        MPI_Comm instanceComm = parentComm;
+        if (isPooled)
+        {
+            MPICHECK(MPI_Comm_dup(parentComm, &instanceComm));
+        }
+
+        ModelInstanceState* state;
+        if (!ModelInstanceState::Create(&modelState, instanceComm, &state))
+        {
+            // The orchestrator fails the model load. A pooled worker is still healthy and waits for the next model.
+            int rank = 0;
+            MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+            if (rank == 0)
+            {
+                MpiId const failedId = MpiId::WORKER_FAILED;
+                MPICHECK(MPI_Send(&failedId, 1, MPI_UINT64_T, 0, kMPI_ID_TAG, instanceComm));
+            }
+            if (!isPooled)
+            {
+                return -1;
+            }
+            MPICHECK(MPI_Comm_free(&instanceComm));
+            continue;
+        }
+
+        delete state;
+    } while (isPooled);
 
     MPI_Finalize();
     return 0;
@@ -0,0 +1,88 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "worker_pool.h"
+
+#include "tensorrt_llm/common/logger.h"
+#include "tensorrt_llm/common/mpiUtils.h"
+
+namespace triton::backend::inflight_batcher_llm
+{
+
+WorkerPool::WorkerPool(std::string const& workerPath, int32_t size)
+    : mWorkerPath(workerPath)
+{
+    std::vector<char> arg(kPooledWorkerArg, kPooledWorkerArg + std::char_traits<char>::length(kPooledWorkerArg) + 1);
+    char* argv[] = {arg.data(), nullptr};
+
+    // Each worker is spawned separately so that it runs in its own MPI_COMM_WORLD, like a single-rank model
+    for (int32_t i = 0; i < size; ++i)
+    {
+        MPI_Comm worker;
+        MPICHECK(MPI_Comm_spawn(
+            workerPath.c_str(), argv, 1, MPI_INFO_NULL, 0, MPI_COMM_SELF, &worker, MPI_ERRCODES_IGNORE));
+        mIdleWorkers.push_back(worker);
+    }
+
+    TLLM_LOG_INFO("Spawned %d pooled workers", size);
+}
+
+WorkerPool::~WorkerPool()
+{
+    std::lock_guard<std::mutex> lk(mMutex);
+    for (auto& worker : mIdleWorkers)
+    {
+        // An empty model tells the worker to exit
+        int64_t n = 0;
+        MPICHECK(MPI_Bcast(&n, 1, MPI_INT64_T, MPI_ROOT, worker));
+        MPICHECK(MPI_Comm_disconnect(&worker));
+    }
+    mIdleWorkers.clear();
+}
+
+MPI_Comm WorkerPool::acquire()
+{
+    std::lock_guard<std::mutex> lk(mMutex);
+    if (mIdleWorkers.empty())
+    {
+        ++mNumMisses;
+        return MPI_COMM_NULL;
+    }
+
+    auto const worker = mIdleWorkers.back();
+    mIdleWorkers.pop_back();
+    ++mNumHits;
+    return worker;
+}
+
+void WorkerPool::release(MPI_Comm worker)
+{
+    std::lock_guard<std::mutex> lk(mMutex);
+    mIdleWorkers.push_back(worker);
+}
+
+} // namespace triton::backend::inflight_batcher_llm
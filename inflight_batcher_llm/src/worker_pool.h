@@ -0,0 +1,99 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <mpi.h>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace triton::backend::inflight_batcher_llm
+{
+
+/// @brief Workers of the orchestrator mode spawned once at backend initialization, so that loading a model does not
+/// pay for starting a process and initializing MPI, CUDA and the TensorRT-LLM plugins. A pooled worker runs a single
+/// rank: it receives the serialized ModelState of a model over its inter-communicator, serves the model until it is
+/// unloaded, then waits for the next one. Models running on several GPUs spawn their workers on demand.
+class WorkerPool
+{
+public:
+    /// @brief Command line argument telling a worker to serve models until the pool releases it
+    static constexpr char const* kPooledWorkerArg = "--pooled";
+
+    /// @param workerPath Path of the worker executable
+    /// @param size Number of workers to spawn
+    WorkerPool(std::string const& workerPath, int32_t size);
+
+    /// @brief Tell the idle workers to exit
+    ~WorkerPool();
+
+    /// @brief Take an idle worker out of the pool
+    /// @return The inter-communicator of the worker, or MPI_COMM_NULL if no worker is idle
+    MPI_Comm acquire();
+
+    /// @brief Give back a worker whose model has been unloaded
+    void release(MPI_Comm worker);
+
+    /// @brief Path of the worker executable, only models using it can take a pooled worker
+    std::string const& getWorkerPath() const
+    {
+        return mWorkerPath;
+    }
+
+    /// @brief Number of workers waiting for a model
+    size_t numIdle() const
+    {
+        std::lock_guard<std::mutex> lk(mMutex);
+        return mIdleWorkers.size();
+    }
+
+    /// @brief Number of models loaded by an idle worker of the pool
+    uint64_t numHits() const
+    {
+        return mNumHits.load();
+    }
+
+    /// @brief Number of single-rank models that found no idle worker in the pool
+    uint64_t numMisses() const
+    {
+        return mNumMisses.load();
+    }
+
+private:
+    std::string mWorkerPath;
+    std::vector<MPI_Comm> mIdleWorkers;
+    mutable std::mutex mMutex;
+
+    std::atomic<uint64_t> mNumHits{0};
+    std::atomic<uint64_t> mNumMisses{0};
+};
+
+} // namespace triton::backend::inflight_batcher_llm
@@ -0,0 +1,356 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Measures what defer_request_conversion saves while requests wait in the queue of a model instance: the heap memory
+// held by the queued requests, the time taken from the thread enqueuing them, and the work spent on requests cancelled
+// before they are scheduled. The requests are served by fake Triton requests whose inputs are host buffers.
+//
+// Usage: deferred_conversion_benchmark [number of requests] [input length] [number converted ahead]
+
+#include "request_arena.h"
+#include "work_items_queue.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+std::atomic<int64_t> liveBytes{0};
+std::atomic<int64_t> allocatedBytes{0};
+
+// Allocations are prefixed with their size to track the live bytes
+constexpr size_t kHeaderBytes = alignof(std::max_align_t);
+
+} // namespace
+
+void* operator new(std::size_t size)
+{
+    auto* ptr = static_cast<char*>(std::malloc(size + kHeaderBytes));
+    if (ptr == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    *reinterpret_cast<std::size_t*>(ptr) = size;
+    liveBytes.fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed);
+    allocatedBytes.fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed);
+    return ptr + kHeaderBytes;
+}
+
+void operator delete(void* ptr) noexcept
+{
+    if (ptr == nullptr)
+    {
+        return;
+    }
+    auto* base = static_cast<char*>(ptr) - kHeaderBytes;
+    liveBytes.fetch_sub(static_cast<int64_t>(*reinterpret_cast<std::size_t*>(base)), std::memory_order_relaxed);
+    std::free(base);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    operator delete(ptr);
+}
+
+// Triton request whose inputs are host buffers, served by the TRITONBACKEND functions below
+struct TRITONBACKEND_Input
+{
+    std::string name;
+    TRITONSERVER_DataType dataType;
+    std::vector<int64_t> shape;
+    std::vector<char> data;
+};
+
+struct TRITONBACKEND_Request
+{
+    std::vector<TRITONBACKEND_Input> inputs;
+    std::atomic<bool> cancelled{false};
+};
+
+namespace
+{
+
+// Error returned for the inputs a request does not have
+int missingInput;
+
+} // namespace
+
+extern "C"
+{
+
+TRITONSERVER_Error* TRITONBACKEND_RequestInputCount(TRITONBACKEND_Request* request, uint32_t* count)
+{
+    *count = static_cast<uint32_t>(request->inputs.size());
+    return nullptr;
+}
+
+TRITONSERVER_Error* TRITONBACKEND_RequestInputByIndex(
+    TRITONBACKEND_Request* request, const uint32_t index, TRITONBACKEND_Input** input)
+{
+    *input = &request->inputs.at(index);
+    return nullptr;
+}
+
+TRITONSERVER_Error* TRITONBACKEND_RequestInput(
+    TRITONBACKEND_Request* request, const char* name, TRITONBACKEND_Input** input)
+{
+    for (auto& requestInput : request->inputs)
+    {
+        if (requestInput.name == name)
+        {
+            *input = &requestInput;
+            return nullptr;
+        }
+    }
+    return reinterpret_cast<TRITONSERVER_Error*>(&missingInput);
+}
+
+TRITONSERVER_Error* TRITONBACKEND_InputProperties(TRITONBACKEND_Input* input, const char** name,
+    TRITONSERVER_DataType* datatype, const int64_t** shape, uint32_t* dims_count, uint64_t* byte_size,
+    uint32_t* buffer_count)
+{
+    if (name != nullptr)
+    {
+        *name = input->name.c_str();
+    }
+    if (datatype != nullptr)
+    {
+        *datatype = input->dataType;
+    }
+    if (shape != nullptr)
+    {
+        *shape = input->shape.data();
+    }
+    if (dims_count != nullptr)
+    {
+        *dims_count = static_cast<uint32_t>(input->shape.size());
+    }
+    if (byte_size != nullptr)
+    {
+        *byte_size = input->data.size();
+    }
+    if (buffer_count != nullptr)
+    {
+        *buffer_count = 1;
+    }
+    return nullptr;
+}
+
+TRITONSERVER_Error* TRITONBACKEND_InputBuffer(TRITONBACKEND_Input* input, const uint32_t index, const void** buffer,
+    uint64_t* buffer_byte_size, TRITONSERVER_MemoryType* memory_type, int64_t* memory_type_id)
+{
+    *buffer = input->data.data();
+    *buffer_byte_size = input->data.size();
+    *memory_type = TRITONSERVER_MEMORY_CPU;
+    *memory_type_id = 0;
+    return nullptr;
+}
+
+TRITONSERVER_Error* TRITONBACKEND_RequestOutputCount(TRITONBACKEND_Request* request, uint32_t* count)
+{
+    *count = 0;
+    return nullptr;
+}
+
+TRITONSERVER_Error* TRITONBACKEND_RequestOutputName(
+    TRITONBACKEND_Request* request, const uint32_t index, const char** output_name)
+{
+    return reinterpret_cast<TRITONSERVER_Error*>(&missingInput);
+}
+
+TRITONSERVER_Error* TRITONBACKEND_RequestCorrelationId(TRITONBACKEND_Request* request, uint64_t* id)
+{
+    *id = 0;
+    return nullptr;
+}
+
+TRITONSERVER_Error* TRITONBACKEND_ResponseFactoryNew(
+    TRITONBACKEND_ResponseFactory** factory, TRITONBACKEND_Request* request)
+{
+    *factory = reinterpret_cast<TRITONBACKEND_ResponseFactory*>(request);
+    return nullptr;
+}
+
+TRITONSERVER_Error* TRITONBACKEND_ResponseFactoryDelete(TRITONBACKEND_ResponseFactory* factory)
+{
+    return nullptr;
+}
+
+TRITONSERVER_Error* TRITONBACKEND_ResponseFactoryIsCancelled(
+    TRITONBACKEND_ResponseFactory* factory, bool* is_cancelled)
+{
+    *is_cancelled = reinterpret_cast<TRITONBACKEND_Request*>(factory)->cancelled;
+    return nullptr;
+}
+
+void TRITONSERVER_ErrorDelete(TRITONSERVER_Error* error) {}
+
+} // extern "C"
+
+using namespace triton::backend::inflight_batcher_llm;
+
+namespace
+{
+
+template <typename T>
+TRITONBACKEND_Input makeTritonInput(std::string name, TRITONSERVER_DataType dataType, std::vector<T> const& values)
+{
+    TRITONBACKEND_Input input{std::move(name), dataType, {1, static_cast<int64_t>(values.size())}, {}};
+    input.data.resize(values.size() * sizeof(T));
+    std::memcpy(input.data.data(), values.data(), input.data.size());
+    return input;
+}
+
+/// @brief Triton requests of a chat workload: the input ids, the output length and 8 sampling scalars
+std::vector<std::unique_ptr<TRITONBACKEND_Request>> makeTritonRequests(int numRequests, int inputLength)
+{
+    std::vector<int32_t> inputIds(inputLength);
+    for (int i = 0; i < inputLength; ++i)
+    {
+        inputIds[i] = 100 + i % 30000;
+    }
+    std::vector<std::unique_ptr<TRITONBACKEND_Request>> requests;
+    for (int r = 0; r < numRequests; ++r)
+    {
+        auto request = std::make_unique<TRITONBACKEND_Request>();
+        request->inputs.push_back(makeTritonInput("input_ids", TRITONSERVER_TYPE_INT32, inputIds));
+        request->inputs.push_back(makeTritonInput("request_output_len", TRITONSERVER_TYPE_INT32, std::vector{128}));
+        request->inputs.push_back(makeTritonInput("beam_width", TRITONSERVER_TYPE_INT32, std::vector{1}));
+        request->inputs.push_back(makeTritonInput("runtime_top_k", TRITONSERVER_TYPE_INT32, std::vector{40}));
+        request->inputs.push_back(makeTritonInput("end_id", TRITONSERVER_TYPE_INT32, std::vector{2}));
+        request->inputs.push_back(makeTritonInput("min_length", TRITONSERVER_TYPE_INT32, std::vector{1}));
+        request->inputs.push_back(makeTritonInput("temperature", TRITONSERVER_TYPE_FP32, std::vector{0.7f}));
+        request->inputs.push_back(makeTritonInput("runtime_top_p", TRITONSERVER_TYPE_FP32, std::vector{0.9f}));
+        request->inputs.push_back(makeTritonInput("repetition_penalty", TRITONSERVER_TYPE_FP32, std::vector{1.1f}));
+        request->inputs.push_back(makeTritonInput("random_seed", TRITONSERVER_TYPE_UINT64, std::vector<uint64_t>{1}));
+        requests.push_back(std::move(request));
+    }
+    return requests;
+}
+
+/// @brief Heap bytes in use, without the arena blocks kept by the pool for the next requests
+int64_t usedBytes()
+{
+    return liveBytes.load() - static_cast<int64_t>(RequestArena::getPooledBytes());
+}
+
+struct Result
+{
+    double pushNsPerRequest{0};
+    double queuedBytesPerRequest{0};
+    double cancelNsPerRequest{0};
+    double cancelAllocatedBytesPerRequest{0};
+};
+
+/// @brief Queue the requests, then cancel all of them and drain the queue as the scheduling step does
+Result run(bool deferConversion, int numRequests, int inputLength, size_t numMaterializedAhead)
+{
+    Result result;
+    auto requests = makeTritonRequests(numRequests, inputLength);
+    WorkItemsQueue queue(false);
+    queue.setDeferConversion(deferConversion);
+    queue.materializeAhead(numMaterializedAhead);
+
+    std::vector<WorkItemsQueue::RequestWrapper> requestsToPush;
+    for (int r = 0; r < numRequests; ++r)
+    {
+        requestsToPush.emplace_back(r + 1, requests[r].get());
+    }
+
+    auto const usedBefore = usedBytes();
+    auto const allocatedBefore = allocatedBytes.load();
+    auto start = std::chrono::steady_clock::now();
+    // Triton hands over the requests in small batches
+    for (size_t begin = 0; begin < requestsToPush.size(); begin += 8)
+    {
+        std::vector<WorkItemsQueue::RequestWrapper> batch(requestsToPush.begin() + begin,
+            requestsToPush.begin() + std::min(begin + 8, requestsToPush.size()));
+        queue.pushBatch(batch, 0);
+    }
+    result.pushNsPerRequest
+        = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / numRequests;
+    // Let the background thread convert the window ahead of the scheduling
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    result.queuedBytesPerRequest = static_cast<double>(usedBytes() - usedBefore) / numRequests;
+
+    start = std::chrono::steady_clock::now();
+    for (auto& request : requests)
+    {
+        request->cancelled = true;
+    }
+    while (true)
+    {
+        auto [workItem, stoppedRequest] = queue.pop();
+        if (!workItem)
+        {
+            break;
+        }
+        if (!stoppedRequest)
+        {
+            std::fprintf(stderr, "request %lu was not cancelled\n", workItem->requestId());
+            std::exit(EXIT_FAILURE);
+        }
+    }
+    result.cancelNsPerRequest
+        = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / numRequests;
+    // Conversions of the cancelled requests, done while they were queued or by the drain
+    result.cancelAllocatedBytesPerRequest = static_cast<double>(allocatedBytes.load() - allocatedBefore) / numRequests;
+    return result;
+}
+
+void print(char const* label, Result const& result)
+{
+    std::printf("%-10s %12.0f %14.0f %12.0f %16.0f\n", label, result.pushNsPerRequest, result.queuedBytesPerRequest,
+        result.cancelNsPerRequest, result.cancelAllocatedBytesPerRequest);
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    int const numRequests = argc > 1 ? std::atoi(argv[1]) : 2000;
+    int const inputLength = argc > 2 ? std::atoi(argv[2]) : 2048;
+    size_t const numMaterializedAhead = argc > 3 ? std::atoi(argv[3]) : 64;
+
+    // warm up the pool of arena blocks
+    run(false, numRequests / 10 + 1, inputLength, numMaterializedAhead);
+
+    std::printf("%d requests of %d input tokens, %zu converted ahead, all cancelled while queued\n", numRequests,
+        inputLength, numMaterializedAhead);
+    std::printf("%-10s %12s %14s %12s %16s\n", "mode", "push ns/req", "queued B/req", "drain ns/req",
+        "allocated B/req");
+    print("eager", run(false, numRequests, inputLength, numMaterializedAhead));
+    print("deferred", run(true, numRequests, inputLength, numMaterializedAhead));
+    return 0;
+}
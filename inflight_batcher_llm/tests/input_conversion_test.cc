@@ -0,0 +1,204 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "input_conversion.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+using namespace triton::backend::inflight_batcher_llm;
+
+namespace
+{
+
+float bitsToFloat(uint32_t bits)
+{
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+/// @brief Convert fp32 values to fp16 or bf16 through convertInput, which uses F16C when available
+std::vector<uint16_t> narrow(std::vector<float> const& values, nvinfer1::DataType dstType)
+{
+    std::vector<uint16_t> narrowed(values.size());
+    convertInput("prompt_embedding_table", values.data(), TRITONSERVER_TYPE_FP32, narrowed.data(), dstType,
+        values.size());
+    return narrowed;
+}
+
+uint16_t toBf16(float value)
+{
+    // padded to a full vector so that both paths are exercised the same way
+    return narrow(std::vector<float>(8, value), nvinfer1::DataType::kBF16).front();
+}
+
+template <typename T>
+std::string toInt32Error(TRITONSERVER_DataType dataType, std::vector<T> const& values)
+{
+    std::vector<int32_t> converted(values.size());
+    try
+    {
+        convertInput("input_ids", values.data(), dataType, converted.data(), nvinfer1::DataType::kINT32, values.size());
+    }
+    catch (std::out_of_range const& e)
+    {
+        return e.what();
+    }
+    return "";
+}
+
+} // namespace
+
+TEST(InputConversionTest, NarrowsIntegersThatFit)
+{
+    std::vector<int64_t> const values{0, -1, std::numeric_limits<int32_t>::min(), std::numeric_limits<int32_t>::max()};
+    std::vector<int32_t> converted(values.size());
+    convertInput("input_ids", values.data(), TRITONSERVER_TYPE_INT64, converted.data(), nvinfer1::DataType::kINT32,
+        values.size());
+    EXPECT_EQ(converted, (std::vector<int32_t>{0, -1, std::numeric_limits<int32_t>::min(),
+                             std::numeric_limits<int32_t>::max()}));
+}
+
+TEST(InputConversionTest, ReportsInt32Overflow)
+{
+    EXPECT_EQ(toInt32Error(TRITONSERVER_TYPE_INT64, std::vector<int64_t>{1, 2, int64_t{1} << 31, -1}),
+        "input_ids[2] = 2147483648 does not fit in the int32 expected by the engine");
+    EXPECT_EQ(toInt32Error(TRITONSERVER_TYPE_INT64, std::vector<int64_t>{-(int64_t{1} << 31) - 1}),
+        "input_ids[0] = -2147483649 does not fit in the int32 expected by the engine");
+    EXPECT_EQ(toInt32Error(TRITONSERVER_TYPE_UINT32, std::vector<uint32_t>{7, 0x80000000u}),
+        "input_ids[1] = 2147483648 does not fit in the int32 expected by the engine");
+    EXPECT_EQ(toInt32Error(TRITONSERVER_TYPE_UINT64, std::vector<uint64_t>{std::numeric_limits<uint64_t>::max()}),
+        "input_ids[0] = 18446744073709551615 does not fit in the int32 expected by the engine");
+    EXPECT_EQ(toInt32Error(TRITONSERVER_TYPE_UINT16, std::vector<uint16_t>{0xffff}), "");
+}
+
+TEST(InputConversionTest, KeepsBf16NaNs)
+{
+    // a NaN whose payload is only in the low bits must not round to the infinity
+    for (uint32_t const bits : {0x7fc00000u, 0x7f800001u, 0xff800001u, 0x7fffffffu})
+    {
+        auto const bf16 = toBf16(bitsToFloat(bits));
+        EXPECT_EQ(bf16 & 0x7f80, 0x7f80) << std::hex << bits;
+        EXPECT_NE(bf16 & 0x7f, 0) << std::hex << bits;
+        EXPECT_EQ(bf16 & 0x8000, (bits >> 16) & 0x8000) << std::hex << bits;
+    }
+    EXPECT_EQ(toBf16(std::numeric_limits<float>::infinity()), 0x7f80);
+    EXPECT_EQ(toBf16(-std::numeric_limits<float>::infinity()), 0xff80);
+}
+
+TEST(InputConversionTest, RoundsBf16ToNearestEven)
+{
+    // ties round to the even mantissa
+    EXPECT_EQ(toBf16(bitsToFloat(0x3f808000u)), 0x3f80);
+    EXPECT_EQ(toBf16(bitsToFloat(0x3f818000u)), 0x3f82);
+    EXPECT_EQ(toBf16(bitsToFloat(0x3f808001u)), 0x3f81);
+    // the largest finite values round to the infinity past the halfway point
+    EXPECT_EQ(toBf16(bitsToFloat(0x7f7fffffu)), 0x7f80);
+    EXPECT_EQ(toBf16(bitsToFloat(0x7f7f7fffu)), 0x7f7f);
+}
+
+TEST(InputConversionTest, HandlesFp16EdgeCases)
+{
+    EXPECT_EQ(floatToHalf(0.f), 0x0000);
+    EXPECT_EQ(floatToHalf(-0.f), 0x8000);
+    EXPECT_EQ(floatToHalf(1.f), 0x3c00);
+    EXPECT_EQ(floatToHalf(65504.f), 0x7bff);
+    // 65520 is halfway between the largest finite value and the next power of two
+    EXPECT_EQ(floatToHalf(65519.f), 0x7bff);
+    EXPECT_EQ(floatToHalf(65520.f), 0x7c00);
+    EXPECT_EQ(floatToHalf(-1e10f), 0xfc00);
+    EXPECT_EQ(floatToHalf(std::numeric_limits<float>::infinity()), 0x7c00);
+    // ties round to the even mantissa
+    EXPECT_EQ(floatToHalf(1.f + std::ldexp(1.f, -11)), 0x3c00);
+    EXPECT_EQ(floatToHalf(1.f + 3 * std::ldexp(1.f, -11)), 0x3c02);
+    // subnormals, and the rounding up to the smallest normal value
+    EXPECT_EQ(floatToHalf(std::ldexp(1.f, -24)), 0x0001);
+    EXPECT_EQ(floatToHalf(std::ldexp(1.f, -25)), 0x0000);
+    EXPECT_EQ(floatToHalf(std::ldexp(3.f, -26)), 0x0001);
+    EXPECT_EQ(floatToHalf(std::ldexp(3.f, -25)), 0x0002);
+    EXPECT_EQ(floatToHalf(std::ldexp(1.f, -14) - std::ldexp(1.f, -26)), 0x0400);
+    EXPECT_EQ(floatToHalf(std::numeric_limits<float>::denorm_min()), 0x0000);
+    EXPECT_EQ(floatToHalf(-std::numeric_limits<float>::denorm_min()), 0x8000);
+    // NaNs stay quiet NaNs with their sign
+    EXPECT_EQ(floatToHalf(bitsToFloat(0x7f800001u)), 0x7e00);
+    EXPECT_EQ(floatToHalf(bitsToFloat(0xffc00000u)), 0xfe00);
+
+    for (uint32_t h = 0; h < 0x10000; ++h)
+    {
+        auto const f = halfToFloat(static_cast<uint16_t>(h));
+        if (!std::isnan(f))
+        {
+            EXPECT_EQ(floatToHalf(f), h) << "round trip of " << std::hex << h;
+        }
+    }
+}
+
+#if defined(__x86_64__)
+__attribute__((target("avx,f16c"))) uint16_t floatToHalfF16c(float f)
+{
+    return static_cast<uint16_t>(_cvtss_sh(f, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC));
+}
+
+__attribute__((target("avx,f16c"))) float halfToFloatF16c(uint16_t h)
+{
+    return _cvtsh_ss(h);
+}
+
+TEST(InputConversionTest, MatchesF16c)
+{
+    if (!__builtin_cpu_supports("avx") || !__builtin_cpu_supports("f16c"))
+    {
+        GTEST_SKIP() << "F16C is not supported";
+    }
+    for (uint32_t h = 0; h < 0x10000; ++h)
+    {
+        uint32_t expected;
+        uint32_t actual;
+        auto const expectedFloat = halfToFloatF16c(static_cast<uint16_t>(h));
+        auto const actualFloat = halfToFloat(static_cast<uint16_t>(h));
+        std::memcpy(&expected, &expectedFloat, sizeof(expected));
+        std::memcpy(&actual, &actualFloat, sizeof(actual));
+        ASSERT_EQ(actual, expected) << "fp16 " << std::hex << h;
+    }
+    // a prime stride covers all the exponents with varied mantissas
+    for (uint64_t bits = 0; bits <= 0xffffffffu; bits += 4099)
+    {
+        auto const f = bitsToFloat(static_cast<uint32_t>(bits));
+        ASSERT_EQ(floatToHalf(f), floatToHalfF16c(f)) << "fp32 " << std::hex << bits;
+    }
+}
+#endif
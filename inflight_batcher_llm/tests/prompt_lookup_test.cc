@@ -0,0 +1,135 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "prompt_lookup.h"
+#include "speculative_decoding.h"
+
+#include <gtest/gtest.h>
+
+#include <list>
+#include <memory>
+#include <vector>
+
+using namespace triton::backend::inflight_batcher_llm;
+using tensorrt_llm::batch_manager::InferenceRequest;
+using tensorrt_llm::batch_manager::NamedTensor;
+namespace inference_request = tensorrt_llm::batch_manager::inference_request;
+
+namespace
+{
+
+NamedTensor makeTensor(std::string const& name, std::vector<int64_t> const& shape, std::vector<int32_t> const& values)
+{
+    return NamedTensor(nvinfer1::DataType::kINT32, shape, name, values.data());
+}
+
+std::vector<int32_t> getValues(InferenceRequest const& request, std::string const& name)
+{
+    auto const tensor = request.getInputTensorUnchecked(name);
+    if (!tensor || !tensor.value())
+    {
+        return {};
+    }
+    auto const* data = static_cast<int32_t const*>(tensor.value()->data());
+    return std::vector<int32_t>(data, data + tensor.value()->getSize());
+}
+
+} // namespace
+
+TEST(PromptLookupTest, ProposesTheContinuationOfTheLongestNgram)
+{
+    PromptLookup lookup(2);
+    lookup.append({6, 1, 8, 5, 1, 9, 6});
+    lookup.append({1});
+    // the bigram (6, 1) is followed by 8, while the last occurrence of the unigram 1 is followed by 9
+    EXPECT_EQ(lookup.propose(2), (std::vector<int32_t>{8, 5}));
+    EXPECT_EQ(lookup.propose(0), (std::vector<int32_t>{}));
+}
+
+TEST(PromptLookupTest, TruncatesTheDraftAtTheEndOfTheSequence)
+{
+    PromptLookup lookup(3);
+    lookup.append({1, 2, 1});
+    EXPECT_EQ(lookup.propose(4), (std::vector<int32_t>{2, 1}));
+}
+
+TEST(PromptLookupTest, ProposesNothingWithoutEarlierOccurrence)
+{
+    PromptLookup lookup(3);
+    lookup.append({1, 2, 3, 4});
+    EXPECT_TRUE(lookup.propose(4).empty());
+}
+
+TEST(PromptLookupTest, LowAcceptanceDisablesDrafting)
+{
+    SpeculativeDecoder::Config config;
+    config.maxDraftLength = 2;
+    config.promptLookupMaxNgramSize = 2;
+    config.promptLookupByDefault = true;
+    config.minAcceptanceRate = 0.5f;
+    config.excludeInputInOutput = true;
+    std::shared_ptr<InferenceRequest> submittedRound;
+    SpeculativeDecoder decoder(
+        nullptr, config, [&submittedRound](uint64_t, std::shared_ptr<InferenceRequest> round)
+        { submittedRound = std::move(round); },
+        []() { return size_t{0}; });
+
+    uint64_t const requestId = 5;
+    int32_t const maxNewTokens = 100;
+    auto request = std::make_shared<InferenceRequest>(requestId);
+    auto inputIds = makeTensor(inference_request::kInputIdsTensorName, {1, 8}, {1, 2, 3, 1, 2, 3, 1, 2});
+    request->emplaceInputTensor(inputIds.name, std::move(inputIds.tensor));
+    auto outputLen = makeTensor(inference_request::kMaxNewTokensTensorName, {1, 1}, {maxNewTokens});
+    request->emplaceInputTensor(outputLen.name, std::move(outputLen.tensor));
+
+    auto round = decoder.start(request);
+    ASSERT_TRUE(round);
+    EXPECT_EQ(getValues(*round, inference_request::kDraftInputIdsTensorName), (std::vector<int32_t>{3, 1}));
+
+    // The engine rejects every draft, its token is still found in the prompt so that the next round has a draft
+    int32_t numGenerated = 0;
+    while (decoder.numFallbacks() == 0)
+    {
+        auto const draftIds = getValues(*round, inference_request::kDraftInputIdsTensorName);
+        ASSERT_FALSE(draftIds.empty());
+        int32_t const token = draftIds.front() % 3 + 1;
+        std::list<NamedTensor> responseTensors;
+        responseTensors.push_back(makeTensor(inference_request::kOutputIdsTensorName, {1, 1, 1}, {token}));
+        responseTensors.push_back(makeTensor(inference_request::kSequenceLengthTensorName, {1, 1}, {1}));
+        ++numGenerated;
+        ASSERT_FALSE(decoder.onRoundComplete(requestId, responseTensors).finished);
+        decoder.continueRequest(requestId);
+        ASSERT_TRUE(submittedRound);
+        round = std::move(submittedRound);
+    }
+    EXPECT_EQ(numGenerated, 4);
+    EXPECT_EQ(decoder.numAcceptedTokens(), 0);
+
+    // The remaining tokens are generated in a single round without draft
+    EXPECT_TRUE(getValues(*round, inference_request::kDraftInputIdsTensorName).empty());
+    EXPECT_EQ(getValues(*round, inference_request::kMaxNewTokensTensorName),
+        (std::vector<int32_t>{maxNewTokens - numGenerated}));
+}
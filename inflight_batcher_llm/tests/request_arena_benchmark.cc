@@ -0,0 +1,194 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Load test of the request arenas: producer threads build requests with their input tensors, as the conversion of
+// the Triton requests does, and hand them over through a queue to as many consumer threads, which release them as
+// the completion of the requests does. Every request is built once on the heap and once in an arena, so blocks are
+// allocated and freed by different threads. Also reports the bytes kept by the pool of arena blocks after each run
+// and once the pool was trimmed.
+//
+// Usage: request_arena_benchmark [number of requests] [input length]
+
+#include "request_arena.h"
+
+#include "tensorrt_llm/batch_manager/inferenceRequest.h"
+#include "tensorrt_llm/runtime/bufferManager.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace triton::backend::inflight_batcher_llm;
+
+namespace
+{
+
+using tensorrt_llm::batch_manager::InferenceRequest;
+using tensorrt_llm::runtime::BufferManager;
+using tensorrt_llm::runtime::ITensor;
+
+// input_ids and the one-element inputs of a typical request
+constexpr int kNumScalarInputs = 12;
+
+std::shared_ptr<InferenceRequest> makeRequest(uint64_t requestId, int inputLength, bool useArena)
+{
+    std::vector<ITensor::Shape> shapes{ITensor::makeShape({1, inputLength})};
+    for (int i = 0; i < kNumScalarInputs; ++i)
+    {
+        shapes.push_back(ITensor::makeShape({1, 1}));
+    }
+
+    std::shared_ptr<RequestArena> arena;
+    std::shared_ptr<InferenceRequest> request;
+    if (useArena)
+    {
+        size_t arenaBytes = sizeof(InferenceRequest) + RequestArena::kObjectBytes;
+        for (auto const& shape : shapes)
+        {
+            arenaBytes += RequestArena::tensorBytes(ITensor::volume(shape) * sizeof(int32_t));
+        }
+        arena = RequestArena::create(arenaBytes);
+        request
+            = std::allocate_shared<InferenceRequest>(RequestArena::Allocator<InferenceRequest>(arena), requestId);
+    }
+    else
+    {
+        request = std::make_shared<InferenceRequest>(requestId);
+    }
+
+    for (size_t i = 0; i < shapes.size(); ++i)
+    {
+        auto tensor = useArena ? RequestArena::allocateTensor(arena, nvinfer1::DataType::kINT32, shapes[i])
+                               : ITensor::SharedPtr(BufferManager::cpu(shapes[i], nvinfer1::DataType::kINT32));
+        std::memset(tensor->data(), 0, tensor->getSizeInBytes());
+        request->emplaceInputTensor("input_" + std::to_string(i), std::move(tensor));
+    }
+    return request;
+}
+
+/// @return the duration of the run in seconds
+double run(int numThreads, int numRequests, int inputLength, bool useArena)
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::shared_ptr<InferenceRequest>> queue;
+    bool done = false;
+
+    auto const start = std::chrono::steady_clock::now();
+    std::vector<std::thread> producers;
+    std::vector<std::thread> consumers;
+    for (int p = 0; p < numThreads; ++p)
+    {
+        producers.emplace_back(
+            [&, p]()
+            {
+                for (int r = p; r < numRequests; r += numThreads)
+                {
+                    auto request = makeRequest(r, inputLength, useArena);
+                    {
+                        std::lock_guard<std::mutex> lk(mutex);
+                        queue.push_back(std::move(request));
+                    }
+                    cv.notify_one();
+                }
+            });
+    }
+    for (int c = 0; c < numThreads; ++c)
+    {
+        consumers.emplace_back(
+            [&]()
+            {
+                while (true)
+                {
+                    std::shared_ptr<InferenceRequest> request;
+                    {
+                        std::unique_lock<std::mutex> lk(mutex);
+                        cv.wait(lk, [&]() { return done || !queue.empty(); });
+                        if (queue.empty())
+                        {
+                            return;
+                        }
+                        request = std::move(queue.front());
+                        queue.pop_front();
+                    }
+                    // the last reference is released outside the lock, like a completed request
+                    request.reset();
+                }
+            });
+    }
+    for (auto& producer : producers)
+    {
+        producer.join();
+    }
+    {
+        std::lock_guard<std::mutex> lk(mutex);
+        done = true;
+    }
+    cv.notify_all();
+    for (auto& consumer : consumers)
+    {
+        consumer.join();
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+double toMiB(size_t bytes)
+{
+    return static_cast<double>(bytes) / (1024 * 1024);
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    int const numRequests = argc > 1 ? std::atoi(argv[1]) : 200000;
+    int const inputLength = argc > 2 ? std::atoi(argv[2]) : 256;
+
+    std::printf("%d requests of %d input tokens and %d scalar inputs\n", numRequests, inputLength, kNumScalarInputs);
+    std::printf("%8s %10s %10s %12s %12s\n", "threads", "heap s", "arena s", "pooled MiB", "trimmed MiB");
+    for (int numThreads : {1, 8, 32})
+    {
+        auto const heapSeconds = run(numThreads, numRequests, inputLength, false);
+        auto const arenaSeconds = run(numThreads, numRequests, inputLength, true);
+        auto const pooledBytes = RequestArena::getPooledBytes();
+        // Idle for two trim intervals with one request per interval: the first trim starts a new interval, the
+        // second one frees the blocks that stayed unused during it
+        for (int i = 0; i < 2; ++i)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+            run(1, 1, inputLength, true);
+        }
+        std::printf("%8d %10.3f %10.3f %12.1f %12.1f\n", numThreads, heapSeconds, arenaSeconds, toMiB(pooledBytes),
+            toMiB(RequestArena::getPooledBytes()));
+    }
+    return 0;
+}
@@ -0,0 +1,349 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "engine_config.h"
+#include "request_validator.h"
+#include "sampling_params.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace triton::backend::inflight_batcher_llm;
+using tensorrt_llm::batch_manager::InferenceRequest;
+using tensorrt_llm::batch_manager::NamedTensor;
+namespace inference_request = tensorrt_llm::batch_manager::inference_request;
+
+// Triton request whose inputs are host buffers, served by the TRITONBACKEND functions below
+struct TRITONBACKEND_Input
+{
+    std::string name;
+    TRITONSERVER_DataType dataType;
+    std::vector<int64_t> shape;
+    std::vector<char> data;
+};
+
+struct TRITONBACKEND_Request
+{
+    std::vector<TRITONBACKEND_Input> inputs;
+};
+
+extern "C"
+{
+
+TRITONSERVER_Error* TRITONBACKEND_RequestInputCount(TRITONBACKEND_Request* request, uint32_t* count)
+{
+    *count = static_cast<uint32_t>(request->inputs.size());
+    return nullptr;
+}
+
+TRITONSERVER_Error* TRITONBACKEND_RequestInputByIndex(
+    TRITONBACKEND_Request* request, const uint32_t index, TRITONBACKEND_Input** input)
+{
+    *input = &request->inputs.at(index);
+    return nullptr;
+}
+
+TRITONSERVER_Error* TRITONBACKEND_InputProperties(TRITONBACKEND_Input* input, const char** name,
+    TRITONSERVER_DataType* datatype, const int64_t** shape, uint32_t* dims_count, uint64_t* byte_size,
+    uint32_t* buffer_count)
+{
+    if (name != nullptr)
+    {
+        *name = input->name.c_str();
+    }
+    if (datatype != nullptr)
+    {
+        *datatype = input->dataType;
+    }
+    if (shape != nullptr)
+    {
+        *shape = input->shape.data();
+    }
+    if (dims_count != nullptr)
+    {
+        *dims_count = static_cast<uint32_t>(input->shape.size());
+    }
+    if (byte_size != nullptr)
+    {
+        *byte_size = input->data.size();
+    }
+    if (buffer_count != nullptr)
+    {
+        *buffer_count = 1;
+    }
+    return nullptr;
+}
+
+TRITONSERVER_Error* TRITONBACKEND_InputBuffer(TRITONBACKEND_Input* input, const uint32_t index, const void** buffer,
+    uint64_t* buffer_byte_size, TRITONSERVER_MemoryType* memory_type, int64_t* memory_type_id)
+{
+    *buffer = input->data.data();
+    *buffer_byte_size = input->data.size();
+    *memory_type = TRITONSERVER_MEMORY_CPU;
+    *memory_type_id = 0;
+    return nullptr;
+}
+
+} // extern "C"
+
+namespace
+{
+
+template <typename T>
+TRITONBACKEND_Input makeTritonInput(std::string name, TRITONSERVER_DataType dataType, std::vector<T> const& values)
+{
+    TRITONBACKEND_Input input{std::move(name), dataType, {1, static_cast<int64_t>(values.size())}, {}};
+    input.data.resize(values.size() * sizeof(T));
+    std::memcpy(input.data.data(), values.data(), input.data.size());
+    return input;
+}
+
+/// @brief Same request as an InferenceRequest and as a Triton request
+struct TestRequest
+{
+    std::vector<int32_t> inputIds;
+    std::optional<int32_t> maxNewTokens;
+    std::optional<int32_t> beamWidth;
+    std::optional<int32_t> promptVocabSize;
+
+    std::shared_ptr<InferenceRequest> inferenceRequest(uint64_t requestId) const
+    {
+        auto request = std::make_shared<InferenceRequest>(requestId);
+        auto const emplace = [&request](std::string const& name, std::vector<int32_t> const& values)
+        {
+            NamedTensor tensor(nvinfer1::DataType::kINT32, {1, static_cast<int64_t>(values.size())}, name,
+                values.data());
+            request->emplaceInputTensor(tensor.name, std::move(tensor.tensor));
+        };
+        emplace(inference_request::kInputIdsTensorName, inputIds);
+        if (maxNewTokens)
+        {
+            emplace(inference_request::kMaxNewTokensTensorName, {maxNewTokens.value()});
+        }
+        if (promptVocabSize)
+        {
+            emplace(inference_request::kPromptVocabSizeName, {promptVocabSize.value()});
+        }
+        // the beam width is a packed sampling parameter
+        if (beamWidth)
+        {
+            SamplingParams samplingParams;
+            *static_cast<int32_t*>(
+                samplingParams.slot(inference_request::kBeamWidthTensorName, nvinfer1::DataType::kINT32, 1))
+                = beamWidth.value();
+            samplingParams.store(*request);
+        }
+        return request;
+    }
+
+    TRITONBACKEND_Request tritonRequest() const
+    {
+        TRITONBACKEND_Request request;
+        request.inputs.push_back(
+            makeTritonInput(inference_request::kInputIdsTensorName, TRITONSERVER_TYPE_INT32, inputIds));
+        if (maxNewTokens)
+        {
+            request.inputs.push_back(makeTritonInput(inference_request::kMaxNewTokensTensorName,
+                TRITONSERVER_TYPE_INT32, std::vector{maxNewTokens.value()}));
+        }
+        if (beamWidth)
+        {
+            // the scalars are read whatever their integer type
+            request.inputs.push_back(makeTritonInput(inference_request::kBeamWidthTensorName, TRITONSERVER_TYPE_INT64,
+                std::vector{int64_t{beamWidth.value()}}));
+        }
+        if (promptVocabSize)
+        {
+            request.inputs.push_back(makeTritonInput(inference_request::kPromptVocabSizeName, TRITONSERVER_TYPE_INT32,
+                std::vector{promptVocabSize.value()}));
+        }
+        return request;
+    }
+};
+
+EngineLimits makeLimits()
+{
+    EngineLimits limits;
+    limits.maxInputLen = 8;
+    limits.maxSequenceLen = 12;
+    limits.maxBeamWidth = 2;
+    limits.vocabSize = 100;
+    return limits;
+}
+
+/// @brief Error of the validation of a request from both of its forms, which must match
+std::string validate(RequestValidator& validator, TestRequest const& request)
+{
+    uint64_t const requestId = 7;
+    std::string inferenceRequestError;
+    try
+    {
+        validator.validate(*request.inferenceRequest(requestId));
+    }
+    catch (std::invalid_argument const& e)
+    {
+        inferenceRequestError = e.what();
+    }
+
+    std::string tritonRequestError;
+    try
+    {
+        auto tritonRequest = request.tritonRequest();
+        validator.validate(&tritonRequest, requestId);
+    }
+    catch (std::invalid_argument const& e)
+    {
+        tritonRequestError = e.what();
+    }
+    EXPECT_EQ(inferenceRequestError, tritonRequestError);
+    return tritonRequestError;
+}
+
+} // namespace
+
+TEST(RequestValidatorTest, AcceptsRequestsWithinLimits)
+{
+    RequestValidator validator(makeLimits());
+    EXPECT_EQ(validate(validator, {{1, 2, 3, 99}, 8, 2, std::nullopt}), "");
+    EXPECT_EQ(validate(validator, {{1, 2, 3, 4, 5, 6, 7, 8}, 4, std::nullopt, std::nullopt}), "");
+    EXPECT_EQ(validator.numInputLengthRejections() + validator.numSequenceLengthRejections()
+            + validator.numBeamWidthRejections() + validator.numTokenIdRejections(),
+        0);
+}
+
+TEST(RequestValidatorTest, RejectsLongInput)
+{
+    RequestValidator validator(makeLimits());
+    EXPECT_EQ(validate(validator, {std::vector<int32_t>(9, 1), 1, std::nullopt, std::nullopt}),
+        "request 7: input length 9 exceeds the max_input_len 8 of the engine");
+    EXPECT_EQ(validator.numInputLengthRejections(), 2);
+}
+
+TEST(RequestValidatorTest, RejectsLongSequence)
+{
+    RequestValidator validator(makeLimits());
+    EXPECT_EQ(validate(validator, {{1, 2, 3, 4}, 9, std::nullopt, std::nullopt}),
+        "request 7: input length 4 plus request_output_len 9 exceeds the max_seq_len 12 of the engine");
+    EXPECT_EQ(validator.numSequenceLengthRejections(), 2);
+}
+
+TEST(RequestValidatorTest, RejectsWideBeam)
+{
+    RequestValidator validator(makeLimits());
+    EXPECT_EQ(validate(validator, {{1, 2}, 1, 3, std::nullopt}),
+        "request 7: beam_width 3 exceeds the max_beam_width 2");
+    EXPECT_EQ(validator.numBeamWidthRejections(), 2);
+}
+
+TEST(RequestValidatorTest, RejectsTokenIdsOutsideOfVocabulary)
+{
+    RequestValidator validator(makeLimits());
+    EXPECT_EQ(validate(validator, {{1, 2, 100}, 1, std::nullopt, std::nullopt}),
+        "request 7: input_ids[2] = 100 is outside of the vocabulary of size 100");
+    EXPECT_EQ(validate(validator, {{-1, 2}, 1, std::nullopt, std::nullopt}),
+        "request 7: input_ids[0] = -1 is outside of the vocabulary of size 100");
+    EXPECT_EQ(validator.numTokenIdRejections(), 4);
+}
+
+TEST(RequestValidatorTest, AcceptsPromptTableIds)
+{
+    RequestValidator validator(makeLimits());
+    EXPECT_EQ(validate(validator, {{1, 2, 109}, 1, std::nullopt, 10}), "");
+    EXPECT_EQ(validate(validator, {{1, 2, 110}, 1, std::nullopt, 10}),
+        "request 7: input_ids[2] = 110 is outside of the vocabulary of size 110");
+}
+
+TEST(RequestValidatorTest, SkipsMissingLimits)
+{
+    RequestValidator validator(EngineLimits{});
+    EXPECT_EQ(validate(validator, {std::vector<int32_t>(100, 1000), 1000, 8, std::nullopt}), "");
+}
+
+TEST(RequestValidatorTest, ReadsTritonInt64InputIds)
+{
+    RequestValidator validator(makeLimits());
+    TRITONBACKEND_Request request;
+    request.inputs.push_back(makeTritonInput(
+        inference_request::kInputIdsTensorName, TRITONSERVER_TYPE_INT64, std::vector<int64_t>{1, int64_t{1} << 40}));
+    EXPECT_THROW(validator.validate(&request, 1), std::invalid_argument);
+    EXPECT_EQ(validator.numTokenIdRejections(), 1);
+}
+
+TEST(EngineConfigTest, ParsesLimitsAndDataTypes)
+{
+    auto const dir = testing::TempDir();
+    {
+        std::ofstream config(dir + "/config.json");
+        config << R"({
+            // comments are allowed
+            "pretrained_config": {"dtype": "bfloat16", "logits_dtype": "float32", "vocab_size": 32000},
+            "build_config": {"max_input_len": 1024, "max_seq_len": 2048, "max_beam_width": 4,
+                "gather_context_logits": true}
+        })";
+    }
+    auto const config = EngineConfig::load(dir);
+    EXPECT_EQ(config.limits.maxInputLen, 1024);
+    EXPECT_EQ(config.limits.maxSequenceLen, 2048);
+    EXPECT_EQ(config.limits.maxBeamWidth, 4);
+    EXPECT_EQ(config.limits.vocabSize, 32000);
+    EXPECT_EQ(config.dataTypes.model, nvinfer1::DataType::kBF16);
+    EXPECT_EQ(config.dataTypes.logits, nvinfer1::DataType::kFLOAT);
+    EXPECT_EQ(config.dataTypes.gatherContextLogits, true);
+    EXPECT_EQ(config.dataTypes.gatherGenerationLogits, false);
+    std::remove((dir + "/config.json").c_str());
+}
+
+TEST(EngineConfigTest, ParsesLegacyBuilderConfig)
+{
+    auto const dir = testing::TempDir();
+    {
+        std::ofstream config(dir + "/config.json");
+        config << R"({"builder_config": {"max_input_len": 512, "max_output_len": 256, "precision": "float16",
+            "vocab_size": 50257, "gather_all_token_logits": true}})";
+    }
+    auto const config = EngineConfig::load(dir);
+    EXPECT_EQ(config.limits.maxInputLen, 512);
+    EXPECT_EQ(config.limits.maxSequenceLen, 768);
+    EXPECT_FALSE(config.limits.maxBeamWidth.has_value());
+    EXPECT_EQ(config.limits.vocabSize, 50257);
+    EXPECT_EQ(config.dataTypes.model, nvinfer1::DataType::kHALF);
+    EXPECT_FALSE(config.dataTypes.logits.has_value());
+    EXPECT_EQ(config.dataTypes.gatherContextLogits, true);
+    EXPECT_EQ(config.dataTypes.gatherGenerationLogits, true);
+    std::remove((dir + "/config.json").c_str());
+}
+
+TEST(EngineConfigTest, ThrowsOnMissingFile)
+{
+    EXPECT_ANY_THROW(EngineConfig::load(testing::TempDir() + "/missing_engine"));
+}
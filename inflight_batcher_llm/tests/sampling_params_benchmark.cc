@@ -0,0 +1,213 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+// Compares the serialized size, the heap allocations and the time of a request whose scalar sampling inputs are
+// one-element tensors with the same request carrying them in a SamplingParams block. The request goes through the
+// path of the orchestrator and tensor-parallel transfers: it is built, serialized, deserialized and, for the block,
+// expanded back into tensors on the receiving rank.
+//
+// Usage: sampling_params_benchmark [iterations] [input length]
+
+#include "sampling_params.h"
+
+#include "tensorrt_llm/batch_manager/inferenceRequest.h"
+#include "tensorrt_llm/batch_manager/namedTensor.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <numeric>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+std::atomic<uint64_t> numAllocations{0};
+
+} // namespace
+
+void* operator new(std::size_t size)
+{
+    numAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size == 0 ? 1 : size))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+using namespace triton::backend::inflight_batcher_llm;
+
+namespace
+{
+
+namespace inference_request = tensorrt_llm::batch_manager::inference_request;
+using tensorrt_llm::batch_manager::InferenceRequest;
+using tensorrt_llm::batch_manager::NamedTensor;
+
+/// @brief Scalar sampling inputs of a typical chat request
+struct Scalar
+{
+    char const* name;
+    nvinfer1::DataType dataType;
+    int64_t bits;
+};
+
+std::vector<Scalar> const kScalars = {
+    {inference_request::kBeamWidthTensorName, nvinfer1::DataType::kINT32, 1},
+    {inference_request::kRuntimeTopKTensorName, nvinfer1::DataType::kINT32, 40},
+    {inference_request::kMinLengthTensorName, nvinfer1::DataType::kINT32, 1},
+    {inference_request::kEndIdTensorName, nvinfer1::DataType::kINT32, 2},
+    {inference_request::kTemperatureTensorName, nvinfer1::DataType::kFLOAT, 0x3f333333},       // 0.7
+    {inference_request::kRuntimeTopPTensorName, nvinfer1::DataType::kFLOAT, 0x3f666666},       // 0.9
+    {inference_request::kRepetitionPenaltyTensorName, nvinfer1::DataType::kFLOAT, 0x3f8ccccd}, // 1.1
+    {inference_request::kRandomSeedTensorName, nvinfer1::DataType::kINT64, 1234},
+};
+
+std::shared_ptr<InferenceRequest> makeRequest(uint64_t requestId, std::vector<int32_t> const& inputIds, bool packed)
+{
+    auto request = std::make_shared<InferenceRequest>(requestId);
+    NamedTensor ids(nvinfer1::DataType::kINT32, {1, static_cast<int64_t>(inputIds.size())},
+        inference_request::kInputIdsTensorName, inputIds.data());
+    request->emplaceInputTensor(ids.name, std::move(ids.tensor));
+    int32_t const maxNewTokens = 128;
+    NamedTensor len(nvinfer1::DataType::kINT32, {1, 1}, inference_request::kMaxNewTokensTensorName, &maxNewTokens);
+    request->emplaceInputTensor(len.name, std::move(len.tensor));
+
+    SamplingParams samplingParams;
+    for (auto const& scalar : kScalars)
+    {
+        if (packed)
+        {
+            auto* slot = samplingParams.slot(scalar.name, scalar.dataType, 1);
+            std::memcpy(slot, &scalar.bits, scalar.dataType == nvinfer1::DataType::kINT64 ? 8 : 4);
+            continue;
+        }
+        NamedTensor t(scalar.dataType, {1, 1}, scalar.name, &scalar.bits);
+        request->emplaceInputTensor(t.name, std::move(t.tensor));
+    }
+    if (packed)
+    {
+        samplingParams.store(*request);
+    }
+    return request;
+}
+
+struct Result
+{
+    size_t numTensors{0};
+    size_t serializedBytes{0};
+    double buildAllocations{0};
+    double transferAllocations{0};
+    double expandAllocations{0};
+    double nsPerRequest{0};
+};
+
+Result run(bool packed, int iterations, std::vector<int32_t> const& inputIds)
+{
+    Result result;
+    uint64_t buildAllocations = 0;
+    uint64_t transferAllocations = 0;
+    uint64_t expandAllocations = 0;
+    auto const start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+    {
+        auto before = numAllocations.load(std::memory_order_relaxed);
+        auto request = makeRequest(i, inputIds, packed);
+        auto after = numAllocations.load(std::memory_order_relaxed);
+        buildAllocations += after - before;
+
+        before = after;
+        auto const serialized = request->serialize();
+        auto received = InferenceRequest::deserialize(serialized);
+        after = numAllocations.load(std::memory_order_relaxed);
+        transferAllocations += after - before;
+
+        before = after;
+        SamplingParams::expand(*received);
+        after = numAllocations.load(std::memory_order_relaxed);
+        expandAllocations += after - before;
+
+        if (i == 0)
+        {
+            result.numTensors = request->getInputTensors().size();
+            result.serializedBytes = serialized.size() * sizeof(int64_t);
+            if (received->getInputTensors().size() != 2 + kScalars.size())
+            {
+                std::fprintf(stderr, "unexpected number of tensors after expansion\n");
+                std::exit(EXIT_FAILURE);
+            }
+        }
+    }
+    auto const elapsed = std::chrono::steady_clock::now() - start;
+    result.buildAllocations = static_cast<double>(buildAllocations) / iterations;
+    result.transferAllocations = static_cast<double>(transferAllocations) / iterations;
+    result.expandAllocations = static_cast<double>(expandAllocations) / iterations;
+    result.nsPerRequest = std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+    return result;
+}
+
+void print(char const* label, Result const& result)
+{
+    std::printf("%-8s %8zu %12zu %10.1f %10.1f %10.1f %12.0f\n", label, result.numTensors, result.serializedBytes,
+        result.buildAllocations, result.transferAllocations, result.expandAllocations, result.nsPerRequest);
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    int const iterations = argc > 1 ? std::atoi(argv[1]) : 100000;
+    int const inputLength = argc > 2 ? std::atoi(argv[2]) : 256;
+    std::vector<int32_t> inputIds(inputLength);
+    std::iota(inputIds.begin(), inputIds.end(), 100);
+
+    // warm up the allocator
+    run(false, iterations / 10 + 1, inputIds);
+    run(true, iterations / 10 + 1, inputIds);
+
+    std::printf("%d requests of %d input tokens and %zu sampling scalars\n", iterations, inputLength, kScalars.size());
+    std::printf("%-8s %8s %12s %10s %10s %10s %12s\n", "layout", "tensors", "serialized B", "allocs", "allocs",
+        "allocs", "ns/request");
+    std::printf("%-8s %8s %12s %10s %10s %10s %12s\n", "", "", "", "build", "transfer", "expand", "");
+    print("tensors", run(false, iterations, inputIds));
+    print("block", run(true, iterations, inputIds));
+    return 0;
+}
@@ -0,0 +1,153 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "session_store.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+using namespace triton::backend::inflight_batcher_llm;
+using tensorrt_llm::batch_manager::InferenceRequest;
+using tensorrt_llm::batch_manager::NamedTensor;
+namespace inference_request = tensorrt_llm::batch_manager::inference_request;
+
+namespace
+{
+
+std::shared_ptr<InferenceRequest> makeRequest(std::vector<int32_t> const& inputIds)
+{
+    auto request = std::make_shared<InferenceRequest>(1);
+    NamedTensor ids(nvinfer1::DataType::kINT32, {1, static_cast<int64_t>(inputIds.size())},
+        inference_request::kInputIdsTensorName, inputIds.data());
+    request->emplaceInputTensor(ids.name, std::move(ids.tensor));
+    int32_t const inputLength = static_cast<int32_t>(inputIds.size());
+    NamedTensor lengths(nvinfer1::DataType::kINT32, {1}, "input_lengths", &inputLength);
+    request->emplaceInputTensor(lengths.name, std::move(lengths.tensor));
+    return request;
+}
+
+std::vector<int32_t> getInputIds(InferenceRequest const& request)
+{
+    auto const& tensor = request.getInputTensor(inference_request::kInputIdsTensorName);
+    auto const* data = static_cast<int32_t const*>(tensor->data());
+    return std::vector<int32_t>(data, data + tensor->getSize());
+}
+
+int32_t getInputLength(InferenceRequest const& request)
+{
+    return *static_cast<int32_t const*>(request.getInputTensor("input_lengths")->data());
+}
+
+/// @brief Begin a turn and end it with the given output ids, returning the full input ids of the turn
+std::vector<int32_t> runTurn(SessionStore& store, uint64_t correlationId, std::vector<int32_t> const& inputIds,
+    std::vector<int32_t> const& outputIds, bool start = false)
+{
+    auto request = makeRequest(inputIds);
+    auto fullInputIds = store.beginTurn(*request, correlationId, start);
+    store.endTurn(correlationId, fullInputIds, outputIds, false);
+    return fullInputIds;
+}
+
+} // namespace
+
+TEST(SessionStoreTest, PrependsTheHistoryOfTheSession)
+{
+    SessionStore store(1 << 20);
+    uint64_t const correlationId = 3;
+
+    auto first = makeRequest({1, 2, 3});
+    EXPECT_EQ(store.beginTurn(*first, correlationId, true), (std::vector<int32_t>{1, 2, 3}));
+    // the output of the model excludes the input
+    store.endTurn(correlationId, {1, 2, 3}, {10, 11}, false);
+
+    auto second = makeRequest({4});
+    auto const secondInputIds = store.beginTurn(*second, correlationId, false);
+    EXPECT_EQ(secondInputIds, (std::vector<int32_t>{1, 2, 3, 10, 11, 4}));
+    EXPECT_EQ(getInputIds(*second), secondInputIds);
+    EXPECT_EQ(getInputLength(*second), 6);
+    EXPECT_EQ(store.numHits(), 1);
+    EXPECT_EQ(store.numReusedTokens(), 5);
+    // the output of the model includes the input
+    store.endTurn(correlationId, secondInputIds, {1, 2, 3, 10, 11, 4, 12}, false);
+
+    auto third = makeRequest({5});
+    EXPECT_EQ(store.beginTurn(*third, correlationId, false), (std::vector<int32_t>{1, 2, 3, 10, 11, 4, 12, 5}));
+}
+
+TEST(SessionStoreTest, StartDiscardsTheHistory)
+{
+    SessionStore store(1 << 20);
+    runTurn(store, 3, {1, 2}, {10}, true);
+
+    auto request = makeRequest({4, 5});
+    EXPECT_EQ(store.beginTurn(*request, 3, true), (std::vector<int32_t>{4, 5}));
+    EXPECT_EQ(getInputIds(*request), (std::vector<int32_t>{4, 5}));
+    EXPECT_EQ(getInputLength(*request), 2);
+    EXPECT_EQ(store.numHits(), 0);
+}
+
+TEST(SessionStoreTest, EndDiscardsTheHistory)
+{
+    SessionStore store(1 << 20);
+    auto request = makeRequest({1, 2});
+    store.beginTurn(*request, 3, true);
+    store.endTurn(3, {1, 2}, {10}, true);
+
+    EXPECT_EQ(runTurn(store, 3, {4}, {}), (std::vector<int32_t>{4}));
+}
+
+TEST(SessionStoreTest, EvictsLeastRecentlyUsedSessions)
+{
+    // room for 6 tokens
+    SessionStore store(6 * sizeof(int32_t));
+    runTurn(store, 1, {1, 2}, {3}, true);
+    runTurn(store, 2, {4, 5}, {6}, true);
+    // the longer history of the first session evicts the second one, which is the least recently used
+    EXPECT_EQ(runTurn(store, 1, {7}, {}), (std::vector<int32_t>{1, 2, 3, 7}));
+
+    EXPECT_EQ(runTurn(store, 2, {8}, {}), (std::vector<int32_t>{8}));
+    EXPECT_EQ(runTurn(store, 1, {9}, {}), (std::vector<int32_t>{1, 2, 3, 7, 9}));
+}
+
+TEST(SessionStoreTest, RejectsASecondTurnInFlight)
+{
+    SessionStore store(1 << 20);
+    runTurn(store, 3, {1, 2}, {10}, true);
+
+    auto first = makeRequest({4});
+    store.beginTurn(*first, 3, false);
+    auto second = makeRequest({5});
+    EXPECT_THROW(store.beginTurn(*second, 3, false), std::runtime_error);
+    // other sessions are not affected
+    EXPECT_EQ(runTurn(store, 4, {6}, {}, true), (std::vector<int32_t>{6}));
+
+    // once the failed turn is erased, the session starts over
+    store.erase(3);
+    EXPECT_EQ(store.beginTurn(*second, 3, false), (std::vector<int32_t>{5}));
+}
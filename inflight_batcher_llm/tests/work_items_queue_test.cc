@@ -0,0 +1,344 @@
+// Copyright 2024, NVIDIA CORPORATION & AFFILIATES. All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//  * Redistributions of source code must retain the above copyright
+//    notice, this list of conditions and the following disclaimer.
+//  * Redistributions in binary form must reproduce the above copyright
+//    notice, this list of conditions and the following disclaimer in the
+//    documentation and/or other materials provided with the distribution.
+//  * Neither the name of NVIDIA CORPORATION nor the names of its
+//    contributors may be used to endorse or promote products derived
+//    from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS ``AS IS'' AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY
+// OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+// OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "request_validator.h"
+#include "session_store.h"
+#include "utils.h"
+#include "work_items_queue.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace triton::backend::inflight_batcher_llm;
+namespace inference_request = tensorrt_llm::batch_manager::inference_request;
+
+// Triton request whose inputs are host buffers, served by the TRITONBACKEND functions below. A request with a
+// correlation id is a turn of a session. The responses sent for the request are recorded.
+struct TRITONBACKEND_Input
+{
+    std::string name;
+    TRITONSERVER_DataType dataType;
+    std::vector<int64_t> shape;
+    std::vector<char> data;
+};
+
+struct TRITONSERVER_Error
+{
+    std::string message;
+};
+
+struct TestResponse
+{
+    uint32_t flags;
+    std::string error;
+};
+
+struct TRITONBACKEND_Request
+{
+    std::vector<TRITONBACKEND_Input> inputs;
+    uint64_t correlationId = 0;
+    uint32_t flags = 0;
+    std::vector<TestResponse> responses;
+};
+
+namespace
+{
+
+// Error returned for the inputs a request does not have
+TRITONSERVER_Error missingInput{"input not found"};
+
+} // namespace
+
+extern "C"
+{
+
+TRITONSERVER_Error* TRITONBACKEND_RequestInputCount(TRITONBACKEND_Request* request, uint32_t* count)
+{
+    *count = static_cast<uint32_t>(request->inputs.size());
+    return nullptr;
+}
+
+TRITONSERVER_Error* TRITONBACKEND_RequestInputByIndex(
+    TRITONBACKEND_Request* request, const uint32_t index, TRITONBACKEND_Input** input)
+{
+    *input = &request->inputs.at(index);
+    return nullptr;
+}
+
+TRITONSERVER_Error* TRITONBACKEND_RequestInput(
+    TRITONBACKEND_Request* request, const char* name, TRITONBACKEND_Input** input)
+{
+    for (auto& requestInput : request->inputs)
+    {
+        if (requestInput.name == name)
+        {
+            *input = &requestInput;
+            return nullptr;
+        }
+    }
+    return &missingInput;
+}
+
+TRITONSERVER_Error* TRITONBACKEND_InputProperties(TRITONBACKEND_Input* input, const char** name,
+    TRITONSERVER_DataType* datatype, const int64_t** shape, uint32_t* dims_count, uint64_t* byte_size,
+    uint32_t* buffer_count)
+{
+    if (name != nullptr)
+    {
+        *name = input->name.c_str();
+    }
+    if (datatype != nullptr)
+    {
+        *datatype = input->dataType;
+    }
+    if (shape != nullptr)
+    {
+        *shape = input->shape.data();
+    }
+    if (dims_count != nullptr)
+    {
+        *dims_count = static_cast<uint32_t>(input->shape.size());
+    }
+    if (byte_size != nullptr)
+    {
+        *byte_size = input->data.size();
+    }
+    if (buffer_count != nullptr)
+    {
+        *buffer_count = 1;
+    }
+    return nullptr;
+}
+
+TRITONSERVER_Error* TRITONBACKEND_InputBuffer(TRITONBACKEND_Input* input, const uint32_t index, const void** buffer,
+    uint64_t* buffer_byte_size, TRITONSERVER_MemoryType* memory_type, int64_t* memory_type_id)
+{
+    *buffer = input->data.data();
+    *buffer_byte_size = input->data.size();
+    *memory_type = TRITONSERVER_MEMORY_CPU;
+    *memory_type_id = 0;
+    return nullptr;
+}
+
+TRITONSERVER_Error* TRITONBACKEND_RequestOutputCount(TRITONBACKEND_Request* request, uint32_t* count)
+{
+    *count = 0;
+    return nullptr;
+}
+
+TRITONSERVER_Error* TRITONBACKEND_RequestOutputName(
+    TRITONBACKEND_Request* request, const uint32_t index, const char** output_name)
+{
+    return &missingInput;
+}
+
+TRITONSERVER_Error* TRITONBACKEND_RequestCorrelationId(TRITONBACKEND_Request* request, uint64_t* id)
+{
+    *id = request->correlationId;
+    return nullptr;
+}
+
+TRITONSERVER_Error* TRITONBACKEND_RequestFlags(TRITONBACKEND_Request* request, uint32_t* flags)
+{
+    *flags = request->flags;
+    return nullptr;
+}
+
+TRITONSERVER_Error* TRITONBACKEND_ResponseFactoryNew(
+    TRITONBACKEND_ResponseFactory** factory, TRITONBACKEND_Request* request)
+{
+    *factory = reinterpret_cast<TRITONBACKEND_ResponseFactory*>(request);
+    return nullptr;
+}
+
+TRITONSERVER_Error* TRITONBACKEND_ResponseFactoryDelete(TRITONBACKEND_ResponseFactory* factory)
+{
+    return nullptr;
+}
+
+TRITONSERVER_Error* TRITONBACKEND_ResponseFactoryIsCancelled(
+    TRITONBACKEND_ResponseFactory* factory, bool* is_cancelled)
+{
+    *is_cancelled = false;
+    return nullptr;
+}
+
+TRITONSERVER_Error* TRITONBACKEND_ResponseNewFromFactory(
+    TRITONBACKEND_Response** response, TRITONBACKEND_ResponseFactory* factory)
+{
+    *response = reinterpret_cast<TRITONBACKEND_Response*>(factory);
+    return nullptr;
+}
+
+TRITONSERVER_Error* TRITONBACKEND_ResponseSend(
+    TRITONBACKEND_Response* response, const uint32_t send_flags, TRITONSERVER_Error* error)
+{
+    auto* request = reinterpret_cast<TRITONBACKEND_Request*>(response);
+    request->responses.push_back({send_flags, error != nullptr ? error->message : ""});
+    delete error;
+    return nullptr;
+}
+
+TRITONSERVER_Error* TRITONSERVER_ErrorNew(TRITONSERVER_Error_Code code, const char* msg)
+{
+    return new TRITONSERVER_Error{msg};
+}
+
+const char* TRITONSERVER_ErrorMessage(TRITONSERVER_Error* error)
+{
+    return error->message.c_str();
+}
+
+void TRITONSERVER_ErrorDelete(TRITONSERVER_Error* error)
+{
+    if (error != &missingInput)
+    {
+        delete error;
+    }
+}
+
+} // extern "C"
+
+namespace
+{
+
+template <typename T>
+TRITONBACKEND_Input makeTritonInput(std::string name, TRITONSERVER_DataType dataType, std::vector<T> const& values)
+{
+    TRITONBACKEND_Input input{std::move(name), dataType, {1, static_cast<int64_t>(values.size())}, {}};
+    input.data.resize(values.size() * sizeof(T));
+    std::memcpy(input.data.data(), values.data(), input.data.size());
+    return input;
+}
+
+TRITONBACKEND_Request makeRequest(std::vector<int32_t> const& inputIds, uint64_t correlationId = 0, uint32_t flags = 0)
+{
+    TRITONBACKEND_Request request;
+    request.correlationId = correlationId;
+    request.flags = flags;
+    request.inputs.push_back(
+        makeTritonInput(inference_request::kInputIdsTensorName, TRITONSERVER_TYPE_INT32, inputIds));
+    request.inputs.push_back(makeTritonInput(
+        inference_request::kMaxNewTokensTensorName, TRITONSERVER_TYPE_INT32, std::vector<int32_t>{2}));
+    return request;
+}
+
+std::shared_ptr<RequestValidator> makeValidator(int32_t maxInputLen)
+{
+    EngineLimits limits;
+    limits.maxInputLen = maxInputLen;
+    return std::make_shared<RequestValidator>(std::move(limits));
+}
+
+} // namespace
+
+TEST(WorkItemsQueueTest, AnswersRejectedRequests)
+{
+    // Configured like the queue of the orchestrator, which hands the accepted work items over to its replicas
+    WorkItemsQueue queue(false);
+    queue.setRequestValidator(makeValidator(4));
+    std::vector<std::shared_ptr<WorkItem>> unassignedWorkItems;
+    auto const workItemCb = [&unassignedWorkItems](std::shared_ptr<WorkItem> workItem)
+    { unassignedWorkItems.push_back(std::move(workItem)); };
+
+    auto accepted = makeRequest({1, 2, 3});
+    auto tooLong = makeRequest({1, 2, 3, 4, 5});
+    auto duplicate = makeRequest({1, 2});
+    std::vector<WorkItemsQueue::RequestWrapper> requestsToPush{{1, &accepted}, {2, &tooLong}, {1, &duplicate}};
+    utils::pushTritonRequests(queue, requestsToPush, 0, workItemCb);
+
+    ASSERT_EQ(unassignedWorkItems.size(), 1);
+    EXPECT_EQ(unassignedWorkItems.front()->requestId(), 1);
+    EXPECT_EQ(queue.numPendingWorkItems(), 1);
+    EXPECT_TRUE(accepted.responses.empty());
+
+    ASSERT_EQ(tooLong.responses.size(), 1);
+    EXPECT_EQ(tooLong.responses.front().flags, TRITONSERVER_RESPONSE_COMPLETE_FINAL);
+    EXPECT_NE(tooLong.responses.front().error.find("max_input_len"), std::string::npos);
+
+    ASSERT_EQ(duplicate.responses.size(), 1);
+    EXPECT_EQ(duplicate.responses.front().flags, TRITONSERVER_RESPONSE_COMPLETE_FINAL);
+    EXPECT_NE(duplicate.responses.front().error.find("already in progress"), std::string::npos);
+}
+
+TEST(WorkItemsQueueTest, RejectedTurnEndsItsSession)
+{
+    WorkItemsQueue queue(false);
+    queue.setSessionStore(std::make_shared<SessionStore>(1 << 20));
+    queue.setRequestValidator(makeValidator(6));
+    uint64_t const correlationId = 9;
+
+    auto first = makeRequest({1, 2, 3, 4}, correlationId, TRITONSERVER_REQUEST_FLAG_SEQUENCE_START);
+    std::vector<WorkItemsQueue::RequestWrapper> firstToPush{{1, &first}};
+    utils::pushTritonRequests(queue, firstToPush, 0);
+    auto [firstWorkItem, firstInProgress] = queue.pop();
+    ASSERT_TRUE(firstWorkItem);
+    firstWorkItem->updateSession({}, true, false);
+    queue.markFinished(1);
+
+    // The history of 4 tokens is prepended to the input of the turn, which exceeds the max_input_len
+    auto second = makeRequest({5, 6, 7, 8}, correlationId);
+    std::vector<WorkItemsQueue::RequestWrapper> secondToPush{{2, &second}};
+    utils::pushTritonRequests(queue, secondToPush, 0);
+    ASSERT_EQ(second.responses.size(), 1);
+    EXPECT_NE(second.responses.front().error.find("max_input_len"), std::string::npos);
+    EXPECT_EQ(queue.numPendingWorkItems(), 0);
+
+    // The next turn is accepted without the history
+    auto third = makeRequest({5, 6}, correlationId);
+    std::vector<WorkItemsQueue::RequestWrapper> thirdToPush{{3, &third}};
+    utils::pushTritonRequests(queue, thirdToPush, 0);
+    EXPECT_TRUE(third.responses.empty());
+    auto [thirdWorkItem, thirdInProgress] = queue.pop();
+    ASSERT_TRUE(thirdWorkItem);
+    auto const& inputIds = thirdWorkItem->getInferenceRequest()->getInputTensor(inference_request::kInputIdsTensorName);
+    EXPECT_EQ(tensorrt_llm::runtime::ITensor::volume(inputIds->getShape()), 2);
+}
+
+TEST(WorkItemsQueueTest, DuplicateTurnEndsItsSession)
+{
+    WorkItemsQueue queue(false);
+    queue.setSessionStore(std::make_shared<SessionStore>(1 << 20));
+
+    // The second request reuses the id of the first one, it is only found to be a duplicate once its turn has begun
+    auto first = makeRequest({1, 2}, 11, TRITONSERVER_REQUEST_FLAG_SEQUENCE_START);
+    auto duplicate = makeRequest({3, 4}, 12, TRITONSERVER_REQUEST_FLAG_SEQUENCE_START);
+    std::vector<WorkItemsQueue::RequestWrapper> requestsToPush{{1, &first}, {1, &duplicate}};
+    utils::pushTritonRequests(queue, requestsToPush, 0);
+    EXPECT_TRUE(first.responses.empty());
+    ASSERT_EQ(duplicate.responses.size(), 1);
+    EXPECT_NE(duplicate.responses.front().error.find("already in progress"), std::string::npos);
+
+    // The session of the duplicate is not left with a turn in progress
+    auto next = makeRequest({3, 4}, 12, TRITONSERVER_REQUEST_FLAG_SEQUENCE_START);
+    std::vector<WorkItemsQueue::RequestWrapper> nextToPush{{2, &next}};
+    utils::pushTritonRequests(queue, nextToPush, 0);
+    EXPECT_TRUE(next.responses.empty());
+    EXPECT_EQ(queue.numPendingWorkItems(), 2);
+}
@@ -68,6 +68,14 @@ def parse_arguments():
         'Enable support for multiple TRT-LLM models in the Triton model repository'
     )
 
+    parser.add_argument(
+        '--worker_pool_size',
+        type=int,
+        default=0,
+        help=
+        'Number of workers spawned at startup and reused to load the single-GPU models, only used with --multi-model'
+    )
+
     return parser.parse_args()
 
 
@@ -111,4 +119,7 @@ if __name__ == '__main__':
     if args.multi_model:
         assert args.world_size == 1, 'World size must be 1 when using multi-model. Processes will be spawned automatically to run the multi-GPU models'
         env['TRTLLM_ORCHESTRATOR'] = '1'
+        if args.worker_pool_size > 0:
+            env['TRTLLM_ORCHESTRATOR_WORKER_POOL_SIZE'] = str(
+                args.worker_pool_size)
     subprocess.Popen(cmd, env=env)
@@ -0,0 +1,148 @@
+#!/usr/bin/python
+
+import os
+import sys
+
+utils_path = os.path.dirname(os.path.dirname(os.path.realpath(__file__)))
+root_path = os.path.dirname(utils_path)
+sys.path.append(utils_path)
+sys.path.append(os.path.join(root_path, "inflight_batcher_llm"))
+
+import argparse
+import glob
+import time
+from concurrent.futures import ThreadPoolExecutor
+
+import numpy as np
+import tritonclient.grpc as grpcclient
+from client import e2e_grpc_speculative_decoding_client as client_utils
+
+
+def read_thread_stats(pid):
+    # Number of threads of the server and context switches summed over its threads
+    num_threads = 0
+    num_switches = 0
+    for status_path in glob.glob(f"/proc/{pid}/task/*/status"):
+        try:
+            with open(status_path) as f:
+                for line in f:
+                    if line.startswith("voluntary_ctxt_switches") or \
+                            line.startswith("nonvoluntary_ctxt_switches"):
+                        num_switches += int(line.split()[1])
+        except FileNotFoundError:
+            continue
+        num_threads += 1
+    return num_threads, num_switches
+
+
+def measure_idle(pid, duration):
+    _, start_switches = read_thread_stats(pid)
+    time.sleep(duration)
+    num_threads, end_switches = read_thread_stats(pid)
+    return num_threads, (end_switches - start_switches) / duration
+
+
+def send_request(FLAGS, request_id):
+    client = grpcclient.InferenceServerClient(url=FLAGS.url)
+    input_ids = np.random.randint(100,
+                                  1000,
+                                  size=FLAGS.input_len,
+                                  dtype=np.int32)
+    inputs = [
+        client_utils.prepare_tensor("input_ids",
+                                    np.expand_dims(input_ids, axis=0)),
+        client_utils.prepare_tensor(
+            "input_lengths", np.array([[FLAGS.input_len]], dtype=np.int32)),
+        client_utils.prepare_tensor(
+            "request_output_len",
+            np.array([[FLAGS.output_len]], dtype=np.int32)),
+    ]
+    start_time = time.time()
+    client.infer(FLAGS.tensorrt_llm_model_name,
+                 inputs,
+                 request_id=str(request_id))
+    return time.time() - start_time
+
+
+def measure_load(pid, FLAGS):
+    _, start_switches = read_thread_stats(pid)
+    start_time = time.time()
+    with ThreadPoolExecutor(max_workers=FLAGS.concurrency) as executor:
+        latencies = list(
+            executor.map(lambda i: send_request(FLAGS, i),
+                         range(FLAGS.num_requests)))
+    duration = time.time() - start_time
+    num_threads, end_switches = read_thread_stats(pid)
+    return num_threads, (end_switches -
+                         start_switches) / duration, sorted(latencies)
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(
+        description=
+        'Measure the threads, wakeups and request latency of a Triton server running the backend in '
+        'orchestrator mode. Run it against two builds of the backend to compare them.'
+    )
+    parser.add_argument('-u',
+                        '--url',
+                        type=str,
+                        required=False,
+                        default='localhost:8001',
+                        help='Inference server URL')
+
+    parser.add_argument('--pid',
+                        type=int,
+                        required=True,
+                        help='Process id of the Triton server')
+
+    parser.add_argument('--tensorrt-llm-model-name',
+                        type=str,
+                        required=False,
+                        default="tensorrt_llm",
+                        help='Name of the tensorrt_llm model')
+
+    parser.add_argument('--idle-duration',
+                        type=float,
+                        required=False,
+                        default=10.0,
+                        help='Duration in seconds of the idle measurement')
+
+    parser.add_argument('--num-requests',
+                        type=int,
+                        required=False,
+                        default=200,
+                        help='Number of requests of the load measurement')
+
+    parser.add_argument('--concurrency',
+                        type=int,
+                        required=False,
+                        default=16,
+                        help='Number of requests in flight')
+
+    parser.add_argument('--input-len',
+                        type=int,
+                        required=False,
+                        default=128,
+                        help='Number of input tokens of the requests')
+
+    parser.add_argument('-o',
+                        '--output-len',
+                        type=int,
+                        required=False,
+                        default=16,
+                        help='Number of output tokens of the requests')
+
+    FLAGS = parser.parse_args()
+
+    num_threads, idle_switches = measure_idle(FLAGS.pid, FLAGS.idle_duration)
+    print(
+        f"idle: {num_threads} threads, {idle_switches:.0f} context switches/s"
+    )
+
+    num_threads, load_switches, latencies = measure_load(FLAGS.pid, FLAGS)
+    print(
+        f"load: {num_threads} threads, {load_switches:.0f} context switches/s")
+    print(
+        f"latency: p50 {latencies[len(latencies) // 2] * 1000:.1f} ms, "
+        f"p99 {latencies[min(len(latencies) - 1, int(len(latencies) * 0.99))] * 1000:.1f} ms"
+    )
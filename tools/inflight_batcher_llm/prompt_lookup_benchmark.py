@@ -0,0 +1,188 @@
+#!/usr/bin/python
+
+import os
+import sys
+
+utils_path = os.path.dirname(os.path.dirname(os.path.realpath(__file__)))
+root_path = os.path.dirname(utils_path)
+sys.path.append(utils_path)
+sys.path.append(os.path.join(root_path, "inflight_batcher_llm"))
+
+import argparse
+import json
+import queue
+import re
+import time
+import urllib.request
+from functools import partial
+
+import numpy as np
+import tritonclient.grpc as grpcclient
+from client import e2e_grpc_speculative_decoding_client as client_utils
+
+
+def read_iteration_counter(metrics_url):
+    with urllib.request.urlopen(metrics_url) as response:
+        metrics = response.read().decode('utf-8')
+    match = re.search(
+        r'nv_trt_llm_general_metrics\{.*general_type="iteration_counter".*\} (\d+)',
+        metrics)
+    if match is None:
+        raise Exception(f'iteration_counter not found in {metrics_url}')
+    return int(match.group(1))
+
+
+def callback(responses, result, error):
+    responses.put((result, error))
+
+
+def stream_request(client, inputs, request_id, FLAGS):
+    # The tensorrt_llm model is decoupled, each streamed response holds the tokens of one step (or of one verified
+    # draft with prompt lookup)
+    responses = queue.Queue()
+    client.start_stream(callback=partial(callback, responses))
+    client.async_stream_infer(FLAGS.tensorrt_llm_model_name,
+                              inputs,
+                              request_id=str(request_id))
+    client.stop_stream()
+
+    output_ids = []
+    num_responses = 0
+    while not responses.empty():
+        result, error = responses.get()
+        if error is not None:
+            raise Exception(f"request {request_id} failed: {error}")
+        new_ids = result.as_numpy("output_ids")[0][0].tolist()
+        if new_ids:
+            num_responses += 1
+        output_ids += new_ids
+    return output_ids, num_responses
+
+
+def run_pass(client, requests, prompt_lookup, FLAGS):
+    start_iterations = read_iteration_counter(FLAGS.metrics_url)
+    start_time = time.time()
+    num_generated_tokens = 0
+    num_responses = 0
+    outputs = []
+    for request_id, (input_ids, bad_words_ids, stop_words_ids, end_id, pad_id,
+                     output_len) in enumerate(requests):
+        inputs = client_utils.get_trtllm_inputs(
+            input_ids, len(input_ids), output_len, None, 1, 1.0, None, None,
+            None, bad_words_ids, stop_words_ids, end_id, pad_id)
+        inputs.append(
+            client_utils.prepare_tensor(
+                "prompt_lookup", np.array([[prompt_lookup]], dtype=bool)))
+        inputs.append(
+            client_utils.prepare_tensor("streaming",
+                                        np.array([[True]], dtype=bool)))
+        output_ids, request_responses = stream_request(client, inputs,
+                                                       request_id, FLAGS)
+        outputs.append(output_ids)
+        num_generated_tokens += len(output_ids)
+        num_responses += request_responses
+    elapsed = time.time() - start_time
+    num_iterations = read_iteration_counter(
+        FLAGS.metrics_url) - start_iterations
+    return outputs, num_generated_tokens, num_responses, num_iterations, elapsed
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser()
+    parser.add_argument('-v',
+                        '--verbose',
+                        action="store_true",
+                        required=False,
+                        default=False,
+                        help='Enable verbose output')
+
+    parser.add_argument('-u',
+                        '--url',
+                        type=str,
+                        required=False,
+                        default='localhost:8001',
+                        help='Inference server URL')
+
+    parser.add_argument('--metrics-url',
+                        type=str,
+                        required=False,
+                        default='http://localhost:8002/metrics',
+                        help='Inference server metrics URL')
+
+    parser.add_argument('--max-input-len',
+                        type=int,
+                        required=True,
+                        help='Max input length for input prompts')
+
+    parser.add_argument('--preprocessor-model-name',
+                        type=str,
+                        required=False,
+                        default="preprocessing",
+                        help='Name of the preprocessor model')
+
+    parser.add_argument('--tensorrt-llm-model-name',
+                        type=str,
+                        required=False,
+                        default="tensorrt_llm",
+                        help='Name of the tensorrt_llm model')
+
+    parser.add_argument('--dataset',
+                        type=str,
+                        required=False,
+                        default=os.path.join(root_path, "ci", "L0_backend_trtllm",
+                                             "simple_data.json"),
+                        help='Dataset path used for the benchmark.')
+
+    FLAGS = parser.parse_args()
+
+    try:
+        client = grpcclient.InferenceServerClient(url=FLAGS.url)
+    except Exception as e:
+        print("client creation failed: " + str(e))
+        sys.exit(1)
+
+    # Tokenize the dataset once, both passes send the same input ids
+    requests = []
+    with open(FLAGS.dataset, 'r') as f:
+        data_dict = json.load(f)
+        for req in data_dict:
+            prompt = req['input'] + ' ' + req['instruction']
+            output = req['output']
+            # 1.3 is a magic number that converts number of words to number of tokens
+            if int(len(prompt.split(' ')) / 1.3) > FLAGS.max_input_len:
+                continue
+            # 1.3 is a magic number that converts number of words to number of tokens
+            output_len = int(len(output.split(' ')) * 1.3)
+            result = client.infer(
+                FLAGS.preprocessor_model_name,
+                client_utils.get_preprocessor_inputs(prompt, output_len, [],
+                                                     [], None, None))
+            requests.append(
+                client_utils.extract_preprocessor_outputs(result) +
+                (output_len, ))
+
+    baseline, baseline_tokens, baseline_responses, baseline_iterations, baseline_time = run_pass(
+        client, requests, False, FLAGS)
+    lookup, lookup_tokens, lookup_responses, lookup_iterations, lookup_time = run_pass(
+        client, requests, True, FLAGS)
+
+    num_mismatches = sum(1 for a, b in zip(baseline, lookup) if a != b)
+    if FLAGS.verbose:
+        for i, (a, b) in enumerate(zip(baseline, lookup)):
+            if a != b:
+                print(f"{i}: Outputs don't match")
+                print(f"Output without prompt lookup: {a}")
+                print(f"Output with prompt lookup: {b}")
+
+    print(f"requests: {len(requests)}, mismatches: {num_mismatches}")
+    # Requests are sent one at a time, so engine steps are not shared between requests
+    for name, tokens, responses, iterations, elapsed in [
+        ("without prompt lookup", baseline_tokens, baseline_responses,
+         baseline_iterations, baseline_time),
+        ("with prompt lookup", lookup_tokens, lookup_responses,
+         lookup_iterations, lookup_time)
+    ]:
+        print(
+            f"{name}: {tokens} tokens, {iterations} steps, {tokens / max(iterations, 1):.2f} tokens/step, "
+            f"{tokens / max(responses, 1):.2f} tokens/response, {elapsed:.2f} s"
+        )
@@ -0,0 +1,130 @@
+#!/usr/bin/python
+
+import os
+import sys
+
+utils_path = os.path.dirname(os.path.dirname(os.path.realpath(__file__)))
+root_path = os.path.dirname(utils_path)
+sys.path.append(utils_path)
+sys.path.append(os.path.join(root_path, "inflight_batcher_llm"))
+
+import argparse
+import queue
+import time
+from concurrent.futures import ThreadPoolExecutor
+from functools import partial
+
+import numpy as np
+import tritonclient.grpc as grpcclient
+from client import e2e_grpc_speculative_decoding_client as client_utils
+
+
+def callback(response_times, result, error):
+    response_times.put((time.time(), error))
+
+
+def stream_request(FLAGS, request_id):
+    # Time to the first response and times between the next responses of a streaming request
+    client = grpcclient.InferenceServerClient(url=FLAGS.url)
+    input_ids = np.random.randint(100,
+                                  1000,
+                                  size=FLAGS.input_len,
+                                  dtype=np.int32)
+    inputs = [
+        client_utils.prepare_tensor("input_ids",
+                                    np.expand_dims(input_ids, axis=0)),
+        client_utils.prepare_tensor(
+            "input_lengths", np.array([[FLAGS.input_len]], dtype=np.int32)),
+        client_utils.prepare_tensor(
+            "request_output_len",
+            np.array([[FLAGS.output_len]], dtype=np.int32)),
+        client_utils.prepare_tensor("streaming", np.array([[True]],
+                                                          dtype=bool)),
+    ]
+
+    response_times = queue.Queue()
+    client.start_stream(callback=partial(callback, response_times))
+    start_time = time.time()
+    client.async_stream_infer(FLAGS.tensorrt_llm_model_name,
+                              inputs,
+                              request_id=str(request_id))
+    client.stop_stream()
+
+    times = []
+    while not response_times.empty():
+        response_time, error = response_times.get()
+        if error is not None:
+            raise Exception(f"request {request_id} failed: {error}")
+        times.append(response_time)
+    if not times:
+        return None, []
+    return times[0] - start_time, list(np.diff(times))
+
+
+def percentiles(values):
+    values = sorted(values)
+    if not values:
+        return "n/a"
+    p50 = values[len(values) // 2] * 1000
+    p99 = values[min(len(values) - 1, int(len(values) * 0.99))] * 1000
+    return f"p50 {p50:.2f} ms, p99 {p99:.2f} ms"
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(
+        description=
+        'Measure the latency of the streamed responses of a decoupled tensorrt_llm model. Run it against the '
+        'server started with cpu_affinity set to none and to auto to compare the response paths.'
+    )
+    parser.add_argument('-u',
+                        '--url',
+                        type=str,
+                        required=False,
+                        default='localhost:8001',
+                        help='Inference server URL')
+
+    parser.add_argument('--tensorrt-llm-model-name',
+                        type=str,
+                        required=False,
+                        default="tensorrt_llm",
+                        help='Name of the tensorrt_llm model')
+
+    parser.add_argument('--num-requests',
+                        type=int,
+                        required=False,
+                        default=200,
+                        help='Number of requests')
+
+    parser.add_argument('--concurrency',
+                        type=int,
+                        required=False,
+                        default=16,
+                        help='Number of requests in flight')
+
+    parser.add_argument('--input-len',
+                        type=int,
+                        required=False,
+                        default=128,
+                        help='Number of input tokens of the requests')
+
+    parser.add_argument('-o',
+                        '--output-len',
+                        type=int,
+                        required=False,
+                        default=64,
+                        help='Number of output tokens of the requests')
+
+    FLAGS = parser.parse_args()
+
+    start_time = time.time()
+    with ThreadPoolExecutor(max_workers=FLAGS.concurrency) as executor:
+        results = list(
+            executor.map(lambda i: stream_request(FLAGS, i),
+                         range(FLAGS.num_requests)))
+    duration = time.time() - start_time
+
+    first_response_times = [r[0] for r in results if r[0] is not None]
+    inter_response_times = [t for r in results for t in r[1]]
+    print(f"{FLAGS.num_requests} requests in {duration:.2f} s")
+    print(f"first response: {percentiles(first_response_times)}")
+    print(f"between responses: {percentiles(inter_response_times)}")